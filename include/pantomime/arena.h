@@ -0,0 +1,55 @@
+/*******************************************************************************
+ * arena.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file arena.h
+ * @brief A region allocator for data that's freed all at once.
+ *
+ * An arena hands out memory from a chain of large blocks. Nothing allocated from an arena
+ * is freed on its own; the whole arena is released at once. That makes allocating a
+ * pointer bump, and releasing thousands of small objects a handful of calls to free().
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE 65536 /* The size of an arena's blocks, unless an allocation is larger. */
+
+struct arena_block {
+    struct arena_block *next; /**< The block allocated before this one. */
+    size_t size;              /**< The number of bytes in data. */
+    size_t used;              /**< The number of bytes of data handed out. */
+    _Alignas(max_align_t) unsigned char data[];
+};
+
+struct arena {
+    struct arena_block *head; /**< The block being allocated from, or NULL if there is none. */
+    size_t used;              /**< The number of bytes handed out from every block. */
+};
+
+void arena_initialize(struct arena *arena);
+void arena_release(struct arena *arena);
+
+void *arena_alloc(struct arena *arena, size_t size);
+char *arena_strdup(struct arena *arena, const char *str);
+void arena_adopt(struct arena *arena, struct arena *other);
+
+#endif /* ARENA_H */
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * event_loop.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file event_loop.h
+ * @brief Waits on everything the client reacts to with a single poll().
+ *
+ * The loop watches the terminal, the pipe the MPD worker thread signals when it has
+ * replies, a timerfd for redraws that depend on time passing, and a signalfd for
+ * signals. Nothing wakes the process unless one of them is ready, so an idle client
+ * with nothing playing never wakes up at all.
+ *
+ * The signals are blocked for the whole process, so they must be blocked before any
+ * other thread is started, or that thread could still receive them.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <poll.h>
+#include <stdbool.h>
+
+/**
+ * @brief The things an event loop waits on. Each one is a bit in what it returns.
+ */
+enum event_source {
+    EVENT_INPUT,  /**< The terminal has input. */
+    EVENT_SERVER, /**< The MPD worker thread has sent replies. */
+    EVENT_TICK,   /**< The tick timer has expired. */
+    EVENT_SIGNAL, /**< A watched signal has arrived. */
+    NUM_EVENT_SOURCES
+};
+
+#define EVENT_READY(ready, source) (((ready) >> (source)) & 1)
+
+struct event_loop {
+    struct pollfd fds[NUM_EVENT_SOURCES]; /**< What to wait on, indexed by source. */
+    bool input_closed;                    /**< Whether the terminal hung up unreported. */
+};
+
+bool event_loop_initialize(struct event_loop *loop);
+void event_loop_release(struct event_loop *loop);
+
+void event_loop_watch(struct event_loop *loop, enum event_source source, int fd);
+void event_loop_set_tick(struct event_loop *loop, int delay_ms);
+
+unsigned event_loop_wait(struct event_loop *loop);
+int event_loop_next_signal(struct event_loop *loop);
+
+#endif /* EVENT_LOOP_H */
@@ -0,0 +1,51 @@
+/*******************************************************************************
+ * intern.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file intern.h
+ * @brief A process-wide table of interned strings.
+ *
+ * Interning a string stores it once and gives it a small, stable ID. Equal strings
+ * always get the same ID, so comparing IDs compares the strings, and tables keyed by ID
+ * can be plain arrays. Interned strings are never freed, so the table is meant for values
+ * that repeat, such as artist and album names, not for every string the client sees.
+ *
+ * Any thread can intern strings. Looking up a string by ID takes no lock, as long as the
+ * ID was handed over from the interning thread through something that synchronizes,
+ * such as the worker's [ring buffers](@ref ringbuffer.h).
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <limits.h>
+
+#define INTERN_EMPTY 0              /* The ID of the empty string, which stands for no value. */
+#define INTERN_NOT_FOUND UINT_MAX   /* What intern_find() gives for a string with no ID. */
+#define INTERN_CHUNK_SIZE 4096      /* The number of strings in each chunk of the ID table. */
+#define INTERN_MAX_CHUNKS 4096      /* The most chunks the ID table can have. */
+#define INTERN_MIN_CAPACITY 1024    /* The number of slots in the hash table's first allocation. */
+
+unsigned intern(const char *str);
+unsigned intern_find(const char *str);
+const char *intern_string(unsigned id);
+unsigned intern_count();
+void intern_release();
+
+#endif /* INTERN_H */
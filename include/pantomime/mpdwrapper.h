@@ -31,51 +31,137 @@
 struct mpdwrapper;
 struct songlist;
 
+/**
+ * @brief The kinds of lists that can be requested from the music database.
+ */
+enum mpdwrapper_list { LIST_ARTISTS, LIST_ALBUMS, LIST_SONGS };
+
+/**
+ * @brief The state of the connection to the server.
+ */
+enum mpdwrapper_connection {
+    CONNECTION_CONNECTING,   /**< A connection attempt is under way. */
+    CONNECTION_CONNECTED,    /**< Connected, and the state shown is the server's. */
+    CONNECTION_DISCONNECTED, /**< The last attempt failed, and another is scheduled. */
+};
+
+/**
+ * @brief A song in the queue.
+ *
+ * Queue songs and their strings are allocated together in the queue's
+ * [arena](@ref arena.h), and are only valid until the queue next changes.
+ * Artists and albums repeat across the queue, so they're [interned](@ref intern.h)
+ * instead.
+ */
+struct queue_song {
+    unsigned id;        /**< The song's MPD ID. */
+    unsigned duration;  /**< The song's length in seconds, or 0 if it's unknown. */
+    unsigned artist_id; /**< The song's interned artist, or INTERN_EMPTY if it isn't tagged. */
+    unsigned album_id;  /**< The song's interned album, or INTERN_EMPTY if it isn't tagged. */
+    const char *uri;    /**< The song's URI. */
+    const char *title;  /**< The song's title, or NULL if it isn't tagged. */
+};
+
+/**
+ * @brief A read-only view of the queue's columns.
+ *
+ * Each array has one entry per song, in queue order, so an index into the arrays is
+ * also the song's position in the queue. The arrays are only valid until the queue
+ * next changes.
+ */
+struct queue_columns {
+    const unsigned *ids;        /**< Each song's MPD ID. */
+    const unsigned *durations;  /**< Each song's length in seconds, or 0 if it's unknown. */
+    const unsigned *artist_ids; /**< Each song's interned artist. */
+    const unsigned *album_ids;  /**< Each song's interned album. */
+    int count;                  /**< The number of songs. */
+};
+
+/**
+ * @brief Callbacks for results that arrive after the request that caused them.
+ *
+ * Handlers are only ever called from mpdwrapper_refresh(), on the thread that calls it.
+ */
+struct mpdwrapper_handlers {
+    /** Receives a requested list of names. The array is only valid during the call, and
+     * so are song titles; artist and album names are [interned](@ref intern.h). */
+    void (*on_list)(void *data, enum mpdwrapper_list type, const char *const *names, int count);
+    /** Receives a description of a failed request. The message is freed after the call. */
+    void (*on_error)(void *data, char *message);
+};
+
 struct mpdwrapper *mpdwrapper_new(const char *host, int port, int timeout);
 void mpdwrapper_free(struct mpdwrapper *mpd);
+void mpdwrapper_set_handlers(struct mpdwrapper *mpd, const struct mpdwrapper_handlers *handlers,
+                             void *data);
 
-void mpdwrapper_delete_from_queue(struct mpdwrapper *mpd, unsigned pos);
-void mpdwrapper_clear_queue(struct mpdwrapper *mpd);
+bool mpdwrapper_delete_from_queue(struct mpdwrapper *mpd, unsigned pos);
+bool mpdwrapper_delete_range(struct mpdwrapper *mpd, unsigned start, unsigned end);
+bool mpdwrapper_clear_queue(struct mpdwrapper *mpd);
 
-void mpdwrapper_refresh(struct mpdwrapper *mpd);
-int mpdwrapper_update_db(struct mpdwrapper *mpd);
+bool mpdwrapper_refresh(struct mpdwrapper *mpd);
+int mpdwrapper_get_fd(struct mpdwrapper *mpd);
+int mpdwrapper_flush(struct mpdwrapper *mpd);
+bool mpdwrapper_update_db(struct mpdwrapper *mpd);
 
 struct mpd_status *mpdwrapper_get_status(struct mpdwrapper *mpd);
+struct mpd_stats *mpdwrapper_get_stats(struct mpdwrapper *mpd);
 struct songlist *mpdwrapper_get_queue(struct mpdwrapper *mpd);
 
 bool mpdwrapper_is_playing(struct mpdwrapper *mpd);
 bool mpdwrapper_is_paused(struct mpdwrapper *mpd);
 bool mpdwrapper_is_stopped(struct mpdwrapper *mpd);
 bool mpdwrapper_has_valid_state(struct mpdwrapper *mpd);
-bool mpdwrapper_queue_changed(struct mpdwrapper *mpd);
+int mpdwrapper_get_volume(struct mpdwrapper *mpd);
+enum mpdwrapper_connection mpdwrapper_get_connection(struct mpdwrapper *mpd);
+const char *mpdwrapper_get_connection_error(struct mpdwrapper *mpd);
+int mpdwrapper_get_reconnect_delay_ms(struct mpdwrapper *mpd);
+unsigned mpdwrapper_get_queue_changes(struct mpdwrapper *mpd);
+unsigned mpdwrapper_get_queue_version(struct mpdwrapper *mpd);
+unsigned mpdwrapper_get_db_version(struct mpdwrapper *mpd);
 
 struct mpd_song *mpdwrapper_get_current_song(struct mpdwrapper *mpd);
 const char *mpdwrapper_get_current_song_title(struct mpdwrapper *mpd);
 int mpdwrapper_get_current_song_duration(struct mpdwrapper *mpd);
 int mpdwrapper_get_current_song_elapsed(struct mpdwrapper *mpd);
+int mpdwrapper_get_current_song_elapsed_ms(struct mpdwrapper *mpd);
 int mpdwrapper_get_current_song_id(struct mpdwrapper *mpd);
 
 /* TODO: Make this function internal? */
 char *mpdwrapper_get_song_tag(struct mpd_song *song, enum mpd_tag_type tag);
 
-struct stringlist *mpdwrapper_list_artists(struct mpdwrapper *mpd);
-struct stringlist *mpdwrapper_list_albums(struct mpdwrapper *mpd, char *artist);
-struct stringlist *mpdwrapper_list_songs(struct mpdwrapper *mpd, char *artist, char *album);
-
-char *mpdwrapper_get_last_error_message(struct mpdwrapper *mpd);
+bool mpdwrapper_list_artists(struct mpdwrapper *mpd);
+bool mpdwrapper_list_albums(struct mpdwrapper *mpd, const char *artist);
+bool mpdwrapper_list_songs(struct mpdwrapper *mpd, const char *artist, const char *album);
 
 bool mpdwrapper_play_queue_pos(struct mpdwrapper *mpd, unsigned pos);
-bool mpdwrapper_add_artist(struct mpdwrapper *mpd, char *artist);
-bool mpdwrapper_add_album(struct mpdwrapper *mpd, char *artist, char *album);
-bool mpdwrapper_add_song(struct mpdwrapper *mpd, char *artist, char *album, char *song);
+bool mpdwrapper_toggle_pause(struct mpdwrapper *mpd);
+bool mpdwrapper_stop(struct mpdwrapper *mpd);
+bool mpdwrapper_seek_by(struct mpdwrapper *mpd, int delta_ms);
+bool mpdwrapper_prev_song(struct mpdwrapper *mpd);
+bool mpdwrapper_next_song(struct mpdwrapper *mpd);
+bool mpdwrapper_set_repeat(struct mpdwrapper *mpd, bool mode);
+bool mpdwrapper_set_random(struct mpdwrapper *mpd, bool mode);
+bool mpdwrapper_set_single(struct mpdwrapper *mpd, bool mode);
+bool mpdwrapper_set_consume(struct mpdwrapper *mpd, bool mode);
+bool mpdwrapper_set_crossfade(struct mpdwrapper *mpd, unsigned seconds);
+bool mpdwrapper_change_volume(struct mpdwrapper *mpd, int delta);
+
+bool mpdwrapper_add_artist(struct mpdwrapper *mpd, const char *artist);
+bool mpdwrapper_add_album(struct mpdwrapper *mpd, const char *artist, const char *album);
+bool mpdwrapper_add_song(struct mpdwrapper *mpd, const char *artist, const char *album,
+                         const char *song);
 
 struct songlist *songlist_new();
 void songlist_free(struct songlist *songlist);
 
-struct mpd_song *songlist_at(struct songlist *songlist, unsigned int index);
+struct queue_song *songlist_at(struct songlist *songlist, unsigned int index);
 int songlist_get_size(struct songlist *songlist);
+void songlist_get_columns(struct songlist *songlist, struct queue_columns *columns);
+int songlist_find_id(struct songlist *songlist, unsigned id);
+bool songlist_take_changes(struct songlist *songlist, const unsigned **ids, int *count);
 
-void songlist_append(struct songlist *songlist, struct mpd_song *song);
+void songlist_append(struct songlist *songlist, const struct queue_song *song);
 void songlist_remove(struct songlist *songlist, unsigned int index);
 void songlist_clear(struct songlist *songlist);
 
@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * ringbuffer.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file ringbuffer.h
+ * @brief A bounded, lock-free queue for passing messages between two threads.
+ *
+ * Exactly one thread may push to a ring buffer and exactly one other thread may pop
+ * from it. Elements are copied in and out by value, so they should be small structs
+ * that refer to any larger data by pointer.
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct ringbuffer {
+    unsigned char *slots; /**< Storage for capacity elements of element_size bytes each. */
+    size_t element_size;  /**< The size of one element in bytes. */
+    size_t capacity;      /**< The number of slots. Always a power of two. */
+
+    /* The indexes only ever increase and are masked to find a slot. They're kept on
+     * separate cache lines so the two threads don't contend for the same line. */
+    _Alignas(64) atomic_size_t head; /**< The next slot to pop. Written by the consumer. */
+    _Alignas(64) atomic_size_t tail; /**< The next slot to push. Written by the producer. */
+};
+
+struct ringbuffer *ringbuffer_new(size_t capacity, size_t element_size);
+void ringbuffer_free(struct ringbuffer *ring);
+
+bool ringbuffer_push(struct ringbuffer *ring, const void *element);
+bool ringbuffer_pop(struct ringbuffer *ring, void *element);
+bool ringbuffer_is_empty(struct ringbuffer *ring);
+
+#endif /* RINGBUFFER_H */
@@ -32,6 +32,9 @@ struct statusbar *statusbar_new();
 void statusbar_free(struct statusbar *statusbar);
 
 void statusbar_draw(struct statusbar *statusbar, struct mpdwrapper *mpd);
+int statusbar_next_change(struct statusbar *statusbar, struct mpdwrapper *mpd);
+void statusbar_invalidate(struct statusbar *statusbar);
 void statusbar_set_notification(struct statusbar *statusbar, char *msg, int duration);
+void statusbar_set_prompt(struct statusbar *statusbar, const char *prompt);
 
 #endif /* STATUSBAR_H */
@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * trigram_index.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file trigram_index.h
+ * @brief A substring search index over a growing list of strings.
+ *
+ * Each string is normalized (ASCII letters are lowercased) and every three-byte
+ * sequence in it is recorded in a posting list, along with where it first appears. A
+ * query is answered by intersecting the posting lists of its own trigrams, starting with
+ * the shortest. When every trigram first appears where the query would put it, the
+ * string is a match without being read; only the rest are checked against the text.
+ *
+ * Strings are numbered in the order they're added, which keeps every posting list
+ * sorted, so adding a string never touches existing entries. Removing a string only
+ * marks its ID, and searches skip it; once removed strings make up much of the index,
+ * the owner is expected to clear and refill it.
+ *
+ * Queries shorter than three bytes have no trigrams, so they're checked against every
+ * string instead.
+ */
+
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The strings containing one trigram.
+ */
+struct trigram_postings {
+    uint32_t trigram; /**< The three bytes, plus one so zero can mark an empty slot. */
+    int *ids;         /**< The strings containing the trigram, in increasing order. */
+    uint8_t *offsets; /**< Where the trigram first appears in each string, up to 255. */
+    int count;        /**< The number of strings. */
+    int capacity;     /**< The number of strings there is room for. */
+};
+
+struct trigram_index {
+    struct trigram_postings *postings; /**< A hash table of posting lists, by trigram. */
+    int postings_count;                /**< The number of distinct trigrams. */
+    int postings_capacity;             /**< The number of slots. A power of two. */
+
+    uint32_t *offsets; /**< Where each normalized string starts in text. */
+    bool *removed;     /**< Whether each string has been removed. */
+    int count;         /**< The number of strings, including removed ones. */
+    int removed_count; /**< The number of removed strings. */
+    int capacity;      /**< The number of strings there is room for. */
+
+    char *text;           /**< The normalized strings, NUL-terminated. */
+    size_t text_size;     /**< The number of bytes used in text. */
+    size_t text_capacity; /**< The size of text. */
+};
+
+struct trigram_index *trigram_index_new();
+void trigram_index_free(struct trigram_index *index);
+
+int trigram_index_add(struct trigram_index *index, const char *str);
+void trigram_index_remove(struct trigram_index *index, int id);
+int trigram_index_replace(struct trigram_index *index, int id, const char *str);
+void trigram_index_clear(struct trigram_index *index);
+
+int trigram_index_search(struct trigram_index *index, const char *query, int *results);
+bool trigram_index_match(struct trigram_index *index, int id, const char *query);
+
+#endif /* TRIGRAM_INDEX_H */
@@ -35,5 +35,11 @@ void ui_free(struct ui *ui);
 
 void ui_draw(struct ui *ui, struct mpdwrapper *mpd);
 void ui_set_visible_panel(struct ui *ui, enum ui_panel panel);
+int ui_next_tick(struct ui *ui, struct mpdwrapper *mpd);
+void ui_resize(struct ui *ui);
+
+void ui_search_begin(struct ui *ui);
+bool ui_search_is_active(struct ui *ui);
+void ui_search_input(struct ui *ui, int key);
 
 #endif /* UI_H */
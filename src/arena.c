@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * arena.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file arena.h
+ */
+
+#include "pantomime/arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Sets up an empty arena. No memory is allocated until the first allocation.
+ */
+void arena_initialize(struct arena *arena)
+{
+    arena->head = NULL;
+    arena->used = 0;
+}
+
+/**
+ * @brief Frees every block in an arena, and with them everything allocated from it.
+ *
+ * The arena is left empty and can be allocated from again.
+ */
+void arena_release(struct arena *arena)
+{
+    struct arena_block *block = arena->head;
+
+    while (block) {
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena_initialize(arena);
+}
+
+/**
+ * @brief Allocates memory from an arena at the given alignment.
+ *
+ * @param align A power of two no greater than the alignment of max_align_t.
+ * @return A pointer to the memory, or NULL on error.
+ */
+static void *arena_alloc_aligned(struct arena *arena, size_t size, size_t align)
+{
+    struct arena_block *block = arena->head;
+    size_t offset = block ? (block->used + align - 1) & ~(align - 1) : 0;
+
+    if (!block || offset > block->size || block->size - offset < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+
+        block = malloc(sizeof(*block) + block_size);
+        if (!block)
+            return NULL;
+
+        block->size = block_size;
+        block->used = 0;
+        offset = 0;
+
+        /* An oversized block is filled by this allocation, so it goes behind the head
+         * to leave the head's free space for the allocations that follow. */
+        if (arena->head && size > ARENA_BLOCK_SIZE) {
+            block->next = arena->head->next;
+            arena->head->next = block;
+        }
+        else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+
+    arena->used += offset + size - block->used;
+    block->used = offset + size;
+
+    return block->data + offset;
+}
+
+/**
+ * @brief Allocates memory from an arena, aligned for any type.
+ *
+ * The memory stays valid until the arena is released.
+ *
+ * @return A pointer to the memory, or NULL on error.
+ */
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    return arena_alloc_aligned(arena, size, alignof(max_align_t));
+}
+
+/**
+ * @brief Copies a string into an arena.
+ *
+ * @return The copy, or NULL on error.
+ */
+char *arena_strdup(struct arena *arena, const char *str)
+{
+    size_t length = strlen(str) + 1;
+
+    char *copy = arena_alloc_aligned(arena, length, 1);
+    if (copy)
+        memcpy(copy, str, length);
+
+    return copy;
+}
+
+/**
+ * @brief Moves every block from one arena into another.
+ *
+ * Everything allocated from the other arena stays where it is, but now belongs to the
+ * first arena and is freed when it's released. The other arena is left empty.
+ */
+void arena_adopt(struct arena *arena, struct arena *other)
+{
+    if (!other->head)
+        return;
+
+    if (arena->head) {
+        /* The adopted blocks go behind the head, so the arena keeps filling its own block. */
+        struct arena_block *tail = other->head;
+        while (tail->next)
+            tail = tail->next;
+
+        tail->next = arena->head->next;
+        arena->head->next = other->head;
+    }
+    else
+        arena->head = other->head;
+
+    arena->used += other->used;
+    arena_initialize(other);
+}
@@ -24,8 +24,11 @@
 #include "command.h"
 
 #include <ncurses.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 
 #define KEY_CTRL(x) ((x)&0x1f)
 #define KEY_RETURN 10
@@ -71,7 +74,11 @@ static struct command commands[] = {
 
     {CMD_VOL_UP, {KEY_RIGHT, 0, 0}, "Volume up", "Increase the playback volume"},
 
-    {CMD_DELETE, {'d', 0, 0}, "Delete", "Deletes a song from the queue"},
+    {CMD_DELETE,
+     {0, 0, 0},
+     "Delete",
+     "Delete the selected song, or N songs with a count",
+     {'d', 'd'}},
 
     {CMD_CLEAR, {'C', 0, 0}, "Clear Queue", "Removes all songs from the queue"},
 
@@ -103,55 +110,404 @@ static struct command commands[] = {
     {CMD_CURSOR_MIDDLE,
      {'M', 0, 0},
      "Move to middle",
-     "Move the cursor to the middle of the screen"}};
+     "Move the cursor to the middle of the screen"},
+
+    {CMD_CURSOR_FIRST,
+     {KEY_HOME, 0, 0},
+     "Go to first",
+     "Move the cursor to the first line, or to line N with a count",
+     {'g', 'g'}},
+
+    {CMD_CURSOR_LAST,
+     {'G', KEY_END, 0},
+     "Go to last",
+     "Move the cursor to the last line, or to line N with a count"},
+
+    {CMD_SEARCH, {'/', 0, 0}, "Search", "Filter the current list as you type"},
+
+    {CMD_JUMP_PLAYING, {'o', 0, 0}, "Jump to playing", "Move the cursor to the playing song"},
+
+    {CMD_FOLLOW_PLAYING,
+     {'F', 0, 0},
+     "Follow playing",
+     "Toggle moving the cursor to each new song as it starts playing"}};
+
+/* The keymap is a trie with a node for each key of each binding. The first key of a
+ * binding, below KEY_MAX, which covers every character and every key curses names, is
+ * looked up directly in a flat table. Anything wider, like a key added with define_key(),
+ * goes through a small hash table. Keys after the first are found by walking a node's
+ * children, of which there are only ever a few. */
+#define KEYMAP_DIRECT_KEYS (KEY_MAX + 1)
+#define KEYMAP_SLOTS 512 /* A power of two at least twice the number of first keys. */
+#define KEYMAP_NODES (1 + NUM_CMDS * (MAX_KEYS + MAX_SEQUENCE_LENGTH))
+
+_Static_assert(KEYMAP_SLOTS >= 2 * NUM_CMDS * (MAX_KEYS + 1),
+               "the keymap's hash table is too small");
+_Static_assert(KEYMAP_NODES <= 0xffff, "the keymap has too many nodes");
 
 /**
- * @brief Finds the command mapped to the given key.
+ * @brief A first key too wide for the direct table.
+ */
+struct keymap_slot {
+    int key;             /* The key, or 0 if the slot is empty. */
+    unsigned short node; /* The node the key leads to. */
+};
+
+/**
+ * @brief A key in a binding, and what the keys leading up to it run.
+ */
+struct keymap_node {
+    int key;                /* The key that leads here from the parent node. */
+    enum command_type cmd;  /* The command the keys up to here run, or CMD_NULL. */
+    unsigned short child;   /* The first node one key further on, or 0 if none. */
+    unsigned short sibling; /* The next node with the same parent, or 0 if none. */
+};
+
+/**
+ * @brief The bindings in commands[], compiled for lookup by key.
  *
- * @param key The key that was pressed by the user.
- * @return The command mapped to the key.
+ * Rebuilt whenever a binding changes, which is rare next to looking keys up.
  */
-enum command_type find_key_command(int key)
+static struct keymap {
+    unsigned short direct[KEYMAP_DIRECT_KEYS]; /* The node for each narrow first key. */
+    struct keymap_slot slots[KEYMAP_SLOTS];    /* The nodes for wide first keys. */
+    struct keymap_node nodes[KEYMAP_NODES];    /* Every node. The first is the root. */
+    int node_count;                            /* The number of nodes in use. */
+    char labels[NUM_CMDS][COMMAND_LABEL_LENGTH]; /* The names of each command's keys. */
+} keymap;
+
+static unsigned keymap_hash(int key)
+{
+    return ((unsigned)key * 2654435761u) & (KEYMAP_SLOTS - 1);
+}
+
+/**
+ * @brief Finds the node a key leads to from another node.
+ *
+ * @return The node's index, or 0 if the key doesn't lead anywhere.
+ */
+static int keymap_child(int node, int key)
 {
-    if (key == 0)
-        return CMD_NULL;
+    if (key <= 0)
+        return 0;
 
-    for (int i = 0; i < NUM_CMDS; ++i) {     /* Search each command. */
-        for (int j = 0; j < MAX_KEYS; ++j) { /* Search each key mapped to the command. */
-            if (key == commands[i].keys[j])
-                return commands[i].cmd;
+    if (node == 0 && key < KEYMAP_DIRECT_KEYS)
+        return keymap.direct[key];
+
+    if (node == 0) {
+        for (unsigned slot = keymap_hash(key); keymap.slots[slot].key != 0;
+             slot = (slot + 1) & (KEYMAP_SLOTS - 1)) {
+            if (keymap.slots[slot].key == key)
+                return keymap.slots[slot].node;
         }
+        return 0;
     }
 
-    return CMD_NULL;
+    for (int child = keymap.nodes[node].child; child; child = keymap.nodes[child].sibling) {
+        if (keymap.nodes[child].key == key)
+            return child;
+    }
+    return 0;
 }
 
 /**
- * @brief Gets a string representation of the keys mapped to a command.
+ * @brief Finds the node a key leads to from another node, adding it if there isn't one.
+ */
+static int keymap_add_child(int node, int key)
+{
+    int child = keymap_child(node, key);
+    if (child)
+        return child;
+
+    child = keymap.node_count++;
+    keymap.nodes[child] = (struct keymap_node){.key = key};
+
+    if (node == 0 && key < KEYMAP_DIRECT_KEYS) {
+        keymap.direct[key] = child;
+    }
+    else if (node == 0) {
+        unsigned slot = keymap_hash(key);
+        while (keymap.slots[slot].key != 0)
+            slot = (slot + 1) & (KEYMAP_SLOTS - 1);
+        keymap.slots[slot] = (struct keymap_slot){key, child};
+    }
+    else {
+        keymap.nodes[child].sibling = keymap.nodes[node].child;
+        keymap.nodes[node].child = child;
+    }
+
+    return child;
+}
+
+/**
+ * @brief Adds a binding to the keymap, unless its keys are already bound.
+ *
+ * Bindings are added in table order, so keys listed under two commands go to the first
+ * of them.
+ *
+ * @param keys The keys to press, one after another. Stops at the first 0.
  */
-void get_command_keys(enum command_type cmd, char *buffer)
+static void keymap_add(const int *keys, int length, enum command_type cmd)
 {
+    int node = 0;
+
+    for (int i = 0; i < length && keys[i] > 0; ++i)
+        node = keymap_add_child(node, keys[i]);
+
+    if (node != 0 && keymap.nodes[node].cmd == CMD_NULL)
+        keymap.nodes[node].cmd = cmd;
+}
+
+/**
+ * @brief Builds the names of a command's keys, separated by spaces.
+ *
+ * A key sequence is named by its keys run together, like "gg".
+ */
+static void keymap_label(enum command_type cmd)
+{
+    char *label = keymap.labels[cmd];
+    char key_str[KEY_LABEL_LENGTH];
+
+    label[0] = '\0';
+    for (int i = 0; i < MAX_KEYS && commands[cmd].keys[i] != 0; ++i) {
+        key_to_str(commands[cmd].keys[i], key_str);
+        if (label[0] != '\0')
+            strcat(label, " ");
+        strcat(label, key_str);
+    }
+
+    for (int i = 0; i < MAX_SEQUENCE_LENGTH && commands[cmd].sequence[i] != 0; ++i) {
+        key_to_str(commands[cmd].sequence[i], key_str);
+        if (i == 0 && label[0] != '\0')
+            strcat(label, " ");
+        strcat(label, key_str);
+    }
+}
+
+/**
+ * @brief Compiles the key bindings for lookup. Call this once at startup.
+ *
+ * Afterwards, following a key and finding the names of a command's keys take the same
+ * time however many commands and bindings there are.
+ */
+void build_keymap(void)
+{
+    memset(&keymap, 0, sizeof(keymap));
+    keymap.node_count = 1;
+
+    for (int i = 0; i < NUM_CMDS; ++i) {
+        for (int j = 0; j < MAX_KEYS; ++j)
+            keymap_add(&commands[i].keys[j], 1, commands[i].cmd);
+        keymap_add(commands[i].sequence, MAX_SEQUENCE_LENGTH, commands[i].cmd);
+        keymap_label(commands[i].cmd);
+    }
+}
+
+/**
+ * @brief Removes a key from whichever command it's bound to, if any.
+ *
+ * The command's other keys keep their order. The keymap isn't rebuilt.
+ */
+static void remove_key(int key)
+{
+    for (int i = 0; i < NUM_CMDS; ++i) {
+        int *keys = commands[i].keys;
+
+        for (int j = 0; j < MAX_KEYS; ++j) {
+            if (keys[j] != key)
+                continue;
+            memmove(&keys[j], &keys[j + 1], (MAX_KEYS - j - 1) * sizeof(*keys));
+            keys[MAX_KEYS - 1] = 0;
+            --j;
+        }
+    }
+}
+
+/**
+ * @brief Binds a key to a command while the client is running.
+ *
+ * The key is taken from any command it was bound to before. If the command already has
+ * as many keys as it can hold, its first key is dropped to make room.
+ *
+ * @return true if the key was bound, or false if the key or command isn't valid.
+ */
+bool bind_key(int key, enum command_type cmd)
+{
+    if (key <= 0 || cmd <= CMD_NULL || cmd >= NUM_CMDS)
+        return false;
+
+    remove_key(key);
+
     int *keys = commands[cmd].keys;
-    char *key_str = malloc(16 * sizeof(char));
+    int count = 0;
 
-    if (!key_str)
+    while (count < MAX_KEYS && keys[count] != 0)
+        ++count;
+    if (count == MAX_KEYS) {
+        memmove(&keys[0], &keys[1], (MAX_KEYS - 1) * sizeof(*keys));
+        --count;
+    }
+    keys[count] = key;
+
+    build_keymap();
+    return true;
+}
+
+/**
+ * @brief Unbinds a key, so pressing it does nothing.
+ */
+void unbind_key(int key)
+{
+    if (key <= 0)
         return;
 
-    key_to_str(keys[0], key_str);
-    strcpy(buffer, key_str);
+    remove_key(key);
+    build_keymap();
+}
+
+/**
+ * @brief Finds a command by the name shown in the help screen, ignoring case.
+ *
+ * @return The command, or CMD_NULL if no command has that name.
+ */
+enum command_type find_command(const char *name)
+{
+    for (int i = CMD_NULL + 1; i < NUM_CMDS; ++i)
+        if (strcasecmp(commands[i].name, name) == 0)
+            return commands[i].cmd;
+    return CMD_NULL;
+}
+
+/**
+ * @brief Finds the command mapped to the given key.
+ *
+ * Only single keys are matched. Key sequences and counts go through key_sequence_feed().
+ *
+ * @param key The key that was pressed by the user.
+ * @return The command mapped to the key.
+ */
+enum command_type find_key_command(int key)
+{
+    return keymap.nodes[keymap_child(0, key)].cmd;
+}
+
+/**
+ * @brief Gets the current time on the monotonic clock, in milliseconds.
+ */
+static uint64_t key_sequence_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void key_sequence_initialize(struct key_sequence *sequence)
+{
+    sequence->node = 0;
+    sequence->count = 0;
+    sequence->count_key = 0;
+    sequence->deadline = 0;
+}
+
+/**
+ * @brief Feeds the next key typed into a key sequence.
+ *
+ * A key that doesn't continue any binding throws away the keys before it, as in vi.
+ *
+ * @param call Set to the command to run, if the key completes one.
+ * @return true if a command is ready to run, or false if more keys are needed or the
+ *   keys didn't match anything.
+ */
+bool key_sequence_feed(struct key_sequence *sequence, int key, struct command_call *call)
+{
+    bool digit = key >= '0' && key <= '9' && (key != '0' || sequence->count > 0);
+
+    if (sequence->node == 0 && digit) {
+        sequence->count_key = (sequence->count == 0) ? key : 0;
+        sequence->count = sequence->count * 10 + (key - '0');
+        if (sequence->count > MAX_COUNT)
+            sequence->count = MAX_COUNT;
+        sequence->deadline = key_sequence_now() + KEY_SEQUENCE_TIMEOUT;
+        return false;
+    }
+
+    int node = keymap_child(sequence->node, key);
 
-    if (keys[1] != 0) {
-        key_to_str(keys[1], key_str);
-        strcat(buffer, " ");
-        strcat(buffer, key_str);
+    /* A binding that can't go on runs straight away. One that can waits to see whether
+     * the next key continues it. */
+    if (node && keymap.nodes[node].child == 0) {
+        *call = (struct command_call){keymap.nodes[node].cmd, sequence->count};
+        key_sequence_initialize(sequence);
+        return true;
     }
-    if (keys[2] != 0) {
-        key_to_str(keys[2], key_str);
-        strcat(buffer, " ");
-        strcat(buffer, key_str);
+    if (node == 0) {
+        key_sequence_initialize(sequence);
+        return false;
     }
 
-    free(key_str);
+    sequence->node = node;
+    sequence->count_key = 0;
+    sequence->deadline = key_sequence_now() + KEY_SEQUENCE_TIMEOUT;
+    return false;
+}
+
+/**
+ * @brief Gives up waiting for the next key of a sequence, once it's taken too long.
+ *
+ * If the keys typed so far are a binding in their own right, it runs. A single digit
+ * that's bound to a command, and wasn't followed by anything, runs that command.
+ *
+ * @param call Set to the command to run, if there is one.
+ * @return true if a command is ready to run.
+ */
+bool key_sequence_expire(struct key_sequence *sequence, struct command_call *call)
+{
+    if (key_sequence_get_delay(sequence) != 0)
+        return false;
+
+    enum command_type cmd = keymap.nodes[sequence->node].cmd;
+    int count = sequence->count;
+
+    if (sequence->node == 0) {
+        cmd = find_key_command(sequence->count_key);
+        count = 0;
+    }
+    key_sequence_initialize(sequence);
+
+    if (cmd == CMD_NULL)
+        return false;
+    *call = (struct command_call){cmd, count};
+    return true;
+}
+
+/**
+ * @brief Finds how long until a sequence that's been started times out.
+ *
+ * @return The number of milliseconds, or -1 if no keys are waiting.
+ */
+int key_sequence_get_delay(struct key_sequence *sequence)
+{
+    if (sequence->node == 0 && sequence->count == 0)
+        return -1;
+
+    uint64_t now = key_sequence_now();
+    return (now < sequence->deadline) ? (int)(sequence->deadline - now) : 0;
+}
+
+/**
+ * @brief Gets a string representation of the keys mapped to a command.
+ *
+ * The string is built along with the keymap, and stays valid until a key is rebound.
+ */
+const char *get_command_keys(enum command_type cmd)
+{
+    return keymap.labels[cmd];
+}
+
+const char *get_command_name(enum command_type cmd)
+{
+    return commands[cmd].name;
 }
 
 char *get_command_desc(enum command_type cmd)
@@ -161,6 +517,8 @@ char *get_command_desc(enum command_type cmd)
 
 /**
  * @brief Creates a string representation for a keypress.
+ *
+ * @param buffer Where to write the name. Must have room for KEY_LABEL_LENGTH bytes.
  */
 void key_to_str(int key, char *buffer)
 {
@@ -172,6 +530,9 @@ void key_to_str(int key, char *buffer)
         case KEY_RETURN:
             str = "Enter";
             break;
+        case ' ':
+            str = "Space";
+            break;
         case KEY_BACKSPACE:
             str = "Backspace";
             break;
@@ -240,19 +601,34 @@ void key_to_str(int key, char *buffer)
             break;
     }
 
-    int length;
-    if (str) {
-        length = strlen(str);
-        buffer = realloc(buffer, length * sizeof(char));
-        sprintf(buffer, str);
-    }
-    else if (!str && !(key & ~0x1f)) { /* A CTRL combo was pressed */
-        length = strlen("Ctrl-A");
-        buffer = realloc(buffer, length * sizeof(char));
-        sprintf(buffer, "Ctrl-%c", 'A' + (key & 0x1f) - 1);
-    }
-    else { /* The key is just one character */
-        buffer = realloc(buffer, sizeof(char));
-        sprintf(buffer, "%c", key);
+    if (str)
+        snprintf(buffer, KEY_LABEL_LENGTH, "%s", str);
+    else if (key > 0 && !(key & ~0x1f)) /* A CTRL combo was pressed */
+        snprintf(buffer, KEY_LABEL_LENGTH, "Ctrl-%c", 'A' + (key & 0x1f) - 1);
+    else if (key > 0 && key < 0x100) /* The key is just one character */
+        snprintf(buffer, KEY_LABEL_LENGTH, "%c", key);
+    else
+        snprintf(buffer, KEY_LABEL_LENGTH, "Key-%d", key);
+}
+
+/**
+ * @brief Reads a key written the way key_to_str() writes it.
+ *
+ * A single character is taken as is. Longer names like "Enter" or "Ctrl-A" ignore case.
+ *
+ * @return The key, or 0 if the name doesn't match any key.
+ */
+int str_to_key(const char *str)
+{
+    char buffer[KEY_LABEL_LENGTH];
+
+    if (str[0] != '\0' && str[1] == '\0')
+        return (unsigned char)str[0];
+
+    for (int key = 1; key <= KEY_MAX; ++key) {
+        key_to_str(key, buffer);
+        if (strcasecmp(buffer, str) == 0)
+            return key;
     }
+    return 0;
 }
@@ -20,7 +20,16 @@
 #ifndef COMMAND_H
 #define COMMAND_H
 
-#define MAX_KEYS 3 /* Maximum number of keys a command can be mapped to. */
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_KEYS 3            /* Maximum number of keys a command can be mapped to. */
+#define MAX_SEQUENCE_LENGTH 4 /* Maximum number of keys in a command's key sequence. */
+#define KEY_LABEL_LENGTH 16   /* The longest name of a single key, in bytes. */
+#define COMMAND_LABEL_LENGTH ((MAX_KEYS + MAX_SEQUENCE_LENGTH) * KEY_LABEL_LENGTH)
+
+#define KEY_SEQUENCE_TIMEOUT 500 /* Milliseconds to wait for the next key of a sequence. */
+#define MAX_COUNT 99999          /* The largest count that can be typed before a command. */
 
 enum command_type {
     CMD_NULL,
@@ -55,6 +64,11 @@ enum command_type {
     CMD_CURSOR_BOTTOM,
     CMD_CURSOR_TOP,
     CMD_CURSOR_MIDDLE,
+    CMD_CURSOR_FIRST,
+    CMD_CURSOR_LAST,
+    CMD_SEARCH,
+    CMD_JUMP_PLAYING,
+    CMD_FOLLOW_PLAYING,
     NUM_CMDS
 };
 
@@ -63,11 +77,47 @@ struct command {
     int keys[MAX_KEYS];    /** The keys bound to the command. */
     char *name;            /** The name of the command. */
     char *description;     /** Brief description of what the command does. */
+    int sequence[MAX_SEQUENCE_LENGTH]; /** Keys pressed one after another, or all 0 if none. */
 };
 
+/**
+ * @brief A command that's been typed, ready to run.
+ */
+struct command_call {
+    enum command_type cmd; /** The command to run. */
+    int count;             /** The count typed before the command's keys, or 0 if none was. */
+};
+
+/**
+ * @brief The keys typed so far towards a command.
+ *
+ * Keys are fed in one at a time and matched against the keymap, which is a trie of every
+ * binding. A command runs as soon as its keys can't be the start of a longer binding.
+ * Otherwise, it waits for the next key until KEY_SEQUENCE_TIMEOUT passes. Digits typed
+ * before the keys are a count, as in vi: "5j" moves down five lines.
+ */
+struct key_sequence {
+    int node;          /** The keymap node the keys so far lead to, or 0 if there are none. */
+    int count;         /** The count typed so far, or 0 if there isn't one. */
+    int count_key;     /** The count's digit while it's the only key typed, or 0. */
+    uint64_t deadline; /** When to stop waiting for the next key, on the monotonic clock. */
+};
+
+void build_keymap(void);
+bool bind_key(int key, enum command_type cmd);
+void unbind_key(int key);
+
+enum command_type find_command(const char *name);
 enum command_type find_key_command(int key);
-void get_command_keys(enum command_type cmd, char *buffer);
+
+void key_sequence_initialize(struct key_sequence *sequence);
+bool key_sequence_feed(struct key_sequence *sequence, int key, struct command_call *call);
+bool key_sequence_expire(struct key_sequence *sequence, struct command_call *call);
+int key_sequence_get_delay(struct key_sequence *sequence);
+const char *get_command_keys(enum command_type cmd);
+const char *get_command_name(enum command_type cmd);
 char *get_command_desc(enum command_type cmd);
 void key_to_str(int key, char *buffer);
+int str_to_key(const char *str);
 
 #endif
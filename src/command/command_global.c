@@ -31,12 +31,30 @@
 
 void update_mpd_database(struct mpdwrapper *mpd, struct ui *ui)
 {
-    statusbar_set_notification(ui->statusbar, "Starting database update...", 3);
-
-    int rc = mpdwrapper_update_db(mpd);
-    char *msg = (rc > 0) ? "Music database updated successfully" : "Error updating music database";
+    if (mpdwrapper_update_db(mpd))
+        statusbar_set_notification(ui->statusbar, "Starting database update...", 3);
+}
 
-    statusbar_set_notification(ui->statusbar, msg, 3);
+/**
+ * @brief Moves the cursor in the visible panel by a number of lines at once.
+ *
+ * A run of cursor up and cursor down keys is added up and applied with this, so holding
+ * one down costs one move per frame however fast the keys repeat.
+ *
+ * @param count The number of lines to move down, or up if negative.
+ */
+void cmd_move_cursor(struct ui *ui, int count)
+{
+    switch (ui->visible_panel) {
+        case QUEUE:
+            playlist_move(ui->queue, count);
+            break;
+        case LIBRARY:
+            screen_library_move(ui->library, count);
+            break;
+        default:
+            break;
+    }
 }
 
 void cmd_global(enum command_type cmd, struct mpdwrapper *mpd, struct ui *ui)
@@ -54,6 +72,9 @@ void cmd_global(enum command_type cmd, struct mpdwrapper *mpd, struct ui *ui)
         case CMD_DB_UPDATE:
             update_mpd_database(mpd, ui);
             break;
+        case CMD_SEARCH:
+            ui_search_begin(ui);
+            break;
         default:
             break;
     }
@@ -22,4 +22,6 @@
 
 void update_mpd_database(struct mpdwrapper *mpd, struct ui *ui);
 
+void cmd_move_cursor(struct ui *ui, int count);
+
 void cmd_global(enum command_type cmd, struct mpdwrapper *mpd, struct ui *ui);
\ No newline at end of file
@@ -22,10 +22,10 @@
 void cmd_add_artist(struct screen_library *screen, struct statusbar *statusbar,
                     struct mpdwrapper *mpd)
 {
-    char *artist = screen->artist_list_view->selected->text;
+    struct list_view_item *artist = list_view_get_selected(screen->artist_list_view);
 
-    if (mpdwrapper_add_artist(mpd, artist))
-        statusbar_set_notification(statusbar, "Added songs by artist to queue", 3);
+    if (artist && mpdwrapper_add_artist(mpd, artist->text))
+        statusbar_set_notification(statusbar, "Adding songs by artist to queue", 3);
     else
         statusbar_set_notification(statusbar, "Unable to add artist's songs to queue", 3);
 }
@@ -33,11 +33,11 @@ void cmd_add_artist(struct screen_library *screen, struct statusbar *statusbar,
 void cmd_add_album(struct screen_library *screen, struct statusbar *statusbar,
                    struct mpdwrapper *mpd)
 {
-    char *artist = screen->artist_list_view->selected->text;
-    char *album = screen->album_list_view->selected->text;
+    struct list_view_item *artist = list_view_get_selected(screen->artist_list_view);
+    struct list_view_item *album = list_view_get_selected(screen->album_list_view);
 
-    if (mpdwrapper_add_album(mpd, artist, album))
-        statusbar_set_notification(statusbar, "Added songs from album to queue", 3);
+    if (artist && album && mpdwrapper_add_album(mpd, artist->text, album->text))
+        statusbar_set_notification(statusbar, "Adding songs from album to queue", 3);
     else
         statusbar_set_notification(statusbar, "Unable to add album's songs to queue", 3);
 }
@@ -45,12 +45,13 @@ void cmd_add_album(struct screen_library *screen, struct statusbar *statusbar,
 void cmd_add_song(struct screen_library *screen, struct statusbar *statusbar,
                   struct mpdwrapper *mpd)
 {
-    char *artist = screen->artist_list_view->selected->text;
-    char *album = screen->album_list_view->selected->text;
-    char *song = screen->song_list_view->selected->text;
+    struct list_view_item *artist = list_view_get_selected(screen->artist_list_view);
+    struct list_view_item *album = list_view_get_selected(screen->album_list_view);
+    struct list_view_item *song = list_view_get_selected(screen->song_list_view);
 
-    if (mpdwrapper_add_song(mpd, artist, album, song))
-        statusbar_set_notification(statusbar, "Added song to queue", 3);
+    if (artist && album && song &&
+        mpdwrapper_add_song(mpd, artist->text, album->text, song->text))
+        statusbar_set_notification(statusbar, "Adding song to queue", 3);
     else
         statusbar_set_notification(statusbar, "Unable to add song to queue", 3);
 }
@@ -64,14 +65,29 @@ void cmd_add_to_queue(struct screen_library *screen, struct statusbar *statusbar
         cmd_add_album(screen, statusbar, mpd);
     else
         cmd_add_song(screen, statusbar, mpd);
+}
+
+/*
+ * A count is a line number, counting from 1. Without one, this goes to the first or the
+ * last line. Lines past the end select the last one.
+ */
+void cmd_go_to_line(struct screen_library *screen, int count, bool last)
+{
+    int length = screen->visible_view->viewport.length;
+
+    if (length == 0)
+        return;
 
-    mpdwrapper_refresh(mpd);
+    if (count > 0)
+        screen_library_select(screen, ((count < length) ? count : length) - 1);
+    else
+        screen_library_select(screen, last ? length - 1 : 0);
 }
 
-void cmd_library(enum command_type cmd, struct screen_library *screen, struct statusbar *statusbar,
-                 struct mpdwrapper *mpd)
+void cmd_library(struct command_call call, struct screen_library *screen,
+                 struct statusbar *statusbar, struct mpdwrapper *mpd)
 {
-    switch (cmd) {
+    switch (call.cmd) {
         case CMD_NULL:
             break;
         case CMD_CURSOR_DOWN:
@@ -106,6 +122,12 @@ void cmd_library(enum command_type cmd, struct screen_library *screen, struct st
         case CMD_CURSOR_MIDDLE:
             screen_library_select_middle_visible(screen);
             break;
+        case CMD_CURSOR_FIRST:
+            cmd_go_to_line(screen, call.count, false);
+            break;
+        case CMD_CURSOR_LAST:
+            cmd_go_to_line(screen, call.count, true);
+            break;
         default:
             break;
     }
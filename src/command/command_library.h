@@ -33,7 +33,9 @@ void cmd_add_song(struct screen_library *screen, struct statusbar *statusbar,
 void cmd_add_to_queue(struct screen_library *screen, struct statusbar *statusbar,
                       struct mpdwrapper *mpd);
 
-void cmd_library(enum command_type cmd, struct screen_library *screen, struct statusbar *statusbar,
-                 struct mpdwrapper *mpd);
+void cmd_go_to_line(struct screen_library *screen, int count, bool last);
+
+void cmd_library(struct command_call call, struct screen_library *screen,
+                 struct statusbar *statusbar, struct mpdwrapper *mpd);
 
 #endif /* COMMAND_LIBRARY_H */
@@ -24,38 +24,36 @@
 
 #include "command_player.h"
 
-void toggle_pause(struct mpd_connection *connection)
+void toggle_pause(struct mpdwrapper *mpd)
 {
-    mpd_run_toggle_pause(connection);
+    mpdwrapper_toggle_pause(mpd);
 }
 
-void stop_playback(struct mpd_connection *connection)
+void stop_playback(struct mpdwrapper *mpd)
 {
-    mpd_run_stop(connection);
+    mpdwrapper_stop(mpd);
 }
 
-void seek_backward(struct mpdwrapper *mpd)
+/* A count moves that many steps in one seek. */
+void seek_backward(struct mpdwrapper *mpd, int count)
 {
     if (mpd->state != MPD_STATE_PLAY)
         return;
 
-    unsigned int elapsed_time = mpdwrapper_get_current_song_elapsed(mpd);
-    if (elapsed_time > 0) {
-        mpd_run_seek_pos(mpd->connection, mpd_song_get_pos(mpd->current_song), elapsed_time - 1);
-    }
+    if (mpdwrapper_get_current_song_elapsed_ms(mpd) > 0)
+        mpdwrapper_seek_by(mpd, -SEEK_STEP * ((count > 0) ? count : 1));
 }
 
-void seek_forward(struct mpdwrapper *mpd)
+void seek_forward(struct mpdwrapper *mpd, int count)
 {
     if (mpd->state != MPD_STATE_PLAY)
         return;
 
-    unsigned int elapsed_time = mpdwrapper_get_current_song_elapsed(mpd);
-    unsigned int total_time = mpdwrapper_get_current_song_duration(mpd);
+    int elapsed_ms = mpdwrapper_get_current_song_elapsed_ms(mpd);
+    int total_time = mpdwrapper_get_current_song_duration(mpd);
 
-    if (elapsed_time != total_time) { /* Song hasn't finished playing */
-        mpd_run_seek_pos(mpd->connection, mpd_song_get_pos(mpd->current_song), elapsed_time + 1);
-    }
+    if (elapsed_ms < total_time * 1000) /* Song hasn't finished playing */
+        mpdwrapper_seek_by(mpd, SEEK_STEP * ((count > 0) ? count : 1));
 }
 
 void prev_song(struct mpdwrapper *mpd, struct statusbar *statusbar)
@@ -63,7 +61,7 @@ void prev_song(struct mpdwrapper *mpd, struct statusbar *statusbar)
     if (mpd->state == MPD_STATE_STOP)
         statusbar_set_notification(statusbar, "Not playing", 3);
     else
-        mpd_run_previous(mpd->connection);
+        mpdwrapper_prev_song(mpd);
 }
 
 void next_song(struct mpdwrapper *mpd, struct statusbar *statusbar)
@@ -71,13 +69,16 @@ void next_song(struct mpdwrapper *mpd, struct statusbar *statusbar)
     if (mpd->state == MPD_STATE_STOP)
         statusbar_set_notification(statusbar, "Not playing", 3);
     else
-        mpd_run_next(mpd->connection);
+        mpdwrapper_next_song(mpd);
 }
 
 void toggle_repeat(struct mpdwrapper *mpd, struct statusbar *statusbar)
 {
+    if (!mpd->status)
+        return;
+
     bool repeat = mpd_status_get_repeat(mpd->status);
-    mpd_run_repeat(mpd->connection, !repeat);
+    mpdwrapper_set_repeat(mpd, !repeat);
 
     char *notification = !repeat ? "Repeat mode is on" : "Repeat mode is off";
     statusbar_set_notification(statusbar, notification, 3);
@@ -85,8 +86,11 @@ void toggle_repeat(struct mpdwrapper *mpd, struct statusbar *statusbar)
 
 void toggle_random(struct mpdwrapper *mpd, struct statusbar *statusbar)
 {
+    if (!mpd->status)
+        return;
+
     bool random = mpd_status_get_random(mpd->status);
-    mpd_run_random(mpd->connection, !random);
+    mpdwrapper_set_random(mpd, !random);
 
     char *notification = !random ? "Random mode is on" : "Random mode is off";
     statusbar_set_notification(statusbar, notification, 3);
@@ -94,8 +98,11 @@ void toggle_random(struct mpdwrapper *mpd, struct statusbar *statusbar)
 
 void toggle_single(struct mpdwrapper *mpd, struct statusbar *statusbar)
 {
+    if (!mpd->status)
+        return;
+
     bool single = mpd_status_get_single(mpd->status);
-    mpd_run_single(mpd->connection, !single);
+    mpdwrapper_set_single(mpd, !single);
 
     char *notification = !single ? "Single mode is on" : "Single mode is off";
     statusbar_set_notification(statusbar, notification, 3);
@@ -103,8 +110,11 @@ void toggle_single(struct mpdwrapper *mpd, struct statusbar *statusbar)
 
 void toggle_consume(struct mpdwrapper *mpd, struct statusbar *statusbar)
 {
+    if (!mpd->status)
+        return;
+
     bool consume = mpd_status_get_consume(mpd->status);
-    mpd_run_consume(mpd->connection, !consume);
+    mpdwrapper_set_consume(mpd, !consume);
 
     char *notification = !consume ? "Consume mode is on" : "Consume mode is off";
     statusbar_set_notification(statusbar, notification, 3);
@@ -112,53 +122,57 @@ void toggle_consume(struct mpdwrapper *mpd, struct statusbar *statusbar)
 
 void toggle_crossfade(struct mpdwrapper *mpd, struct statusbar *statusbar)
 {
+    if (!mpd->status)
+        return;
+
     unsigned int crossfade = mpd_status_get_crossfade(mpd->status);
     char *notification;
 
     if (crossfade == 0) {
-        mpd_run_crossfade(mpd->connection, 5);
+        mpdwrapper_set_crossfade(mpd, 5);
         notification = "Crossfade set to 5 seconds";
     }
     else {
-        mpd_run_crossfade(mpd->connection, 0);
+        mpdwrapper_set_crossfade(mpd, 0);
         notification = "Crossfade set to 0 seconds";
     }
 
     statusbar_set_notification(statusbar, notification, 3);
 }
 
-void decrease_volume(struct mpd_connection *connection)
+/* A count changes the volume that many steps at once. */
+void decrease_volume(struct mpdwrapper *mpd, int count)
 {
-    mpd_run_change_volume(connection, -2);
+    mpdwrapper_change_volume(mpd, -VOLUME_STEP * ((count > 0) ? count : 1));
 }
 
-void increase_volume(struct mpd_connection *connection)
+void increase_volume(struct mpdwrapper *mpd, int count)
 {
-    mpd_run_change_volume(connection, 2);
+    mpdwrapper_change_volume(mpd, VOLUME_STEP * ((count > 0) ? count : 1));
 }
 
 /**
  * @brief Finds the requested player command and executes it.
  *
- * @param cmd The command to execute.
+ * @param call The command to execute, and the count typed before it.
  * @param mpd The MPD connection to run the command on.
  */
-void cmd_player(enum command_type cmd, struct mpdwrapper *mpd, struct statusbar *statusbar)
+void cmd_player(struct command_call call, struct mpdwrapper *mpd, struct statusbar *statusbar)
 {
-    switch (cmd) {
+    switch (call.cmd) {
         case CMD_NULL:
             break;
         case CMD_PAUSE:
-            toggle_pause(mpd->connection);
+            toggle_pause(mpd);
             break;
         case CMD_STOP:
-            stop_playback(mpd->connection);
+            stop_playback(mpd);
             break;
         case CMD_SEEK_BACKWARD:
-            seek_backward(mpd);
+            seek_backward(mpd, call.count);
             break;
         case CMD_SEEK_FORWARD:
-            seek_forward(mpd);
+            seek_forward(mpd, call.count);
             break;
         case CMD_PREV_SONG:
             prev_song(mpd, statusbar);
@@ -182,10 +196,10 @@ void cmd_player(enum command_type cmd, struct mpdwrapper *mpd, struct statusbar
             toggle_crossfade(mpd, statusbar);
             break;
         case CMD_VOL_DOWN:
-            decrease_volume(mpd->connection);
+            decrease_volume(mpd, call.count);
             break;
         case CMD_VOL_UP:
-            increase_volume(mpd->connection);
+            increase_volume(mpd, call.count);
             break;
         default:
             break;
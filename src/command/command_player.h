@@ -29,12 +29,15 @@
 #include "../ui/statusbar.h"
 #include "command.h"
 
-void toggle_pause(struct mpd_connection *connection);
+#define SEEK_STEP 1000 /* How far each seek moves, in milliseconds. */
+#define VOLUME_STEP 2  /* How much each volume change moves, in percent. */
+
+void toggle_pause(struct mpdwrapper *mpd);
 void start_playback(int id);
-void stop_playback(struct mpd_connection *connection);
+void stop_playback(struct mpdwrapper *mpd);
 
-void seek_backward(struct mpdwrapper *mpd);
-void seek_forward(struct mpdwrapper *mpd);
+void seek_backward(struct mpdwrapper *mpd, int count);
+void seek_forward(struct mpdwrapper *mpd, int count);
 
 void prev_song(struct mpdwrapper *mpd, struct statusbar *statusbar);
 void next_song(struct mpdwrapper *mpd, struct statusbar *statusbar);
@@ -45,9 +48,9 @@ void toggle_single(struct mpdwrapper *mpd, struct statusbar *statusbar);
 void toggle_consume(struct mpdwrapper *mpd, struct statusbar *statusbar);
 void toggle_crossfade(struct mpdwrapper *mpd, struct statusbar *statusbar);
 
-void decrease_volume(struct mpd_connection *connection);
-void increase_volume(struct mpd_connection *connection);
+void decrease_volume(struct mpdwrapper *mpd, int count);
+void increase_volume(struct mpdwrapper *mpd, int count);
 
-void cmd_player(enum command_type cmd, struct mpdwrapper *mpd, struct statusbar *statusbar);
+void cmd_player(struct command_call call, struct mpdwrapper *mpd, struct statusbar *statusbar);
 
 #endif
@@ -24,50 +24,119 @@
 
 #include "../ui/statusbar.h"
 
-void queue_remove_selected(struct mpdwrapper *mpd, struct ui *ui)
+/*
+ * The playlist reads straight from the cached queue, so the removed songs disappear
+ * from it once the server reports the change.
+ *
+ * With a count, that many rows are removed starting at the selected one. Rows are taken
+ * from the bottom up, so the positions of the rows still to go don't shift, and each run
+ * of rows that are next to each other in the queue goes in a single ranged delete. That's
+ * one request however many rows there are, unless the queue is filtered.
+ */
+void queue_remove_selected(struct mpdwrapper *mpd, struct ui *ui, int count)
 {
-    char *title = ui->queue->selected->title;
-    int len_msg = strlen(title) + strlen("Removed '' from play queue") + 1;
+    struct playlist_row row;
+    if (!playlist_get_selected_row(ui->queue, &row))
+        return;
+
+    int first = ui->queue->viewport.selected;
+    int last = first + ((count > 1) ? count : 1) - 1;
+    if (last >= ui->queue->viewport.length)
+        last = ui->queue->viewport.length - 1;
+
+    bool sent = true;
+    int start = -1;
+    int end = -1;
 
-    char *msg = malloc(len_msg * sizeof(char));
-    snprintf(msg, len_msg, "Removed '%s' from play queue", title);
+    for (int i = last; i >= first && sent; --i) {
+        int pos = playlist_get_pos(ui->queue, i);
 
-    mpdwrapper_delete_from_queue(mpd, ui->queue->idx_selected);
-    playlist_remove_selected(ui->queue);
-    statusbar_set_notification(ui->statusbar, msg, 3);
+        if (end >= 0 && pos == start - 1) {
+            start = pos;
+            continue;
+        }
+        if (end >= 0)
+            sent = mpdwrapper_delete_range(mpd, start, end);
+        start = pos;
+        end = pos + 1;
+    }
+    if (sent && end >= 0)
+        sent = mpdwrapper_delete_range(mpd, start, end);
+
+    if (!sent)
+        return;
+    if (first == last) {
+        int len_msg = strlen(row.title) + strlen("Removed '' from play queue") + 1;
 
-    free(msg);
+        char *msg = malloc(len_msg * sizeof(char));
+        snprintf(msg, len_msg, "Removed '%s' from play queue", row.title);
+        statusbar_set_notification(ui->statusbar, msg, 3);
+        free(msg);
+    }
+    else {
+        char msg[64];
+
+        snprintf(msg, sizeof(msg), "Removed %d songs from play queue", last - first + 1);
+        statusbar_set_notification(ui->statusbar, msg, 3);
+    }
 }
 
 /* TODO: prompt user to confirm they want to clear the queue. */
 void queue_clear(struct mpdwrapper *mpd, struct ui *ui)
 {
-    char *msg_content = "Queue cleared";
-    int len_msg = strlen(msg_content) + 1;
+    if (mpdwrapper_clear_queue(mpd))
+        statusbar_set_notification(ui->statusbar, "Queue cleared", 3);
+}
 
-    char *msg = malloc(len_msg * sizeof(char));
-    snprintf(msg, len_msg, msg_content);
+/*
+ * The playing song's row is found through the queue's ID index, so this takes the
+ * same time however long the queue is.
+ */
+void queue_jump_to_playing(struct mpdwrapper *mpd, struct ui *ui)
+{
+    if (!mpdwrapper_is_playing(mpd) && !mpdwrapper_is_paused(mpd))
+        statusbar_set_notification(ui->statusbar, "Nothing is playing", 3);
+    else if (!playlist_select_id(ui->queue, mpdwrapper_get_current_song_id(mpd)))
+        statusbar_set_notification(ui->statusbar, "The playing song isn't shown", 3);
+}
 
-    mpdwrapper_clear_queue(mpd);
-    playlist_clear(ui->queue);
-    statusbar_set_notification(ui->statusbar, msg, 3);
+void queue_toggle_follow(struct ui *ui)
+{
+    ui->follow_playing = !ui->follow_playing;
+    ui->followed_id = 0; /* Jump to the playing song on the next draw. */
+
+    if (ui->follow_playing)
+        statusbar_set_notification(ui->statusbar, "Following the playing song", 3);
+    else
+        statusbar_set_notification(ui->statusbar, "Stopped following the playing song", 3);
+}
+
+/*
+ * A count is a line number, counting from 1. Without one, this goes to the first or the
+ * last line.
+ */
+void queue_go_to_line(struct ui *ui, int count, bool last)
+{
+    int length = ui->queue->viewport.length;
 
-    free(msg);
+    if (count > 0)
+        playlist_set_selected(ui->queue, ((count < length) ? count : length) - 1);
+    else
+        playlist_set_selected(ui->queue, last ? length - 1 : 0);
 }
 
 void cmd_play_queue_pos(struct mpdwrapper *mpd, struct ui *ui)
 {
-    bool success = mpdwrapper_play_queue_pos(mpd, ui->queue->idx_selected);
+    int pos = playlist_get_selected_pos(ui->queue);
 
-    if (!success) {
-        char *error_msg = mpdwrapper_get_last_error_message(mpd);
-        statusbar_set_notification(ui->statusbar, error_msg, DEFAULT_NOTIFICATION_LENGTH);
-    }
+    /* Errors are reported to the statusbar through the error handler. */
+    if (pos >= 0)
+        mpdwrapper_play_queue_pos(mpd, pos);
 }
 
-void cmd_queue(enum command_type cmd, struct mpdwrapper *mpd, struct ui *ui)
+void cmd_queue(struct command_call call, struct mpdwrapper *mpd, struct ui *ui)
 {
-    switch (cmd) {
+    switch (call.cmd) {
         case CMD_NULL:
             break;
         case CMD_CURSOR_DOWN:
@@ -94,12 +163,24 @@ void cmd_queue(enum command_type cmd, struct mpdwrapper *mpd, struct ui *ui)
         case CMD_CURSOR_MIDDLE:
             playlist_select_middle_visible(ui->queue);
             break;
+        case CMD_CURSOR_FIRST:
+            queue_go_to_line(ui, call.count, false);
+            break;
+        case CMD_CURSOR_LAST:
+            queue_go_to_line(ui, call.count, true);
+            break;
         case CMD_DELETE:
-            queue_remove_selected(mpd, ui);
+            queue_remove_selected(mpd, ui, call.count);
             break;
         case CMD_CLEAR:
             queue_clear(mpd, ui);
             break;
+        case CMD_JUMP_PLAYING:
+            queue_jump_to_playing(mpd, ui);
+            break;
+        case CMD_FOLLOW_PLAYING:
+            queue_toggle_follow(ui);
+            break;
         default:
             break;
     }
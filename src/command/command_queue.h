@@ -23,11 +23,16 @@
 #include "../ui/ui.h"
 #include "command.h"
 
-void queue_remove_selected(struct mpdwrapper *mpd, struct ui *ui);
+void queue_remove_selected(struct mpdwrapper *mpd, struct ui *ui, int count);
 void queue_clear(struct mpdwrapper *mpd, struct ui *ui);
 
+void queue_jump_to_playing(struct mpdwrapper *mpd, struct ui *ui);
+void queue_toggle_follow(struct ui *ui);
+
 void cmd_play_queue_pos(struct mpdwrapper *mod, struct ui *ui);
 
-void cmd_queue(enum command_type cmd, struct mpdwrapper *mpd, struct ui *ui);
+void queue_go_to_line(struct ui *ui, int count, bool last);
+
+void cmd_queue(struct command_call call, struct mpdwrapper *mpd, struct ui *ui);
 
 #endif /* COMMAND_QUEUE_H */
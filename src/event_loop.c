@@ -0,0 +1,165 @@
+/*******************************************************************************
+ * event_loop.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file event_loop.h
+ */
+
+#include "pantomime/event_loop.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Resizes are redrawn; the rest ask the client to quit. */
+static const int event_loop_signals[] = {SIGWINCH, SIGTERM, SIGINT, SIGHUP};
+
+/**
+ * @brief Blocks the watched signals and opens the timer and signal descriptors.
+ *
+ * The terminal is watched on standard input. The server isn't watched until its
+ * descriptor is passed to event_loop_watch().
+ *
+ * @return true on success, or false if a descriptor couldn't be opened.
+ */
+bool event_loop_initialize(struct event_loop *loop)
+{
+    sigset_t signals;
+
+    sigemptyset(&signals);
+    for (size_t i = 0; i < sizeof(event_loop_signals) / sizeof(event_loop_signals[0]); ++i)
+        sigaddset(&signals, event_loop_signals[i]);
+
+    /* poll() skips negative descriptors, so sources that aren't set up are ignored. */
+    for (int i = 0; i < NUM_EVENT_SOURCES; ++i)
+        loop->fds[i] = (struct pollfd){.fd = -1, .events = POLLIN};
+    loop->fds[EVENT_INPUT].fd = STDIN_FILENO;
+    loop->input_closed = false;
+
+    if (pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0)
+        return false;
+
+    loop->fds[EVENT_TICK].fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->fds[EVENT_SIGNAL].fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    return loop->fds[EVENT_TICK].fd >= 0 && loop->fds[EVENT_SIGNAL].fd >= 0;
+}
+
+/**
+ * @brief Closes the loop's timer and signal descriptors.
+ *
+ * The signals stay blocked, so one that arrives during shutdown can't cut it short.
+ */
+void event_loop_release(struct event_loop *loop)
+{
+    if (loop->fds[EVENT_TICK].fd >= 0)
+        close(loop->fds[EVENT_TICK].fd);
+    if (loop->fds[EVENT_SIGNAL].fd >= 0)
+        close(loop->fds[EVENT_SIGNAL].fd);
+
+    loop->fds[EVENT_TICK].fd = -1;
+    loop->fds[EVENT_SIGNAL].fd = -1;
+}
+
+/**
+ * @brief Sets the descriptor to wait on for a source, or -1 to stop waiting on it.
+ */
+void event_loop_watch(struct event_loop *loop, enum event_source source, int fd)
+{
+    loop->fds[source].fd = fd;
+}
+
+/**
+ * @brief Arms the tick timer to go off once, after the given delay.
+ *
+ * @param delay_ms The delay in milliseconds, or a negative number to disarm the timer.
+ */
+void event_loop_set_tick(struct event_loop *loop, int delay_ms)
+{
+    struct itimerspec spec = {0};
+
+    /* A zero delay would disarm the timer instead. */
+    if (delay_ms >= 0) {
+        delay_ms = delay_ms ? delay_ms : 1;
+        spec.it_value.tv_sec = delay_ms / 1000;
+        spec.it_value.tv_nsec = (delay_ms % 1000) * 1000000L;
+    }
+
+    timerfd_settime(loop->fds[EVENT_TICK].fd, 0, &spec, NULL);
+}
+
+/**
+ * @brief Sleeps until at least one source is ready.
+ *
+ * An expired tick is acknowledged here. Input and replies are left for the caller to
+ * read, and signals for event_loop_next_signal().
+ *
+ * If the terminal hangs up, it stops being watched, and it's reported as a SIGHUP so
+ * the caller doesn't spin on a descriptor that stays readable forever.
+ *
+ * @return A bit for each ready source, to be tested with EVENT_READY().
+ */
+unsigned event_loop_wait(struct event_loop *loop)
+{
+    unsigned ready = 0;
+
+    while (poll(loop->fds, NUM_EVENT_SOURCES, -1) < 0) {
+        if (errno != EINTR)
+            return 0;
+    }
+
+    for (int i = 0; i < NUM_EVENT_SOURCES; ++i) {
+        if (loop->fds[i].fd >= 0 && loop->fds[i].revents)
+            ready |= 1u << i;
+    }
+
+    if (loop->fds[EVENT_INPUT].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+        loop->fds[EVENT_INPUT].fd = -1;
+        loop->input_closed = true;
+        ready |= 1u << EVENT_SIGNAL;
+    }
+    if (EVENT_READY(ready, EVENT_TICK)) {
+        uint64_t expirations;
+        read(loop->fds[EVENT_TICK].fd, &expirations, sizeof(expirations));
+    }
+
+    return ready;
+}
+
+/**
+ * @brief Takes the next signal that has arrived.
+ *
+ * @return The signal's number, or 0 if none are waiting.
+ */
+int event_loop_next_signal(struct event_loop *loop)
+{
+    struct signalfd_siginfo info;
+
+    if (loop->input_closed) {
+        loop->input_closed = false;
+        return SIGHUP;
+    }
+    if (read(loop->fds[EVENT_SIGNAL].fd, &info, sizeof(info)) == sizeof(info))
+        return info.ssi_signo;
+
+    return 0;
+}
@@ -0,0 +1,262 @@
+/*******************************************************************************
+ * intern.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file intern.h
+ */
+
+#include "pantomime/intern.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pantomime/arena.h"
+
+/**
+ * @brief The table's state. Everything but the ID table is only touched with the lock held.
+ *
+ * IDs index the chunks, so a string's pointer never moves once it's been handed out.
+ * The hash table maps strings to IDs with open addressing. Each slot holds an ID plus
+ * one, so zero can mark an empty slot, and the string's hash, so most mismatches are
+ * rejected without comparing strings.
+ */
+static struct {
+    pthread_mutex_t lock;
+    struct arena strings;                   /**< The interned strings. */
+    const char **chunks[INTERN_MAX_CHUNKS]; /**< The strings by ID. */
+    unsigned count;                         /**< The number of IDs given out. */
+    uint32_t *slots;                        /**< An ID plus one, or 0 for an empty slot. */
+    uint32_t *hashes;                       /**< The hash of each slot's string. */
+    size_t capacity;                        /**< The number of slots. A power of two. */
+} intern_table = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @brief Hashes a string with FNV-1a.
+ */
+static uint32_t intern_hash(const char *str)
+{
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char *p = (const unsigned char *)str; *p; ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Finds a string's slot in the hash table, or the empty slot it would go in.
+ *
+ * The caller must hold the lock, and the table must have at least one empty slot.
+ */
+static size_t intern_probe(const char *str, uint32_t hash)
+{
+    size_t mask = intern_table.capacity - 1;
+    size_t slot = hash & mask;
+
+    while (intern_table.slots[slot]) {
+        unsigned id = intern_table.slots[slot] - 1;
+
+        if (intern_table.hashes[slot] == hash && strcmp(intern_string(id), str) == 0)
+            break;
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Doubles the size of the hash table.
+ *
+ * @return false if memory couldn't be allocated, true otherwise.
+ */
+static bool intern_grow()
+{
+    size_t capacity = intern_table.capacity ? intern_table.capacity * 2 : INTERN_MIN_CAPACITY;
+    uint32_t *slots = calloc(capacity, sizeof(*slots));
+    uint32_t *hashes = malloc(capacity * sizeof(*hashes));
+
+    if (!slots || !hashes) {
+        free(slots);
+        free(hashes);
+        return false;
+    }
+
+    for (size_t i = 0; i < intern_table.capacity; ++i) {
+        if (!intern_table.slots[i])
+            continue;
+
+        size_t slot = intern_table.hashes[i] & (capacity - 1);
+        while (slots[slot])
+            slot = (slot + 1) & (capacity - 1);
+        slots[slot] = intern_table.slots[i];
+        hashes[slot] = intern_table.hashes[i];
+    }
+
+    free(intern_table.slots);
+    free(intern_table.hashes);
+    intern_table.slots = slots;
+    intern_table.hashes = hashes;
+    intern_table.capacity = capacity;
+
+    return true;
+}
+
+/**
+ * @brief Gives the next ID to a string. The caller must hold the lock.
+ *
+ * @return The ID, or INTERN_EMPTY if the table is full or memory couldn't be allocated.
+ */
+static unsigned intern_add(const char *str)
+{
+    /* The empty string takes ID 0 the first time anything is added. */
+    if (intern_table.count == 0) {
+        intern_table.chunks[0] = calloc(INTERN_CHUNK_SIZE, sizeof(**intern_table.chunks));
+        if (!intern_table.chunks[0])
+            return INTERN_EMPTY;
+        intern_table.chunks[0][INTERN_EMPTY] = "";
+        intern_table.count = 1;
+    }
+
+    unsigned id = intern_table.count;
+    unsigned chunk = id / INTERN_CHUNK_SIZE;
+
+    if (chunk >= INTERN_MAX_CHUNKS)
+        return INTERN_EMPTY;
+    if (!intern_table.chunks[chunk]) {
+        intern_table.chunks[chunk] = malloc(INTERN_CHUNK_SIZE * sizeof(**intern_table.chunks));
+        if (!intern_table.chunks[chunk])
+            return INTERN_EMPTY;
+    }
+
+    const char *copy = arena_strdup(&intern_table.strings, str);
+    if (!copy)
+        return INTERN_EMPTY;
+
+    intern_table.chunks[chunk][id % INTERN_CHUNK_SIZE] = copy;
+    intern_table.count++;
+
+    return id;
+}
+
+/**
+ * @brief Gets a string's ID, interning it if it hasn't been seen before.
+ *
+ * @param str The string, which is copied. NULL is treated as the empty string.
+ * @return The string's ID, or INTERN_EMPTY if it couldn't be interned.
+ */
+unsigned intern(const char *str)
+{
+    if (!str || str[0] == '\0')
+        return INTERN_EMPTY;
+
+    uint32_t hash = intern_hash(str);
+    unsigned id = INTERN_EMPTY;
+
+    pthread_mutex_lock(&intern_table.lock);
+
+    if ((intern_table.count + 1) * 2 <= intern_table.capacity || intern_grow()) {
+        size_t slot = intern_probe(str, hash);
+
+        if (intern_table.slots[slot])
+            id = intern_table.slots[slot] - 1;
+        else if ((id = intern_add(str)) != INTERN_EMPTY) {
+            intern_table.slots[slot] = id + 1;
+            intern_table.hashes[slot] = hash;
+        }
+    }
+
+    pthread_mutex_unlock(&intern_table.lock);
+
+    return id;
+}
+
+/**
+ * @brief Gets a string's ID without interning it.
+ *
+ * @return The string's ID, or INTERN_NOT_FOUND if it hasn't been interned.
+ */
+unsigned intern_find(const char *str)
+{
+    if (!str || str[0] == '\0')
+        return INTERN_EMPTY;
+
+    uint32_t hash = intern_hash(str);
+    unsigned id = INTERN_NOT_FOUND;
+
+    pthread_mutex_lock(&intern_table.lock);
+
+    if (intern_table.capacity) {
+        size_t slot = intern_probe(str, hash);
+        if (intern_table.slots[slot])
+            id = intern_table.slots[slot] - 1;
+    }
+
+    pthread_mutex_unlock(&intern_table.lock);
+
+    return id;
+}
+
+/**
+ * @brief Gets the string with the given ID.
+ *
+ * @return The string, which is valid until intern_release() is called.
+ */
+const char *intern_string(unsigned id)
+{
+    if (id == INTERN_EMPTY)
+        return "";
+
+    return intern_table.chunks[id / INTERN_CHUNK_SIZE][id % INTERN_CHUNK_SIZE];
+}
+
+/**
+ * @brief Gets the number of IDs given out, which is one more than the largest ID.
+ */
+unsigned intern_count()
+{
+    pthread_mutex_lock(&intern_table.lock);
+    unsigned count = intern_table.count ? intern_table.count : 1;
+    pthread_mutex_unlock(&intern_table.lock);
+
+    return count;
+}
+
+/**
+ * @brief Frees every interned string. Only call this once no other thread is running.
+ */
+void intern_release()
+{
+    for (unsigned i = 0; i < INTERN_MAX_CHUNKS && intern_table.chunks[i]; ++i) {
+        free(intern_table.chunks[i]);
+        intern_table.chunks[i] = NULL;
+    }
+
+    arena_release(&intern_table.strings);
+    free(intern_table.slots);
+    free(intern_table.hashes);
+    intern_table.slots = NULL;
+    intern_table.hashes = NULL;
+    intern_table.capacity = 0;
+    intern_table.count = 0;
+}
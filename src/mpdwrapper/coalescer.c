@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * coalescer.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file coalescer.h
+ */
+
+#include "coalescer.h"
+
+/**
+ * @brief Initializes a coalescer with nothing to send.
+ */
+void coalescer_initialize(struct coalescer *coalescer)
+{
+    coalescer->target = -1;
+    coalescer->held = false;
+    coalescer->sent_at = 0;
+    coalescer->hold_until = 0;
+}
+
+/**
+ * @brief Asks for a new value.
+ *
+ * @param target The value, which must not be negative.
+ * @param now The time, from playback_clock_now().
+ * @return true if the value should be sent now, or false if it's held until
+ *   coalescer_take() says it's due.
+ */
+bool coalescer_set(struct coalescer *coalescer, int target, uint64_t now)
+{
+    coalescer->target = target;
+    coalescer->held = true;
+
+    return coalescer_take(coalescer, now);
+}
+
+/**
+ * @brief Checks whether a held value is due to be sent, and marks it sent if so.
+ *
+ * @return true if the target should be sent now.
+ */
+bool coalescer_take(struct coalescer *coalescer, uint64_t now)
+{
+    if (!coalescer->held || now < coalescer->hold_until)
+        return false;
+
+    coalescer->held = false;
+    coalescer->sent_at = now;
+    coalescer->hold_until = now + COALESCE_WINDOW;
+    return true;
+}
+
+/**
+ * @brief Lets go of the target once the server reports a state that includes it.
+ *
+ * @param fetched_at When the server's state was fetched, on the playback clock.
+ */
+void coalescer_confirm(struct coalescer *coalescer, uint64_t fetched_at)
+{
+    if (!coalescer->held && fetched_at >= coalescer->sent_at)
+        coalescer->target = -1;
+}
+
+/**
+ * @brief Finds how long until a held value is due.
+ *
+ * @return The number of milliseconds, or -1 if nothing is held.
+ */
+int coalescer_get_delay(const struct coalescer *coalescer, uint64_t now)
+{
+    if (!coalescer->held)
+        return -1;
+
+    return (now < coalescer->hold_until) ? (int)(coalescer->hold_until - now) : 0;
+}
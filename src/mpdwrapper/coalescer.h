@@ -0,0 +1,56 @@
+/*******************************************************************************
+ * coalescer.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file coalescer.h
+ * @brief Merges a burst of changes to one setting into as few requests as possible.
+ *
+ * Holding down a key like volume up asks for a new value many times a second. Sending
+ * each one would queue up round trips to the server, and the player would lag behind the
+ * key for seconds. Instead, the first change goes out at once, and any that follow within
+ * a short window are merged into one absolute value that's sent when the window ends.
+ *
+ * Until the server has reported a state fetched after the last value was sent, that
+ * value is what should be shown, so the UI reacts the moment the key is pressed.
+ */
+
+#ifndef COALESCER_H
+#define COALESCER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define COALESCE_WINDOW 100 /* Milliseconds after a request during which changes are held. */
+
+struct coalescer {
+    int target;          /**< The latest value asked for, or -1 once the server has it. */
+    bool held;           /**< Whether the target is waiting to be sent. */
+    uint64_t sent_at;    /**< When the target was last sent, on the playback clock. */
+    uint64_t hold_until; /**< Until when new targets are held rather than sent. */
+};
+
+void coalescer_initialize(struct coalescer *coalescer);
+
+bool coalescer_set(struct coalescer *coalescer, int target, uint64_t now);
+bool coalescer_take(struct coalescer *coalescer, uint64_t now);
+void coalescer_confirm(struct coalescer *coalescer, uint64_t fetched_at);
+
+int coalescer_get_delay(const struct coalescer *coalescer, uint64_t now);
+
+#endif /* COALESCER_H */
@@ -0,0 +1,415 @@
+/*******************************************************************************
+ * library.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file library.h
+ */
+
+#include "library.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pantomime/intern.h"
+
+/**
+ * @brief Creates an empty library, ready for chunks to be added.
+ *
+ * @return A pointer to the new library, or NULL on error.
+ */
+struct library *library_new()
+{
+    struct library *library = malloc(sizeof(*library));
+    if (!library)
+        return NULL;
+
+    library->artists = NULL;
+    library->artist_count = 0;
+    library->capacity = 0;
+    library->index = NULL;
+    library->strings = NULL;
+    library->complete = false;
+
+    return library;
+}
+
+/**
+ * @brief Loads a library from a saved index.
+ *
+ * The library takes ownership of the index, and its titles and URIs point into the
+ * mapping.
+ * Chunks can't be added to a library loaded this way.
+ *
+ * @return A pointer to the new library, or NULL on error.
+ */
+struct library *library_new_from_index(struct library_index *index)
+{
+    struct library *library = library_new();
+    if (!library)
+        return NULL;
+
+    const struct library_index_header *header = index->header;
+
+    library->index = index;
+    library->artists = calloc(header->artist_count + 1, sizeof(*library->artists));
+    library->artist_count = header->artist_count;
+    library->capacity = header->artist_count + 1;
+    library->complete = true;
+
+    for (uint32_t i = 0; i < header->artist_count; ++i) {
+        const struct library_index_artist *index_artist = &index->artists[i];
+        struct library_artist *artist = &library->artists[i];
+
+        artist->name_id = intern(library_index_string(index, index_artist->name));
+        artist->name = intern_string(artist->name_id);
+        artist->albums = calloc(index_artist->album_count + 1, sizeof(*artist->albums));
+        artist->album_count = index_artist->album_count;
+        artist->capacity = index_artist->album_count + 1;
+
+        for (uint32_t j = 0; j < index_artist->album_count; ++j) {
+            const struct library_index_album *index_album =
+                &index->albums[index_artist->first_album + j];
+            struct library_album *album = &artist->albums[j];
+
+            album->name_id = intern(library_index_string(index, index_album->name));
+            album->name = intern_string(album->name_id);
+            album->tracks = malloc((index_album->track_count + 1) * sizeof(*album->tracks));
+            album->track_count = index_album->track_count;
+            album->capacity = index_album->track_count + 1;
+
+            for (uint32_t k = 0; k < index_album->track_count; ++k) {
+                const struct library_index_track *track =
+                    &index->tracks[index_album->first_track + k];
+
+                album->tracks[k] = (struct library_track){
+                    .title = library_index_string(index, track->title),
+                    .uri = library_index_string(index, track->uri),
+                    .track = track->track,
+                    .duration = track->duration,
+                };
+            }
+        }
+    }
+
+    return library;
+}
+
+void library_free(struct library *library)
+{
+    for (int i = 0; i < library->artist_count; ++i) {
+        struct library_artist *artist = &library->artists[i];
+
+        for (int j = 0; j < artist->album_count; ++j)
+            free(artist->albums[j].tracks);
+        free(artist->albums);
+    }
+    free(library->artists);
+
+    struct library_string_block *block = library->strings;
+    while (block) {
+        struct library_string_block *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    if (library->index)
+        library_index_close(library->index);
+
+    free(library);
+}
+
+/**
+ * @brief Copies a string into the library's string storage.
+ *
+ * @return The copy, which lasts as long as the library.
+ */
+static const char *library_store(struct library *library, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    struct library_string_block *block = library->strings;
+
+    if (!block || block->size + len > block->capacity) {
+        size_t capacity = len > LIBRARY_STRING_BLOCK_SIZE ? len : LIBRARY_STRING_BLOCK_SIZE;
+
+        block = malloc(sizeof(*block) + capacity);
+        block->next = library->strings;
+        block->size = 0;
+        block->capacity = capacity;
+        library->strings = block;
+    }
+
+    char *copy = block->data + block->size;
+    memcpy(copy, str, len);
+    block->size += len;
+
+    return copy;
+}
+
+/**
+ * @brief Finds where an artist is or would be in a sorted range of artists.
+ */
+static int library_artist_lower_bound(struct library_artist *artists, int count, const char *name)
+{
+    int low = 0;
+    int high = count;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+
+        if (strcmp(artists[mid].name, name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/**
+ * @brief Finds where an album is or would be in an artist's albums.
+ */
+static int library_album_lower_bound(struct library_artist *artist, const char *name)
+{
+    int low = 0;
+    int high = artist->album_count;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+
+        if (strcmp(artist->albums[mid].name, name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/**
+ * @brief Finds an artist by name, adding them after the sorted artists if needed.
+ *
+ * @param name_id The interned name.
+ * @param sorted The number of artists at the start of the array that are sorted.
+ * @return The artist's index.
+ */
+static int library_add_artist(struct library *library, unsigned name_id, int sorted)
+{
+    const char *name = intern_string(name_id);
+
+    int pos = library_artist_lower_bound(library->artists, sorted, name);
+    if (pos < sorted && library->artists[pos].name_id == name_id)
+        return pos;
+
+    for (int i = sorted; i < library->artist_count; ++i) {
+        if (library->artists[i].name_id == name_id)
+            return i;
+    }
+
+    if (library->artist_count == library->capacity) {
+        library->capacity = library->capacity ? library->capacity * 2 : 64;
+        library->artists = realloc(library->artists, library->capacity * sizeof(*library->artists));
+    }
+
+    library->artists[library->artist_count] =
+        (struct library_artist){.name = name, .name_id = name_id};
+
+    return library->artist_count++;
+}
+
+/**
+ * @brief Finds one of an artist's albums by name, adding it in order if needed.
+ *
+ * @param name_id The interned name.
+ */
+static struct library_album *library_add_album(struct library_artist *artist, unsigned name_id)
+{
+    const char *name = intern_string(name_id);
+
+    int pos = library_album_lower_bound(artist, name);
+    if (pos < artist->album_count && artist->albums[pos].name_id == name_id)
+        return &artist->albums[pos];
+
+    if (artist->album_count == artist->capacity) {
+        artist->capacity = artist->capacity ? artist->capacity * 2 : 4;
+        artist->albums = realloc(artist->albums, artist->capacity * sizeof(*artist->albums));
+    }
+
+    memmove(&artist->albums[pos + 1], &artist->albums[pos],
+            (artist->album_count - pos) * sizeof(*artist->albums));
+    artist->albums[pos] = (struct library_album){.name = name, .name_id = name_id};
+    artist->album_count++;
+
+    return &artist->albums[pos];
+}
+
+/**
+ * @brief Orders tracks by track number, then title.
+ */
+static int library_track_compare(const struct library_track *a, const struct library_track *b)
+{
+    if (a->track != b->track)
+        return (a->track > b->track) - (a->track < b->track);
+    return strcmp(a->title, b->title);
+}
+
+/**
+ * @brief Adds a track to an album, keeping the tracks in order.
+ *
+ * Songs are usually listed in order, so the new track is moved back from the end.
+ */
+static void library_album_add_track(struct library_album *album, struct library_track track)
+{
+    if (album->track_count == album->capacity) {
+        album->capacity = album->capacity ? album->capacity * 2 : 16;
+        album->tracks = realloc(album->tracks, album->capacity * sizeof(*album->tracks));
+    }
+
+    int pos = album->track_count;
+    while (pos > 0 && library_track_compare(&album->tracks[pos - 1], &track) > 0) {
+        album->tracks[pos] = album->tracks[pos - 1];
+        --pos;
+    }
+
+    album->tracks[pos] = track;
+    album->track_count++;
+}
+
+static int library_artist_compare(const void *a, const void *b)
+{
+    const struct library_artist *artist_a = a;
+    const struct library_artist *artist_b = b;
+
+    return strcmp(artist_a->name, artist_b->name);
+}
+
+/**
+ * @brief Merges the artists after the sorted ones into their places.
+ *
+ * @param sorted The number of artists at the start of the array that are sorted.
+ */
+static void library_merge_artists(struct library *library, int sorted)
+{
+    struct library_artist *artists = library->artists;
+    int added = library->artist_count - sorted;
+
+    if (added == 0)
+        return;
+
+    struct library_artist *tail = malloc(added * sizeof(*tail));
+    memcpy(tail, &artists[sorted], added * sizeof(*tail));
+    qsort(tail, added, sizeof(*tail), library_artist_compare);
+
+    /* Merge from the back, so nothing is overwritten before it's moved. */
+    int i = sorted - 1;
+    int j = added - 1;
+    int k = library->artist_count - 1;
+
+    while (j >= 0) {
+        if (i >= 0 && strcmp(artists[i].name, tail[j].name) > 0)
+            artists[k--] = artists[i--];
+        else
+            artists[k--] = tail[j--];
+    }
+
+    free(tail);
+}
+
+/**
+ * @brief Merges a chunk of songs into the library.
+ *
+ * Each song is filed under its artist and album. Artists new to the library are
+ * collected at the end of the array and merged into place once the chunk is done, so
+ * adding a chunk costs one pass over the artists.
+ */
+void library_add_chunk(struct library *library, const struct library_chunk *chunk)
+{
+    int sorted = library->artist_count;
+    int last = -1;
+
+    for (int i = 0; i < chunk->count; ++i) {
+        const struct library_chunk_song *song = &chunk->songs[i];
+        unsigned artist_id = intern(library_chunk_string(chunk, song->artist));
+        unsigned album_id = intern(library_chunk_string(chunk, song->album));
+
+        /* Songs are listed by directory, so runs of songs usually share an artist. */
+        if (last < 0 || library->artists[last].name_id != artist_id)
+            last = library_add_artist(library, artist_id, sorted);
+
+        struct library_album *album = library_add_album(&library->artists[last], album_id);
+        struct library_track track = {
+            .title = library_store(library, library_chunk_string(chunk, song->title)),
+            .uri = library_store(library, library_chunk_string(chunk, song->uri)),
+            .track = song->track,
+            .duration = song->duration,
+        };
+
+        library_album_add_track(album, track);
+    }
+
+    library_merge_artists(library, sorted);
+}
+
+/**
+ * @brief Finds an artist by name.
+ *
+ * @return The artist, or NULL if there's no such artist.
+ */
+struct library_artist *library_find_artist(struct library *library, const char *name)
+{
+    int pos = library_artist_lower_bound(library->artists, library->artist_count, name);
+
+    if (pos < library->artist_count && strcmp(library->artists[pos].name, name) == 0)
+        return &library->artists[pos];
+    return NULL;
+}
+
+/**
+ * @brief Finds one of an artist's albums by name.
+ *
+ * @return The album, or NULL if the artist has no such album.
+ */
+struct library_album *library_find_album(struct library_artist *artist, const char *name)
+{
+    if (!artist)
+        return NULL;
+
+    int pos = library_album_lower_bound(artist, name);
+
+    if (pos < artist->album_count && strcmp(artist->albums[pos].name, name) == 0)
+        return &artist->albums[pos];
+    return NULL;
+}
+
+/**
+ * @brief Finds a track on an album by title.
+ *
+ * @return The first track with the title, or NULL if there's no such track.
+ */
+struct library_track *library_find_track(struct library_album *album, const char *title)
+{
+    if (!album)
+        return NULL;
+
+    for (int i = 0; i < album->track_count; ++i) {
+        if (strcmp(album->tracks[i].title, title) == 0)
+            return &album->tracks[i];
+    }
+    return NULL;
+}
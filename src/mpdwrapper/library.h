@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * library.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file library.h
+ * @brief An in-memory tree of the music library's artists, albums, and tracks.
+ *
+ * The tree is loaded from the saved [library index](@ref library_index.h) when it's
+ * current, and otherwise built from the chunks the worker streams while listing the
+ * database. Chunks are merged in as they arrive, so the tree can be browsed before the
+ * listing finishes. Once loaded, browsing the library and adding songs to the queue
+ * don't need any lookups on the server.
+ *
+ * Artist and album names are [interned](@ref intern.h), so each is stored once no matter
+ * how many tracks share it, and can be compared by ID. Titles and URIs loaded from the
+ * index point into its mapping.
+ */
+
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "library_index.h"
+
+#define LIBRARY_CHUNK_SIZE 4096         /* Songs the worker collects before streaming them. */
+#define LIBRARY_STRING_BLOCK_SIZE 65536 /* The size of each block of string storage. */
+
+struct library_track {
+    const char *title;
+    const char *uri;
+    unsigned track;    /**< The track number, or 0 if there isn't one. */
+    unsigned duration; /**< The track's length in seconds. */
+};
+
+struct library_album {
+    const char *name;
+    unsigned name_id; /**< The interned name. */
+    struct library_track *tracks; /**< The album's tracks, sorted by track number. */
+    int track_count;
+    int capacity;
+};
+
+struct library_artist {
+    const char *name;
+    unsigned name_id; /**< The interned name. */
+    struct library_album *albums; /**< The artist's albums, sorted by name. */
+    int album_count;
+    int capacity;
+};
+
+/**
+ * @brief A block of storage for the library's strings.
+ */
+struct library_string_block {
+    struct library_string_block *next;
+    size_t size;     /**< The number of bytes used. */
+    size_t capacity; /**< The number of bytes in data. */
+    char data[];
+};
+
+/**
+ * @brief The library tree and the storage for its strings.
+ */
+struct library {
+    struct library_artist *artists; /**< The artists, sorted by name. */
+    int artist_count;
+    int capacity;
+
+    struct library_index *index;          /**< The index the tree was loaded from, or NULL. */
+    struct library_string_block *strings; /**< Storage for strings not in the index. */
+
+    bool complete; /**< Whether the whole library has been loaded. */
+};
+
+struct library *library_new();
+struct library *library_new_from_index(struct library_index *index);
+void library_free(struct library *library);
+
+void library_add_chunk(struct library *library, const struct library_chunk *chunk);
+
+struct library_artist *library_find_artist(struct library *library, const char *name);
+struct library_album *library_find_album(struct library_artist *artist, const char *name);
+struct library_track *library_find_track(struct library_album *album, const char *title);
+
+#endif /* LIBRARY_H */
@@ -0,0 +1,529 @@
+/*******************************************************************************
+ * library_index.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file library_index.h
+ */
+
+#include "library_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Creates a directory and any missing parents.
+ *
+ * @return true if the directory exists afterwards, false otherwise.
+ */
+static bool make_directories(char *path)
+{
+    for (char *p = path + 1; *p; ++p) {
+        if (*p != '/')
+            continue;
+
+        *p = '\0';
+        int rc = mkdir(path, 0755);
+        *p = '/';
+        if (rc != 0 && errno != EEXIST)
+            return false;
+    }
+
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+/**
+ * @brief Finds where to cache the library index for a server, creating the directory
+ * if needed.
+ *
+ * Indexes live in $XDG_CACHE_HOME/pantomime, or ~/.cache/pantomime if that isn't set,
+ * with one file per host and port.
+ *
+ * @return A heap-allocated path, or NULL if there is nowhere to put the cache.
+ */
+char *library_index_default_path(const char *host, int port)
+{
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char dir[4096];
+
+    if (cache_home && cache_home[0] == '/')
+        snprintf(dir, sizeof(dir), "%s/pantomime", cache_home);
+    else if (home && home[0] == '/')
+        snprintf(dir, sizeof(dir), "%s/.cache/pantomime", home);
+    else
+        return NULL;
+
+    if (!make_directories(dir))
+        return NULL;
+
+    /* The host may be a socket path, so it can't be used in a file name as-is. */
+    char *name = strdup(host ? host : "localhost");
+    for (char *p = name; *p; ++p) {
+        if (*p == '/')
+            *p = '_';
+    }
+
+    int len = snprintf(NULL, 0, "%s/library-%s-%d.idx", dir, name, port) + 1;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/library-%s-%d.idx", dir, name, port);
+
+    free(name);
+    return path;
+}
+
+/**
+ * @brief Checks that every record in a mapped index points inside the file.
+ */
+static bool library_index_validate(struct library_index *index)
+{
+    const struct library_index_header *header = index->header;
+    uint64_t strings_size = header->strings_size;
+
+    if (strings_size == 0 || index->strings[strings_size - 1] != '\0')
+        return false;
+
+    for (uint32_t i = 0; i < header->artist_count; ++i) {
+        const struct library_index_artist *artist = &index->artists[i];
+        if (artist->name >= strings_size || artist->first_album > header->album_count ||
+            artist->album_count > header->album_count - artist->first_album)
+            return false;
+    }
+    for (uint32_t i = 0; i < header->album_count; ++i) {
+        const struct library_index_album *album = &index->albums[i];
+        if (album->name >= strings_size || album->first_track > header->track_count ||
+            album->track_count > header->track_count - album->first_track)
+            return false;
+    }
+    for (uint32_t i = 0; i < header->track_count; ++i) {
+        const struct library_index_track *track = &index->tracks[i];
+        if (track->title >= strings_size || track->uri >= strings_size)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Maps a library index file into memory.
+ *
+ * @return The open index, or NULL if the file doesn't exist or isn't a valid index.
+ */
+struct library_index *library_index_open(const char *path)
+{
+    if (!path)
+        return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct library_index_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    struct library_index *index = malloc(sizeof(*index));
+    const struct library_index_header *header = map;
+
+    index->map = map;
+    index->size = st.st_size;
+    index->header = header;
+
+    uint64_t expected = sizeof(*header) +
+                        (uint64_t)header->artist_count * sizeof(struct library_index_artist) +
+                        (uint64_t)header->album_count * sizeof(struct library_index_album) +
+                        (uint64_t)header->track_count * sizeof(struct library_index_track) +
+                        header->strings_size;
+
+    if (memcmp(header->magic, LIBRARY_INDEX_MAGIC, sizeof(LIBRARY_INDEX_MAGIC)) != 0 ||
+        header->version != LIBRARY_INDEX_VERSION || expected != index->size) {
+        library_index_close(index);
+        return NULL;
+    }
+
+    const char *base = map;
+    index->artists = (const void *)(base + sizeof(*header));
+    index->albums = (const void *)(index->artists + header->artist_count);
+    index->tracks = (const void *)(index->albums + header->album_count);
+    index->strings = (const char *)(index->tracks + header->track_count);
+
+    if (!library_index_validate(index)) {
+        library_index_close(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+void library_index_close(struct library_index *index)
+{
+    if (!index)
+        return;
+
+    munmap(index->map, index->size);
+    free(index);
+}
+
+/**
+ * @brief Reads the database update time an index file was built from, without mapping it.
+ *
+ * @return true on success, or false if the file doesn't exist or isn't a valid index.
+ */
+bool library_index_read_db_update(const char *path, uint64_t *db_update)
+{
+    struct library_index_header header;
+    FILE *file = path ? fopen(path, "rb") : NULL;
+
+    if (!file)
+        return false;
+
+    bool success = fread(&header, sizeof(header), 1, file) == 1 &&
+                   memcmp(header.magic, LIBRARY_INDEX_MAGIC, sizeof(LIBRARY_INDEX_MAGIC)) == 0 &&
+                   header.version == LIBRARY_INDEX_VERSION;
+    fclose(file);
+
+    if (success)
+        *db_update = header.db_update;
+    return success;
+}
+
+uint64_t library_index_get_db_update(struct library_index *index)
+{
+    return index->header->db_update;
+}
+
+/**
+ * @brief Gets a string from the index's string pool.
+ */
+const char *library_index_string(struct library_index *index, uint32_t offset)
+{
+    return index->strings + offset;
+}
+
+/**
+ * @brief Finds an artist by name.
+ *
+ * @return The artist's index, or -1 if there's no such artist.
+ */
+int library_index_find_artist(struct library_index *index, const char *name)
+{
+    int low = 0;
+    int high = (int)index->header->artist_count - 1;
+
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        int cmp = strcmp(library_index_string(index, index->artists[mid].name), name);
+
+        if (cmp == 0)
+            return mid;
+        else if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Finds one of an artist's albums by name.
+ *
+ * @return The album's index, or -1 if the artist has no such album.
+ */
+int library_index_find_album(struct library_index *index, int artist, const char *name)
+{
+    if (artist < 0 || artist >= index->header->artist_count)
+        return -1;
+
+    int low = index->artists[artist].first_album;
+    int high = low + (int)index->artists[artist].album_count - 1;
+
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        int cmp = strcmp(library_index_string(index, index->albums[mid].name), name);
+
+        if (cmp == 0)
+            return mid;
+        else if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief A song from a chunk, with its strings resolved for sorting.
+ */
+struct library_track_info {
+    const char *artist;
+    const char *album;
+    const char *title;
+    const char *uri;
+    unsigned track;
+    unsigned duration;
+};
+
+/**
+ * @brief Orders tracks by artist, then album, then track number, then title.
+ */
+static int library_track_compare(const void *a, const void *b)
+{
+    const struct library_track_info *track_a = a;
+    const struct library_track_info *track_b = b;
+    int cmp;
+
+    if ((cmp = strcmp(track_a->artist, track_b->artist)) != 0)
+        return cmp;
+    if ((cmp = strcmp(track_a->album, track_b->album)) != 0)
+        return cmp;
+    if (track_a->track != track_b->track)
+        return (track_a->track > track_b->track) - (track_a->track < track_b->track);
+    return strcmp(track_a->title, track_b->title);
+}
+
+/**
+ * @brief A growable buffer of NUL-terminated strings.
+ */
+struct string_pool {
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+/**
+ * @brief Copies a string into a pool.
+ *
+ * @return The string's offset in the pool.
+ */
+static uint32_t string_pool_add(struct string_pool *pool, const char *str)
+{
+    size_t len = strlen(str) + 1;
+
+    if (pool->size + len > pool->capacity) {
+        size_t capacity = pool->capacity ? pool->capacity : 4096;
+        while (pool->size + len > capacity)
+            capacity *= 2;
+        pool->data = realloc(pool->data, capacity);
+        pool->capacity = capacity;
+    }
+
+    uint32_t offset = pool->size;
+    memcpy(pool->data + pool->size, str, len);
+    pool->size += len;
+
+    return offset;
+}
+
+/**
+ * @brief Writes a new index file holding the given songs.
+ *
+ * The index is written to a temporary file and renamed into place, so readers never
+ * see a partially written index.
+ *
+ * @param songs Every song in the library.
+ * @param db_update The database update time the songs were listed at.
+ * @return true on success, or false on error.
+ */
+bool library_index_write(const struct library_chunk *songs, const char *path, uint64_t db_update)
+{
+    int count = songs->count;
+
+    if (!path)
+        return false;
+
+    struct library_track_info *infos = malloc((count + 1) * sizeof(*infos));
+    for (int i = 0; i < count; ++i) {
+        const struct library_chunk_song *song = &songs->songs[i];
+        infos[i] = (struct library_track_info){.artist = library_chunk_string(songs, song->artist),
+                                               .album = library_chunk_string(songs, song->album),
+                                               .title = library_chunk_string(songs, song->title),
+                                               .uri = library_chunk_string(songs, song->uri),
+                                               .track = song->track,
+                                               .duration = song->duration};
+    }
+    qsort(infos, count, sizeof(*infos), library_track_compare);
+
+    struct library_index_artist *artists = malloc((count + 1) * sizeof(*artists));
+    struct library_index_album *albums = malloc((count + 1) * sizeof(*albums));
+    struct library_index_track *tracks = malloc((count + 1) * sizeof(*tracks));
+    struct string_pool pool = {NULL, 0, 0};
+    uint32_t artist_count = 0;
+    uint32_t album_count = 0;
+
+    string_pool_add(&pool, ""); /* Keeps the pool non-empty, even for an empty library. */
+
+    for (int i = 0; i < count; ++i) {
+        bool new_artist = i == 0 || strcmp(infos[i].artist, infos[i - 1].artist) != 0;
+        bool new_album = new_artist || strcmp(infos[i].album, infos[i - 1].album) != 0;
+
+        if (new_artist) {
+            artists[artist_count++] = (struct library_index_artist){
+                .name = string_pool_add(&pool, infos[i].artist), .first_album = album_count};
+        }
+        if (new_album) {
+            albums[album_count++] = (struct library_index_album){
+                .name = string_pool_add(&pool, infos[i].album), .first_track = i};
+            artists[artist_count - 1].album_count++;
+        }
+
+        tracks[i] = (struct library_index_track){.title = string_pool_add(&pool, infos[i].title),
+                                                 .uri = string_pool_add(&pool, infos[i].uri),
+                                                 .track = infos[i].track,
+                                                 .duration = infos[i].duration};
+        albums[album_count - 1].track_count++;
+    }
+
+    struct library_index_header header = {
+        .magic = LIBRARY_INDEX_MAGIC,
+        .version = LIBRARY_INDEX_VERSION,
+        .artist_count = artist_count,
+        .album_count = album_count,
+        .track_count = count,
+        .db_update = db_update,
+        .strings_size = pool.size,
+    };
+
+    int len = strlen(path) + sizeof(".tmp");
+    char *tmp_path = malloc(len);
+    snprintf(tmp_path, len, "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    bool success = file != NULL;
+
+    if (file) {
+        success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(artists, sizeof(*artists), artist_count, file) == artist_count &&
+                  fwrite(albums, sizeof(*albums), album_count, file) == album_count &&
+                  fwrite(tracks, sizeof(*tracks), count, file) == (size_t)count &&
+                  fwrite(pool.data, 1, pool.size, file) == pool.size;
+        success = (fclose(file) == 0) && success;
+    }
+
+    /* Renaming over the old file leaves existing mappings of it intact. */
+    if (success)
+        success = rename(tmp_path, path) == 0;
+    else
+        unlink(tmp_path);
+
+    free(tmp_path);
+    free(infos);
+    free(artists);
+    free(albums);
+    free(tracks);
+    free(pool.data);
+
+    return success;
+}
+
+struct library_chunk *library_chunk_new()
+{
+    struct library_chunk *chunk = malloc(sizeof(*chunk));
+    if (!chunk)
+        return NULL;
+
+    chunk->songs = NULL;
+    chunk->count = 0;
+    chunk->capacity = 0;
+    chunk->strings = NULL;
+    chunk->strings_size = 0;
+    chunk->strings_capacity = 0;
+
+    return chunk;
+}
+
+void library_chunk_free(struct library_chunk *chunk)
+{
+    free(chunk->songs);
+    free(chunk->strings);
+    free(chunk);
+}
+
+/**
+ * @brief Copies a string into a chunk's pool.
+ *
+ * @return The string's offset in the pool.
+ */
+static uint32_t library_chunk_add_string(struct library_chunk *chunk, const char *str)
+{
+    struct string_pool pool = {chunk->strings, chunk->strings_size, chunk->strings_capacity};
+    uint32_t offset = string_pool_add(&pool, str ? str : "");
+
+    chunk->strings = pool.data;
+    chunk->strings_size = pool.size;
+    chunk->strings_capacity = pool.capacity;
+
+    return offset;
+}
+
+/**
+ * @brief Adds a song's tags to a chunk.
+ *
+ * A song with several ARTIST values is added once under each of them, so it can be found
+ * under any of its artists, as it could when browsing with the list command.
+ */
+void library_chunk_add_song(struct library_chunk *chunk, const struct mpd_song *song)
+{
+    const char *track = mpd_song_get_tag(song, MPD_TAG_TRACK, 0);
+    const char *artist = mpd_song_get_tag(song, MPD_TAG_ARTIST, 0);
+    unsigned i = 0;
+
+    do {
+        if (chunk->count == chunk->capacity) {
+            int capacity = chunk->capacity ? chunk->capacity * 2 : 1024;
+            struct library_chunk_song *songs = realloc(chunk->songs, capacity * sizeof(*songs));
+            if (!songs)
+                return;
+
+            chunk->songs = songs;
+            chunk->capacity = capacity;
+        }
+
+        chunk->songs[chunk->count++] = (struct library_chunk_song){
+            .artist = library_chunk_add_string(chunk, artist),
+            .album = library_chunk_add_string(chunk, mpd_song_get_tag(song, MPD_TAG_ALBUM, 0)),
+            .title = library_chunk_add_string(chunk, mpd_song_get_tag(song, MPD_TAG_TITLE, 0)),
+            .uri = library_chunk_add_string(chunk, mpd_song_get_uri(song)),
+            .track = track ? strtoul(track, NULL, 10) : 0,
+            .duration = mpd_song_get_duration(song),
+        };
+    } while ((artist = mpd_song_get_tag(song, MPD_TAG_ARTIST, ++i)) != NULL);
+}
+
+/**
+ * @brief Gets a string from a chunk's pool.
+ */
+const char *library_chunk_string(const struct library_chunk *chunk, uint32_t offset)
+{
+    return chunk->strings + offset;
+}
@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * library_index.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file library_index.h
+ * @brief A local, memory-mapped copy of the music library's artist/album/track hierarchy.
+ *
+ * The index is built by the MPD worker from a full listing of the database and saved
+ * under $XDG_CACHE_HOME. Each file records the database's last update time (from the
+ * "stats" command), so a cached index can be checked against the server without
+ * downloading anything. While the index is current, the library can be browsed
+ * without any server requests.
+ *
+ * The file holds a header, then three arrays of fixed-size records (artists, albums,
+ * and tracks), then a pool of NUL-terminated strings. Artists are sorted by name,
+ * each artist's albums by name, and each album's tracks by track number. Records
+ * refer to their children as a range of indices and to strings as offsets into the pool.
+ */
+
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include <mpd/client.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LIBRARY_INDEX_MAGIC "PNTMLIB"
+#define LIBRARY_INDEX_VERSION 1
+
+struct library_index_header {
+    char magic[8];         /**< LIBRARY_INDEX_MAGIC, NUL-terminated. */
+    uint32_t version;      /**< LIBRARY_INDEX_VERSION. */
+    uint32_t artist_count; /**< The number of artist records. */
+    uint32_t album_count;  /**< The number of album records. */
+    uint32_t track_count;  /**< The number of track records. */
+    uint64_t db_update;    /**< The database update time the index was built from. */
+    uint64_t strings_size; /**< The size of the string pool in bytes. */
+};
+
+struct library_index_artist {
+    uint32_t name;        /**< Offset of the artist's name in the string pool. */
+    uint32_t first_album; /**< Index of the artist's first album. */
+    uint32_t album_count; /**< The number of albums by the artist. */
+};
+
+struct library_index_album {
+    uint32_t name;        /**< Offset of the album's name in the string pool. */
+    uint32_t first_track; /**< Index of the album's first track. */
+    uint32_t track_count; /**< The number of tracks on the album. */
+};
+
+struct library_index_track {
+    uint32_t title;    /**< Offset of the track's title in the string pool. */
+    uint32_t uri;      /**< Offset of the song's URI in the string pool. */
+    uint32_t track;    /**< The track number, or 0 if there isn't one. */
+    uint32_t duration; /**< The track's length in seconds. */
+};
+
+/**
+ * @brief An open, memory-mapped library index.
+ */
+struct library_index {
+    void *map;   /**< The mapped file. */
+    size_t size; /**< The size of the mapping. */
+
+    const struct library_index_header *header;
+    const struct library_index_artist *artists;
+    const struct library_index_album *albums;
+    const struct library_index_track *tracks;
+    const char *strings;
+};
+
+/**
+ * @brief A batch of songs listed from the library.
+ *
+ * The worker collects songs into chunks while listing the database. Chunks are streamed
+ * to the UI as they fill up, and one holding every song is used to write the index.
+ * Each song's strings are stored in a single pool, so a chunk is only a few allocations.
+ */
+struct library_chunk {
+    struct library_chunk_song *songs; /**< The songs, in the order they were listed. */
+    int count;                        /**< The number of songs. */
+    int capacity;                     /**< The number of songs there is room for. */
+
+    char *strings;           /**< NUL-terminated strings, referred to by offset. */
+    size_t strings_size;     /**< The number of bytes used in the pool. */
+    size_t strings_capacity; /**< The size of the pool. */
+};
+
+/**
+ * @brief A song in a library chunk. Strings are offsets into the chunk's pool.
+ */
+struct library_chunk_song {
+    uint32_t artist;
+    uint32_t album;
+    uint32_t title;
+    uint32_t uri;
+    uint32_t track;    /**< The track number, or 0 if there isn't one. */
+    uint32_t duration; /**< The song's length in seconds. */
+};
+
+char *library_index_default_path(const char *host, int port);
+
+struct library_index *library_index_open(const char *path);
+void library_index_close(struct library_index *index);
+bool library_index_read_db_update(const char *path, uint64_t *db_update);
+
+uint64_t library_index_get_db_update(struct library_index *index);
+const char *library_index_string(struct library_index *index, uint32_t offset);
+int library_index_find_artist(struct library_index *index, const char *name);
+int library_index_find_album(struct library_index *index, int artist, const char *name);
+
+bool library_index_write(const struct library_chunk *songs, const char *path, uint64_t db_update);
+
+struct library_chunk *library_chunk_new();
+void library_chunk_free(struct library_chunk *chunk);
+void library_chunk_add_song(struct library_chunk *chunk, const struct mpd_song *song);
+const char *library_chunk_string(const struct library_chunk *chunk, uint32_t offset);
+
+#endif /* LIBRARY_INDEX_H */
@@ -0,0 +1,1289 @@
+/*******************************************************************************
+ * mpdworker.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file mpdworker.h
+ */
+
+#include "mpdworker.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "library.h"
+#include "mpdwrapper.h"
+#include "pantomime/intern.h"
+#include "playback_clock.h"
+
+static void *mpdworker_run(void *data);
+static void mpdworker_release(struct mpdworker *worker);
+
+/**
+ * @brief Starts a worker thread that connects to an MPD server.
+ *
+ * The connection is made on the worker thread, so this returns right away. Its progress
+ * is reported through REPLY_CONNECTION replies.
+ *
+ * @param host The IP address or UNIX socket to connect to.
+ * @param port The TCP port to connect to if using an IP address.
+ * @param timeout The timeout in milliseconds.
+ * @param library_path Where to keep the library index, or NULL to not keep one.
+ * @return A pointer to the new worker, or NULL on error.
+ */
+struct mpdworker *mpdworker_new(const char *host, int port, int timeout, const char *library_path)
+{
+    struct mpdworker *worker = malloc(sizeof(*worker));
+    if (!worker)
+        return NULL;
+
+    worker->requests = ringbuffer_new(WORKER_QUEUE_SIZE, sizeof(struct worker_request));
+    worker->replies = ringbuffer_new(WORKER_QUEUE_SIZE, sizeof(struct worker_reply));
+    atomic_init(&worker->quit, false);
+
+    worker->host = strdup(host);
+    worker->port = port;
+    worker->timeout = timeout;
+    worker->error = NULL;
+    worker->backoff = 0;
+    worker->seed = time(NULL) ^ getpid();
+
+    worker->connection = NULL;
+    worker->idle = false;
+    worker->state = MPD_STATE_UNKNOWN;
+    worker->stats_stale = true;
+    worker->last_refresh = 0;
+    worker->server_start = 0;
+
+    worker->queue_valid = false;
+    worker->queue_version = 0;
+    worker->queue_ids = NULL;
+    worker->queue_length = 0;
+
+    worker->library_path = library_path ? strdup(library_path) : NULL;
+    worker->library_db_update = 0;
+    worker->library_stale = false;
+    worker->server_db_update = 0;
+    worker->library_retry = false;
+    worker->library_failed_update = 0;
+    worker->library_backoff = 0;
+    worker->library_retry_at = 0;
+    library_index_read_db_update(library_path, &worker->library_db_update);
+
+    worker->wake_fds[0] = worker->wake_fds[1] = -1;
+    worker->reply_fds[0] = worker->reply_fds[1] = -1;
+    if (pipe(worker->wake_fds) != 0 || pipe(worker->reply_fds) != 0) {
+        mpdworker_release(worker);
+        return NULL;
+    }
+    for (int i = 0; i < 2; ++i) {
+        fcntl(worker->wake_fds[i], F_SETFL, O_NONBLOCK);
+        fcntl(worker->reply_fds[i], F_SETFL, O_NONBLOCK);
+    }
+
+    if (!worker->requests || !worker->replies || !worker->host
+        || (library_path && !worker->library_path)
+        || pthread_create(&worker->thread, NULL, mpdworker_run, worker) != 0) {
+        mpdworker_release(worker);
+        return NULL;
+    }
+
+    return worker;
+}
+
+/**
+ * @brief Stops the worker thread and frees everything it owns, including any
+ * messages that were never received.
+ */
+void mpdworker_free(struct mpdworker *worker)
+{
+    struct worker_request request;
+    struct worker_reply reply;
+
+    atomic_store(&worker->quit, true);
+    write(worker->wake_fds[1], "q", 1);
+    pthread_join(worker->thread, NULL);
+
+    while (ringbuffer_pop(worker->requests, &request))
+        worker_request_clear(&request);
+    while (ringbuffer_pop(worker->replies, &reply))
+        worker_reply_clear(&reply);
+
+    mpdworker_release(worker);
+}
+
+/**
+ * @brief Frees a worker whose thread is not running. Pipes that were never opened are -1.
+ */
+static void mpdworker_release(struct mpdworker *worker)
+{
+    ringbuffer_free(worker->requests);
+    ringbuffer_free(worker->replies);
+    for (int i = 0; i < 2; ++i) {
+        if (worker->wake_fds[i] >= 0)
+            close(worker->wake_fds[i]);
+        if (worker->reply_fds[i] >= 0)
+            close(worker->reply_fds[i]);
+    }
+    free(worker->queue_ids);
+    free(worker->library_path);
+    free(worker->host);
+    free(worker->error);
+    free(worker);
+}
+
+/**
+ * @brief Sends a request to the worker thread. Never blocks.
+ *
+ * On success, the worker takes ownership of the request's strings.
+ *
+ * @return true if the request was queued, or false if too many requests are waiting.
+ */
+bool mpdworker_send(struct mpdworker *worker, struct worker_request *request)
+{
+    if (!ringbuffer_push(worker->requests, request))
+        return false;
+
+    write(worker->wake_fds[1], "r", 1);
+    return true;
+}
+
+/**
+ * @brief Receives the oldest reply from the worker thread, if there is one. Never blocks.
+ *
+ * @return true if a reply was received, or false if there are none waiting.
+ */
+bool mpdworker_receive(struct mpdworker *worker, struct worker_reply *reply)
+{
+    return ringbuffer_pop(worker->replies, reply);
+}
+
+/**
+ * @brief Gets a descriptor that becomes readable whenever the worker sends a reply.
+ */
+int mpdworker_get_fd(struct mpdworker *worker)
+{
+    return worker->reply_fds[0];
+}
+
+/**
+ * @brief Consumes the wakeups for the replies waiting so far.
+ *
+ * Call this before receiving the replies, so one sent while they're being worked through
+ * still leaves the descriptor readable.
+ */
+void mpdworker_acknowledge(struct mpdworker *worker)
+{
+    char buffer[64];
+
+    while (read(worker->reply_fds[0], buffer, sizeof(buffer)) > 0)
+        continue;
+}
+
+void worker_request_clear(struct worker_request *request)
+{
+    for (int i = 0; i < 3; ++i) {
+        free(request->strings[i]);
+        request->strings[i] = NULL;
+    }
+
+    if (request->uris) {
+        for (struct stringlist_item *item = request->uris->head; item; item = item->next)
+            free(item->str);
+        stringlist_free(request->uris);
+        request->uris = NULL;
+    }
+}
+
+/**
+ * @brief Frees everything a reply refers to.
+ */
+void worker_reply_clear(struct worker_reply *reply)
+{
+    if (reply->status)
+        mpd_status_free(reply->status);
+    if (reply->current_song)
+        mpd_song_free(reply->current_song);
+    if (reply->stats)
+        mpd_stats_free(reply->stats);
+    if (reply->patch)
+        queue_patch_free(reply->patch);
+    if (reply->chunk)
+        library_chunk_free(reply->chunk);
+    free(reply->names);
+    for (int i = 0; reply->titles && i < reply->name_count; ++i)
+        free(reply->titles[i]);
+    free(reply->titles);
+    free(reply->message);
+
+    memset(reply, 0, sizeof(*reply));
+}
+
+void queue_patch_free(struct queue_patch *patch)
+{
+    arena_release(&patch->arena);
+    free(patch->changes);
+    free(patch->songs);
+    free(patch);
+}
+
+/**
+ * @brief Hands a reply to the UI thread.
+ *
+ * If the UI has fallen behind and the reply queue is full, this waits for room.
+ * Replies sent while the worker is shutting down are discarded.
+ */
+static void mpdworker_publish(struct mpdworker *worker, struct worker_reply *reply)
+{
+    const struct timespec delay = {.tv_sec = 0, .tv_nsec = 1000000};
+
+    while (!ringbuffer_push(worker->replies, reply)) {
+        if (atomic_load(&worker->quit)) {
+            worker_reply_clear(reply);
+            return;
+        }
+        nanosleep(&delay, NULL);
+    }
+
+    /* If the pipe is full, the UI hasn't read the earlier wakeups yet, which is enough. */
+    write(worker->reply_fds[1], "r", 1);
+}
+
+/**
+ * @brief Remembers why the connection was lost or couldn't be made.
+ */
+static void mpdworker_set_error(struct mpdworker *worker, const char *message)
+{
+    free(worker->error);
+    worker->error = strdup(message);
+}
+
+/**
+ * @brief Reports the connection's current error to the UI and clears it, if possible.
+ *
+ * An error that breaks the connection isn't reported here. It's kept for the
+ * REPLY_CONNECTION that's sent once the connection is dropped.
+ *
+ * @return true if the connection is still usable, false otherwise.
+ */
+static bool mpdworker_report_error(struct mpdworker *worker)
+{
+    char *message = strdup(mpd_connection_get_error_message(worker->connection));
+
+    if (!mpd_connection_clear_error(worker->connection)) {
+        free(worker->error);
+        worker->error = message;
+        return false;
+    }
+
+    struct worker_reply reply = {.type = REPLY_ERROR, .message = message};
+    mpdworker_publish(worker, &reply);
+
+    return true;
+}
+
+/**
+ * @brief Fetches the status, the current song, and (when stale) the database statistics
+ * in a single round trip, and publishes them to the UI.
+ *
+ * All the requests are sent in one command list and their replies parsed in one pass.
+ *
+ * The status is owned by the UI once published, so the queue's version and length are
+ * copied out of it first.
+ *
+ * @return true on success, or false on error.
+ */
+static bool mpdworker_fetch_status(struct mpdworker *worker, bool db_changed,
+                                   unsigned *queue_version, int *queue_length)
+{
+    struct mpd_connection *connection = worker->connection;
+    bool fetch_stats = worker->stats_stale;
+
+    mpd_command_list_begin(connection, true);
+    mpd_send_status(connection);
+    mpd_send_current_song(connection);
+    if (fetch_stats)
+        mpd_send_stats(connection);
+    mpd_command_list_end(connection);
+
+    struct worker_reply reply = {.type = REPLY_STATUS, .db_changed = db_changed};
+
+    reply.status = mpd_recv_status(connection);
+    reply.fetched_at = playback_clock_now();
+    if (reply.status && mpd_response_next(connection)) {
+        reply.current_song = mpd_recv_song(connection);
+        if (fetch_stats && mpd_response_next(connection))
+            reply.stats = mpd_recv_stats(connection);
+    }
+
+    if (!mpd_response_finish(connection) || !reply.status) {
+        worker_reply_clear(&reply);
+        worker->state = MPD_STATE_UNKNOWN;
+        return false;
+    }
+
+    /* Song IDs and queue versions only mean something to the server process that handed
+     * them out. If the server restarted since the queue was synced, it has to be fetched
+     * again in full. */
+    if (reply.stats) {
+        time_t server_start = time(NULL) - mpd_stats_get_uptime(reply.stats);
+
+        if (worker->server_start && labs(server_start - worker->server_start) > 2)
+            worker->queue_valid = false;
+        worker->server_start = server_start;
+    }
+
+    /* A database whose listing already failed waits for its retry in mpdworker_serve(). */
+    if (reply.stats) {
+        uint64_t db_update = mpd_stats_get_db_update_time(reply.stats);
+
+        worker->stats_stale = false;
+        worker->server_db_update = db_update;
+        if (db_update != worker->library_db_update &&
+            (!worker->library_retry || db_update != worker->library_failed_update))
+            worker->library_stale = true;
+    }
+    worker->state = mpd_status_get_state(reply.status);
+    worker->last_refresh = time(NULL);
+    *queue_version = mpd_status_get_queue_version(reply.status);
+    *queue_length = mpd_status_get_queue_length(reply.status);
+
+    mpdworker_publish(worker, &reply);
+
+    return true;
+}
+
+/**
+ * @brief Sets the field of a queue song named by a response line.
+ */
+static void queue_song_feed(struct queue_song *song, struct arena *arena,
+                            const struct mpd_pair *pair)
+{
+    if (strcmp(pair->name, "Id") == 0)
+        song->id = strtoul(pair->value, NULL, 10);
+    else if (strcmp(pair->name, "duration") == 0)
+        song->duration = strtod(pair->value, NULL) + 0.5;
+    else if (strcmp(pair->name, "Time") == 0 && !song->duration)
+        song->duration = strtoul(pair->value, NULL, 10);
+    /* Only the first of a tag's values is kept, as with mpd_song_get_tag(song, tag, 0). */
+    else if (strcmp(pair->name, "Artist") == 0 && song->artist_id == INTERN_EMPTY)
+        song->artist_id = intern(pair->value);
+    else if (strcmp(pair->name, "Album") == 0 && song->album_id == INTERN_EMPTY)
+        song->album_id = intern(pair->value);
+    else if (strcmp(pair->name, "Title") == 0 && !song->title)
+        song->title = arena_strdup(arena, pair->value);
+}
+
+/**
+ * @brief Reads the next song in a response straight into an arena.
+ *
+ * This reads the same lines as mpd_recv_song(), but only keeps what the queue shows,
+ * and doesn't allocate anything per song or per tag.
+ *
+ * @return The song, or NULL at the end of the response or on error.
+ */
+static struct queue_song *mpdworker_recv_queue_song(struct mpd_connection *connection,
+                                                    struct arena *arena)
+{
+    struct mpd_pair *pair = mpd_recv_pair_named(connection, "file");
+    if (!pair)
+        return NULL;
+
+    struct queue_song *song = arena_alloc(arena, sizeof(*song));
+    if (song)
+        *song = (struct queue_song){.uri = arena_strdup(arena, pair->value)};
+    mpd_return_pair(connection, pair);
+
+    while ((pair = mpd_recv_pair(connection)) && strcmp(pair->name, "file") != 0) {
+        if (song)
+            queue_song_feed(song, arena, pair);
+        mpd_return_pair(connection, pair);
+    }
+
+    /* The next song's first line is put back for the next call to read. */
+    if (pair)
+        mpd_enqueue_pair(connection, pair);
+
+    return song;
+}
+
+/**
+ * @brief Fetches the whole queue and publishes it to the UI as a full patch.
+ */
+static void mpdworker_fetch_queue(struct mpdworker *worker, unsigned version)
+{
+    struct queue_patch *patch = calloc(1, sizeof(*patch));
+    int capacity = 64;
+    struct queue_song *song;
+
+    patch->full = true;
+    patch->version = version;
+    patch->songs = malloc(capacity * sizeof(*patch->songs));
+    arena_initialize(&patch->arena);
+
+    mpd_send_list_queue_meta(worker->connection);
+    while ((song = mpdworker_recv_queue_song(worker->connection, &patch->arena))) {
+        if (patch->length == capacity) {
+            capacity *= 2;
+            patch->songs = realloc(patch->songs, capacity * sizeof(*patch->songs));
+        }
+        patch->songs[patch->length++] = song;
+    }
+
+    if (!mpd_response_finish(worker->connection)) {
+        queue_patch_free(patch);
+        worker->queue_valid = false;
+        return;
+    }
+
+    worker->queue_ids = realloc(worker->queue_ids, (patch->length + 1) * sizeof(unsigned));
+    for (int i = 0; i < patch->length; ++i)
+        worker->queue_ids[i] = patch->songs[i]->id;
+    worker->queue_length = patch->length;
+    worker->queue_version = version;
+    worker->queue_valid = true;
+
+    struct worker_reply reply = {.type = REPLY_QUEUE, .patch = patch};
+    mpdworker_publish(worker, &reply);
+}
+
+/**
+ * @brief Compares two queue entries by song ID, for sorting with qsort().
+ */
+static int queue_entry_compare(const void *a, const void *b)
+{
+    const struct queue_entry *entry_a = a;
+    const struct queue_entry *entry_b = b;
+
+    return (entry_a->id > entry_b->id) - (entry_a->id < entry_b->id);
+}
+
+/**
+ * @brief Finds the index of a song in a list of queue entries sorted by ID.
+ *
+ * @return The song's index in the queue, or -1 if the song isn't there.
+ */
+static int queue_entry_find(struct queue_entry *entries, int count, unsigned id)
+{
+    int low = 0;
+    int high = count - 1;
+
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+
+        if (entries[mid].id == id)
+            return entries[mid].index;
+        else if (entries[mid].id < id)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Works out where each changed song comes from.
+ *
+ * Positions that weren't reported keep their song. Reported positions take the song
+ * with the same ID from the old queue, if there is one, and each change's index is set
+ * accordingly.
+ *
+ * @param ids The ID of each song in the old queue, by position.
+ * @return The number of songs that need fetching, or -1 if the changes don't describe
+ *   a valid queue.
+ */
+static int queue_resolve_changes(const unsigned *ids, int id_count, struct queue_change *changes,
+                                 int change_count, int length)
+{
+    struct queue_entry *entries = malloc((id_count + 1) * sizeof(*entries));
+    int *sources = malloc((length + 1) * sizeof(*sources));
+    bool *used = calloc(id_count + 1, sizeof(*used));
+    int missing = 0;
+
+    for (int i = 0; i < id_count; ++i)
+        entries[i] = (struct queue_entry){.id = ids[i], .index = i};
+    qsort(entries, id_count, sizeof(*entries), queue_entry_compare);
+
+    /* -1 marks a position with no song, and -2 a song that will be fetched. */
+    for (int i = 0; i < length; ++i)
+        sources[i] = (i < id_count) ? i : -1;
+    for (int i = 0; i < change_count; ++i) {
+        changes[i].index = queue_entry_find(entries, id_count, changes[i].id);
+        sources[changes[i].pos] = (changes[i].index < 0) ? -2 : changes[i].index;
+        if (changes[i].index < 0)
+            ++missing;
+    }
+
+    /* Every position needs exactly one song. */
+    for (int i = 0; i < length && missing >= 0; ++i) {
+        if (sources[i] == -1)
+            missing = -1;
+        else if (sources[i] >= 0 && used[sources[i]])
+            missing = -1;
+        else if (sources[i] >= 0)
+            used[sources[i]] = true;
+    }
+
+    free(entries);
+    free(sources);
+    free(used);
+
+    return missing;
+}
+
+/**
+ * @brief Fetches the songs in a queue patch that the UI hasn't seen yet.
+ *
+ * All of the songs are requested in a single command list.
+ *
+ * @return true on success, or false if any of the songs couldn't be fetched.
+ */
+static bool mpdworker_fetch_queue_changes(struct mpdworker *worker, struct queue_patch *patch)
+{
+    struct mpd_connection *connection = worker->connection;
+    struct queue_change *changes = patch->changes;
+    bool success = true;
+
+    mpd_command_list_begin(connection, false);
+    for (int i = 0; i < patch->change_count; ++i) {
+        if (changes[i].index < 0)
+            mpd_send_get_queue_song_id(connection, changes[i].id);
+    }
+    mpd_command_list_end(connection);
+
+    for (int i = 0; i < patch->change_count && success; ++i) {
+        if (changes[i].index >= 0)
+            continue;
+
+        struct queue_song *song = mpdworker_recv_queue_song(connection, &patch->arena);
+        if (!song || song->id != changes[i].id)
+            success = false;
+        else
+            patch->songs[i] = song;
+    }
+
+    /* A song removed by another client since the changes were listed fails the whole
+     * command list. The error is recoverable, and the caller falls back to a full fetch. */
+    if (!mpd_response_finish(connection)) {
+        mpd_connection_clear_error(connection);
+        return false;
+    }
+
+    return success;
+}
+
+/**
+ * @brief Brings the UI's queue up to date using only the changes since its queue version.
+ *
+ * Only the positions and IDs of changed songs are requested from the server. Songs the
+ * UI already has are moved to their new positions, and only songs that are new to the
+ * queue have their metadata fetched. If the changes can't be applied, the whole queue is
+ * fetched again.
+ */
+static void mpdworker_sync_queue(struct mpdworker *worker, unsigned version, int length)
+{
+    if (worker->queue_valid && worker->queue_version == version)
+        return;
+    if (!worker->queue_valid) {
+        mpdworker_fetch_queue(worker, version);
+        return;
+    }
+
+    struct queue_patch *patch = calloc(1, sizeof(*patch));
+    int capacity = 0;
+    unsigned pos;
+    unsigned id;
+
+    patch->version = version;
+    arena_initialize(&patch->arena);
+    patch->base_length = worker->queue_length;
+    patch->length = length;
+
+    mpd_send_queue_changes_brief(worker->connection, worker->queue_version);
+    while (mpd_recv_queue_change_brief(worker->connection, &pos, &id)) {
+        if (pos >= length)
+            continue;
+        if (patch->change_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            patch->changes = realloc(patch->changes, capacity * sizeof(*patch->changes));
+        }
+        patch->changes[patch->change_count++] =
+            (struct queue_change){.pos = pos, .id = id, .index = -1};
+    }
+
+    bool success = mpd_response_finish(worker->connection);
+    int missing = -1;
+
+    patch->songs = calloc(patch->change_count + 1, sizeof(*patch->songs));
+    if (success) {
+        missing = queue_resolve_changes(worker->queue_ids, worker->queue_length, patch->changes,
+                                        patch->change_count, length);
+        success = missing >= 0 && missing <= length / 2;
+    }
+    if (success && missing > 0)
+        success = mpdworker_fetch_queue_changes(worker, patch);
+
+    if (!success) {
+        queue_patch_free(patch);
+        mpd_connection_clear_error(worker->connection);
+        mpdworker_fetch_queue(worker, version);
+        return;
+    }
+
+    worker->queue_ids = realloc(worker->queue_ids, (length + 1) * sizeof(unsigned));
+    for (int i = 0; i < patch->change_count; ++i)
+        worker->queue_ids[patch->changes[i].pos] = patch->changes[i].id;
+    worker->queue_length = length;
+    worker->queue_version = version;
+
+    struct worker_reply reply = {.type = REPLY_QUEUE, .patch = patch};
+    mpdworker_publish(worker, &reply);
+}
+
+/**
+ * @brief Fetches the current state from the server and publishes it to the UI.
+ *
+ * @return true on success, or false on error.
+ */
+static bool mpdworker_refresh(struct mpdworker *worker, bool db_changed)
+{
+    unsigned queue_version;
+    int queue_length;
+
+    if (!mpdworker_fetch_status(worker, db_changed, &queue_version, &queue_length))
+        return false;
+
+    mpdworker_sync_queue(worker, queue_version, queue_length);
+    return true;
+}
+
+/**
+ * @brief Parks the connection in MPD's idle mode.
+ *
+ * While idle, the server sends nothing until one of the subsystems we care about changes.
+ * The connection can't be used for other commands until idle mode is left.
+ */
+static void mpdworker_idle_enter(struct mpdworker *worker)
+{
+    if (worker->idle)
+        return;
+
+    enum mpd_idle mask = MPD_IDLE_PLAYER | MPD_IDLE_QUEUE | MPD_IDLE_MIXER | MPD_IDLE_OPTIONS |
+                         MPD_IDLE_DATABASE;
+
+    worker->idle = mpd_send_idle_mask(worker->connection, mask);
+}
+
+/**
+ * @brief Takes the connection out of idle mode.
+ *
+ * @param readable Whether the server has already sent its list of events.
+ * @return The events the server reported before leaving idle mode.
+ */
+static enum mpd_idle mpdworker_idle_leave(struct mpdworker *worker, bool readable)
+{
+    if (!worker->idle)
+        return 0;
+
+    if (!readable)
+        mpd_send_noidle(worker->connection);
+
+    worker->idle = false;
+    return mpd_recv_idle(worker->connection, false);
+}
+
+/**
+ * @brief Interns a name and adds it to the list in a reply.
+ *
+ * @param capacity The number of names the reply's array has room for.
+ */
+static void mpdworker_list_add(struct worker_reply *reply, int *capacity, const char *name)
+{
+    if (reply->name_count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        reply->names = realloc(reply->names, *capacity * sizeof(*reply->names));
+    }
+    reply->names[reply->name_count++] = intern(name);
+}
+
+/**
+ * @brief Copies a song title into the list in a reply.
+ *
+ * Titles rarely repeat, so they're copied rather than kept in the intern table for good.
+ *
+ * @param capacity The number of titles the reply's array has room for.
+ */
+static void mpdworker_list_add_title(struct worker_reply *reply, int *capacity,
+                                     const char *title)
+{
+    if (reply->name_count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        reply->titles = realloc(reply->titles, *capacity * sizeof(*reply->titles));
+    }
+    reply->titles[reply->name_count++] = strdup(title ? title : "");
+}
+
+/**
+ * @brief Lists the values of a tag, optionally limited to one artist.
+ *
+ * @return true if the list was published, or false on error.
+ */
+static bool mpdworker_list_tags(struct mpdworker *worker, enum mpdwrapper_list type,
+                                enum mpd_tag_type tag, const char *artist)
+{
+    struct mpd_connection *connection = worker->connection;
+
+    if (!mpd_search_db_tags(connection, tag))
+        return false;
+    if (artist)
+        mpd_search_add_tag_constraint(connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST, artist);
+    mpd_search_commit(connection);
+
+    struct mpd_pair *pair;
+    struct worker_reply reply = {.type = REPLY_LIST, .list_type = type};
+    int capacity = 0;
+
+    while ((pair = mpd_recv_pair_tag(connection, tag)) != NULL) {
+        mpdworker_list_add(&reply, &capacity, pair->value);
+        mpd_return_pair(connection, pair);
+    }
+
+    /* A listing cut short by an error isn't shown, and the error reaches the caller. */
+    if (!mpd_response_finish(connection)) {
+        worker_reply_clear(&reply);
+        return false;
+    }
+    mpdworker_publish(worker, &reply);
+
+    return true;
+}
+
+/**
+ * @brief Lists the titles of the songs on an album.
+ *
+ * @return true if the list was published, or false on error.
+ */
+static bool mpdworker_list_songs(struct mpdworker *worker, const char *artist, const char *album)
+{
+    struct mpd_connection *connection = worker->connection;
+
+    if (!mpd_search_db_songs(connection, true))
+        return false;
+
+    mpd_search_add_tag_constraint(connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST, artist);
+    mpd_search_add_tag_constraint(connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ALBUM, album);
+    mpd_search_add_sort_tag(connection, MPD_TAG_TRACK, false);
+    mpd_search_commit(connection);
+
+    struct mpd_song *song;
+    struct worker_reply reply = {.type = REPLY_LIST, .list_type = LIST_SONGS};
+    int capacity = 0;
+
+    while ((song = mpd_recv_song(connection)) != NULL) {
+        mpdworker_list_add_title(&reply, &capacity, mpd_song_get_tag(song, MPD_TAG_TITLE, 0));
+        mpd_song_free(song);
+    }
+
+    if (!mpd_response_finish(connection)) {
+        worker_reply_clear(&reply);
+        return false;
+    }
+    mpdworker_publish(worker, &reply);
+
+    return true;
+}
+
+/**
+ * @brief Finds all songs matching the given tags and adds them to the queue.
+ *
+ * @param strings The artist, album, and title to match. Trailing NULLs are ignored.
+ */
+static bool mpdworker_add_songs(struct mpdworker *worker, char **strings)
+{
+    struct mpd_connection *connection = worker->connection;
+    const enum mpd_tag_type tags[] = {MPD_TAG_ARTIST, MPD_TAG_ALBUM, MPD_TAG_TITLE};
+
+    if (!mpd_search_add_db_songs(connection, strings[2] == NULL))
+        return false;
+
+    for (int i = 0; i < 3 && strings[i]; ++i)
+        mpd_search_add_tag_constraint(connection, MPD_OPERATOR_DEFAULT, tags[i], strings[i]);
+
+    bool rc = mpd_search_commit(connection);
+    return mpd_response_finish(connection) && rc;
+}
+
+/**
+ * @brief Streams a chunk of the library to the UI.
+ */
+static void mpdworker_publish_chunk(struct mpdworker *worker, struct library_chunk *chunk,
+                                    bool first)
+{
+    struct worker_reply reply = {.type = REPLY_LIBRARY_CHUNK, .chunk = chunk, .first_chunk = first};
+    mpdworker_publish(worker, &reply);
+}
+
+/**
+ * @brief Holds off listing the library again after a listing failed, and tells the UI.
+ *
+ * The wait doubles with each failure in a row, up to WORKER_LIBRARY_RETRY_MAX, and isn't
+ * reset by reconnecting, so a listing that breaks the connection every time isn't
+ * restarted over and over. A change to the database is still listed at once.
+ *
+ * @param db_update The database update time the listing was of.
+ */
+static void mpdworker_library_failed(struct mpdworker *worker, uint64_t db_update)
+{
+    worker->library_backoff =
+        worker->library_backoff ? worker->library_backoff * 2 : WORKER_BACKOFF_MIN;
+    if (worker->library_backoff > WORKER_LIBRARY_RETRY_MAX)
+        worker->library_backoff = WORKER_LIBRARY_RETRY_MAX;
+
+    worker->library_retry = true;
+    worker->library_failed_update = db_update;
+    worker->library_retry_at = playback_clock_now() + worker->library_backoff;
+
+    /* Whatever part of the listing was already streamed is dropped by the UI. */
+    struct worker_reply reply = {.type = REPLY_LIBRARY, .library_failed = true};
+    mpdworker_publish(worker, &reply);
+}
+
+/**
+ * @brief Gets how long the worker may sit idle before retrying a failed listing.
+ *
+ * @return The wait in ms, or -1 if no listing is waiting to be retried.
+ */
+static int mpdworker_library_retry_delay(struct mpdworker *worker)
+{
+    if (!worker->library_retry)
+        return -1;
+
+    uint64_t now = playback_clock_now();
+    return (worker->library_retry_at > now) ? (int)(worker->library_retry_at - now) : 0;
+}
+
+/**
+ * @brief Lists the whole library, streaming it to the UI and saving it as a new index.
+ *
+ * Every song is listed in a single pass and sent to the UI in chunks as the listing
+ * arrives, so the library can be browsed before it's finished. Very large libraries may
+ * need a larger max_output_buffer_size in the server's configuration.
+ *
+ * @return true on success, or false on error.
+ */
+static bool mpdworker_build_library(struct mpdworker *worker)
+{
+    struct mpd_connection *connection = worker->connection;
+    uint64_t db_update = worker->server_db_update;
+
+    /* A failed build is retried when the database changes, or after a growing wait. */
+    worker->library_stale = false;
+
+    /* Take the update time first, so an update during the listing makes the index stale. */
+    struct mpd_stats *stats = mpd_run_stats(connection);
+    if (!stats) {
+        mpdworker_library_failed(worker, db_update);
+        return false;
+    }
+    db_update = mpd_stats_get_db_update_time(stats);
+    worker->server_db_update = db_update;
+    mpd_stats_free(stats);
+
+    if (!mpd_send_list_all_meta(connection, NULL)) {
+        mpdworker_library_failed(worker, db_update);
+        return false;
+    }
+
+    struct library_chunk *songs = library_chunk_new();
+    struct library_chunk *chunk = library_chunk_new();
+    struct mpd_entity *entity;
+    bool first = true;
+
+    while ((entity = mpd_recv_entity(connection)) != NULL) {
+        if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG) {
+            const struct mpd_song *song = mpd_entity_get_song(entity);
+
+            library_chunk_add_song(songs, song);
+            library_chunk_add_song(chunk, song);
+        }
+        mpd_entity_free(entity);
+
+        if (chunk->count >= LIBRARY_CHUNK_SIZE) {
+            mpdworker_publish_chunk(worker, chunk, first);
+            chunk = library_chunk_new();
+            first = false;
+        }
+    }
+
+    if (!mpd_response_finish(connection)) {
+        library_chunk_free(chunk);
+        library_chunk_free(songs);
+        mpdworker_library_failed(worker, db_update);
+        return false;
+    }
+    mpdworker_publish_chunk(worker, chunk, first);
+
+    worker->library_db_update = db_update;
+    worker->library_retry = false;
+    worker->library_backoff = 0;
+
+    struct worker_reply reply = {.type = REPLY_LIBRARY};
+    mpdworker_publish(worker, &reply);
+
+    if (worker->library_path && !library_index_write(songs, worker->library_path, db_update)) {
+        struct worker_reply error = {.type = REPLY_ERROR};
+
+        error.message = strdup("Unable to save the library index");
+        mpdworker_publish(worker, &error);
+    }
+
+    library_chunk_free(songs);
+    return true;
+}
+
+/**
+ * @brief Adds songs to the queue by URI, in a single command list.
+ */
+static bool mpdworker_add_uris(struct mpdworker *worker, struct stringlist *uris)
+{
+    struct mpd_connection *connection = worker->connection;
+
+    if (!mpd_command_list_begin(connection, false))
+        return false;
+    for (struct stringlist_item *item = uris->head; item; item = item->next)
+        mpd_send_add(connection, item->str);
+    mpd_command_list_end(connection);
+
+    return mpd_response_finish(connection);
+}
+
+/**
+ * @brief Runs a single request from the UI on the server.
+ *
+ * @return true on success, or false on error.
+ */
+static bool mpdworker_run_request(struct mpdworker *worker, struct worker_request *request)
+{
+    struct mpd_connection *connection = worker->connection;
+    int *args = request->args;
+    char **strings = request->strings;
+
+    switch (request->type) {
+        case REQUEST_PLAY_POS:
+            return mpd_run_play_pos(connection, args[0]);
+        case REQUEST_TOGGLE_PAUSE:
+            return mpd_run_toggle_pause(connection);
+        case REQUEST_STOP:
+            return mpd_run_stop(connection);
+        case REQUEST_SEEK_CURRENT:
+            return mpd_run_seek_current(connection, args[0] / 1000.0f, false);
+        case REQUEST_PREV_SONG:
+            return mpd_run_previous(connection);
+        case REQUEST_NEXT_SONG:
+            return mpd_run_next(connection);
+        case REQUEST_REPEAT:
+            return mpd_run_repeat(connection, args[0]);
+        case REQUEST_RANDOM:
+            return mpd_run_random(connection, args[0]);
+        case REQUEST_SINGLE:
+            return mpd_run_single(connection, args[0]);
+        case REQUEST_CONSUME:
+            return mpd_run_consume(connection, args[0]);
+        case REQUEST_CROSSFADE:
+            return mpd_run_crossfade(connection, args[0]);
+        case REQUEST_SET_VOLUME:
+            return mpd_run_set_volume(connection, args[0]);
+        case REQUEST_DELETE:
+            return mpd_run_delete_range(connection, args[0], args[1]);
+        case REQUEST_CLEAR:
+            return mpd_run_clear(connection);
+        case REQUEST_UPDATE_DB:
+            return mpd_run_update(connection, NULL) > 0;
+        case REQUEST_LIST_ARTISTS:
+            return mpdworker_list_tags(worker, LIST_ARTISTS, MPD_TAG_ARTIST, NULL);
+        case REQUEST_LIST_ALBUMS:
+            return mpdworker_list_tags(worker, LIST_ALBUMS, MPD_TAG_ALBUM, strings[0]);
+        case REQUEST_LIST_SONGS:
+            return mpdworker_list_songs(worker, strings[0], strings[1]);
+        case REQUEST_ADD_ARTIST:
+        case REQUEST_ADD_ALBUM:
+        case REQUEST_ADD_SONG:
+            return mpdworker_add_songs(worker, strings);
+        case REQUEST_ADD_URIS:
+            return mpdworker_add_uris(worker, request->uris);
+        case REQUEST_RESYNC_QUEUE:
+            worker->queue_valid = false;
+            return mpdworker_refresh(worker, false);
+        default:
+            return true;
+    }
+}
+
+/**
+ * @brief Empties the pipe the UI uses to wake the worker.
+ */
+static void mpdworker_drain_wake(struct mpdworker *worker)
+{
+    char buffer[64];
+
+    while (read(worker->wake_fds[0], buffer, sizeof(buffer)) > 0)
+        ;
+}
+
+/**
+ * @brief Runs every request the UI has sent since the last call.
+ *
+ * @return true if the connection is still usable, false otherwise.
+ */
+static bool mpdworker_handle_requests(struct mpdworker *worker)
+{
+    struct worker_request request;
+    bool usable = true;
+
+    mpdworker_drain_wake(worker);
+
+    while (usable && ringbuffer_pop(worker->requests, &request)) {
+        if (!mpdworker_run_request(worker, &request))
+            usable = mpdworker_report_error(worker);
+        worker_request_clear(&request);
+    }
+
+    return usable;
+}
+
+/**
+ * @brief Serves the UI over an open connection until it breaks or the worker is stopped.
+ *
+ * The connection sits in idle mode until either the server reports a change or the UI
+ * sends a request. Elapsed time isn't reported through idle, but it doesn't need to be:
+ * the UI counts it forward from the last status on its own.
+ */
+static void mpdworker_serve(struct mpdworker *worker)
+{
+    bool usable = mpdworker_refresh(worker, false) || mpdworker_report_error(worker);
+
+    while (usable && !atomic_load(&worker->quit)) {
+        if (mpdworker_library_retry_delay(worker) == 0)
+            worker->library_stale = true;
+
+        /* Requests go first, since the listing can take a while on a big library. */
+        if (worker->library_stale) {
+            usable = mpdworker_handle_requests(worker);
+            if (usable && !mpdworker_build_library(worker))
+                usable = mpdworker_report_error(worker);
+            continue;
+        }
+
+        mpdworker_idle_enter(worker);
+
+        struct pollfd fds[2] = {
+            {.fd = mpd_connection_get_fd(worker->connection), .events = POLLIN},
+            {.fd = worker->wake_fds[0], .events = POLLIN},
+        };
+        int ready = poll(fds, 2, mpdworker_library_retry_delay(worker));
+
+        if (ready < 0 && errno == EINTR)
+            continue;
+
+        enum mpd_idle events = mpdworker_idle_leave(worker, fds[0].revents != 0);
+        if (mpd_connection_get_error(worker->connection) != MPD_ERROR_SUCCESS) {
+            usable = mpdworker_report_error(worker);
+            continue;
+        }
+
+        if (fds[1].revents)
+            usable = mpdworker_handle_requests(worker);
+
+        if (events & MPD_IDLE_DATABASE)
+            worker->stats_stale = true;
+        if (usable && events && !mpdworker_refresh(worker, events & MPD_IDLE_DATABASE))
+            usable = mpdworker_report_error(worker);
+    }
+
+    if (worker->idle && usable)
+        mpdworker_idle_leave(worker, false);
+}
+
+/**
+ * @brief Has the kernel probe a quiet TCP connection, so a server that went away without
+ * closing it is noticed.
+ *
+ * Fails harmlessly on UNIX sockets, which can't go quietly dead.
+ */
+static void mpdworker_enable_keepalive(int fd)
+{
+    int on = 1;
+    int idle = WORKER_KEEPALIVE_IDLE;
+    int interval = WORKER_KEEPALIVE_INTERVAL;
+    int count = WORKER_KEEPALIVE_COUNT;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) != 0)
+        return;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+}
+
+/**
+ * @brief Opens a connection to the server.
+ *
+ * Everything learned from the server is fetched again over a new connection, except the
+ * queue, which is only synced from the last version the UI has.
+ *
+ * @return true on success, or false if the connection couldn't be made.
+ */
+static bool mpdworker_connect(struct mpdworker *worker)
+{
+    struct mpd_connection *connection =
+        mpd_connection_new(worker->host, worker->port, worker->timeout);
+
+    if (!connection) {
+        mpdworker_set_error(worker, "Out of memory");
+        return false;
+    }
+    if (mpd_connection_get_error(connection) != MPD_ERROR_SUCCESS) {
+        mpdworker_set_error(worker, mpd_connection_get_error_message(connection));
+        mpd_connection_free(connection);
+        return false;
+    }
+
+    mpdworker_enable_keepalive(mpd_connection_get_fd(connection));
+
+    worker->connection = connection;
+    worker->idle = false;
+    worker->stats_stale = true;
+    worker->backoff = 0;
+
+    return true;
+}
+
+/**
+ * @brief Closes the connection to the server.
+ */
+static void mpdworker_disconnect(struct mpdworker *worker)
+{
+    mpd_connection_free(worker->connection);
+    worker->connection = NULL;
+    worker->idle = false;
+    worker->state = MPD_STATE_UNKNOWN;
+}
+
+/**
+ * @brief Works out how long to wait before the next connection attempt.
+ *
+ * The limit doubles with each failed attempt, up to WORKER_BACKOFF_MAX. Half of the wait
+ * is random, so clients that lost the same server don't all come back at once.
+ *
+ * @return The wait in milliseconds.
+ */
+static int mpdworker_next_backoff(struct mpdworker *worker)
+{
+    worker->backoff = worker->backoff ? worker->backoff * 2 : WORKER_BACKOFF_MIN;
+    if (worker->backoff > WORKER_BACKOFF_MAX)
+        worker->backoff = WORKER_BACKOFF_MAX;
+
+    return worker->backoff / 2 + rand_r(&worker->seed) % (worker->backoff / 2 + 1);
+}
+
+/**
+ * @brief Tells the UI the connection's new state.
+ *
+ * @param delay How long until the next attempt, in ms, if disconnected.
+ */
+static void mpdworker_publish_connection(struct mpdworker *worker,
+                                         enum mpdwrapper_connection connection, int delay)
+{
+    struct worker_reply reply = {.type = REPLY_CONNECTION, .connection = connection};
+
+    reply.retry_at = playback_clock_now() + delay;
+    if (connection != CONNECTION_CONNECTED && worker->error)
+        reply.message = strdup(worker->error);
+
+    mpdworker_publish(worker, &reply);
+}
+
+/**
+ * @brief Waits out the delay before the next connection attempt.
+ *
+ * Requests sent in the meantime can't be run, so they're dropped and the UI is told so.
+ */
+static void mpdworker_wait(struct mpdworker *worker, int delay)
+{
+    uint64_t deadline = playback_clock_now() + delay;
+    uint64_t now;
+    struct worker_request request;
+
+    while (!atomic_load(&worker->quit) && (now = playback_clock_now()) < deadline) {
+        struct pollfd fd = {.fd = worker->wake_fds[0], .events = POLLIN};
+        bool dropped = false;
+
+        if (poll(&fd, 1, deadline - now) <= 0)
+            continue;
+
+        mpdworker_drain_wake(worker);
+        while (ringbuffer_pop(worker->requests, &request)) {
+            worker_request_clear(&request);
+            dropped = true;
+        }
+
+        if (dropped) {
+            struct worker_reply reply = {.type = REPLY_ERROR};
+            reply.message = strdup("Not connected to MPD");
+            mpdworker_publish(worker, &reply);
+        }
+    }
+}
+
+/**
+ * @brief The worker thread's main loop.
+ *
+ * Connects to the server and serves the UI until the connection breaks, then connects
+ * again, for as long as the worker runs.
+ */
+static void *mpdworker_run(void *data)
+{
+    struct mpdworker *worker = data;
+
+    while (!atomic_load(&worker->quit)) {
+        if (!mpdworker_connect(worker)) {
+            int delay = mpdworker_next_backoff(worker);
+
+            mpdworker_publish_connection(worker, CONNECTION_DISCONNECTED, delay);
+            mpdworker_wait(worker, delay);
+            continue;
+        }
+
+        mpdworker_publish_connection(worker, CONNECTION_CONNECTED, 0);
+        mpdworker_serve(worker);
+        mpdworker_disconnect(worker);
+
+        if (!atomic_load(&worker->quit))
+            mpdworker_publish_connection(worker, CONNECTION_CONNECTING, 0);
+    }
+
+    return NULL;
+}
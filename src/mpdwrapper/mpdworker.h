@@ -0,0 +1,212 @@
+/*******************************************************************************
+ * mpdworker.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file mpdworker.h
+ * @brief The background thread that owns the MPD connection.
+ *
+ * All communication with the MPD server happens on the worker thread, so a slow server
+ * never blocks input or drawing. The UI thread sends requests to the worker through one
+ * [ring buffer](@ref ringbuffer.h), and the worker sends replies and state snapshots back
+ * through another. Anything referenced by a request or reply belongs to whichever thread
+ * currently holds the message.
+ *
+ * The worker also makes the connection, and makes it again whenever it's lost. Attempts
+ * are spaced out with a randomized, doubling delay, and the UI is told the state of the
+ * connection as it changes. Once reconnected, the UI's copy of the queue is brought up to
+ * date with the usual changes-only sync, unless the server was restarted in the meantime.
+ */
+
+#ifndef MPDWORKER_H
+#define MPDWORKER_H
+
+#include <mpd/client.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "pantomime/arena.h"
+#include "pantomime/mpdwrapper.h"
+#include "pantomime/ringbuffer.h"
+#include "pantomime/stringlist.h"
+
+#define WORKER_QUEUE_SIZE 256 /* Maximum number of messages waiting in each direction. */
+
+#define WORKER_BACKOFF_MIN 500   /* The longest wait in ms before the first reconnection attempt. */
+#define WORKER_BACKOFF_MAX 30000 /* The longest wait in ms between reconnection attempts. */
+#define WORKER_LIBRARY_RETRY_MAX 600000 /* The longest wait in ms to retry a failed listing. */
+
+#define WORKER_KEEPALIVE_IDLE 30     /* Seconds of silence before a TCP connection is probed. */
+#define WORKER_KEEPALIVE_INTERVAL 10 /* Seconds between unanswered probes. */
+#define WORKER_KEEPALIVE_COUNT 3     /* Unanswered probes before the connection is dropped. */
+
+enum worker_request_type {
+    REQUEST_PLAY_POS,
+    REQUEST_TOGGLE_PAUSE,
+    REQUEST_STOP,
+    REQUEST_SEEK_CURRENT,
+    REQUEST_PREV_SONG,
+    REQUEST_NEXT_SONG,
+    REQUEST_REPEAT,
+    REQUEST_RANDOM,
+    REQUEST_SINGLE,
+    REQUEST_CONSUME,
+    REQUEST_CROSSFADE,
+    REQUEST_SET_VOLUME,
+    REQUEST_DELETE,
+    REQUEST_CLEAR,
+    REQUEST_UPDATE_DB,
+    REQUEST_LIST_ARTISTS,
+    REQUEST_LIST_ALBUMS,
+    REQUEST_LIST_SONGS,
+    REQUEST_ADD_ARTIST,
+    REQUEST_ADD_ALBUM,
+    REQUEST_ADD_SONG,
+    REQUEST_ADD_URIS,
+    REQUEST_RESYNC_QUEUE
+};
+
+/**
+ * @brief A command sent from the UI thread to the worker.
+ */
+struct worker_request {
+    enum worker_request_type type;
+    int args[2];      /**< Numeric arguments, such as a queue position or a volume. */
+    char *strings[3]; /**< Artist, album, and song title arguments. Freed by the worker. */
+    struct stringlist *uris; /**< REQUEST_ADD_URIS: the songs to add. Freed by the worker. */
+};
+
+enum worker_reply_type {
+    REPLY_STATUS,
+    REPLY_QUEUE,
+    REPLY_LIST,
+    REPLY_LIBRARY_CHUNK,
+    REPLY_LIBRARY,
+    REPLY_CONNECTION,
+    REPLY_ERROR
+};
+
+/**
+ * @brief The changes needed to bring the UI's copy of the queue up to date.
+ *
+ * A full patch carries every song in the queue. Otherwise, the patch lists the positions
+ * that changed along with the songs the worker knows the UI hasn't seen yet. Songs that
+ * moved are taken from their old index in the UI's copy of the queue.
+ */
+struct queue_patch {
+    unsigned version; /**< The queue version after applying the patch. */
+    int base_length;  /**< The length of the queue the delta applies to. */
+    int length;       /**< The length of the queue after applying the patch. */
+    bool full;        /**< Whether songs holds the whole queue rather than a delta. */
+
+    struct queue_change *changes; /**< The changed positions. Unused for full patches. */
+    int change_count;             /**< The number of changed positions. */
+
+    /** For a delta, the song for each change, or NULL if the song is already in the queue.
+     * For a full patch, every song in order. */
+    struct queue_song **songs;
+    struct arena arena; /**< Holds the songs and their strings. */
+};
+
+/**
+ * @brief A message sent from the worker to the UI thread.
+ */
+struct worker_reply {
+    enum worker_reply_type type;
+
+    struct mpd_status *status;     /**< REPLY_STATUS: the new player status. */
+    struct mpd_song *current_song; /**< REPLY_STATUS: the current song, or NULL if there is none. */
+    struct mpd_stats *stats;       /**< REPLY_STATUS: new database statistics, or NULL. */
+    bool db_changed;               /**< REPLY_STATUS: whether MPD reported a database change. */
+    uint64_t fetched_at; /**< REPLY_STATUS: when the status was received, on the playback clock. */
+
+    struct queue_patch *patch; /**< REPLY_QUEUE: changes to apply to the queue. */
+
+    enum mpdwrapper_list list_type; /**< REPLY_LIST: which kind of list this is. */
+    unsigned *names;                /**< REPLY_LIST: the interned artist or album names. */
+    char **titles;                  /**< REPLY_LIST: the song titles, which aren't interned. */
+    int name_count;                 /**< REPLY_LIST: the number of names or titles. */
+
+    struct library_chunk *chunk; /**< REPLY_LIBRARY_CHUNK: the next songs in the library. */
+    bool first_chunk;            /**< REPLY_LIBRARY_CHUNK: whether a new listing is starting. */
+    bool library_failed;         /**< REPLY_LIBRARY: whether the listing failed partway. */
+
+    enum mpdwrapper_connection connection; /**< REPLY_CONNECTION: the new connection state. */
+    uint64_t retry_at; /**< REPLY_CONNECTION: when the next attempt is made, if disconnected. */
+
+    char *message; /**< REPLY_ERROR and REPLY_CONNECTION: a description of the error. */
+};
+
+/**
+ * @brief The worker thread and the state it keeps about the server.
+ *
+ * Everything below the ring buffers is only touched by the worker thread.
+ */
+struct mpdworker {
+    pthread_t thread;
+    struct ringbuffer *requests; /**< Requests from the UI thread. */
+    struct ringbuffer *replies;  /**< Replies to the UI thread. */
+    int wake_fds[2];             /**< A pipe the UI writes to when it sends a request. */
+    int reply_fds[2];            /**< A pipe the worker writes to when it sends a reply. */
+    atomic_bool quit;            /**< Set by the UI thread to stop the worker. */
+
+    char *host;    /**< The address or socket path of the server. */
+    int port;      /**< The server's TCP port. */
+    int timeout;   /**< The connection timeout in milliseconds. */
+    char *error;   /**< Why the connection was lost or couldn't be made, or NULL. */
+    int backoff;   /**< The current limit on the wait before reconnecting, in ms. */
+    unsigned seed; /**< Random state for spreading out reconnection attempts. */
+
+    struct mpd_connection *connection; /**< The MPD server connection, or NULL if there is none. */
+    bool idle;                         /**< Whether the connection is in idle mode. */
+    enum mpd_state state;              /**< The last known player state. */
+    bool stats_stale;                  /**< Whether the database statistics need fetching. */
+    time_t last_refresh;               /**< When the status was last fetched. */
+    time_t server_start;               /**< When the server was started, from its uptime. */
+
+    bool queue_valid;       /**< Whether queue_ids matches what the UI has. */
+    unsigned queue_version; /**< The queue version the UI has. */
+    unsigned *queue_ids;    /**< The ID of each song in the UI's copy of the queue, by position. */
+    int queue_length;       /**< The number of songs in the UI's copy of the queue. */
+
+    char *library_path;         /**< Where to save the library index, or NULL to not keep one. */
+    uint64_t library_db_update; /**< The database update time the saved index was built from. */
+    bool library_stale;         /**< Whether the saved index needs rebuilding. */
+
+    uint64_t server_db_update;      /**< The server's database update time, as last fetched. */
+    bool library_retry;             /**< Whether the last listing failed and waits to retry. */
+    uint64_t library_failed_update; /**< The database update time the failed listing was of. */
+    int library_backoff;            /**< The current wait before retrying a listing, in ms. */
+    uint64_t library_retry_at;      /**< When to retry a failed listing, on the playback clock. */
+};
+
+struct mpdworker *mpdworker_new(const char *host, int port, int timeout, const char *library_path);
+void mpdworker_free(struct mpdworker *worker);
+
+bool mpdworker_send(struct mpdworker *worker, struct worker_request *request);
+bool mpdworker_receive(struct mpdworker *worker, struct worker_reply *reply);
+int mpdworker_get_fd(struct mpdworker *worker);
+void mpdworker_acknowledge(struct mpdworker *worker);
+
+void worker_request_clear(struct worker_request *request);
+void worker_reply_clear(struct worker_reply *reply);
+void queue_patch_free(struct queue_patch *patch);
+
+#endif /* MPDWORKER_H */
@@ -29,6 +29,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "library.h"
+#include "mpdworker.h"
+#include "pantomime/intern.h"
 #include "pantomime/mpdwrapper.h"
 
 /**
@@ -37,7 +40,7 @@
  * @param host The MPD server host to connect to. Defaults to "localhost".
  * @param port The port MPD is running on. Defaults to 6600.
  * @param timeout The MPD timeout. Defaults to 30000ms.
- * @return Pointer to an mpdwrapper struct.
+ * @return Pointer to an mpdwrapper struct, or NULL if the worker thread couldn't be started.
  */
 struct mpdwrapper *mpdwrapper_new(const char *host, int port, int timeout)
 {
@@ -45,37 +48,59 @@ struct mpdwrapper *mpdwrapper_new(const char *host, int port, int timeout)
     if (!mpd)
         return NULL;
 
-    mpdwrapper_initialize(mpd, host, port, timeout);
+    if (!mpdwrapper_initialize(mpd, host, port, timeout)) {
+        mpdwrapper_free(mpd);
+        return NULL;
+    }
 
     return mpd;
 }
 
 /**
- * @brief Initializes the mpdwrapper struct and attempts to create a connection to the provided
- * host.
+ * @brief Initializes the mpdwrapper struct and starts connecting to the provided host.
+ *
+ * The connection is made by a worker thread, which makes it again whenever it's lost.
+ * The state of the connection and the server's initial state arrive through
+ * mpdwrapper_refresh() like any other update.
  *
  * @param mpd An empty mpd struct to initialize. Assumes memory has already been allocated.
  * @param host The IP address or UNIX socket to connect to.
  * @param port The TCP port to connect to if using an IP address.
  * @param timeout The timeout in milliseconds.
+ * @return false if the worker thread couldn't be started.
  */
-void mpdwrapper_initialize(struct mpdwrapper *mpd, const char *host, int port, int timeout)
+bool mpdwrapper_initialize(struct mpdwrapper *mpd, const char *host, int port, int timeout)
 {
-    mpd->connection = mpd_connection_new(host, port, timeout);
-
-    /* Unable to connect to MPD */
-    if (mpd_connection_get_error(mpd->connection) != MPD_ERROR_SUCCESS) {
-        fprintf(stderr, "MPD error: %s\n", mpd_connection_get_error_message(mpd->connection));
-        exit(1);
-    }
-
-    mpd->status = mpd_run_status(mpd->connection);
-    mpd->current_song = mpd_run_current_song(mpd->connection);
+    mpd->handlers = NULL;
+    mpd->handler_data = NULL;
+    mpd->status = NULL;
+    mpd->current_song = NULL;
+    mpd->stats = NULL;
     mpd->queue = songlist_new();
-    mpd->state = mpd_status_get_state(mpd->status);
-    mpd->last_error = mpd_connection_get_error(mpd->connection);
-
-    mpdwrapper_fetch_queue(mpd);
+    mpd->state = MPD_STATE_UNKNOWN;
+    playback_clock_initialize(&mpd->clock);
+    coalescer_initialize(&mpd->volume);
+    coalescer_initialize(&mpd->seek);
+    mpd->connection = CONNECTION_CONNECTING;
+    mpd->connection_error = NULL;
+    mpd->reconnect_at = 0;
+    mpd->queue_version = 0;
+    mpd->queue_changes = 0;
+    mpd->db_version = 0;
+
+    /* The index is trusted until the server's stats say the database has changed. */
+    struct library_index *index;
+
+    mpd->library_path = library_index_default_path(host, port);
+    mpd->library = NULL;
+    mpd->library_pending = false;
+    mpd->library_announced_at = 0;
+    if ((index = library_index_open(mpd->library_path)) != NULL)
+        mpd->library = library_new_from_index(index);
+
+    mpd->worker = mpdworker_new(host, port, timeout, mpd->library_path);
+
+    return mpd->worker != NULL;
 }
 
 /**
@@ -83,27 +108,84 @@ void mpdwrapper_initialize(struct mpdwrapper *mpd, const char *host, int port, i
  */
 void mpdwrapper_free(struct mpdwrapper *mpd)
 {
+    if (mpd->worker)
+        mpdworker_free(mpd->worker);
     if (mpd->current_song)
         mpd_song_free(mpd->current_song);
     if (mpd->status)
         mpd_status_free(mpd->status);
-    if (mpd->connection)
-        mpd_connection_free(mpd->connection);
+    if (mpd->stats)
+        mpd_stats_free(mpd->stats);
     if (mpd->queue)
         songlist_free(mpd->queue);
+    if (mpd->library)
+        library_free(mpd->library);
 
+    free(mpd->library_path);
+    free(mpd->connection_error);
     free(mpd);
 }
 
+/**
+ * @brief Sets the callbacks that receive lists and errors from the server.
+ *
+ * @param handlers The callbacks. Must outlive the mpdwrapper.
+ * @param data Passed as the first argument to each callback.
+ */
+void mpdwrapper_set_handlers(struct mpdwrapper *mpd, const struct mpdwrapper_handlers *handlers,
+                             void *data)
+{
+    mpd->handlers = handlers;
+    mpd->handler_data = data;
+}
+
+/**
+ * @brief Reports an error through the error handler, if there is one.
+ */
+static void mpdwrapper_report_error(struct mpdwrapper *mpd, char *message)
+{
+    if (mpd->handlers && mpd->handlers->on_error)
+        mpd->handlers->on_error(mpd->handler_data, message);
+}
+
+/**
+ * @brief Queues a request for the worker thread.
+ *
+ * If the request can't be queued, its strings are freed and an error is reported.
+ *
+ * @return true if the request was queued, or false on error.
+ */
+static bool mpdwrapper_send(struct mpdwrapper *mpd, struct worker_request request)
+{
+    if (mpdworker_send(mpd->worker, &request))
+        return true;
+
+    worker_request_clear(&request);
+    mpdwrapper_report_error(mpd, "Too many pending requests");
+    return false;
+}
+
 /**
  * @brief Removes a song from the play queue. Does not update the queue version.
  *
  * @param mpd The mpd connection
  * @param pos The position of the song in the queue
  */
-void mpdwrapper_delete_from_queue(struct mpdwrapper *mpd, unsigned pos)
+bool mpdwrapper_delete_from_queue(struct mpdwrapper *mpd, unsigned pos)
 {
-    mpd_run_delete(mpd->connection, pos);
+    return mpdwrapper_delete_range(mpd, pos, pos + 1);
+}
+
+/**
+ * @brief Removes a run of songs from the play queue with a single command.
+ *
+ * @param start The position of the first song to remove.
+ * @param end The position after the last song to remove.
+ */
+bool mpdwrapper_delete_range(struct mpdwrapper *mpd, unsigned start, unsigned end)
+{
+    return mpdwrapper_send(mpd,
+                           (struct worker_request){.type = REQUEST_DELETE, .args = {start, end}});
 }
 
 /**
@@ -111,48 +193,314 @@ void mpdwrapper_delete_from_queue(struct mpdwrapper *mpd, unsigned pos)
  *
  * @param mpd The mpd connection.
  */
-void mpdwrapper_clear_queue(struct mpdwrapper *mpd)
+bool mpdwrapper_clear_queue(struct mpdwrapper *mpd)
 {
-    mpd_run_clear(mpd->connection);
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_CLEAR});
 }
 
 /**
- * @brief Fetches the current state from the MPD server.
+ * @brief Replaces the cached status with one sent by the worker.
  */
-void mpdwrapper_refresh(struct mpdwrapper *mpd)
+static void mpdwrapper_apply_status(struct mpdwrapper *mpd, struct worker_reply *reply)
 {
+    /* A seek that hasn't gone out yet was meant for the song that was playing. */
+    if (!reply->current_song || !mpd->current_song ||
+        mpd_song_get_id(reply->current_song) != mpd_song_get_id(mpd->current_song))
+        coalescer_initialize(&mpd->seek);
+
+    if (mpd->status)
+        mpd_status_free(mpd->status);
+    if (mpd->current_song)
+        mpd_song_free(mpd->current_song);
+
+    mpd->status = reply->status;
+    mpd->current_song = reply->current_song;
     mpd->state = mpd_status_get_state(mpd->status);
-    mpd->last_error = mpd_connection_get_error(mpd->connection);
 
-    mpd_status_free(mpd->status);
-    mpd->status = mpd_run_status(mpd->connection);
+    /* Until the server reports a seek that's been asked for, the clock keeps counting from
+     * where it was sent to, so the song doesn't jump back and forth. */
+    coalescer_confirm(&mpd->volume, reply->fetched_at);
+    coalescer_confirm(&mpd->seek, reply->fetched_at);
+    if (mpd->seek.target < 0)
+        playback_clock_set(&mpd->clock, mpd_status_get_elapsed_ms(mpd->status),
+                           reply->fetched_at, mpd->state == MPD_STATE_PLAY);
+    else
+        playback_clock_set(&mpd->clock, playback_clock_get_elapsed_ms(&mpd->clock),
+                           playback_clock_now(), mpd->state == MPD_STATE_PLAY);
+    reply->status = NULL;
+    reply->current_song = NULL;
+
+    if (reply->stats) {
+        if (mpd->stats)
+            mpd_stats_free(mpd->stats);
+        mpd->stats = reply->stats;
+        reply->stats = NULL;
+
+        /* A stale index is dropped; the worker streams a new library in its place. */
+        struct library *library = mpd->library;
+        unsigned long db_update = mpd_stats_get_db_update_time(mpd->stats);
+
+        if (library && library->index && db_update != library_index_get_db_update(library->index)) {
+            library_free(library);
+            mpd->library = NULL;
+        }
+    }
+    if (reply->db_changed)
+        mpd->db_version++;
+}
 
-    if (!mpd->status)
-        fprintf(stderr, "%s\n", mpd_connection_get_error_message(mpd->connection));
+/**
+ * @brief Hands a list from the worker to the list handler.
+ *
+ * Artist and album names arrive as interned IDs and are passed on as their strings.
+ * Song titles arrive as copies, which the reply frees once the handler returns.
+ */
+static void mpdwrapper_deliver_list(struct mpdwrapper *mpd, const struct worker_reply *reply)
+{
+    if (!mpd->handlers || !mpd->handlers->on_list)
+        return;
 
-    if (mpd->current_song)
-        mpd_song_free(mpd->current_song);
-    mpd->current_song = mpd_run_current_song(mpd->connection);
+    if (reply->titles) {
+        mpd->handlers->on_list(mpd->handler_data, reply->list_type,
+                               (const char *const *)reply->titles, reply->name_count);
+        return;
+    }
+
+    const char **names = malloc((reply->name_count + 1) * sizeof(*names));
+    if (!names)
+        return;
+
+    for (int i = 0; i < reply->name_count; ++i)
+        names[i] = intern_string(reply->names[i]);
 
-    int queue_version = mpd_status_get_queue_version(mpd->status);
-    if (mpd->queue_version != queue_version) {
-        mpdwrapper_fetch_queue(mpd);
-        mpd->queue_version = queue_version;
-        mpd->queue_changed = true;
+    mpd->handlers->on_list(mpd->handler_data, reply->list_type, names, reply->name_count);
+    free(names);
+}
+
+/**
+ * @brief Applies a queue patch from the worker to the cached queue.
+ *
+ * Songs that only moved are kept; only new songs are added. The queue takes over the
+ * arena holding the patch's songs, and songs that left the queue are reclaimed when it's
+ * next compacted.
+ *
+ * @return true on success, or false if the patch doesn't apply to the cached queue or
+ * memory ran out. The cached queue is left as it was on failure.
+ */
+static bool mpdwrapper_apply_queue_patch(struct mpdwrapper *mpd, struct queue_patch *patch)
+{
+    if (patch->full) {
+        songlist_clear(mpd->queue);
+        bool replaced = songlist_replace(mpd->queue, patch->songs, patch->length);
+        songlist_adopt(mpd->queue, &patch->arena);
+        patch->songs = NULL;
+        mpd->queue_version = patch->version;
+        return replaced;
     }
-    else
-        mpd->queue_changed = false;
+
+    int old_length = songlist_get_size(mpd->queue);
+    if (old_length != patch->base_length)
+        return false;
+
+    struct queue_song **old_songs = mpd->queue->songs;
+    struct queue_song **songs = malloc((patch->length + 1) * sizeof(*songs));
+    int *sources = malloc((patch->length + 1) * sizeof(*sources));
+    bool *used = calloc(old_length + 1, sizeof(*used));
+    if (!songs || !sources || !used) {
+        free(songs);
+        free(sources);
+        free(used);
+        return false;
+    }
+
+    /* The worker has already checked that every position gets exactly one song. */
+    for (int i = 0; i < patch->length; ++i) {
+        sources[i] = (i < old_length) ? i : -1;
+        songs[i] = (i < old_length) ? old_songs[i] : NULL;
+    }
+    for (int i = 0; i < patch->change_count; ++i) {
+        struct queue_change *change = &patch->changes[i];
+
+        sources[change->pos] = change->index;
+        if (change->index >= 0)
+            songs[change->pos] = old_songs[change->index];
+        else {
+            songs[change->pos] = patch->songs[i];
+            songlist_touch(mpd->queue, change->id);
+        }
+    }
+
+    for (int i = 0; i < patch->length; ++i) {
+        if (sources[i] >= 0)
+            used[sources[i]] = true;
+    }
+    for (int i = 0; i < old_length; ++i) {
+        if (!used[i])
+            songlist_forget(mpd->queue, old_songs[i]);
+    }
+
+    bool replaced = songlist_replace(mpd->queue, songs, patch->length);
+    songlist_adopt(mpd->queue, &patch->arena);
+    songlist_compact(mpd->queue);
+    mpd->queue_version = patch->version;
+
+    free(sources);
+    free(used);
+
+    return replaced;
 }
 
 /**
- * @brief Performs an update of the MPD music database.
+ * @brief Bumps the database version for artists streamed in since it was last bumped.
+ *
+ * @param force Whether to announce them now, rather than at most once per
+ *              LIBRARY_REFRESH_INTERVAL.
  */
-int mpdwrapper_update_db(struct mpdwrapper *mpd)
+static void mpdwrapper_announce_library(struct mpdwrapper *mpd, bool force)
 {
-    int rc = mpd_run_update(mpd->connection, NULL);
-    mpd->last_error = mpd_connection_get_error(mpd->connection);
+    uint64_t now = playback_clock_now();
+
+    if (!mpd->library_pending ||
+        (!force && now - mpd->library_announced_at < LIBRARY_REFRESH_INTERVAL))
+        return;
 
-    return rc;
+    mpd->db_version++;
+    mpd->library_pending = false;
+    mpd->library_announced_at = now;
+}
+
+/**
+ * @brief Adds a chunk of songs streamed by the worker to the library tree.
+ *
+ * The first chunk of a listing replaces whatever library was loaded before.
+ * New artists are announced through the database version, so the library
+ * screen fills in while the listing is still arriving. Each announcement
+ * has the screen list every artist again, so they're spaced out rather
+ * than made for every chunk.
+ */
+static void mpdwrapper_apply_library_chunk(struct mpdwrapper *mpd, struct library_chunk *chunk,
+                                           bool first)
+{
+    if (first || !mpd->library) {
+        if (mpd->library)
+            library_free(mpd->library);
+        mpd->library = library_new();
+        mpd->library_pending = true;
+        mpdwrapper_announce_library(mpd, true);
+    }
+
+    int artist_count = mpd->library->artist_count;
+    library_add_chunk(mpd->library, chunk);
+    if (mpd->library->artist_count != artist_count)
+        mpd->library_pending = true;
+    mpdwrapper_announce_library(mpd, false);
+}
+
+/**
+ * @brief Marks the library tree complete once its listing has finished.
+ *
+ * A listing that failed partway leaves a tree that's missing songs, so it's dropped and
+ * the library is listed by the server until the next listing finishes.
+ */
+static void mpdwrapper_finish_library(struct mpdwrapper *mpd, bool failed)
+{
+    if (!mpd->library)
+        return;
+
+    if (!failed) {
+        mpd->library->complete = true;
+        mpdwrapper_announce_library(mpd, true);
+        return;
+    }
+
+    if (!mpd->library->complete) {
+        library_free(mpd->library);
+        mpd->library = NULL;
+        mpd->library_pending = false;
+        mpd->db_version++;
+    }
+}
+
+/**
+ * @brief Applies a change in the state of the connection.
+ *
+ * While disconnected, the last known queue and status are kept, but playback is treated
+ * as unknown and the elapsed time stops counting. Everything is brought up to date once
+ * the connection is back.
+ */
+static void mpdwrapper_apply_connection(struct mpdwrapper *mpd, struct worker_reply *reply)
+{
+    mpd->connection = reply->connection;
+    mpd->reconnect_at = reply->retry_at;
+
+    free(mpd->connection_error);
+    mpd->connection_error = reply->message;
+    reply->message = NULL;
+
+    if (mpd->connection != CONNECTION_CONNECTED) {
+        mpd->state = MPD_STATE_UNKNOWN;
+        playback_clock_set(&mpd->clock, playback_clock_get_elapsed_ms(&mpd->clock),
+                           playback_clock_now(), false);
+    }
+}
+
+/**
+ * @brief Applies everything the worker thread has sent since the last call.
+ *
+ * Never blocks. Lists and errors are passed on to the handlers set with
+ * mpdwrapper_set_handlers().
+ *
+ * @return true if anything was received, false otherwise.
+ */
+bool mpdwrapper_refresh(struct mpdwrapper *mpd)
+{
+    struct worker_reply reply;
+    bool received = false;
+
+    mpdworker_acknowledge(mpd->worker);
+
+    while (mpdworker_receive(mpd->worker, &reply)) {
+        received = true;
+
+        switch (reply.type) {
+            case REPLY_STATUS:
+                mpdwrapper_apply_status(mpd, &reply);
+                break;
+            case REPLY_QUEUE:
+                if (mpdwrapper_apply_queue_patch(mpd, reply.patch))
+                    mpd->queue_changes++;
+                else
+                    mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_RESYNC_QUEUE});
+                break;
+            case REPLY_LIST:
+                mpdwrapper_deliver_list(mpd, &reply);
+                break;
+            case REPLY_LIBRARY_CHUNK:
+                mpdwrapper_apply_library_chunk(mpd, reply.chunk, reply.first_chunk);
+                break;
+            case REPLY_LIBRARY:
+                mpdwrapper_finish_library(mpd, reply.library_failed);
+                break;
+            case REPLY_CONNECTION:
+                mpdwrapper_apply_connection(mpd, &reply);
+                break;
+            case REPLY_ERROR:
+                mpdwrapper_report_error(mpd, reply.message);
+                break;
+        }
+
+        worker_reply_clear(&reply);
+    }
+
+    return received;
+}
+
+/**
+ * @brief Performs an update of the MPD music database.
+ */
+bool mpdwrapper_update_db(struct mpdwrapper *mpd)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_UPDATE_DB});
 }
 
 struct mpd_status *mpdwrapper_get_status(struct mpdwrapper *mpd)
@@ -160,6 +508,11 @@ struct mpd_status *mpdwrapper_get_status(struct mpdwrapper *mpd)
     return mpd->status;
 }
 
+struct mpd_stats *mpdwrapper_get_stats(struct mpdwrapper *mpd)
+{
+    return mpd->stats;
+}
+
 /*
  * TEMP:
  * This function only exists to be a placeholder until the playlist view
@@ -215,6 +568,38 @@ bool mpdwrapper_has_valid_state(struct mpdwrapper *mpd)
     return mpd->state != MPD_STATE_UNKNOWN;
 }
 
+/**
+ * @brief Gets the state of the connection to the server.
+ */
+enum mpdwrapper_connection mpdwrapper_get_connection(struct mpdwrapper *mpd)
+{
+    return mpd->connection;
+}
+
+/**
+ * @brief Gets why the connection was lost or couldn't be made.
+ *
+ * @return A description of the error, or NULL if there hasn't been one.
+ */
+const char *mpdwrapper_get_connection_error(struct mpdwrapper *mpd)
+{
+    return mpd->connection_error;
+}
+
+/**
+ * @brief Gets how long until the next connection attempt.
+ *
+ * @return The number of milliseconds, or 0 if not disconnected.
+ */
+int mpdwrapper_get_reconnect_delay_ms(struct mpdwrapper *mpd)
+{
+    uint64_t now = playback_clock_now();
+
+    if (mpd->connection != CONNECTION_DISCONNECTED || now >= mpd->reconnect_at)
+        return 0;
+    return mpd->reconnect_at - now;
+}
+
 struct mpd_song *mpdwrapper_get_current_song(struct mpdwrapper *mpd)
 {
     return mpd->current_song;
@@ -253,10 +638,31 @@ int mpdwrapper_get_current_song_duration(struct mpdwrapper *mpd)
  */
 int mpdwrapper_get_current_song_elapsed(struct mpdwrapper *mpd)
 {
-    if (mpd->current_song)
-        return mpd_status_get_elapsed_time(mpd->status);
-    else
+    int elapsed_ms = mpdwrapper_get_current_song_elapsed_ms(mpd);
+
+    return (elapsed_ms < 0) ? -1 : elapsed_ms / 1000;
+}
+
+/**
+ * @brief Gets the amount of time elapsed for the currently playing song.
+ *
+ * The time is counted forward from the last status while the song plays, so it stays
+ * current without asking the server. It never runs past the end of the song.
+ *
+ * @param mpd The mpd connection to parse.
+ * @return The time elapsed in milliseconds, or -1 on error.
+ */
+int mpdwrapper_get_current_song_elapsed_ms(struct mpdwrapper *mpd)
+{
+    if (!mpd->current_song || !mpd->status)
         return -1;
+
+    unsigned elapsed_ms = playback_clock_get_elapsed_ms(&mpd->clock);
+    unsigned duration = mpd_song_get_duration(mpd->current_song);
+
+    if (duration > 0 && elapsed_ms > duration * 1000)
+        elapsed_ms = duration * 1000;
+    return elapsed_ms;
 }
 
 /**
@@ -279,6 +685,7 @@ int mpdwrapper_get_current_song_id(struct mpdwrapper *mpd)
  * freeing this memory.
  *
  * @return A null-terminated string containing the tag value, or NULL on error.
+ *   Missing tags give an empty string.
  */
 char *mpdwrapper_get_song_tag(struct mpd_song *song, enum mpd_tag_type tag)
 {
@@ -286,6 +693,9 @@ char *mpdwrapper_get_song_tag(struct mpd_song *song, enum mpd_tag_type tag)
         return NULL;
 
     const char *tag_val = mpd_song_get_tag(song, tag, 0);
+    if (!tag_val)
+        tag_val = "";
+
     int len = strlen(tag_val) + 1;
 
     char *buffer = malloc(len * sizeof(char));
@@ -295,230 +705,427 @@ char *mpdwrapper_get_song_tag(struct mpd_song *song, enum mpd_tag_type tag)
 }
 
 /**
- * @brief Gets a list of all artists in the MPD library.
+ * @brief Passes a list built from the library tree to the list handler.
  *
- * @param mpd The MPD connection to query.
- * @return stringlist* A list of strings containing the artists' names.
+ * @return true if the list was handled, or false if it should be requested from the server.
  */
-struct stringlist *mpdwrapper_list_artists(struct mpdwrapper *mpd)
+static bool mpdwrapper_list_local(struct mpdwrapper *mpd, enum mpdwrapper_list type,
+                                  const char *artist, const char *album)
 {
-    bool artist_query_success = mpd_search_db_tags(mpd->connection, MPD_TAG_ARTIST);
+    struct library *library = mpd->library;
 
-    /* No need to manually set an error code here, as the MPD connection
-     * will have one set automatically when the query is run. */
-    if (!artist_query_success)
-        return NULL;
-    mpd_search_commit(mpd->connection);
+    if (!library || !mpd->handlers || !mpd->handlers->on_list)
+        return false;
+
+    /* A listing still in progress may not have reached all of an artist's songs yet. */
+    if (!library->complete && type != LIST_ARTISTS)
+        return false;
+
+    struct library_artist *library_artist = artist ? library_find_artist(library, artist) : NULL;
+    struct library_album *library_album = album ? library_find_album(library_artist, album) : NULL;
 
-    struct mpd_pair *pair;
-    struct stringlist *list = stringlist_new();
+    /* Titles are lent straight from the library tree, since the handler doesn't keep them. */
+    const char **names = NULL;
+    int count = 0;
 
-    while ((pair = mpd_recv_pair_tag(mpd->connection, MPD_TAG_ARTIST)) != NULL) {
-        stringlist_append(list, pair->value);
-        mpd_return_pair(mpd->connection, pair);
+    if (type == LIST_ARTISTS) {
+        names = malloc((library->artist_count + 1) * sizeof(*names));
+        for (; names && count < library->artist_count; ++count)
+            names[count] = intern_string(library->artists[count].name_id);
+    }
+    else if (type == LIST_ALBUMS && library_artist) {
+        names = malloc((library_artist->album_count + 1) * sizeof(*names));
+        for (; names && count < library_artist->album_count; ++count)
+            names[count] = intern_string(library_artist->albums[count].name_id);
+    }
+    else if (type == LIST_SONGS && library_album) {
+        names = malloc((library_album->track_count + 1) * sizeof(*names));
+        for (; names && count < library_album->track_count; ++count)
+            names[count] = library_album->tracks[count].title;
     }
 
-    return list;
+    mpd->handlers->on_list(mpd->handler_data, type, names, count);
+    free(names);
+
+    return true;
 }
 
 /**
- * @brief Gets a list of album names belonging to an artist.
+ * @brief Appends the URIs of an album's tracks to a list.
  *
- * @param mpd The MPD connection to query.
- * @param artist The artist whose albums to look up.
- * @return struct stringlist* A list of strings containing the album names.
+ * @param title The song to add, or NULL to add every track on the album.
  */
-struct stringlist *mpdwrapper_list_albums(struct mpdwrapper *mpd, char *artist)
+static void library_album_list_uris(struct library_album *album, const char *title,
+                                    struct stringlist *uris)
 {
-    if (!mpd_search_db_tags(mpd->connection, MPD_TAG_ALBUM))
+    for (int i = 0; i < album->track_count; ++i) {
+        if (!title || strcmp(album->tracks[i].title, title) == 0)
+            stringlist_append(uris, strdup(album->tracks[i].uri));
+    }
+}
+
+/**
+ * @brief Looks up songs to add to the queue in the library tree.
+ *
+ * Only a complete library is used, since a listing in progress may be missing songs.
+ *
+ * @param album The album to add from, or NULL to add every album by the artist.
+ * @param title The song to add, or NULL to add every song found.
+ * @return The songs' URIs, or NULL if the server should be searched instead.
+ */
+static struct stringlist *mpdwrapper_find_local(struct mpdwrapper *mpd, const char *artist,
+                                                const char *album, const char *title)
+{
+    struct library *library = mpd->library;
+
+    if (!library || !library->complete)
         return NULL;
 
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST, artist);
-    mpd_search_commit(mpd->connection);
+    struct library_artist *library_artist = library_find_artist(library, artist);
+    if (!library_artist)
+        return NULL;
+
+    struct stringlist *uris = stringlist_new();
 
-    struct mpd_pair *pair;
-    struct stringlist *list = stringlist_new();
-    while ((pair = mpd_recv_pair_tag(mpd->connection, MPD_TAG_ALBUM)) != NULL) {
-        stringlist_append(list, pair->value);
-        mpd_return_pair(mpd->connection, pair);
+    if (album) {
+        struct library_album *library_album = library_find_album(library_artist, album);
+        if (library_album)
+            library_album_list_uris(library_album, title, uris);
+    }
+    else {
+        for (int i = 0; i < library_artist->album_count; ++i)
+            library_album_list_uris(&library_artist->albums[i], NULL, uris);
     }
 
-    return list;
+    if (uris->item_count == 0) {
+        stringlist_free(uris);
+        return NULL;
+    }
+
+    return uris;
 }
 
 /**
- * @brief Gets a list of song names belonging to an album.
+ * @brief Adds songs to the queue, looking them up locally if possible.
  *
- * @param mpd The MPD connection to query.
- * @param artist The album's artist.
- * @param album The album to find songs from.
- * @return struct stringlist* A list of strings containing the song names.
+ * @return true if the request was sent, or false on error.
  */
-struct stringlist *mpdwrapper_list_songs(struct mpdwrapper *mpd, char *artist, char *album)
+static bool mpdwrapper_add(struct mpdwrapper *mpd, enum worker_request_type type,
+                           const char *artist, const char *album, const char *title)
 {
-    if (!mpd_search_db_songs(mpd->connection, true))
-        return NULL;
+    struct stringlist *uris = mpdwrapper_find_local(mpd, artist, album, title);
 
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST, artist);
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ALBUM, album);
-    mpd_search_add_sort_tag(mpd->connection, MPD_TAG_TRACK, false);
-    mpd_search_commit(mpd->connection);
-
-    struct mpd_song *song;
-    char *song_title;
-    struct stringlist *list = stringlist_new();
-    while ((song = mpd_recv_song(mpd->connection)) != NULL) {
-        song_title = mpdwrapper_get_song_tag(song, MPD_TAG_TITLE);
-        stringlist_append(list, song_title);
-        mpd_song_free(song);
+    if (uris) {
+        struct worker_request request = {.type = REQUEST_ADD_URIS, .uris = uris};
+        return mpdwrapper_send(mpd, request);
     }
-    mpd_response_finish(mpd->connection);
 
-    return list;
+    struct worker_request request = {.type = type,
+                                     .strings = {strdup(artist), album ? strdup(album) : NULL,
+                                                 title ? strdup(title) : NULL}};
+    return mpdwrapper_send(mpd, request);
+}
+
+/**
+ * @brief Requests a list of all artists in the MPD library.
+ *
+ * The list is passed to the list handler once it arrives. If the library index is
+ * up to date, that happens before this returns.
+ *
+ * @param mpd The MPD connection to query.
+ * @return true if the request was sent, or false on error.
+ */
+bool mpdwrapper_list_artists(struct mpdwrapper *mpd)
+{
+    if (mpdwrapper_list_local(mpd, LIST_ARTISTS, NULL, NULL))
+        return true;
+
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_LIST_ARTISTS});
 }
 
 /**
- * @brief Returns an error message describing the last error encountered by MPD.
+ * @brief Requests a list of album names belonging to an artist.
+ *
+ * @param mpd The MPD connection to query.
+ * @param artist The artist whose albums to look up.
+ * @return true if the request was sent, or false on error.
+ */
+bool mpdwrapper_list_albums(struct mpdwrapper *mpd, const char *artist)
+{
+    if (mpdwrapper_list_local(mpd, LIST_ALBUMS, artist, NULL))
+        return true;
+
+    struct worker_request request = {.type = REQUEST_LIST_ALBUMS, .strings = {strdup(artist)}};
+    return mpdwrapper_send(mpd, request);
+}
+
+/**
+ * @brief Requests a list of song names belonging to an album.
+ *
+ * @param mpd The MPD connection to query.
+ * @param artist The album's artist.
+ * @param album The album to find songs from.
+ * @return true if the request was sent, or false on error.
  */
-char *mpdwrapper_get_last_error_message(struct mpdwrapper *mpd)
+bool mpdwrapper_list_songs(struct mpdwrapper *mpd, const char *artist, const char *album)
 {
-    return mpd_status_get_error(mpd->status);
+    if (mpdwrapper_list_local(mpd, LIST_SONGS, artist, album))
+        return true;
+
+    struct worker_request request = {.type = REQUEST_LIST_SONGS,
+                                     .strings = {strdup(artist), strdup(album)}};
+    return mpdwrapper_send(mpd, request);
 }
 
 /**
  * @brief Begins playing the specified song from the queue.
  *
  * Begins playing the specified song from the beginning.
- * On error, the details can be fetched with mpdwrapper_get_last_error_message().
+ * On error, the details are passed to the error handler.
  *
  * @param mpd The MPD connection to query.
  * @param pos The position of the song in the queue.
  *
- * @return bool true on success, or false on error.
+ * @return bool true if the request was sent, or false on error.
  */
 bool mpdwrapper_play_queue_pos(struct mpdwrapper *mpd, unsigned pos)
 {
-    bool success = mpd_run_play_pos(mpd->connection, pos);
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_PLAY_POS, .args = {pos}});
+}
 
-    if (!success) {
-        mpd->last_error = mpd_connection_get_error(mpd->connection);
-        mpd->status = mpd_run_status(mpd->connection);
-        mpd->state = mpd_status_get_state(mpd->status);
-    }
+bool mpdwrapper_toggle_pause(struct mpdwrapper *mpd)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_TOGGLE_PAUSE});
+}
 
-    return success;
+bool mpdwrapper_stop(struct mpdwrapper *mpd)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_STOP});
 }
 
 /**
- * @brief Finds all songs by the specified artist and adds them to the play queue.
+ * @brief Moves the playing song forward or back.
+ *
+ * The new offset is shown at once. Seeks made in quick succession are merged, and only
+ * the offset they add up to is sent to the server.
+ *
+ * @param delta_ms How far to move, in milliseconds. The offset stops at either end of the
+ *   song.
  */
-bool mpdwrapper_add_artist(struct mpdwrapper *mpd, char *artist)
+bool mpdwrapper_seek_by(struct mpdwrapper *mpd, int delta_ms)
 {
-    if (!mpd_search_add_db_songs(mpd->connection, true))
+    int elapsed_ms = mpdwrapper_get_current_song_elapsed_ms(mpd);
+    int duration = mpdwrapper_get_current_song_duration(mpd);
+
+    if (elapsed_ms < 0)
         return false;
 
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST, artist);
+    long long target = (long long)elapsed_ms + delta_ms;
+    if (target < 0)
+        target = 0;
+    if (duration > 0 && target > duration * 1000LL)
+        target = duration * 1000LL;
+
+    playback_clock_set(&mpd->clock, target, playback_clock_now(), mpd->state == MPD_STATE_PLAY);
+    if (!coalescer_set(&mpd->seek, target, playback_clock_now()))
+        return true;
+    return mpdwrapper_send(
+        mpd, (struct worker_request){.type = REQUEST_SEEK_CURRENT, .args = {target}});
+}
+
+bool mpdwrapper_prev_song(struct mpdwrapper *mpd)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_PREV_SONG});
+}
+
+bool mpdwrapper_next_song(struct mpdwrapper *mpd)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_NEXT_SONG});
+}
+
+bool mpdwrapper_set_repeat(struct mpdwrapper *mpd, bool mode)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_REPEAT, .args = {mode}});
+}
+
+bool mpdwrapper_set_random(struct mpdwrapper *mpd, bool mode)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_RANDOM, .args = {mode}});
+}
+
+bool mpdwrapper_set_single(struct mpdwrapper *mpd, bool mode)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_SINGLE, .args = {mode}});
+}
+
+bool mpdwrapper_set_consume(struct mpdwrapper *mpd, bool mode)
+{
+    return mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_CONSUME, .args = {mode}});
+}
 
-    bool rc = mpd_search_commit(mpd->connection);
-    mpd_response_finish(mpd->connection);
-    return rc;
+bool mpdwrapper_set_crossfade(struct mpdwrapper *mpd, unsigned seconds)
+{
+    return mpdwrapper_send(mpd,
+                           (struct worker_request){.type = REQUEST_CROSSFADE, .args = {seconds}});
 }
 
 /**
- * @brief Finds all songs in an album and adds them to the play queue.
+ * @brief Raises or lowers the volume.
+ *
+ * The new volume is shown at once. Changes made in quick succession are merged, and only
+ * the volume they add up to is sent to the server.
+ *
+ * @param delta The change in volume, in percent. The volume stops at 0 and 100.
+ * @return false if the volume can't be changed, such as when the server has no mixer.
  */
-bool mpdwrapper_add_album(struct mpdwrapper *mpd, char *artist, char *album)
+bool mpdwrapper_change_volume(struct mpdwrapper *mpd, int delta)
 {
-    if (!mpd_search_add_db_songs(mpd->connection, true))
+    int volume = mpdwrapper_get_volume(mpd);
+
+    if (volume < 0)
         return false;
 
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST, artist);
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ALBUM, album);
+    volume += delta;
+    if (volume < 0)
+        volume = 0;
+    if (volume > 100)
+        volume = 100;
 
-    bool rc = mpd_search_commit(mpd->connection);
-    mpd_response_finish(mpd->connection);
-    return rc;
+    if (!coalescer_set(&mpd->volume, volume, playback_clock_now()))
+        return true;
+    return mpdwrapper_send(mpd,
+                           (struct worker_request){.type = REQUEST_SET_VOLUME, .args = {volume}});
 }
 
 /**
- * @brief Finds a song and adds it to the play queue.
+ * @brief Gets the volume, including any change that hasn't reached the server yet.
+ *
+ * @return The volume in percent, or -1 if it's unknown or the server has no mixer.
  */
-bool mpdwrapper_add_song(struct mpdwrapper *mpd, char *artist, char *album, char *song)
+int mpdwrapper_get_volume(struct mpdwrapper *mpd)
 {
-    if (!mpd_search_add_db_songs(mpd->connection, false))
-        return false;
+    if (mpd->volume.target >= 0)
+        return mpd->volume.target;
+    return mpd->status ? mpd_status_get_volume(mpd->status) : -1;
+}
 
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST, artist);
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_ALBUM, album);
-    mpd_search_add_tag_constraint(mpd->connection, MPD_OPERATOR_DEFAULT, MPD_TAG_TITLE, song);
+/**
+ * @brief Sends the merged volume and seek, once the changes before them have had time
+ * to reach the server.
+ *
+ * @return The number of milliseconds until this should be called again, or -1 if
+ *   nothing is waiting to be sent.
+ */
+int mpdwrapper_flush(struct mpdwrapper *mpd)
+{
+    uint64_t now = playback_clock_now();
+
+    if (coalescer_take(&mpd->volume, now))
+        mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_SET_VOLUME,
+                                                     .args = {mpd->volume.target}});
+    if (coalescer_take(&mpd->seek, now))
+        mpdwrapper_send(mpd, (struct worker_request){.type = REQUEST_SEEK_CURRENT,
+                                                     .args = {mpd->seek.target}});
+
+    int volume_delay = coalescer_get_delay(&mpd->volume, now);
+    int seek_delay = coalescer_get_delay(&mpd->seek, now);
 
-    bool rc = mpd_search_commit(mpd->connection);
-    mpd_response_finish(mpd->connection);
-    return rc;
+    if (volume_delay < 0 || (seek_delay >= 0 && seek_delay < volume_delay))
+        return seek_delay;
+    return volume_delay;
 }
 
 /**
- * @brief Fetches the current MPD queue and stores it in a songlist struct.
- *
- * @param mpd The MPD wrapper to fetch the queue for.
+ * @brief Finds all songs by the specified artist and adds them to the play queue.
  */
-void mpdwrapper_fetch_queue(struct mpdwrapper *mpd)
+bool mpdwrapper_add_artist(struct mpdwrapper *mpd, const char *artist)
 {
-    if (!mpd->connection)
-        return;
-    if (mpd->queue)
-        songlist_clear(mpd->queue);
+    return mpdwrapper_add(mpd, REQUEST_ADD_ARTIST, artist, NULL, NULL);
+}
 
-    struct mpd_song *song;
-    mpd_send_list_queue_meta(mpd->connection);
-    while ((song = mpd_recv_song(mpd->connection)))
-        songlist_append(mpd->queue, song);
+/**
+ * @brief Finds all songs in an album and adds them to the play queue.
+ */
+bool mpdwrapper_add_album(struct mpdwrapper *mpd, const char *artist, const char *album)
+{
+    return mpdwrapper_add(mpd, REQUEST_ADD_ALBUM, artist, album, NULL);
+}
 
-    mpd_response_finish(mpd->connection);
-    mpd->queue_version = mpd_status_get_queue_version(mpd->status);
+/**
+ * @brief Finds a song and adds it to the play queue.
+ */
+bool mpdwrapper_add_song(struct mpdwrapper *mpd, const char *artist, const char *album,
+                         const char *song)
+{
+    return mpdwrapper_add(mpd, REQUEST_ADD_SONG, artist, album, song);
 }
 
-bool mpdwrapper_queue_changed(struct mpdwrapper *mpd)
+/**
+ * @brief Gets a count that goes up whenever the cached queue changes.
+ *
+ * Unlike the queue version, this never repeats, even if the server restarts.
+ */
+unsigned mpdwrapper_get_queue_changes(struct mpdwrapper *mpd)
 {
-    return mpd->queue_changed;
+    return mpd->queue_changes;
 }
 
 /**
- * @brief Allocates memory for a new song node.
+ * @brief Gets a descriptor that becomes readable when mpdwrapper_refresh() has work to do.
  *
- * @return struct songnode* A new song node.
+ * Waiting on this with poll() instead of calling mpdwrapper_refresh() on a timer means
+ * the caller only wakes up when something has arrived from the server.
  */
-struct songnode *songnode_new(struct mpd_song *song)
+int mpdwrapper_get_fd(struct mpdwrapper *mpd)
 {
-    struct songnode *new_node = malloc(sizeof(*new_node));
-    if (!new_node)
-        return NULL;
+    return mpdworker_get_fd(mpd->worker);
+}
 
-    songnode_initialize(new_node, song);
+unsigned mpdwrapper_get_queue_version(struct mpdwrapper *mpd)
+{
+    return mpd->queue_version;
+}
 
-    return new_node;
+unsigned mpdwrapper_get_db_version(struct mpdwrapper *mpd)
+{
+    return mpd->db_version;
 }
 
-void songnode_initialize(struct songnode *node, struct mpd_song *song)
+/**
+ * @brief Gets how much of an arena a queue song and its strings take up.
+ */
+size_t queue_song_size(const struct queue_song *song)
 {
-    node->song = song;
-    node->prev = NULL;
-    node->next = NULL;
+    const char *strings[] = {song->uri, song->title};
+    size_t size = sizeof(*song);
+
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i) {
+        if (strings[i])
+            size += strlen(strings[i]) + 1;
+    }
+
+    return size;
 }
 
 /**
- * @brief Frees memory allocated by a songlist node.
+ * @brief Copies a queue song and its strings into an arena.
+ *
+ * The interned artist and album are shared, so only their IDs are copied.
  *
- * @param node The node to free memory from.
+ * @return The copy, or NULL on error.
  */
-void songnode_free(struct songnode *node)
+struct queue_song *queue_song_copy(struct arena *arena, const struct queue_song *song)
 {
-    if (node->song)
-        mpd_song_free(node->song);
+    struct queue_song *copy = arena_alloc(arena, sizeof(*copy));
+    if (!copy)
+        return NULL;
 
-    node->prev = NULL;
-    node->next = NULL;
-    free(node);
+    *copy = *song;
+    copy->uri = arena_strdup(arena, song->uri ? song->uri : "");
+    if (song->title)
+        copy->title = arena_strdup(arena, song->title);
+
+    return copy;
 }
 
 /**
@@ -539,9 +1146,21 @@ struct songlist *songlist_new()
 
 void songlist_initialize(struct songlist *songlist)
 {
-    songlist->head = NULL;
-    songlist->tail = NULL;
+    songlist->songs = NULL;
+    songlist->ids = NULL;
+    songlist->durations = NULL;
+    songlist->artist_ids = NULL;
+    songlist->album_ids = NULL;
+    songlist->slots = NULL;
+    songlist->slot_count = 0;
     songlist->size = 0;
+    songlist->capacity = 0;
+    arena_initialize(&songlist->arena);
+    songlist->live_bytes = 0;
+    songlist->changed_ids = NULL;
+    songlist->changed_count = 0;
+    songlist->changed_capacity = 0;
+    songlist->all_changed = true;
 }
 
 /**
@@ -552,37 +1171,277 @@ void songlist_initialize(struct songlist *songlist)
 void songlist_free(struct songlist *songlist)
 {
     songlist_clear(songlist);
+    free(songlist->songs);
+    free(songlist->ids);
+    free(songlist->durations);
+    free(songlist->artist_ids);
+    free(songlist->album_ids);
+    free(songlist->slots);
+    free(songlist->changed_ids);
     free(songlist);
 }
 
-struct songnode *songlist_node_at(struct songlist *songlist, unsigned int index)
+/**
+ * @brief Resizes every column of a songlist to the given capacity.
+ *
+ * @return true on success, or false if memory couldn't be allocated.
+ */
+static bool songlist_resize_columns(struct songlist *songlist, int capacity)
 {
-    if (index >= songlist->size)
-        return NULL;
+    unsigned **columns[] = {&songlist->ids, &songlist->durations, &songlist->artist_ids,
+                            &songlist->album_ids};
+
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); ++i) {
+        unsigned *column = realloc(*columns[i], (capacity + 1) * sizeof(*column));
+        if (!column)
+            return false;
+        *columns[i] = column;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Copies the scanned fields of the song at an index into the columns.
+ */
+static void songlist_fill_columns(struct songlist *songlist, int index)
+{
+    const struct queue_song *song = songlist->songs[index];
+
+    songlist->ids[index] = song->id;
+    songlist->durations[index] = song->duration;
+    songlist->artist_ids[index] = song->artist_id;
+    songlist->album_ids[index] = song->album_id;
+}
+
+static size_t songlist_hash_id(unsigned id)
+{
+    return (size_t)(id * 2654435761u);
+}
+
+/**
+ * @brief Adds the song at an index to the ID index, which must have an empty slot.
+ */
+static void songlist_index_song(struct songlist *songlist, int index)
+{
+    size_t mask = songlist->slot_count - 1;
+    size_t slot = songlist_hash_id(songlist->ids[index]) & mask;
 
-    if (index == 0)
-        return songlist->head;
-    if (index == songlist->size - 1)
-        return songlist->tail;
+    while (songlist->slots[slot])
+        slot = (slot + 1) & mask;
+    songlist->slots[slot] = index + 1;
+}
 
-    struct songnode *current = songlist->head;
-    for (int i = 0; i < index; ++i)
-        current = current->next;
+/**
+ * @brief Rebuilds the ID index from the ID column, growing it if needed.
+ *
+ * The table is kept at most half full, so lookups stay short.
+ *
+ * @return true on success, or false if memory couldn't be allocated. The index is left
+ *         empty in that case, so lookups find nothing until the next rebuild.
+ */
+static bool songlist_reindex(struct songlist *songlist)
+{
+    int slot_count = songlist->slot_count ? songlist->slot_count : SONGLIST_MIN_SLOTS;
+    while (slot_count < 2 * (songlist->size + 1))
+        slot_count *= 2;
+
+    if (slot_count != songlist->slot_count) {
+        free(songlist->slots);
+        songlist->slots = malloc(slot_count * sizeof(*songlist->slots));
+        songlist->slot_count = songlist->slots ? slot_count : 0;
+        if (!songlist->slots)
+            return false;
+    }
 
-    return current;
+    memset(songlist->slots, 0, songlist->slot_count * sizeof(*songlist->slots));
+    for (int i = 0; i < songlist->size; ++i)
+        songlist_index_song(songlist, i);
+
+    return true;
 }
 
 /**
- * @brief Gets the MPD song at the given index.
+ * @brief Makes sure a songlist has room for at least the given number of songs.
+ *
+ * The capacity at least doubles each time it grows, so appending is amortized O(1).
+ *
+ * @return true on success, or false if memory couldn't be allocated.
+ */
+bool songlist_reserve(struct songlist *songlist, int capacity)
+{
+    if (capacity <= songlist->capacity)
+        return true;
+
+    int new_capacity = songlist->capacity ? songlist->capacity * 2 : SONGLIST_MIN_CAPACITY;
+    if (new_capacity < capacity)
+        new_capacity = capacity;
+
+    struct queue_song **songs = realloc(songlist->songs, new_capacity * sizeof(*songs));
+    if (!songs)
+        return false;
+
+    songlist->songs = songs;
+    if (!songlist_resize_columns(songlist, new_capacity))
+        return false;
+
+    songlist->capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @brief Replaces the contents of a songlist with the given songs, in order.
+ *
+ * The songlist takes ownership of the array itself, so no songs are copied or allocated.
+ * The songs must already be in the list's arena, or in one it's about to adopt. Any songs
+ * previously in the list that aren't in the array must already have been forgotten.
+ *
+ * @param songs A heap-allocated array of songs.
+ * @param count The number of songs in the array.
+ * @return true on success, or false if the columns couldn't be allocated. The list is
+ *         left empty in that case, but still takes ownership of the array.
+ */
+bool songlist_replace(struct songlist *songlist, struct queue_song **songs, int count)
+{
+    free(songlist->songs);
+
+    songlist->songs = songs;
+    songlist->size = 0;
+    songlist->capacity = 0;
+
+    if (!songlist_resize_columns(songlist, count))
+        return false;
+
+    songlist->size = count;
+    songlist->capacity = count;
+    for (int i = 0; i < count; ++i)
+        songlist_fill_columns(songlist, i);
+
+    return songlist_reindex(songlist);
+}
+
+/**
+ * @brief Takes over an arena holding songs that are being added to a songlist.
+ *
+ * Every song in the arena is counted as being in the list. The arena is left empty.
+ */
+void songlist_adopt(struct songlist *songlist, struct arena *arena)
+{
+    songlist->live_bytes += arena->used;
+    arena_adopt(&songlist->arena, arena);
+}
+
+/**
+ * @brief Stops counting a song that's no longer in a songlist as in use.
+ *
+ * The song's memory is reclaimed the next time the list is compacted.
+ */
+void songlist_forget(struct songlist *songlist, const struct queue_song *song)
+{
+    size_t size = queue_song_size(song);
+
+    songlist->live_bytes -= (size < songlist->live_bytes) ? size : songlist->live_bytes;
+    songlist_touch(songlist, song->id);
+}
+
+/**
+ * @brief Records that the song with an ID was added to, removed from, or replaced in a list.
+ *
+ * Once more has changed than the list holds, the changes stop being listed and the whole
+ * list counts as changed instead.
+ */
+void songlist_touch(struct songlist *songlist, unsigned id)
+{
+    if (songlist->all_changed)
+        return;
+
+    if (songlist->changed_count >= songlist->size + SONGLIST_MIN_CHANGES) {
+        songlist->all_changed = true;
+        return;
+    }
+
+    if (songlist->changed_count == songlist->changed_capacity) {
+        int capacity = songlist->changed_capacity ? songlist->changed_capacity * 2
+                                                  : SONGLIST_MIN_CHANGES;
+        unsigned *ids = realloc(songlist->changed_ids, capacity * sizeof(*ids));
+        if (!ids) {
+            songlist->all_changed = true;
+            return;
+        }
+
+        songlist->changed_ids = ids;
+        songlist->changed_capacity = capacity;
+    }
+
+    songlist->changed_ids[songlist->changed_count++] = id;
+}
+
+/**
+ * @brief Takes the IDs of the songs added, removed or replaced since the last call.
+ *
+ * Songs that only moved aren't listed. An ID can appear more than once.
+ *
+ * @param ids Receives the IDs, which stay valid until the list next changes.
+ * @param count Receives the number of IDs.
+ * @return true if the IDs are every change, or false if too much changed to list and
+ *         every song should be treated as new.
+ */
+bool songlist_take_changes(struct songlist *songlist, const unsigned **ids, int *count)
+{
+    bool listed = !songlist->all_changed;
+
+    *ids = songlist->changed_ids;
+    *count = listed ? songlist->changed_count : 0;
+
+    songlist->changed_count = 0;
+    songlist->all_changed = false;
+
+    return listed;
+}
+
+/**
+ * @brief Moves a songlist's songs into a new arena once its arena is mostly removed songs.
+ *
+ * This keeps steady turnover in the queue, such as in consume mode, from growing the
+ * arena without bound, and costs O(n) at most once per n bytes of songs removed.
+ */
+void songlist_compact(struct songlist *songlist)
+{
+    if (songlist->arena.used <= SONGLIST_COMPACT_RATIO * songlist->live_bytes + ARENA_BLOCK_SIZE)
+        return;
+
+    struct arena arena;
+    arena_initialize(&arena);
+
+    for (int i = 0; i < songlist->size; ++i) {
+        struct queue_song *copy = queue_song_copy(&arena, songlist->songs[i]);
+        if (!copy) {
+            /* Songs that were already copied keep pointing into the new arena. */
+            arena_adopt(&songlist->arena, &arena);
+            return;
+        }
+        songlist->songs[i] = copy;
+    }
+
+    arena_release(&songlist->arena);
+    songlist->arena = arena;
+    songlist->live_bytes = arena.used;
+}
+
+/**
+ * @brief Gets the song at the given index.
  *
  * @param list The list to find a song from.
  * @param index The place in the list where the song is.
  *
- * @return Pointer to the MPD song at the requested position, or NULL on error.
+ * @return Pointer to the song at the requested position, or NULL on error.
  */
-struct mpd_song *songlist_at(struct songlist *songlist, unsigned int index)
+struct queue_song *songlist_at(struct songlist *songlist, unsigned int index)
 {
-    return songlist_node_at(songlist, index)->song;
+    if (index >= songlist->size)
+        return NULL;
+
+    return songlist->songs[index];
 }
 
 /**
@@ -594,29 +1453,65 @@ int songlist_get_size(struct songlist *songlist)
 }
 
 /**
- * @brief Adds a song to the end of the list.
+ * @brief Gets a read-only view of a songlist's columns.
+ */
+void songlist_get_columns(struct songlist *songlist, struct queue_columns *columns)
+{
+    columns->ids = songlist->ids;
+    columns->durations = songlist->durations;
+    columns->artist_ids = songlist->artist_ids;
+    columns->album_ids = songlist->album_ids;
+    columns->count = songlist->size;
+}
+
+/**
+ * @brief Finds the index of the song with the given MPD ID.
+ *
+ * @return The song's index in the list, or -1 if it isn't in the list.
+ */
+int songlist_find_id(struct songlist *songlist, unsigned id)
+{
+    if (songlist->slot_count == 0)
+        return -1;
+
+    size_t mask = songlist->slot_count - 1;
+
+    for (size_t slot = songlist_hash_id(id) & mask; songlist->slots[slot];
+         slot = (slot + 1) & mask) {
+        int index = songlist->slots[slot] - 1;
+        if (songlist->ids[index] == id)
+            return index;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Adds a copy of a song to the end of the list.
  *
  * @param list The list to append a song to.
  * @param song The song to add to the list.
  *   If this is NULL, the function does nothing.
  */
-void songlist_append(struct songlist *songlist, struct mpd_song *song)
+void songlist_append(struct songlist *songlist, const struct queue_song *song)
 {
-    if (!song)
+    if (!song || !songlist_reserve(songlist, songlist->size + 1))
         return;
 
-    struct songnode *new_node = songnode_new(song);
+    size_t used = songlist->arena.used;
+    struct queue_song *copy = queue_song_copy(&songlist->arena, song);
+    if (!copy)
+        return;
 
-    if (!songlist->head)
-        songlist->head = new_node;
-    else {
-        struct songnode *tmp = songlist->tail;
-        tmp->next = new_node;
-        new_node->prev = tmp;
-    }
+    songlist->songs[songlist->size] = copy;
+    songlist_fill_columns(songlist, songlist->size++);
+    songlist->live_bytes += songlist->arena.used - used;
+    songlist_touch(songlist, copy->id);
 
-    songlist->tail = new_node;
-    songlist->size++;
+    if (2 * songlist->size > songlist->slot_count)
+        songlist_reindex(songlist);
+    else
+        songlist_index_song(songlist, songlist->size - 1);
 }
 
 /**
@@ -630,48 +1525,38 @@ void songlist_remove(struct songlist *songlist, unsigned int index)
     if (index >= songlist->size)
         return;
 
-    if (index == 0) {
-        struct songnode *tmp = songlist->head;
-
-        songlist->head = songlist->head->next;
-        songlist->head->prev = NULL;
-        songnode_free(tmp);
-    }
-    else if (index == songlist->size - 1) {
-        struct songnode *tmp = songlist->tail;
+    unsigned *columns[] = {songlist->ids, songlist->durations, songlist->artist_ids,
+                           songlist->album_ids};
+    int after = songlist->size - index - 1;
 
-        songlist->tail = songlist->tail->prev;
-        songlist->tail->next = NULL;
-        songnode_free(tmp);
-    }
-    else {
-        struct songnode *tmp = songlist_node_at(songlist, index);
-
-        tmp->prev->next = tmp->next;
-        tmp->next->prev = tmp->prev;
-        songnode_free(tmp);
-    }
+    songlist_forget(songlist, songlist->songs[index]);
+    memmove(&songlist->songs[index], &songlist->songs[index + 1],
+            after * sizeof(*songlist->songs));
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); ++i)
+        memmove(&columns[i][index], &columns[i][index + 1], after * sizeof(*columns[i]));
 
     songlist->size--;
+    songlist_compact(songlist);
+
+    /* Every later song moved up a row, so their slots are stale either way. */
+    songlist_reindex(songlist);
 }
 
 /**
  * @brief Removes all items from a songlist.
  *
+ * The list keeps its capacity, so refilling it doesn't reallocate. The songs are freed
+ * all at once with the list's arena.
+ *
  * @param list The list to clear.
  */
 void songlist_clear(struct songlist *songlist)
 {
-    struct songnode *current = songlist->head;
-    struct songnode *next;
-
-    while (current) {
-        next = current->next;
-        songnode_free(current);
-        current = next;
-    }
-
-    songlist->head = NULL;
-    songlist->tail = NULL;
+    arena_release(&songlist->arena);
+    songlist->live_bytes = 0;
     songlist->size = 0;
+    songlist->all_changed = true;
+
+    if (songlist->slots)
+        memset(songlist->slots, 0, songlist->slot_count * sizeof(*songlist->slots));
 }
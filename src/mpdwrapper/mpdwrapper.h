@@ -26,53 +26,111 @@
 
 #include <mpd/client.h>
 
+#include "pantomime/arena.h"
 #include "pantomime/mpdwrapper.h"
+#include "coalescer.h"
+#include "playback_clock.h"
+
+#define SONGLIST_MIN_CAPACITY 64 /* The capacity of a songlist's first allocation. */
+#define SONGLIST_COMPACT_RATIO 2 /* How many times its songs' size a songlist's arena can grow. */
+#define SONGLIST_MIN_SLOTS 128   /* The number of slots in a songlist's first ID index. */
+#define SONGLIST_MIN_CHANGES 64  /* Changes kept past the list's size before all of it counts. */
+
+#define LIBRARY_REFRESH_INTERVAL 1000 /* The shortest wait in ms between streamed artist lists. */
+
+/**
+ * @brief A growable array of queue songs.
+ *
+ * The songs belong to the list's arena. Removed songs stay in the arena until the list
+ * is cleared or compacted, so removing songs is cheap.
+ *
+ * The fields that scans read are also kept in parallel arrays, one entry per song in
+ * queue order, so a scan over the queue reads contiguous integers instead of following
+ * a pointer per song. Every array has room for the list's capacity.
+ *
+ * Songs are also indexed by MPD ID in an open-addressing hash table, so the row of any
+ * song, such as the playing one, is found in constant time. Each slot holds a song's
+ * index plus one, so zero can mark an empty slot, and the ID column holds the keys.
+ */
+struct songlist {
+    struct queue_song **songs; /**< The songs in the list, in order. */
+    unsigned *ids;             /**< Each song's MPD ID. */
+    unsigned *durations;       /**< Each song's length in seconds. */
+    unsigned *artist_ids;      /**< Each song's interned artist. */
+    unsigned *album_ids;       /**< Each song's interned album. */
+    int *slots;                /**< The ID index: a song's index plus one, or 0 if empty. */
+    int slot_count;            /**< The number of slots. A power of two, or 0. */
+    int size;                  /**< The number of items in the list. */
+    int capacity;              /**< The number of songs there is room for. */
+    struct arena arena;        /**< Holds the songs and their strings. */
+    size_t live_bytes;         /**< The bytes of the arena used by songs still in the list. */
+
+    unsigned *changed_ids; /**< The IDs of songs added or removed since the changes were taken. */
+    int changed_count;     /**< The number of changed IDs. */
+    int changed_capacity;  /**< The number of changed IDs there is room for. */
+    bool all_changed;      /**< Whether too much changed to list, so every song counts. */
+};
 
 /**
- * @brief A node in a linked list of MPD songs.
+ * @brief A song whose queue position changed, as reported by MPD.
  */
-struct songnode {
-    struct mpd_song *song; /**< The MPD song at this node. */
-    struct songnode *next; /**< The next song in the list. */
-    struct songnode *prev; /**< The previous song in the list. */
+struct queue_change {
+    unsigned pos; /**< The song's new position in the queue. */
+    unsigned id;  /**< The song's MPD ID. */
+    int index;    /**< The song's index in the old queue, or -1 if it's new to the queue. */
 };
 
 /**
- * @brief A doubly-linked list of MPD songs.
+ * @brief A queue song's ID, used for looking songs up by ID.
  */
-struct songlist {
-    struct songnode *head; /**< The first item in the list. */
-    struct songnode *tail; /**< The last item in the list. */
-    int size;              /**< The number of items in the list. */
+struct queue_entry {
+    unsigned id; /**< The song's MPD ID. */
+    int index;   /**< The song's index in the queue. */
 };
 
 /**
  * @brief Holds information about the current MPD server connection.
  *
  * This struct contains information about the current MPD server connection.
- * With this struct, we are able to keep track of the connection state
- * without having to make continual (often unnecessary) server requests.
+ * The connection itself belongs to a worker thread, which keeps this copy of
+ * the server's state up to date through mpdwrapper_refresh().
  */
 struct mpdwrapper {
-    struct mpd_connection *connection; /**< The MPD server connection. */
-    struct mpd_status *status;         /**< Holds info about MPD's status. */
-    struct mpd_song *current_song;     /**< The currently playing song. */
-    struct songlist *queue;    /**< A songlist struct representing the current play queue. */
-    enum mpd_error last_error; /**< The most recent error encountered by MPD. */
-    enum mpd_state state;      /**< Current player state (playing, paused, or stopped). */
+    struct mpdworker *worker; /**< The thread that talks to the MPD server. */
+    const struct mpdwrapper_handlers *handlers; /**< Callbacks for lists and errors. */
+    void *handler_data;                         /**< Passed to each of the handlers. */
+    struct mpd_status *status;                  /**< Holds info about MPD's status. */
+    struct mpd_song *current_song;              /**< The currently playing song. */
+    struct mpd_stats *stats; /**< Database statistics, including the last update time. */
+    struct songlist *queue;  /**< A songlist struct representing the current play queue. */
+    enum mpd_state state;    /**< Current player state (playing, paused, or stopped). */
+    struct playback_clock clock; /**< Counts the elapsed time forward between statuses. */
+    struct coalescer volume;     /**< The volume asked for but not yet reported, in percent. */
+    struct coalescer seek;       /**< The offset asked for but not yet reported, in ms. */
+    enum mpdwrapper_connection connection; /**< The state of the connection to the server. */
+    char *connection_error;                /**< Why the connection was lost, or NULL. */
+    uint64_t reconnect_at; /**< When the next connection attempt is made, if disconnected. */
     int queue_version;  /**< The queue version number. Useful for checking if queue has changed. */
-    bool queue_changed; /**< Whether the queue has changed since the last refresh. */
+    unsigned queue_changes; /**< Counts the changes applied to the cached queue. */
+    unsigned db_version; /**< Incremented whenever MPD reports a database change. */
+    struct library *library;       /**< The library tree, or NULL if it isn't loaded. */
+    bool library_pending;          /**< Whether streamed artists haven't been announced. */
+    uint64_t library_announced_at; /**< When streamed artists were last announced. */
+    char *library_path;            /**< Where the library index is saved. */
 };
 
-struct songnode *songnode_new(struct mpd_song *song);
-void songnode_initialize(struct songnode *node, struct mpd_song *song);
-void songnode_free(struct songnode *node);
+size_t queue_song_size(const struct queue_song *song);
+struct queue_song *queue_song_copy(struct arena *arena, const struct queue_song *song);
 
 void songlist_initialize(struct songlist *songlist);
-struct songnode *songlist_node_at(struct songlist *songlist, unsigned int index);
+bool songlist_reserve(struct songlist *songlist, int capacity);
+bool songlist_replace(struct songlist *songlist, struct queue_song **songs, int count);
+void songlist_adopt(struct songlist *songlist, struct arena *arena);
+void songlist_forget(struct songlist *songlist, const struct queue_song *song);
+void songlist_touch(struct songlist *songlist, unsigned id);
+void songlist_compact(struct songlist *songlist);
 int songlist_get_size(struct songlist *songlist);
 
-void mpdwrapper_initialize(struct mpdwrapper *mpd, const char *host, int port, int timeout);
-void mpdwrapper_fetch_queue(struct mpdwrapper *mpd);
+bool mpdwrapper_initialize(struct mpdwrapper *mpd, const char *host, int port, int timeout);
 
 #endif /* MPDWRAPPER_INTERNAL_H */
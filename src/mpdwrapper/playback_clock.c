@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * playback_clock.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file playback_clock.h
+ */
+
+#include "playback_clock.h"
+
+#include <time.h>
+
+/**
+ * @brief Gets the current time on the monotonic clock.
+ *
+ * @return The time in milliseconds since some unspecified starting point.
+ */
+uint64_t playback_clock_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Initializes a stopped clock at the start of a song.
+ */
+void playback_clock_initialize(struct playback_clock *clock)
+{
+    clock->elapsed_ms = 0;
+    clock->since = playback_clock_now();
+    clock->running = false;
+}
+
+/**
+ * @brief Sets the clock to a new status from the server.
+ *
+ * @param clock The clock to set.
+ * @param elapsed_ms The elapsed time the server reported.
+ * @param since When the status was fetched, from playback_clock_now().
+ * @param running Whether the song is playing.
+ */
+void playback_clock_set(struct playback_clock *clock, unsigned elapsed_ms, uint64_t since,
+                        bool running)
+{
+    clock->elapsed_ms = elapsed_ms;
+    clock->since = since;
+    clock->running = running;
+}
+
+/**
+ * @brief Gets how far into the song the player is now.
+ *
+ * While playing, this is the last reported time plus however long it's been since the
+ * report. Otherwise, it's just the last reported time.
+ *
+ * @return The elapsed time in milliseconds.
+ */
+unsigned playback_clock_get_elapsed_ms(const struct playback_clock *clock)
+{
+    if (!clock->running)
+        return clock->elapsed_ms;
+
+    uint64_t now = playback_clock_now();
+    if (now <= clock->since)
+        return clock->elapsed_ms;
+
+    return clock->elapsed_ms + (unsigned)(now - clock->since);
+}
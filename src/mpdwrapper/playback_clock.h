@@ -0,0 +1,48 @@
+/*******************************************************************************
+ * playback_clock.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file playback_clock.h
+ * @brief Tracks how far into the current song the player is, between status updates.
+ *
+ * MPD only reports the elapsed time when asked for the status. Rather than polling for it,
+ * the clock remembers the elapsed time from the last status along with when that status
+ * was fetched, and counts forward from there on its own while the song is playing.
+ */
+
+#ifndef PLAYBACK_CLOCK_H
+#define PLAYBACK_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct playback_clock {
+    unsigned elapsed_ms; /**< The elapsed time reported by the server. */
+    uint64_t since;      /**< When the elapsed time was reported, on the monotonic clock. */
+    bool running;        /**< Whether the song is playing, so time is passing. */
+};
+
+uint64_t playback_clock_now(void);
+
+void playback_clock_initialize(struct playback_clock *clock);
+void playback_clock_set(struct playback_clock *clock, unsigned elapsed_ms, uint64_t since,
+                        bool running);
+
+unsigned playback_clock_get_elapsed_ms(const struct playback_clock *clock);
+
+#endif /* PLAYBACK_CLOCK_H */
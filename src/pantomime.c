@@ -18,13 +18,19 @@
  ******************************************************************************/
 
 #include <argp.h>
+#include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 #include "command/command.h"
 #include "command/command_global.h"
 #include "command/command_library.h"
 #include "command/command_player.h"
 #include "command/command_queue.h"
+#include "pantomime/event_loop.h"
+#include "pantomime/intern.h"
 #include "pantomime/mpdwrapper.h"
 #include "pantomime/ui.h"
 
@@ -37,6 +43,9 @@ static struct argp_option options[] = {
     {"host", 'h', "HOST", 0, "The IP address or socket path of the MPD host"},
     {"port", 'p', "PORT", 0, "The port of the MPD host"},
     {"timeout", 't', "TIMEOUT", 0, "The timeout in milliseconds"},
+    {"bind", 'b', "KEY=COMMAND", 0,
+     "Bind a key to one of the commands listed below, or to \"none\" to unbind it. "
+     "May be repeated"},
     {0}};
 
 /* Used by main() to communicate with parse_opt. */
@@ -47,6 +56,33 @@ struct arguments {
     int timeout;
 };
 
+/**
+ * @brief Applies a KEY=COMMAND binding from the command line.
+ *
+ * The last '=' splits the key from the command, so "==Volume up" binds the '=' key.
+ *
+ * @return false if the key or the command isn't known.
+ */
+static bool parse_binding(char *binding)
+{
+    char *separator = strrchr(binding, '=');
+    if (!separator)
+        return false;
+    *separator = '\0';
+    int key = str_to_key(binding);
+    *separator = '=';
+
+    const char *name = separator + 1;
+    if (key == 0)
+        return false;
+
+    if (name[0] == '\0' || strcasecmp(name, "none") == 0) {
+        unbind_key(key);
+        return true;
+    }
+    return bind_key(key, find_command(name));
+}
+
 /* Parse a single option. */
 static error_t parse_opt(int key, char *arg, struct argp_state *state)
 {
@@ -63,6 +99,10 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         case 't':
             arguments->timeout = atoi(arg);
             break;
+        case 'b':
+            if (!parse_binding(arg))
+                argp_error(state, "invalid binding '%s'", arg);
+            break;
         case ARGP_KEY_ARG:
             if (state->arg_num >= 0) {
                 /* Too many arguments. */
@@ -75,8 +115,76 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
     return 0;
 }
 
+/**
+ * @brief Lists the commands --bind takes after the options in --help.
+ */
+static char *help_filter(int key, const char *text, void *input)
+{
+    if (key != ARGP_KEY_HELP_POST_DOC)
+        return (char *)text;
+
+    char *list = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&list, &length);
+    if (!stream)
+        return (char *)text;
+
+    fputs("Commands for --bind:\n", stream);
+    for (int i = CMD_NULL + 1; i < NUM_CMDS; ++i)
+        fprintf(stream, "  %s\n", get_command_name(i));
+    fclose(stream);
+    return list;
+}
+
 /* Our argp parser. */
-static struct argp argp = {options, parse_opt, 0, doc};
+static struct argp argp = {options, parse_opt, 0, doc, 0, help_filter};
+
+/**
+ * @brief Runs a command in every part of the client that handles it.
+ *
+ * Cursor moves are only added to the moves still to be applied, so a run of them is
+ * applied as one. Any other command applies them first, so commands still run in the
+ * order they were typed.
+ *
+ * @param moves The lines the cursor is still to move down, or up if negative.
+ */
+static void run_command(struct command_call call, int *moves, struct mpdwrapper *mpd,
+                        struct ui *ui)
+{
+    int count = (call.count > 0) ? call.count : 1;
+
+    if (call.cmd == CMD_CURSOR_DOWN || call.cmd == CMD_CURSOR_UP) {
+        *moves += (call.cmd == CMD_CURSOR_DOWN) ? count : -count;
+        return;
+    }
+
+    cmd_move_cursor(ui, *moves);
+    *moves = 0;
+
+    cmd_global(call.cmd, mpd, ui);
+    cmd_player(call, mpd, ui->statusbar);
+
+    switch (ui->visible_panel) {
+        case HELP:
+            break;
+        case QUEUE:
+            cmd_queue(call, mpd, ui);
+            break;
+        case LIBRARY:
+            cmd_library(call, ui->library, ui->statusbar, mpd);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Picks the sooner of two delays, where -1 means never.
+ */
+static int sooner(int a, int b)
+{
+    return (a < 0 || (b >= 0 && b < a)) ? b : a;
+}
 
 int main(int argc, char **argv)
 {
@@ -87,38 +195,70 @@ int main(int argc, char **argv)
     arguments.timeout = 30000;
     argp_parse(&argp, argc, argv, 0, 0, &arguments);
 
+    /* The signals the loop handles are blocked here, before the worker thread exists, so
+     * that thread inherits the mask and never takes them itself. */
+    struct event_loop loop;
+    if (!event_loop_initialize(&loop)) {
+        fprintf(stderr, "pantomime: could not set up the event loop\n");
+        return 1;
+    }
+
     struct mpdwrapper *mpd = mpdwrapper_new(arguments.host, arguments.port, arguments.timeout);
+    if (!mpd) {
+        fprintf(stderr, "pantomime: could not start the connection thread\n");
+        event_loop_release(&loop);
+        return 1;
+    }
+    event_loop_watch(&loop, EVENT_SERVER, mpdwrapper_get_fd(mpd));
 
+    build_keymap();
     start_curses();
-    halfdelay(TRUE);
 
     struct ui *ui = ui_new(mpd);
     ui_draw(ui, mpd);
 
     int ch;
-    enum command_type cmd;
-
-    while (cmd != CMD_QUIT) {
-        mpdwrapper_refresh(mpd);
-
-        ch = getch();
-        cmd = find_key_command(ch);
-
-        cmd_global(cmd, mpd, ui);
-        cmd_player(cmd, mpd, ui->statusbar);
-
-        switch (ui->visible_panel) {
-            case HELP:
-                break;
-            case QUEUE:
-                cmd_queue(cmd, mpd, ui);
-                break;
-            case LIBRARY:
-                cmd_library(cmd, ui->library, ui->statusbar, mpd);
-                break;
-            default:
-                break;
+    struct command_call call = {CMD_NULL, 0};
+    struct key_sequence keys;
+
+    key_sequence_initialize(&keys);
+
+    /* All server traffic happens on the wrapper's worker thread, which wakes this loop
+     * whenever it has replies. Nothing else happens until a key is pressed, a signal
+     * arrives, or something on screen is due to change with time. */
+    while (call.cmd != CMD_QUIT) {
+        event_loop_set_tick(&loop, sooner(ui_next_tick(ui, mpd), key_sequence_get_delay(&keys)));
+        unsigned ready = event_loop_wait(&loop);
+
+        if (EVENT_READY(ready, EVENT_SIGNAL)) {
+            int signal;
+
+            while ((signal = event_loop_next_signal(&loop)) > 0) {
+                if (signal == SIGWINCH)
+                    ui_resize(ui);
+                else
+                    call.cmd = CMD_QUIT;
+            }
+        }
+        if (EVENT_READY(ready, EVENT_SERVER))
+            mpdwrapper_refresh(mpd);
+
+        /* Every key that's waiting is handled before the next frame is drawn, so held keys
+         * never fall behind. Curses may have read more than one into its own buffer, so
+         * keep going until it has nothing left rather than going back to poll() after each.
+         * Runs of cursor moves are added up and applied as one. */
+        int moves = 0;
+
+        while (EVENT_READY(ready, EVENT_INPUT) && call.cmd != CMD_QUIT &&
+               (ch = getch()) != ERR) {
+            if (ui_search_is_active(ui))
+                ui_search_input(ui, ch);
+            else if (key_sequence_feed(&keys, ch, &call))
+                run_command(call, &moves, mpd, ui);
         }
+        if (call.cmd != CMD_QUIT && key_sequence_expire(&keys, &call))
+            run_command(call, &moves, mpd, ui);
+        cmd_move_cursor(ui, moves);
 
         ui_draw(ui, mpd);
     }
@@ -126,6 +266,8 @@ int main(int argc, char **argv)
     end_curses();
     ui_free(ui);
     mpdwrapper_free(mpd);
+    event_loop_release(&loop);
+    intern_release();
 
     return 0;
 }
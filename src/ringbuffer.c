@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * ringbuffer.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file ringbuffer.h
+ */
+
+#include "pantomime/ringbuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Allocates a new, empty ring buffer.
+ *
+ * @param capacity The maximum number of elements. Rounded up to a power of two.
+ * @param element_size The size of each element in bytes.
+ * @return A pointer to the new ring buffer, or NULL on error.
+ */
+struct ringbuffer *ringbuffer_new(size_t capacity, size_t element_size)
+{
+    struct ringbuffer *ring = aligned_alloc(_Alignof(struct ringbuffer), sizeof(*ring));
+    if (!ring)
+        return NULL;
+
+    size_t slots = 1;
+    while (slots < capacity)
+        slots <<= 1;
+
+    ring->slots = malloc(slots * element_size);
+    if (!ring->slots) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->element_size = element_size;
+    ring->capacity = slots;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+
+    return ring;
+}
+
+void ringbuffer_free(struct ringbuffer *ring)
+{
+    if (!ring)
+        return;
+
+    free(ring->slots);
+    free(ring);
+}
+
+/**
+ * @brief Copies an element into the ring buffer. Must only be called by the producer thread.
+ *
+ * @return true on success, or false if the ring buffer is full.
+ */
+bool ringbuffer_push(struct ringbuffer *ring, const void *element)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail - head == ring->capacity)
+        return false;
+
+    memcpy(ring->slots + (tail & (ring->capacity - 1)) * ring->element_size, element,
+           ring->element_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return true;
+}
+
+/**
+ * @brief Copies the oldest element out of the ring buffer. Must only be called by the
+ * consumer thread.
+ *
+ * @return true on success, or false if the ring buffer is empty.
+ */
+bool ringbuffer_pop(struct ringbuffer *ring, void *element)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head == tail)
+        return false;
+
+    memcpy(element, ring->slots + (head & (ring->capacity - 1)) * ring->element_size,
+           ring->element_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+bool ringbuffer_is_empty(struct ringbuffer *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) ==
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
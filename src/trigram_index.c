@@ -0,0 +1,402 @@
+/*******************************************************************************
+ * trigram_index.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file trigram_index.h
+ */
+
+#include "pantomime/trigram_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIGRAM_QUERY_MAX 256 /* The longest query that's searched; the rest is ignored. */
+#define TRIGRAM_OFFSET_MAX 255 /* Trigram offsets at or past this are stored as this. */
+
+/**
+ * @brief Lowercases an ASCII character. Other bytes are left alone, so UTF-8 survives.
+ */
+static char trigram_normalize_char(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/**
+ * @brief Normalizes a string into a buffer.
+ *
+ * @return The length of the normalized string.
+ */
+static size_t trigram_normalize(const char *str, char *buffer, size_t size)
+{
+    size_t len = 0;
+
+    while (str[len] && len < size - 1) {
+        buffer[len] = trigram_normalize_char(str[len]);
+        ++len;
+    }
+    buffer[len] = '\0';
+
+    return len;
+}
+
+static uint32_t trigram_key(const char *str)
+{
+    const unsigned char *p = (const unsigned char *)str;
+    return ((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) + 1;
+}
+
+static size_t trigram_hash(uint32_t key)
+{
+    return (size_t)(key * 2654435761u);
+}
+
+/**
+ * @brief Allocates a new, empty trigram index.
+ *
+ * @return A pointer to the new index, or NULL on error.
+ */
+struct trigram_index *trigram_index_new()
+{
+    struct trigram_index *index = malloc(sizeof(*index));
+    if (!index)
+        return NULL;
+
+    index->postings = NULL;
+    index->postings_count = 0;
+    index->postings_capacity = 0;
+    index->offsets = NULL;
+    index->removed = NULL;
+    index->count = 0;
+    index->removed_count = 0;
+    index->capacity = 0;
+    index->text = NULL;
+    index->text_size = 0;
+    index->text_capacity = 0;
+
+    return index;
+}
+
+void trigram_index_free(struct trigram_index *index)
+{
+    if (!index)
+        return;
+
+    for (int i = 0; i < index->postings_capacity; ++i) {
+        free(index->postings[i].ids);
+        free(index->postings[i].offsets);
+    }
+
+    free(index->postings);
+    free(index->offsets);
+    free(index->removed);
+    free(index->text);
+    free(index);
+}
+
+/**
+ * @brief Removes every string from the index.
+ *
+ * The index keeps its memory, so refilling it doesn't reallocate.
+ */
+void trigram_index_clear(struct trigram_index *index)
+{
+    for (int i = 0; i < index->postings_capacity; ++i)
+        index->postings[i].count = 0;
+
+    index->count = 0;
+    index->removed_count = 0;
+    index->text_size = 0;
+}
+
+/**
+ * @brief Finds the slot for a trigram in the hash table.
+ *
+ * @return The trigram's slot, or the empty slot it would go in.
+ */
+static struct trigram_postings *trigram_index_slot(struct trigram_index *index, uint32_t key)
+{
+    size_t mask = index->postings_capacity - 1;
+    size_t slot = trigram_hash(key) & mask;
+
+    while (index->postings[slot].trigram && index->postings[slot].trigram != key)
+        slot = (slot + 1) & mask;
+
+    return &index->postings[slot];
+}
+
+/**
+ * @brief Doubles the size of the hash table.
+ */
+static void trigram_index_grow(struct trigram_index *index)
+{
+    struct trigram_postings *old = index->postings;
+    int old_capacity = index->postings_capacity;
+
+    index->postings_capacity = old_capacity ? old_capacity * 2 : 1024;
+    index->postings = calloc(index->postings_capacity, sizeof(*index->postings));
+
+    for (int i = 0; i < old_capacity; ++i) {
+        if (old[i].trigram)
+            *trigram_index_slot(index, old[i].trigram) = old[i];
+    }
+
+    free(old);
+}
+
+/**
+ * @brief Records that a string contains a trigram.
+ *
+ * @param offset Where the trigram appears in the string.
+ */
+static void trigram_index_post(struct trigram_index *index, uint32_t key, int id, size_t offset)
+{
+    if ((index->postings_count + 1) * 2 > index->postings_capacity)
+        trigram_index_grow(index);
+
+    struct trigram_postings *postings = trigram_index_slot(index, key);
+
+    if (!postings->trigram) {
+        postings->trigram = key;
+        index->postings_count++;
+    }
+
+    /* A string containing the same trigram twice is only listed once. */
+    if (postings->count > 0 && postings->ids[postings->count - 1] == id)
+        return;
+
+    if (postings->count == postings->capacity) {
+        postings->capacity = postings->capacity ? postings->capacity * 2 : 4;
+        postings->ids = realloc(postings->ids, postings->capacity * sizeof(*postings->ids));
+        postings->offsets = realloc(postings->offsets, postings->capacity);
+    }
+
+    postings->ids[postings->count] = id;
+    postings->offsets[postings->count] = offset < TRIGRAM_OFFSET_MAX ? offset : TRIGRAM_OFFSET_MAX;
+    postings->count++;
+}
+
+/**
+ * @brief Adds a string to the index.
+ *
+ * @return The string's ID, which is the number of strings added before it.
+ */
+int trigram_index_add(struct trigram_index *index, const char *str)
+{
+    size_t len = strlen(str);
+
+    if (index->count == index->capacity) {
+        index->capacity = index->capacity ? index->capacity * 2 : 64;
+        index->offsets = realloc(index->offsets, index->capacity * sizeof(*index->offsets));
+        index->removed = realloc(index->removed, index->capacity * sizeof(*index->removed));
+    }
+    if (index->text_size + len + 1 > index->text_capacity) {
+        size_t capacity = index->text_capacity ? index->text_capacity : 4096;
+        while (index->text_size + len + 1 > capacity)
+            capacity *= 2;
+        index->text = realloc(index->text, capacity);
+        index->text_capacity = capacity;
+    }
+
+    int id = index->count++;
+    char *text = index->text + index->text_size;
+
+    index->offsets[id] = index->text_size;
+    index->removed[id] = false;
+    index->text_size += trigram_normalize(str, text, len + 1) + 1;
+
+    for (size_t i = 0; i + 3 <= len; ++i)
+        trigram_index_post(index, trigram_key(text + i), id, i);
+
+    return id;
+}
+
+/**
+ * @brief Removes a string from the index.
+ *
+ * The string's posting entries and text stay where they are, so this is O(1); searches
+ * just stop returning its ID. The space is reclaimed when the index is next cleared.
+ */
+void trigram_index_remove(struct trigram_index *index, int id)
+{
+    if (id < 0 || id >= index->count || index->removed[id])
+        return;
+
+    index->removed[id] = true;
+    index->removed_count++;
+}
+
+/**
+ * @brief Replaces a string in the index with a new one.
+ *
+ * @return The new string's ID. The old ID is no longer returned by searches.
+ */
+int trigram_index_replace(struct trigram_index *index, int id, const char *str)
+{
+    trigram_index_remove(index, id);
+    return trigram_index_add(index, str);
+}
+
+/**
+ * @brief Checks whether a string in the index contains a query.
+ *
+ * @param query A query that has already been normalized.
+ */
+static bool trigram_index_contains(struct trigram_index *index, int id, const char *query)
+{
+    return strstr(index->text + index->offsets[id], query) != NULL;
+}
+
+/**
+ * @brief Checks whether one string in the index matches a query.
+ *
+ * @return true if the string contains the query, false otherwise.
+ */
+bool trigram_index_match(struct trigram_index *index, int id, const char *query)
+{
+    char normalized[TRIGRAM_QUERY_MAX];
+
+    if (id < 0 || id >= index->count || index->removed[id])
+        return false;
+
+    trigram_normalize(query, normalized, sizeof(normalized));
+    return trigram_index_contains(index, id, normalized);
+}
+
+/**
+ * @brief Checks whether a sorted list of IDs contains an ID, starting from a hint.
+ *
+ * Candidates are checked in increasing order, so the search picks up where the last one
+ * left off and gallops forward from there.
+ *
+ * @param pos The position to start from. Updated to where the search stopped.
+ */
+static bool trigram_postings_contains(const struct trigram_postings *postings, int id, int *pos)
+{
+    int low = *pos;
+    int step = 1;
+
+    while (low + step < postings->count && postings->ids[low + step] < id) {
+        low += step;
+        step *= 2;
+    }
+
+    int high = (low + step < postings->count) ? low + step : postings->count - 1;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (postings->ids[mid] < id)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    *pos = low;
+    return low < postings->count && postings->ids[low] == id;
+}
+
+/**
+ * @brief Finds every string containing a query.
+ *
+ * Matching is case-insensitive for ASCII letters. An empty query matches everything.
+ *
+ * @param results Receives the matching IDs in increasing order. Must have room for every
+ *   string in the index.
+ * @return The number of matches.
+ */
+int trigram_index_search(struct trigram_index *index, const char *query, int *results)
+{
+    char normalized[TRIGRAM_QUERY_MAX];
+    size_t len = trigram_normalize(query, normalized, sizeof(normalized));
+    int found = 0;
+
+    if (len == 0) {
+        for (int id = 0; id < index->count; ++id) {
+            if (!index->removed[id])
+                results[found++] = id;
+        }
+        return found;
+    }
+    if (len < 3) {
+        for (int id = 0; id < index->count; ++id) {
+            if (!index->removed[id] && trigram_index_contains(index, id, normalized))
+                results[found++] = id;
+        }
+        return found;
+    }
+
+    /* Gather the query's posting lists. Any trigram that's never been seen rules out
+     * every string at once. */
+    const struct trigram_postings *lists[TRIGRAM_QUERY_MAX];
+    int list_count = 0;
+
+    for (size_t i = 0; i + 3 <= len; ++i) {
+        if (index->postings_capacity == 0)
+            return 0;
+
+        const struct trigram_postings *postings =
+            trigram_index_slot(index, trigram_key(normalized + i));
+        if (!postings->trigram || postings->count == 0)
+            return 0;
+
+        lists[list_count++] = postings;
+    }
+
+    /* A single trigram is its own match. */
+    if (list_count == 1) {
+        for (int i = 0; i < lists[0]->count; ++i) {
+            if (!index->removed[lists[0]->ids[i]])
+                results[found++] = lists[0]->ids[i];
+        }
+        return found;
+    }
+
+    /* Walk the shortest list and look each candidate up in the others. */
+    int shortest = 0;
+    for (int i = 1; i < list_count; ++i) {
+        if (lists[i]->count < lists[shortest]->count)
+            shortest = i;
+    }
+
+    int positions[TRIGRAM_QUERY_MAX] = {0};
+
+    for (int i = 0; i < lists[shortest]->count; ++i) {
+        int id = lists[shortest]->ids[i];
+        int start = lists[shortest]->offsets[i] - shortest;
+        bool candidate = !index->removed[id];
+        bool aligned = lists[shortest]->offsets[i] < TRIGRAM_OFFSET_MAX;
+
+        for (int j = 0; j < list_count && candidate; ++j) {
+            if (j == shortest)
+                continue;
+
+            candidate = trigram_postings_contains(lists[j], id, &positions[j]);
+            if (candidate && (lists[j]->offsets[positions[j]] >= TRIGRAM_OFFSET_MAX ||
+                              lists[j]->offsets[positions[j]] != start + j))
+                aligned = false;
+        }
+
+        /* Every trigram being present doesn't mean they're in the right order, unless
+         * they all first appear right where the query puts them. A clamped offset only
+         * says the trigram is somewhere past the limit, so it never counts as aligned. */
+        if (candidate && (aligned || trigram_index_contains(index, id, normalized)))
+            results[found++] = id;
+    }
+
+    return found;
+}
@@ -29,15 +29,16 @@
 #include <stdlib.h>
 #include <string.h>
 
-static enum command_type global_commands[] = {CMD_QUIT, CMD_PANEL_HELP, CMD_PANEL_QUEUE,
-                                              CMD_PANEL_LIBRARY, CMD_DB_UPDATE};
+static enum command_type global_commands[] = {CMD_QUIT,          CMD_PANEL_HELP, CMD_PANEL_QUEUE,
+                                              CMD_PANEL_LIBRARY, CMD_DB_UPDATE,  CMD_SEARCH};
 
 static enum command_type queue_panel_commands[] = {
     CMD_PLAY,           CMD_PAUSE,         CMD_STOP,        CMD_SEEK_BACKWARD, CMD_SEEK_FORWARD,
     CMD_PREV_SONG,      CMD_NEXT_SONG,     CMD_CURSOR_DOWN, CMD_CURSOR_UP,     CMD_CURSOR_PAGE_DOWN,
-    CMD_CURSOR_PAGE_UP, CMD_CURSOR_BOTTOM, CMD_CURSOR_TOP,  CMD_CURSOR_MIDDLE, CMD_RANDOM,
-    CMD_REPEAT,         CMD_SINGLE,        CMD_CONSUME,     CMD_CROSSFADE,     CMD_DELETE,
-    CMD_CLEAR,          CMD_VOL_DOWN,      CMD_VOL_UP};
+    CMD_CURSOR_PAGE_UP, CMD_CURSOR_BOTTOM, CMD_CURSOR_TOP,  CMD_CURSOR_MIDDLE, CMD_CURSOR_FIRST,
+    CMD_CURSOR_LAST,    CMD_RANDOM,        CMD_REPEAT,      CMD_SINGLE,        CMD_CONSUME,
+    CMD_CROSSFADE,      CMD_DELETE,        CMD_CLEAR,       CMD_VOL_DOWN,      CMD_VOL_UP,
+    CMD_JUMP_PLAYING,   CMD_FOLLOW_PLAYING};
 
 void draw_help_screen(WINDOW *win)
 {
@@ -90,14 +91,10 @@ void draw_command_info(WINDOW *win, int begin_y, enum command_type cmd)
     int colon_pos = 17;
 
     char *desc = get_command_desc(cmd);
-    char *keys = malloc(16 * sizeof(char));
-    get_command_keys(cmd, keys);
+    const char *keys = get_command_keys(cmd);
 
     wmove(win, begin_y, colon_pos - strlen(keys) - 1);
     waddstr(win, keys);
     waddstr(win, " : ");
     waddstr(win, desc);
-
-    if (keys)
-        free(keys);
 }
@@ -24,502 +24,849 @@
 #include "playlist.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#include "pantomime/intern.h"
 
 /**
- * @brief Creates a new item to use in a playlist.
+ * @brief Fills in a playlist row with a queue song's information.
  *
- * @param artist The song's artist.
- * @param title  The song's title.
- * @param album  The song's album.
- * @param time   The song's length in seconds.
- * @param id     The song's MPD id.
- * @return       Pointer to a playlist item, or NULL on error.
+ * The row's title points into the song, so it's only valid as long as the song is.
  */
-struct playlist_item *playlist_item_init(char *artist, char *title, char *album, int time,
-                                         unsigned id)
+void playlist_row_from_song(struct playlist_row *row, const struct queue_song *song)
 {
-    struct playlist_item *item = malloc(sizeof(*item));
-    if (!item)
-        return NULL;
-
-    item->artist = artist;
-    item->title = title;
-    item->album = album;
-    item->time = time;
-    item->id = id;
+    row->artist = intern_string(song->artist_id);
+    row->title = song->title ? song->title : "";
+    row->album = intern_string(song->album_id);
+    row->time = song->duration;
+    row->id = song->id;
+}
 
-    item->bold = 0;
-    item->highlight = 0;
+/**
+ * @brief Creates a new playlist UI that draws on the specified window.
+ *
+ * @param win    The ncurses window to draw the playlist on.
+ * @param source The callbacks that supply the playlist's rows.
+ * @param data   Passed as the first argument to each of the source's callbacks.
+ * @return       Pointer to a new playlist struct, or NULL on error.
+ */
+struct playlist *playlist_init(WINDOW *win, const struct playlist_source *source, void *data)
+{
+    struct playlist *playlist = malloc(sizeof(*playlist));
+    if (!playlist)
+        return NULL;
 
-    item->prev = NULL;
-    item->next = NULL;
+    playlist->win = win;
+    playlist->source = source;
+    playlist->source_data = data;
+
+    playlist->search = trigram_index_new();
+    playlist->search_rows = NULL;
+    playlist->search_rows_capacity = 0;
+    playlist->search_slots = NULL;
+    playlist->search_slot_count = 0;
+    playlist->search_live = 0;
+    playlist->search_stale = true;
+
+    playlist->name_search = trigram_index_new();
+    playlist->name_ids = NULL;
+    playlist->name_ids_capacity = 0;
+    playlist->names = NULL;
+    playlist->name_count = 0;
+    playlist->name_live = 0;
+
+    playlist->hits = NULL;
+    playlist->hits_capacity = 0;
+    playlist->shown = NULL;
+    playlist->shown_words = 0;
+    playlist->filter = NULL;
+    playlist->matches = NULL;
+    playlist->match_count = 0;
+    playlist->match_capacity = 0;
+
+    viewport_initialize(&playlist->viewport, getmaxy(win) - 1); /* -1 for the header row */
+    viewport_damage_all(&playlist->damage);
+    playlist->drawn_playing_id = 0;
+    playlist_sync(playlist);
 
-    return item;
+    return playlist;
 }
 
 /**
- * @brief Frees memory allocated by a playlist item.
+ * @brief Frees memory allocated by a playlist UI.
  */
-void playlist_item_free(struct playlist_item *item)
+void playlist_free(struct playlist *playlist)
 {
-    if (!item)
-        return;
+    trigram_index_free(playlist->search);
+    free(playlist->search_rows);
+    free(playlist->search_slots);
+
+    trigram_index_free(playlist->name_search);
+    free(playlist->name_ids);
+    for (int i = 0; i < playlist->name_count; ++i)
+        free(playlist->names[i].rows);
+    free(playlist->names);
+
+    free(playlist->hits);
+    free(playlist->shown);
+    free(playlist->filter);
+    free(playlist->matches);
+    free(playlist);
+}
 
-    free(item->artist);
-    free(item->title);
-    free(item->album);
-    free(item);
+static size_t playlist_hash_id(unsigned id)
+{
+    return (size_t)(id * 2654435761u);
 }
 
 /**
- * @brief Creates a new (empty) playlist UI that draws on the specified window.
+ * @brief Finds the slot holding the indexed row with an MPD ID.
  *
- * @param win The ncurses window to draw the playlist on.
- * @return    Pointer to a new playlist struct, or NULL on error.
+ * @return The slot, or -1 if the row isn't in the index.
  */
-struct playlist *playlist_init(WINDOW *win)
+static int playlist_find_indexed(struct playlist *playlist, unsigned id)
 {
-    struct playlist *playlist = malloc(sizeof(*playlist));
-    if (!playlist)
-        return NULL;
+    if (playlist->search_slot_count == 0)
+        return -1;
 
-    playlist->win = win;
+    size_t mask = playlist->search_slot_count - 1;
+    size_t slot = playlist_hash_id(id) & mask;
 
-    playlist->head = NULL;
-    playlist->tail = NULL;
-    playlist->selected = NULL;
+    while (playlist->search_slots[slot]) {
+        if (playlist->search_rows[playlist->search_slots[slot] - 1].id == id)
+            return slot;
+        slot = (slot + 1) & mask;
+    }
 
-    playlist->top_visible = NULL;
-    playlist->bottom_visible = NULL;
+    return -1;
+}
 
-    playlist->length = 0;
-    playlist->idx_last_top = -1;
-    playlist->idx_selected = -1;
-    playlist->max_visible = getmaxy(win) - 1; /* -1 to account for header row */
+/**
+ * @brief Points a free slot at a string in the index, keyed by the string's MPD ID.
+ */
+static void playlist_insert_slot(struct playlist *playlist, int string)
+{
+    size_t mask = playlist->search_slot_count - 1;
+    size_t slot = playlist_hash_id(playlist->search_rows[string].id) & mask;
 
-    return playlist;
+    while (playlist->search_slots[slot])
+        slot = (slot + 1) & mask;
+    playlist->search_slots[slot] = string + 1;
 }
 
 /**
- * @brief Frees memory allocated by a playlist UI.
+ * @brief Empties a slot, shifting back later entries so no lookup stops short of them.
  */
-void playlist_free(struct playlist *playlist)
+static void playlist_remove_slot(struct playlist *playlist, size_t slot)
 {
-    playlist_clear(playlist);
-    free(playlist);
+    size_t mask = playlist->search_slot_count - 1;
+    size_t next = slot;
+
+    playlist->search_slots[slot] = 0;
+    while (playlist->search_slots[next = (next + 1) & mask]) {
+        size_t home = playlist_hash_id(playlist->search_rows[playlist->search_slots[next] - 1].id);
+
+        /* An entry can only fill the gap if the gap lies between its home and where it is. */
+        if (((next - (home & mask)) & mask) >= ((next - slot) & mask)) {
+            playlist->search_slots[slot] = playlist->search_slots[next];
+            playlist->search_slots[next] = 0;
+            slot = next;
+        }
+    }
 }
 
 /**
- * @brief Adds an item to the end of a playlist.
+ * @brief Sizes the slot table for a number of rows and refills it from the index.
+ *
+ * @return true on success, or false if memory couldn't be allocated.
  */
-void playlist_append(struct playlist *playlist, struct playlist_item *item)
+static bool playlist_resize_slots(struct playlist *playlist, int rows)
 {
-    if (!playlist || !item)
-        return;
+    int slot_count = PLAYLIST_MIN_SLOTS;
+    while (slot_count < 2 * (rows + 1))
+        slot_count *= 2;
 
-    if (!playlist->head) {
-        playlist->head = item;
-        playlist->selected = item;
-        playlist->top_visible = item;
-        playlist->bottom_visible = item;
-        playlist->idx_selected = 0;
-    }
-    else {
-        struct playlist_item *tmp = playlist->tail;
-        tmp->next = item;
-        item->prev = tmp;
+    int *slots = calloc(slot_count, sizeof(*slots));
+    if (!slots)
+        return false;
+
+    free(playlist->search_slots);
+    playlist->search_slots = slots;
+    playlist->search_slot_count = slot_count;
+
+    for (int i = 0; i < playlist->search->count; ++i) {
+        if (!playlist->search->removed[i])
+            playlist_insert_slot(playlist, i);
     }
 
-    playlist->tail = item;
-    playlist->length++;
+    return true;
 }
 
 /**
- * @brief Removes the currently selected song from the playlist.
+ * @brief Adds a row to the list of rows with an artist or album name.
  *
- * This function removes the selected song's entry from the playlist display.
- * This is meant to be used alongside mpdwrapper_delete_from_queue(), which
- * tells the MPD connection to remove the song on the back-end.
+ * A name gets a string in the name index when its first row is added.
  *
- * @return True on success, or false on error.
+ * @param string The row's string in the title index.
+ * @param pos Set to where the row was put in the name's list.
+ * @return true on success, or false if memory couldn't be allocated.
  */
-bool playlist_remove_selected(struct playlist *playlist)
+static bool playlist_name_add(struct playlist *playlist, unsigned id, int string, int *pos)
 {
-    if (!playlist->head)
-        return false;
+    if (id >= (unsigned)playlist->name_count) {
+        int count = playlist->name_count ? playlist->name_count : PLAYLIST_MIN_NAMES;
+        while ((unsigned)count <= id)
+            count *= 2;
+
+        struct playlist_name *names = realloc(playlist->names, count * sizeof(*names));
+        if (!names)
+            return false;
+
+        memset(&names[playlist->name_count], 0, (count - playlist->name_count) * sizeof(*names));
+        playlist->names = names;
+        playlist->name_count = count;
+    }
 
-    if (playlist->selected == playlist->head) {
-        if (!playlist->head->next) /* Only one song in the list */
-            playlist_clear(playlist);
-        else {
-            struct playlist_item *current = playlist->head;
-            playlist_select_next(playlist);
-            playlist->top_visible = playlist->selected;
-            playlist_find_bottom(playlist);
-            playlist->head->prev = NULL;
-
-            playlist_item_free(current);
-            playlist->head = playlist->selected;
-        }
-        playlist->length--;
-        playlist->idx_selected = 0;
+    struct playlist_name *name = &playlist->names[id];
+
+    if (name->count == name->capacity) {
+        int capacity = name->capacity ? name->capacity * 2 : PLAYLIST_MIN_NAME_ROWS;
+        int *rows = realloc(name->rows, capacity * sizeof(*rows));
+        if (!rows)
+            return false;
+
+        name->rows = rows;
+        name->capacity = capacity;
     }
-    else {
-        struct playlist_item *current = playlist->selected;
 
-        if (current->next)
-            playlist_select_next(playlist);
-        else
-            playlist_select_prev(playlist);
+    if (!name->string) {
+        int name_string = trigram_index_add(playlist->name_search, intern_string(id));
 
-        if (current == playlist->top_visible)
-            playlist->top_visible = playlist->selected;
-        if (current == playlist->tail) {
-            playlist->tail = playlist->tail->prev;
-            playlist->idx_selected++; /* Fixes weird off-by-one error */
-        }
+        if (name_string >= playlist->name_ids_capacity) {
+            int capacity = playlist->name_search->capacity;
+            unsigned *ids = realloc(playlist->name_ids, capacity * sizeof(*ids));
+            if (!ids) {
+                trigram_index_remove(playlist->name_search, name_string);
+                return false;
+            }
 
-        if (current->prev)
-            current->prev->next = current->next;
-        if (current->next)
-            current->next->prev = current->prev;
+            playlist->name_ids = ids;
+            playlist->name_ids_capacity = capacity;
+        }
 
-        playlist_item_free(current);
-        playlist->length--;
-        playlist->idx_selected--;
-        playlist_find_bottom(playlist);
+        playlist->name_ids[name_string] = id;
+        name->string = name_string + 1;
+        playlist->name_live++;
     }
 
+    *pos = name->count;
+    name->rows[name->count++] = string;
     return true;
 }
 
 /**
- * @brief Populates the playlist UI with info from a [songlist](@ref songlist.h).
+ * @brief Takes a row out of the list of rows with an artist or album name.
+ *
+ * The last row in the list fills the gap. A name left without rows leaves the name index.
+ *
+ * @param pos Where the row is in the name's list.
+ */
+static void playlist_name_remove(struct playlist *playlist, unsigned id, int pos)
+{
+    struct playlist_name *name = &playlist->names[id];
+    int last = --name->count;
+
+    if (pos != last) {
+        int moved = name->rows[last];
+        struct playlist_entry *entry = &playlist->search_rows[moved];
+
+        /* A row whose artist and album are the same name is in the list twice. */
+        name->rows[pos] = moved;
+        if (entry->artist_id == id && entry->artist_pos == last)
+            entry->artist_pos = pos;
+        else
+            entry->album_pos = pos;
+    }
+
+    if (name->count == 0) {
+        trigram_index_remove(playlist->name_search, name->string - 1);
+        name->string = 0;
+        playlist->name_live--;
+    }
+}
+
+/**
+ * @brief Takes an indexed row's string out of its artist's and album's lists of rows.
+ */
+static void playlist_unlist_row(struct playlist *playlist, int string)
+{
+    struct playlist_entry *entry = &playlist->search_rows[string];
+
+    playlist_name_remove(playlist, entry->artist_id, entry->artist_pos);
+    playlist_name_remove(playlist, entry->album_id, entry->album_pos);
+}
+
+/**
+ * @brief Puts a row in the search index, replacing the entry it had there.
+ *
+ * @param artist_id The row's interned artist, from the source's columns.
+ * @param album_id The row's interned album, from the source's columns.
+ * @param old The row's string in the index, or -1 if it doesn't have one.
+ * @return true on success, or false if memory couldn't be allocated.
  */
-void playlist_populate(struct playlist *playlist, struct songlist *songlist)
+static bool playlist_index_row(struct playlist *playlist, const struct playlist_row *row,
+                               unsigned artist_id, unsigned album_id, int old)
 {
-    struct playlist_item *item;
-    struct mpd_song *song;
-    char *artist;
-    char *title;
-    char *album;
-    int time;
-    unsigned id;
+    if (old >= 0)
+        playlist_unlist_row(playlist, old);
 
-    int length = songlist_get_size(songlist);
-    for (int i = 0; i < length; ++i) {
-        song = songlist_at(songlist, i);
+    int string = (old >= 0) ? trigram_index_replace(playlist->search, old, row->title)
+                            : trigram_index_add(playlist->search, row->title);
 
-        artist = mpdwrapper_get_song_tag(song, MPD_TAG_ARTIST);
-        title = mpdwrapper_get_song_tag(song, MPD_TAG_TITLE);
-        album = mpdwrapper_get_song_tag(song, MPD_TAG_ALBUM);
-        time = mpd_song_get_duration(song);
-        id = mpd_song_get_id(song);
+    if (string >= playlist->search_rows_capacity) {
+        int capacity = playlist->search->capacity;
+        struct playlist_entry *rows = realloc(playlist->search_rows, capacity * sizeof(*rows));
+        if (!rows)
+            return false;
 
-        item = playlist_item_init(artist, title, album, time, id);
-        playlist_append(playlist, item);
+        playlist->search_rows = rows;
+        playlist->search_rows_capacity = capacity;
     }
 
-    playlist_restore_last_top(playlist);
-    playlist_set_selected(playlist, playlist->idx_last_selected);
-    if (playlist->selected)
-        playlist->selected->highlight = 1;
-    playlist_find_bottom(playlist);
+    struct playlist_entry *entry = &playlist->search_rows[string];
+
+    entry->id = row->id;
+    entry->artist_id = artist_id;
+    entry->album_id = album_id;
+    if (!playlist_name_add(playlist, artist_id, string, &entry->artist_pos))
+        return false;
+    if (!playlist_name_add(playlist, album_id, string, &entry->album_pos))
+        return false;
+
+    if (old < 0)
+        playlist->search_live++;
+
+    /* Growing the table refills it from the index, which already holds the new string. */
+    if (2 * (playlist->search_live + 1) > playlist->search_slot_count)
+        return playlist_resize_slots(playlist, playlist->search_live);
+
+    playlist_insert_slot(playlist, string);
+    return true;
 }
 
 /**
- * @brief Removes all items from the playlist UI.
+ * @brief Rebuilds the search index from every row in the data source.
+ *
+ * Titles go in the trigram index. Each distinct artist and album goes in a second,
+ * much smaller, trigram index, with a list of the rows that have it, so a filter
+ * only reaches the rows of the names it matches.
  */
-void playlist_clear(struct playlist *playlist)
+static void playlist_index_rows(struct playlist *playlist)
 {
-    struct playlist_item *current = playlist->head;
-    struct playlist_item *next;
+    struct queue_columns columns;
+    playlist->source->columns(playlist->source_data, &columns);
+
+    int length = playlist->source->length(playlist->source_data);
+    struct playlist_row row;
+
+    trigram_index_clear(playlist->search);
+    trigram_index_clear(playlist->name_search);
+    for (int i = 0; i < playlist->name_count; ++i) {
+        playlist->names[i].count = 0;
+        playlist->names[i].string = 0;
+    }
+    playlist->search_live = 0;
+    playlist->name_live = 0;
+    playlist->search_stale = true;
+
+    if (!playlist_resize_slots(playlist, length))
+        return;
 
-    int idx = 0;
-    while (current) {
-        if (current == playlist->top_visible)
-            playlist->idx_last_top = idx;
-        next = current->next;
-        playlist_item_free(current);
-        current = next;
-        ++idx;
+    for (int i = 0; i < length && i < columns.count; ++i) {
+        if (!playlist->source->row_at(playlist->source_data, i, &row))
+            continue;
+        if (!playlist_index_row(playlist, &row, columns.artist_ids[i], columns.album_ids[i], -1))
+            return;
     }
 
-    playlist->head = NULL;
-    playlist->tail = NULL;
-    playlist->selected = NULL;
-    playlist->top_visible = NULL;
-    playlist->bottom_visible = NULL;
-    playlist->length = 0;
-    playlist->idx_last_selected = playlist->idx_selected;
-    playlist->idx_selected = -1;
+    playlist->search_stale = false;
 }
 
 /**
- * @brief Set the item at the specified index as the currently selected item.
+ * @brief Brings the search index up to date with the data source.
+ *
+ * Rows are indexed by MPD ID rather than by position, so rows that only moved keep their
+ * entries, and only the rows the source reports as changed are re-indexed. The indexes
+ * are rebuilt once removed strings outnumber the live ones, which keeps their size
+ * proportional to the playlist.
  */
-void playlist_set_selected(struct playlist *playlist, int idx)
+static void playlist_update_index(struct playlist *playlist)
 {
-    if (idx < 0 || idx >= playlist->length)
+    const unsigned *ids = NULL;
+    int count = 0;
+    bool listed = playlist->source->take_changes &&
+                  playlist->source->take_changes(playlist->source_data, &ids, &count);
+
+    if (playlist->search_stale || !listed) {
+        playlist_index_rows(playlist);
         return;
+    }
 
-    struct playlist_item *current = playlist->head;
-    for (int i = 0; i < idx; ++i)
-        current = current->next;
+    struct queue_columns columns;
+    struct playlist_row row;
 
-    playlist->selected = current;
-    playlist->idx_selected = idx;
-    current->highlight = 1;
+    playlist->source->columns(playlist->source_data, &columns);
 
-    current = current->next;
-    while (current) {
-        current->highlight = 0;
-        current = current->next;
+    for (int i = 0; i < count; ++i) {
+        int slot = playlist_find_indexed(playlist, ids[i]);
+        int old = (slot >= 0) ? playlist->search_slots[slot] - 1 : -1;
+        int index = playlist->source->find_id(playlist->source_data, ids[i]);
+
+        if (slot >= 0)
+            playlist_remove_slot(playlist, slot);
+
+        if (index >= 0 && index < columns.count &&
+            playlist->source->row_at(playlist->source_data, index, &row)) {
+            if (!playlist_index_row(playlist, &row, columns.artist_ids[index],
+                                    columns.album_ids[index], old)) {
+                playlist->search_stale = true;
+                return;
+            }
+        }
+        else if (old >= 0) {
+            playlist_unlist_row(playlist, old);
+            trigram_index_remove(playlist->search, old);
+            playlist->search_live--;
+        }
     }
+
+    if (playlist->search->removed_count > playlist->search_live + PLAYLIST_REMOVED_SLACK ||
+        playlist->name_search->removed_count > playlist->name_live + PLAYLIST_REMOVED_SLACK)
+        playlist_index_rows(playlist);
 }
 
 /**
- * @brief Selects the previous item in the playlist.
+ * @brief Makes sure the filter's scratch space fits the indexes and the rows.
+ *
+ * The space is kept between filters, so typing a search doesn't allocate.
+ *
+ * @return true on success, or false if memory couldn't be allocated.
  */
-void playlist_select_prev(struct playlist *playlist)
+static bool playlist_reserve_filter(struct playlist *playlist, int length)
 {
-    if (!playlist || playlist->selected == playlist->head)
-        return;
+    int hits = playlist->search->count + playlist->name_search->count + 2;
+    int words = (length + 63) / 64;
+
+    if (hits > playlist->hits_capacity) {
+        int *buffer = realloc(playlist->hits, hits * sizeof(*buffer));
+        if (!buffer)
+            return false;
+
+        playlist->hits = buffer;
+        playlist->hits_capacity = hits;
+    }
+
+    if (words > playlist->shown_words) {
+        uint64_t *shown = realloc(playlist->shown, words * sizeof(*shown));
+        if (!shown)
+            return false;
 
-    struct playlist_item *current = playlist->selected;
-    current->highlight = 0;
-    if (current == playlist->top_visible) {
-        playlist->top_visible = current->prev;
-        playlist_find_bottom(playlist);
+        memset(&shown[playlist->shown_words], 0, (words - playlist->shown_words) * sizeof(*shown));
+        playlist->shown = shown;
+        playlist->shown_words = words;
     }
 
-    current = current->prev;
-    current->highlight = 1;
+    if (length + 1 > playlist->match_capacity) {
+        int *matches = realloc(playlist->matches, (length + 1) * sizeof(*matches));
+        if (!matches)
+            return false;
+
+        playlist->matches = matches;
+        playlist->match_capacity = length + 1;
+    }
 
-    playlist->selected = playlist->selected->prev;
-    playlist->idx_selected--;
+    return true;
 }
 
 /**
- * @brief Selects the next item in the playlist.
+ * @brief Marks the row with an MPD ID as shown, if it's one of the rows in columns.
+ *
+ * Strings are added to the index in row order, so a run of matches is usually a run of
+ * rows. The row after the last one found is checked before looking the ID up.
+ *
+ * @param next The row to check first. Set to the row after the one found.
  */
-void playlist_select_next(struct playlist *playlist)
+static void playlist_show_id(struct playlist *playlist, const struct queue_columns *columns,
+                             unsigned id, int *next)
 {
-    if (!playlist || playlist->selected == playlist->tail)
+    int index = *next;
+
+    if (index < 0 || index >= columns->count || columns->ids[index] != id)
+        index = playlist->source->find_id(playlist->source_data, id);
+    if (index < 0 || index >= columns->count)
         return;
 
-    struct playlist_item *current = playlist->selected;
-    current->highlight = 0;
-    if (current == playlist->bottom_visible && current->next) {
-        playlist->top_visible = playlist->top_visible->next;
-        playlist_find_bottom(playlist);
-    }
+    playlist->shown[index / 64] |= (uint64_t)1 << (index % 64);
+    *next = index + 1;
+}
 
-    current = current->next;
-    current->highlight = 1;
+/**
+ * @brief Checks whether a row is marked as shown.
+ */
+static bool playlist_is_shown(struct playlist *playlist, int index)
+{
+    return (playlist->shown[index / 64] >> (index % 64)) & 1;
+}
 
-    playlist->selected = playlist->selected->next;
-    playlist->idx_selected++;
+/**
+ * @brief Checks whether an interned name was found to contain the filter.
+ */
+static bool playlist_name_matched(struct playlist *playlist, unsigned id)
+{
+    return id < (unsigned)playlist->name_count && playlist->names[id].matched;
 }
 
 /**
- * @brief Sets the first visible item in the window as the selected item.
+ * @brief Finds the rows whose title, artist or album contains the filter.
+ *
+ * Titles, artists and albums are each looked up in a trigram index. The rows behind the
+ * matching titles and names are then marked in a bitmap, and read back in order. A
+ * filter matching names that cover much of the playlist, such as a single letter,
+ * checks each row's artist and album instead, since that's cheaper than finding every
+ * row by ID.
  */
-void playlist_select_top_visible(struct playlist *playlist)
+static void playlist_apply_filter(struct playlist *playlist)
 {
-    if (!playlist || playlist->selected == playlist->top_visible)
+    playlist_update_index(playlist);
+    playlist->match_count = 0;
+
+    struct queue_columns columns;
+    playlist->source->columns(playlist->source_data, &columns);
+
+    int length = columns.count;
+    if (playlist->search_stale || !playlist_reserve_filter(playlist, length))
         return;
 
-    struct playlist_item *current = playlist->selected;
-    current->highlight = 0;
+    int *titles = playlist->hits;
+    int *names = playlist->hits + playlist->search->count + 1;
+    int title_count = trigram_index_search(playlist->search, playlist->filter, titles);
+    int name_count = trigram_index_search(playlist->name_search, playlist->filter, names);
+    long named_rows = 0;
+
+    for (int i = 0; i < name_count; ++i)
+        named_rows += playlist->names[playlist->name_ids[names[i]]].count;
+
+    /* The index is keyed by MPD ID, so each matching row is found by ID in the source. */
+    int next = 0;
+    for (int i = 0; i < title_count; ++i)
+        playlist_show_id(playlist, &columns, playlist->search_rows[titles[i]].id, &next);
+
+    if (named_rows > length / PLAYLIST_SCAN_RATIO) {
+        for (int i = 0; i < name_count; ++i)
+            playlist->names[playlist->name_ids[names[i]]].matched = true;
+
+        for (int i = 0; i < length; ++i) {
+            if (playlist_is_shown(playlist, i) ||
+                playlist_name_matched(playlist, columns.artist_ids[i]) ||
+                playlist_name_matched(playlist, columns.album_ids[i]))
+                playlist->matches[playlist->match_count++] = i;
+        }
 
-    while (current != playlist->top_visible) {
-        current = current->prev;
-        playlist->idx_selected--;
+        for (int i = 0; i < name_count; ++i)
+            playlist->names[playlist->name_ids[names[i]]].matched = false;
+        memset(playlist->shown, 0, ((length + 63) / 64) * sizeof(*playlist->shown));
+        return;
     }
 
-    current->highlight = 1;
-    playlist->selected = current;
+    for (int i = 0; i < name_count; ++i) {
+        struct playlist_name *name = &playlist->names[playlist->name_ids[names[i]]];
+
+        for (int j = 0; j < name->count; ++j)
+            playlist_show_id(playlist, &columns, playlist->search_rows[name->rows[j]].id, &next);
+    }
+
+    /* Reading the bitmap back lists the rows in order, and leaves it clear. */
+    for (int w = 0; w < (length + 63) / 64; ++w) {
+        uint64_t word = playlist->shown[w];
+
+        for (int bit = 0; word; ++bit, word >>= 1) {
+            if (word & 1)
+                playlist->matches[playlist->match_count++] = w * 64 + bit;
+        }
+        playlist->shown[w] = 0;
+    }
 }
 
 /**
- * @brief Sets the last visible item in the window as the selected item.
+ * @brief Updates the playlist UI to match its data source.
+ *
+ * Nothing is copied from the source, so this only has to re-read the number of rows.
+ * The selection and scroll position are kept where possible. The search index is
+ * updated right away if a filter is set, and otherwise the next time one is.
  */
-void playlist_select_bottom_visible(struct playlist *playlist)
+void playlist_sync(struct playlist *playlist)
 {
-    if (!playlist || playlist->selected == playlist->bottom_visible)
-        return;
+    if (!playlist->source->take_changes)
+        playlist->search_stale = true;
+    viewport_damage_all(&playlist->damage);
+
+    if (playlist->filter) {
+        playlist_apply_filter(playlist);
+        viewport_set_length(&playlist->viewport, playlist->match_count);
+    }
+    else
+        viewport_set_length(&playlist->viewport, playlist->source->length(playlist->source_data));
+}
+
+/**
+ * @brief Shows only the rows whose artist, title, or album contain some text.
+ *
+ * Matching ignores ASCII case. Rows are found through the playlist's search index,
+ * so this is fast enough to run on every keystroke, even for very long playlists.
+ *
+ * @param filter The text to search for, or NULL or an empty string to show every row.
+ */
+void playlist_filter(struct playlist *playlist, const char *filter)
+{
+    free(playlist->filter);
+    playlist->filter = NULL;
 
-    struct playlist_item *current = playlist->selected;
-    current->highlight = 0;
+    viewport_initialize(&playlist->viewport, playlist->viewport.height);
+    viewport_damage_all(&playlist->damage);
 
-    while (current != playlist->bottom_visible) {
-        current = current->next;
-        playlist->idx_selected++;
+    if (filter && filter[0] != '\0') {
+        playlist->filter = strdup(filter);
+        playlist_apply_filter(playlist);
+        viewport_set_length(&playlist->viewport, playlist->match_count);
     }
+    else
+        viewport_set_length(&playlist->viewport, playlist->source->length(playlist->source_data));
+}
 
-    current->highlight = 1;
-    playlist->selected = current;
+/**
+ * @brief Gets the text the playlist is filtered by.
+ *
+ * @return The filter, or NULL if every row is shown.
+ */
+const char *playlist_get_filter(struct playlist *playlist)
+{
+    return playlist->filter;
 }
 
 /**
- * @brief Sets the item in the middle of the window as the selected item.
+ * @brief Makes the next draw repaint the whole playlist, such as after it's been covered up.
  */
-void playlist_select_middle_visible(struct playlist *playlist)
+void playlist_invalidate(struct playlist *playlist)
 {
-    if (!playlist || playlist->length == 0)
-        return;
+    viewport_damage_all(&playlist->damage);
+}
 
-    int midpoint = playlist->max_visible / 2;
+/**
+ * @brief Finds where a row shown in the playlist is in the data source.
+ *
+ * @param index The row's index among the rows shown.
+ * @return The row's index in the data source, or -1 if there is no such row.
+ */
+static int playlist_source_index(struct playlist *playlist, int index)
+{
+    if (index < 0 || index >= playlist->viewport.length)
+        return -1;
 
-    playlist_select_top_visible(playlist);
-    for (int i = 0; i < midpoint; ++i)
-        playlist_select_next(playlist);
+    return playlist->filter ? playlist->matches[index] : index;
 }
 
 /**
- * @brief Scrolls up one page in the playlist.
+ * @brief Finds where the song with an MPD ID is among the rows shown.
+ *
+ * The source finds the song's row by ID in constant time. While filtering, the matches
+ * are in source order, so they're binary searched for it.
+ *
+ * @return The row's index among the rows shown, or -1 if the song isn't shown.
  */
-void playlist_scroll_page_up(struct playlist *playlist)
+static int playlist_find_id(struct playlist *playlist, unsigned id)
 {
-    if (!playlist || playlist->length == 0)
-        return;
+    int source_index = playlist->source->find_id(playlist->source_data, id);
 
-    /* For restoring the cursor position, if necessary. */
-    int y_pos = playlist_find_cursor_pos(playlist);
+    if (source_index < 0 || !playlist->filter)
+        return source_index < playlist->viewport.length ? source_index : -1;
 
-    playlist_select_top_visible(playlist);
-    if (!playlist->selected->prev)
-        return;
+    int low = 0;
+    int high = playlist->match_count;
 
-    for (int i = 0; i <= playlist->max_visible - 1; ++i)
-        playlist_select_prev(playlist);
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (playlist->matches[mid] < source_index)
+            low = mid + 1;
+        else
+            high = mid;
+    }
 
-    /* Restore cursor position */
-    for (int i = 0; i < y_pos; ++i)
-        playlist_select_next(playlist);
+    return (low < playlist->match_count && playlist->matches[low] == source_index) ? low : -1;
 }
 
 /**
- * @brief Scrolls down one page in the playlist.
+ * @brief Reads a row shown in the playlist from the data source.
+ *
+ * @param index The row's index among the rows shown.
+ * @return true on success, or false if there is no such row.
  */
-void playlist_scroll_page_down(struct playlist *playlist)
+bool playlist_get_row(struct playlist *playlist, int index, struct playlist_row *row)
 {
-    if (!playlist || playlist->length == 0)
-        return;
+    int source_index = playlist_source_index(playlist, index);
+    if (source_index < 0)
+        return false;
 
-    /* For restoring cursor position, if necessary. */
-    int y_pos = playlist_find_cursor_pos(playlist);
+    return playlist->source->row_at(playlist->source_data, source_index, row);
+}
 
-    playlist_select_bottom_visible(playlist);
-    if (!playlist->selected->next)
-        return;
+/**
+ * @brief Reads the currently selected row from the data source.
+ *
+ * @return true on success, or false if nothing is selected.
+ */
+bool playlist_get_selected_row(struct playlist *playlist, struct playlist_row *row)
+{
+    return playlist_get_row(playlist, playlist->viewport.selected, row);
+}
 
-    playlist_select_next(playlist);
-    playlist->top_visible = playlist->selected;
-    playlist_find_bottom(playlist);
+/**
+ * @brief Gets the selected row's index in the data source, such as its queue position.
+ *
+ * @return The index, or -1 if nothing is selected.
+ */
+int playlist_get_selected_pos(struct playlist *playlist)
+{
+    return playlist_source_index(playlist, playlist->viewport.selected);
+}
 
-    /* Restore cursor position */
-    playlist_select_top_visible(playlist);
-    for (int i = 0; i < y_pos; ++i)
-        playlist_select_next(playlist);
+/**
+ * @brief Gets a row's index in the data source, which differs from the row's index
+ * while filtering.
+ *
+ * @return The index, or -1 if there is no such row.
+ */
+int playlist_get_pos(struct playlist *playlist, int index)
+{
+    return playlist_source_index(playlist, index);
 }
 
 /**
- * @brief Calculates which playlist item is the bottommost visible.
+ * @brief Set the item at the specified index as the currently selected item.
  */
-void playlist_find_bottom(struct playlist *playlist)
+void playlist_set_selected(struct playlist *playlist, int idx)
 {
-    if (!playlist || !playlist->head)
+    if (idx < 0 || idx >= playlist->viewport.length)
         return;
 
-    int rows = getmaxy(playlist->win);
-    struct playlist_item *current = playlist->top_visible;
-
-    for (int i = 0; i < rows - 2; ++i) {
-        if (!current->next)
-            break;
-        current = current->next;
-    }
-    playlist->bottom_visible = current;
+    viewport_select(&playlist->viewport, idx);
 }
 
 /**
- * @brief Finds the y-position of the cursor in the window.
+ * @brief Selects the row of the song with the given MPD ID, scrolling to it if needed.
+ *
+ * @return true if the song was found, or false if it isn't shown.
  */
-int playlist_find_cursor_pos(struct playlist *playlist)
+bool playlist_select_id(struct playlist *playlist, unsigned id)
 {
-    if (!playlist->top_visible)
-        return -1;
+    int index = playlist_find_id(playlist, id);
+    if (index < 0)
+        return false;
 
-    struct playlist_item *current = playlist->top_visible;
-    int i = 0;
+    viewport_select(&playlist->viewport, index);
+    return true;
+}
 
-    while (current != playlist->selected) {
-        ++i;
-        current = current->next;
-    }
+/**
+ * @brief Selects the previous item in the playlist.
+ */
+void playlist_select_prev(struct playlist *playlist)
+{
+    viewport_select_prev(&playlist->viewport);
+}
 
-    return i;
+/**
+ * @brief Selects the next item in the playlist.
+ */
+void playlist_select_next(struct playlist *playlist)
+{
+    viewport_select_next(&playlist->viewport);
 }
 
-void playlist_restore_last_top(struct playlist *playlist)
+/**
+ * @brief Moves the selection down a number of items, or up if the count is negative.
+ */
+void playlist_move(struct playlist *playlist, int count)
 {
-    if (playlist->idx_last_top < 0)
-        playlist->top_visible = playlist->head;
-    else
-        playlist->top_visible = playlist_at(playlist, playlist->idx_last_top);
+    viewport_move(&playlist->viewport, count);
 }
 
 /**
- * @brief Finds the playlist item at the given index.
- *
- * @param playlist The playlist to search.
- * @param idx The index to check.
- * @return struct playlist_item*
+ * @brief Sets the first visible item in the window as the selected item.
  */
-struct playlist_item *playlist_at(struct playlist *playlist, int index)
+void playlist_select_top_visible(struct playlist *playlist)
 {
-    if (index >= playlist->length)
-        return NULL;
+    viewport_select_top_visible(&playlist->viewport);
+}
 
-    if (index == 0)
-        return playlist->head;
-    if (index == playlist->length - 1)
-        return playlist->tail;
+/**
+ * @brief Sets the last visible item in the window as the selected item.
+ */
+void playlist_select_bottom_visible(struct playlist *playlist)
+{
+    viewport_select_bottom_visible(&playlist->viewport);
+}
 
-    struct playlist_item *current = playlist->head;
-    for (int i = 0; i < index; ++i) {
-        current = current->next;
-    }
+/**
+ * @brief Sets the item in the middle of the window as the selected item.
+ */
+void playlist_select_middle_visible(struct playlist *playlist)
+{
+    viewport_select_middle_visible(&playlist->viewport);
+}
 
-    return current;
+/**
+ * @brief Scrolls up one page in the playlist.
+ */
+void playlist_scroll_page_up(struct playlist *playlist)
+{
+    viewport_scroll_page_up(&playlist->viewport);
 }
 
 /**
- * @brief Draws a playlist item on the specified window.
+ * @brief Scrolls down one page in the playlist.
+ */
+void playlist_scroll_page_down(struct playlist *playlist)
+{
+    viewport_scroll_page_down(&playlist->viewport);
+}
+
+/**
+ * @brief Draws a playlist row on the specified window.
  *
- * @param item          The item to draw.
+ * @param row           The row to draw.
  * @param win           The window to draw on.
  * @param y             The y-position for drawing.
  * @param field_width   The number of characters in each column.
+ * @param bold          Whether to print the row's text in bold.
+ * @param highlight     Whether to highlight the row.
  */
-void playlist_item_draw(struct playlist_item *item, WINDOW *win, unsigned y, unsigned field_width)
+void playlist_row_draw(struct playlist_row *row, WINDOW *win, unsigned y, unsigned field_width,
+                       bool bold, bool highlight)
 {
     int maxx = getmaxx(win);
 
-    if (item->bold)
+    if (bold)
         wattr_on(win, A_BOLD, 0);
-    if (item->highlight)
+    if (highlight)
         wattr_on(win, A_STANDOUT, 0);
 
-    mvwprintw(win, y, 0, "%.*s\n", field_width - 2, item->artist);
-    mvwprintw(win, y, field_width + 1, "%.*s\n", field_width - 2, item->title);
-    mvwprintw(win, y, (field_width * 2) + 1, "%.*s\n", field_width - 2, item->album);
-    mvwprintw(win, y, maxx - 8, "%d:%02d\n", item->time / 60,
-              item->time % 60); /* "Length" column has a fixed width */
+    mvwprintw(win, y, 0, "%.*s\n", field_width - 2, row->artist);
+    mvwprintw(win, y, field_width + 1, "%.*s\n", field_width - 2, row->title);
+    mvwprintw(win, y, (field_width * 2) + 1, "%.*s\n", field_width - 2, row->album);
+    mvwprintw(win, y, maxx - 8, "%d:%02d\n", row->time / 60,
+              row->time % 60); /* "Length" column has a fixed width */
 
-    if (item->highlight)
+    if (highlight)
         mvwchgat(win, y, 0, -1, A_STANDOUT, 0, NULL);
     wattr_off(win, A_BOLD, 0);
     wattr_off(win, A_STANDOUT, 0);
@@ -546,46 +893,56 @@ void playlist_deaw_header(struct playlist *playlist, unsigned field_width)
 /**
  * @brief Draws a playlist on the screen.
  *
+ * Only the rows that fit in the window are looked at, so drawing takes the same time no
+ * matter how long the playlist is. Of those, only the rows that changed since the last
+ * draw are repainted: the ones that gained or lost the selection or the playing song, or
+ * all of them if the playlist scrolled or its rows changed. The playing song's row is
+ * looked up by ID rather than found by comparing rows, and a row is only read from the
+ * source if it's repainted.
+ *
  * @param playlist      The playlist to draw.
  * @param playing_id    The MPD id of the currently playing song.
  */
 void playlist_draw(struct playlist *playlist, unsigned playing_id)
 {
-    werase(playlist->win);
+    struct viewport *viewport = &playlist->viewport;
+    struct viewport_damage *damage = &playlist->damage;
+    unsigned drawn_playing_id = playlist->drawn_playing_id;
+    bool full = viewport_damage_is_full(damage, viewport);
+    bool playing_changed = playing_id != drawn_playing_id;
+
+    if (!full && !playing_changed && damage->selected == viewport->selected)
+        return;
 
     int maxx = getmaxx(playlist->win);
     int field_width = (maxx - 8) / 3;
-    playlist_deaw_header(playlist, field_width);
 
-    if (playlist->length <= 0)
-        return;
-    if (!playlist->selected)
-        playlist_select_top_visible(playlist);
-
-    /* Trying to draw the whole list at once and scrolling thorugh it
-     * doesn't work because drawing past the bounds of an ncurses window
-     * does nothing (this can kind of work with an ncurses pad, but that doesn't
-     * allow for list selection, navigation, and manipulation in the way we want).
-     * Because of this, it's more efficient to just worry about the items
-     * that are currently visible and redraw manually when there's a change.
-     *
-     * Since we know which item is displayed at the top and have the window dimensions,
-     * we can figure out which item will be the last one visible and only draw
-     * the ones in that range.
-     */
-    struct playlist_item *current = playlist->top_visible;
-    playlist_find_bottom(playlist);
-
-    int y = 1;
-    while (current != playlist->bottom_visible->next) {
-        if (current->id == playing_id)
-            current->bold = 1;
-        else
-            current->bold = 0;
+    if (full) {
+        werase(playlist->win);
+        playlist_deaw_header(playlist, field_width);
+    }
+
+    int bottom = viewport_bottom(viewport);
+    int playing_row = playing_id ? playlist_find_id(playlist, playing_id) : -1;
+    int drawn_playing_row = drawn_playing_id ? playlist_find_id(playlist, drawn_playing_id) : -1;
+    struct playlist_row row;
 
-        playlist_item_draw(current, playlist->win, y++, field_width);
-        current = current->next;
+    for (int i = viewport->top, y = 1; i <= bottom; ++i, ++y) {
+        bool playing_moved = playing_changed && (i == playing_row || i == drawn_playing_row);
+        if (!viewport_damage_has_row(damage, viewport, i) && !playing_moved)
+            continue;
+        if (!playlist_get_row(playlist, i, &row))
+            break;
+
+        if (!full) {
+            wmove(playlist->win, y, 0);
+            wclrtoeol(playlist->win);
+        }
+        playlist_row_draw(&row, playlist->win, y, field_width, i == playing_row,
+                          i == viewport->selected);
     }
 
+    viewport_damage_clear(damage, viewport);
+    playlist->drawn_playing_id = playing_id;
     wnoutrefresh(playlist->win);
 }
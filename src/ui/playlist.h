@@ -22,8 +22,9 @@
  * @brief UI elements for displaying a playlist.
  *
  * The structures and functions in this file are used for drawing a playlist on-screen.
- * Text for UI elements is populated from a [songlist](@ref songlist.h) structure, which contains
- * the underlying MPD playlist.
+ * Rows are read on demand from a [data source](@ref playlist_source), such as the
+ * [songlist](@ref songlist.h) holding the play queue, so only the rows that are on
+ * screen are ever formatted.
  *
  * This is for displaying any type of playlist (stored playlists, the play queue, etc.).
  * MPD uses the terms "playlist" and "queue" interchangeably when referring to the current
@@ -35,24 +36,69 @@
 #define PLAYLIST_H
 
 #include <ncurses.h>
+#include <stdint.h>
 
 #include "pantomime/mpdwrapper.h"
+#include "pantomime/trigram_index.h"
+#include "views/viewport.h"
+
+#define PLAYLIST_MIN_SLOTS 128      /* The number of slots in a playlist's first search table. */
+#define PLAYLIST_REMOVED_SLACK 1024 /* Removed strings kept past the live ones before a rebuild. */
+#define PLAYLIST_MIN_NAMES 1024     /* The number of interned names first given row lists. */
+#define PLAYLIST_MIN_NAME_ROWS 4    /* The capacity of a name's first list of rows. */
+#define PLAYLIST_SCAN_RATIO 8       /* Names matching over 1/N of the rows are found by a scan. */
+
+/**
+ * @brief The information shown in one row of the playlist display.
+ *
+ * The strings belong to the data source and only need to stay valid until the row is drawn.
+ */
+struct playlist_row {
+    const char *artist; /**< The song's artist. */
+    const char *title;  /**< The song's title. */
+    const char *album;  /**< The song's album. */
+    int time;           /**< Length of the song in seconds. */
+    unsigned id;        /**< The MPD ID of the song. */
+};
+
+/**
+ * @brief A row in a playlist's search index, stored by the string holding its title.
+ */
+struct playlist_entry {
+    unsigned id;        /**< The row's MPD ID. */
+    unsigned artist_id; /**< The row's interned artist. */
+    unsigned album_id;  /**< The row's interned album. */
+    int artist_pos;     /**< Where the row is in its artist's list of rows. */
+    int album_pos;      /**< Where the row is in its album's list of rows. */
+};
+
+/**
+ * @brief The rows of a playlist that share an interned artist or album name.
+ */
+struct playlist_name {
+    int *rows;    /**< The title string of each row with this name, in no order. */
+    int count;    /**< The number of rows with this name. */
+    int capacity; /**< The number of rows there is room for. */
+    int string;   /**< The name's string in the name index, plus one, or 0 if it has none. */
+    bool matched; /**< Set only while filtering, if the name contains the filter. */
+};
 
 /**
- * @brief A row in the playlist display, representing one song.
+ * @brief Callbacks that supply a playlist's rows by index.
  */
-struct playlist_item {
-    char *artist; /**< The song's artist. */
-    char *title;  /**< The song's title. */
-    char *album;  /**< The song's album. */
-    int time;     /**< Length of the song in seconds. */
-    unsigned id;  /**< The MPD ID of the song. */
-
-    int bold;      /**< Whether to print this item's text in bold. */
-    int highlight; /**< Whether to highlight this item after printing. */
-
-    struct playlist_item *prev; /**< The next song in the playlist. */
-    struct playlist_item *next; /**< The previous song in the playlist. */
+struct playlist_source {
+    /** Returns the number of rows. */
+    int (*length)(void *data);
+    /** Fills in the row at the given index. Returns false if there is no such row. */
+    bool (*row_at)(void *data, int index, struct playlist_row *row);
+    /** Fills in the columns that scans over every row read, indexed the same way. */
+    void (*columns)(void *data, struct queue_columns *columns);
+    /** Returns the index of the row with the given MPD ID, or -1 if there is none. */
+    int (*find_id)(void *data, unsigned id);
+    /** Takes the IDs of the rows added, removed or replaced since the last call, and
+     * returns false if every row should be treated as changed. Optional: without it,
+     * the search index is rebuilt whenever the playlist syncs. */
+    bool (*take_changes)(void *data, const unsigned **ids, int *count);
 };
 
 /**
@@ -65,38 +111,58 @@ struct playlist_item {
 struct playlist {
     WINDOW *win; /**< The ncurses window to draw the playlist on. */
 
-    struct playlist_item *head;     /**< The first item in the list. */
-    struct playlist_item *tail;     /**< The last item in the list. */
-    struct playlist_item *selected; /**< The currently selected item. */
-
-    struct playlist_item *top_visible;    /**< First visible item in the window. */
-    struct playlist_item *bottom_visible; /**< Last visible item in the window. */
-
-    int length;       /**< The number of items in the playlist. MPD's default maximum is 4096. */
-    int idx_selected; /**< The index of the currently selected item. */
-    int idx_last_selected; /**< The index of the last item selected before clearing the playlist. */
-    int idx_last_top;      /**< The index of the last item pointed to by top_visible. Useful for
-                              restoring scroll position on refresh. */
-    int max_visible; /**< The maximum number of items that can be displayed with the current window
-                        size. */
+    const struct playlist_source *source; /**< Where the playlist's rows come from. */
+    void *source_data;                    /**< Passed to each of the source's callbacks. */
+
+    struct trigram_index *search;       /**< Each row's title, indexed for filtering. */
+    struct playlist_entry *search_rows; /**< The row behind each string in the index. */
+    int search_rows_capacity;           /**< The number of rows there is room for. */
+    int *search_slots;                  /**< Each indexed row's string by MPD ID, plus one, or 0. */
+    int search_slot_count;              /**< The number of slots. A power of two, or 0. */
+    int search_live;                    /**< The number of rows in the index. */
+    bool search_stale;                  /**< Whether the index has to be rebuilt from scratch. */
+
+    struct trigram_index *name_search; /**< Each artist and album name in the rows, once. */
+    unsigned *name_ids;                /**< The interned name behind each name string. */
+    int name_ids_capacity;             /**< The number of names there is room for. */
+    struct playlist_name *names;       /**< The rows with each name, by interned ID. */
+    int name_count;                    /**< The number of interned IDs there are entries for. */
+    int name_live;                     /**< The number of names in the name index. */
+
+    int *hits;          /**< Room for the strings both indexes find for a filter. */
+    int hits_capacity;  /**< The number of strings there is room for. */
+    uint64_t *shown;    /**< One bit per row, set while filtering for each row that matches. */
+    int shown_words;    /**< The number of words in the bitmap, which is otherwise kept clear. */
+    char *filter;       /**< Only rows containing this are shown, if it's set. */
+    int *matches;       /**< The source indices of the rows shown while filtering. */
+    int match_count;    /**< The number of rows shown while filtering. */
+    int match_capacity; /**< The number of rows there is room for in matches. */
+
+    struct viewport viewport;      /**< The rows shown, the selection, and the scroll position. */
+    struct viewport_damage damage; /**< What needs repainting on the next draw. */
+    unsigned drawn_playing_id;     /**< The playing song's ID when the playlist was last drawn. */
 };
 
-struct playlist_item *playlist_item_init(char *artist, char *title, char *album, int time,
-                                         unsigned id);
-void playlist_item_free(struct playlist_item *item);
+void playlist_row_from_song(struct playlist_row *row, const struct queue_song *song);
 
-struct playlist *playlist_init(WINDOW *win);
+struct playlist *playlist_init(WINDOW *win, const struct playlist_source *source, void *data);
 void playlist_free(struct playlist *playlist);
 
-void playlist_append(struct playlist *playlist, struct playlist_item *item);
-bool playlist_remove_selected(struct playlist *playlist);
+void playlist_sync(struct playlist *playlist);
+bool playlist_get_row(struct playlist *playlist, int index, struct playlist_row *row);
+bool playlist_get_selected_row(struct playlist *playlist, struct playlist_row *row);
+int playlist_get_selected_pos(struct playlist *playlist);
+int playlist_get_pos(struct playlist *playlist, int index);
 
-void playlist_populate(struct playlist *playlist, struct songlist *songlist);
-void playlist_clear(struct playlist *playlist);
+void playlist_filter(struct playlist *playlist, const char *filter);
+const char *playlist_get_filter(struct playlist *playlist);
+void playlist_invalidate(struct playlist *playlist);
 
 void playlist_set_selected(struct playlist *playlist, int idx);
+bool playlist_select_id(struct playlist *playlist, unsigned id);
 void playlist_select_prev(struct playlist *playlist);
 void playlist_select_next(struct playlist *playlist);
+void playlist_move(struct playlist *playlist, int count);
 void playlist_select_top_visible(struct playlist *playlist);
 void playlist_select_bottom_visible(struct playlist *playlist);
 void playlist_select_middle_visible(struct playlist *playlist);
@@ -104,13 +170,8 @@ void playlist_select_middle_visible(struct playlist *playlist);
 void playlist_scroll_page_up(struct playlist *playlist);
 void playlist_scroll_page_down(struct playlist *playlist);
 
-void playlist_find_bottom(struct playlist *playlist);
-int playlist_find_cursor_pos(struct playlist *playlist);
-void playlist_restore_last_top(struct playlist *playlist);
-
-struct playlist_item *playlist_at(struct playlist *playlist, int index);
-
-void playlist_item_draw(struct playlist_item *item, WINDOW *win, unsigned y, unsigned field_width);
+void playlist_row_draw(struct playlist_row *row, WINDOW *win, unsigned y, unsigned field_width,
+                       bool bold, bool highlight);
 void playlist_deaw_header(struct playlist *playlist, unsigned field_width);
 void playlist_draw(struct playlist *playlist, unsigned playing_id);
 
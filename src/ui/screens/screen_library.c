@@ -52,53 +52,79 @@ void screen_library_free(struct screen_library *screen)
     free(screen);
 }
 
-void screen_library_populate_artists(struct screen_library *screen, struct mpdwrapper *mpd)
+/**
+ * @brief Asks the server for the list of artists.
+ *
+ * The artist view is filled in by screen_library_handle_list() once the list arrives.
+ */
+void screen_library_request_artists(struct screen_library *screen, struct mpdwrapper *mpd)
 {
-    struct stringlist *artist_list = mpdwrapper_list_artists(mpd);
-    struct list_view *list_view = screen->artist_list_view;
-    struct stringlist_item *current = artist_list->head;
-
-    while (current) {
-        list_view->lv_ops->lv_append(list_view, current->str);
-        current = current->next;
-    }
-
-    stringlist_free(artist_list);
-    list_view->lv_ops->lv_select_top_visible(list_view);
+    mpdwrapper_list_artists(mpd);
 }
 
-void screen_library_populate_albums(struct screen_library *screen, char *artist,
-                                    struct mpdwrapper *mpd)
+/**
+ * @brief Replaces the contents of a list view with a list of names.
+ *
+ * @param interned Whether the names are interned, so the view can share them.
+ */
+static void screen_library_populate(struct list_view *list_view, const char *const *names,
+                                    int count, bool interned)
 {
-    struct list_view *list_view = screen->album_list_view;
     list_view->lv_ops->lv_clear(list_view);
 
-    struct stringlist *album_list = mpdwrapper_list_albums(mpd, artist);
-    struct stringlist_item *current = album_list->head;
-    while (current) {
-        list_view->lv_ops->lv_append(list_view, current->str);
-        current = current->next;
+    for (int i = 0; i < count; ++i) {
+        if (interned)
+            list_view_append_interned(list_view, names[i]);
+        else
+            list_view_append(list_view, names[i]);
     }
 
-    stringlist_free(album_list);
     list_view->lv_ops->lv_select_top_visible(list_view);
 }
 
-void screen_library_populate_songs(struct screen_library *screen, char *artist, char *album,
-                                   struct mpdwrapper *mpd)
-{
-    struct list_view *list_view = screen->song_list_view;
-    list_view->lv_ops->lv_clear(list_view);
-
-    struct stringlist *song_list = mpdwrapper_list_songs(mpd, artist, album);
-    struct stringlist_item *current = song_list->head;
-    while (current) {
-        list_view->lv_ops->lv_append(list_view, current->str);
-        current = current->next;
+/**
+ * @brief Fills in a view with a list received from the server.
+ *
+ * Album and song lists are only shown if the view they were requested from is
+ * still visible.
+ *
+ * @param names The names to show. Artists and albums are [interned](@ref intern.h);
+ *              song titles are only valid during the call, so they're copied.
+ * @param count The number of names.
+ */
+void screen_library_handle_list(struct screen_library *screen, enum mpdwrapper_list type,
+                                const char *const *names, int count)
+{
+    switch (type) {
+        case LIST_ARTISTS: {
+            /* The artist list is refreshed as the library loads, and new artists are sorted
+             * in among the old ones, so the cursor follows the artist it was on. The names
+             * are interned, so the old one outlives the items. */
+            struct list_view *view = screen->artist_list_view;
+            struct list_view_item *item = list_view_get_selected(view);
+            const char *selected = item ? item->text : NULL;
+            int row = view->viewport.selected;
+
+            screen_library_populate(view, names, count, true);
+            if (!list_view_select_text(view, selected))
+                view->lv_ops->lv_select(view, row);
+            break;
+        }
+        case LIST_ALBUMS:
+            if (screen->visible_view != screen->artist_list_view)
+                break;
+            list_view_filter(screen->album_list_view, NULL);
+            screen_library_populate(screen->album_list_view, names, count, true);
+            screen->visible_view = screen->album_list_view;
+            break;
+        case LIST_SONGS:
+            if (screen->visible_view != screen->album_list_view)
+                break;
+            list_view_filter(screen->song_list_view, NULL);
+            screen_library_populate(screen->song_list_view, names, count, false);
+            screen->visible_view = screen->song_list_view;
+            break;
     }
-
-    stringlist_free(song_list);
-    list_view->lv_ops->lv_select_top_visible(list_view);
 }
 
 void screen_library_select(struct screen_library *screen, int index)
@@ -116,6 +142,11 @@ void screen_library_select_next(struct screen_library *screen)
     screen->visible_view->lv_ops->lv_select_next(screen->visible_view);
 }
 
+void screen_library_move(struct screen_library *screen, int count)
+{
+    screen->visible_view->lv_ops->lv_move(screen->visible_view, count);
+}
+
 void screen_library_select_top_visible(struct screen_library *screen)
 {
     screen->visible_view->lv_ops->lv_select_top_visible(screen->visible_view);
@@ -141,21 +172,22 @@ void screen_library_scroll_page_down(struct screen_library *screen)
     screen->visible_view->lv_ops->lv_scroll_page_down(screen->visible_view);
 }
 
+/**
+ * @brief Asks the server for the contents of the next view.
+ *
+ * The view changes once the list arrives.
+ */
 void screen_library_next_view(struct screen_library *screen, struct mpdwrapper *mpd)
 {
     struct list_view *visible = screen->visible_view;
 
-    if (visible == screen->artist_list_view) {
-        char *artist = screen->artist_list_view->selected->text;
-        screen_library_populate_albums(screen, artist, mpd);
-        screen->visible_view = screen->album_list_view;
-    }
-    else if (visible == screen->album_list_view) {
-        char *artist = screen->artist_list_view->selected->text;
-        char *album = screen->album_list_view->selected->text;
-        screen_library_populate_songs(screen, artist, album, mpd);
-        screen->visible_view = screen->song_list_view;
-    }
+    struct list_view_item *artist = list_view_get_selected(screen->artist_list_view);
+    struct list_view_item *album = list_view_get_selected(screen->album_list_view);
+
+    if (visible == screen->artist_list_view && artist)
+        mpdwrapper_list_albums(mpd, artist->text);
+    else if (visible == screen->album_list_view && artist && album)
+        mpdwrapper_list_songs(mpd, artist->text, album->text);
 }
 
 void screen_library_prev_view(struct screen_library *screen)
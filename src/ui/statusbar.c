@@ -32,6 +32,7 @@
 
 #define MODES_LABEL_LENGTH 6
 #define PROGRESS_LABEL_LENGTH 16
+#define CONNECTION_LABEL_LENGTH 256
 
 /**
  * @brief Allocates memory for a new status bar.
@@ -51,6 +52,10 @@ void statusbar_initialize(struct statusbar *statusbar)
 {
     statusbar->win = newwin(2, COLS, LINES - 2, 0);
     statusbar->song_label = NULL;
+    statusbar->notification = NULL;
+    statusbar->prompt = NULL;
+    statusbar->connection_label = NULL;
+    statusbar->dirty = true;
 
     statusbar->modes_label = malloc(MODES_LABEL_LENGTH * sizeof(char));
     memset(statusbar->modes_label, '-', MODES_LABEL_LENGTH - 1);
@@ -66,9 +71,47 @@ void statusbar_free(struct statusbar *statusbar)
     free(statusbar->progress_label);
     free(statusbar->song_label);
     free(statusbar->notification);
+    free(statusbar->prompt);
+    free(statusbar->connection_label);
     free(statusbar);
 }
 
+/**
+ * @brief Records everything the status bar shows, so a redraw can be skipped if none
+ * of it changed.
+ */
+static struct statusbar_snapshot statusbar_take_snapshot(struct statusbar *statusbar,
+                                                        struct mpdwrapper *mpd)
+{
+    struct mpd_status *status = mpdwrapper_get_status(mpd);
+    struct mpd_song *song = mpdwrapper_get_current_song(mpd);
+    int elapsed_ms = mpdwrapper_get_current_song_elapsed_ms(mpd);
+    int duration = mpdwrapper_get_current_song_duration(mpd);
+    struct statusbar_snapshot snapshot = {
+        .state = mpd_status_get_state(status),
+        .volume = mpdwrapper_get_volume(mpd),
+        .modes = mpd_status_get_repeat(status) | mpd_status_get_random(status) << 1 |
+                 mpd_status_get_single(status) << 2 | mpd_status_get_consume(status) << 3 |
+                 (mpd_status_get_crossfade(status) > 0) << 4,
+        .elapsed = (elapsed_ms < 0) ? -1 : elapsed_ms / 1000,
+        .bar_column = statusbar_progress_column(statusbar, elapsed_ms, duration),
+        .duration = duration,
+        .song_id = song ? (long)mpd_song_get_id(song) : -1,
+        .notification = statusbar->notification && time(NULL) <= statusbar->notify_end,
+    };
+
+    return snapshot;
+}
+
+static bool statusbar_snapshot_equal(const struct statusbar_snapshot *a,
+                                     const struct statusbar_snapshot *b)
+{
+    return a->state == b->state && a->volume == b->volume && a->modes == b->modes &&
+           a->elapsed == b->elapsed && a->bar_column == b->bar_column &&
+           a->duration == b->duration &&
+           a->song_id == b->song_id && a->notification == b->notification;
+}
+
 /**
  * @brief Draws the status bar at the bottom of the screen.
  *
@@ -76,6 +119,12 @@ void statusbar_free(struct statusbar *statusbar)
  * progress bar. If a status message needs to be shown to the user, then
  * that message will be printed temporarily instead.
  *
+ * Nothing is drawn unless something shown on the bar has changed since it was
+ * last drawn. While a song plays, that's whenever the progress label passes a
+ * second or the progress bar moves a column.
+ *
+ * While there's no connection to the server, its state is shown instead.
+ *
  * @param win The ncurses window to draw on.
  * @param mpd The mpd connection to parse data from.
  */
@@ -83,26 +132,42 @@ void statusbar_draw(struct statusbar *statusbar, struct mpdwrapper *mpd)
 {
     struct mpd_status *status = mpdwrapper_get_status(mpd);
 
+    if (mpdwrapper_get_connection(mpd) != CONNECTION_CONNECTED) {
+        statusbar_draw_connection(statusbar, mpd);
+        return;
+    }
+    if (statusbar->connection_label) {
+        free(statusbar->connection_label);
+        statusbar->connection_label = NULL;
+        statusbar->dirty = true;
+    }
+
     if (!mpdwrapper_has_valid_state(mpd))
         return;
 
+    struct statusbar_snapshot snapshot = statusbar_take_snapshot(statusbar, mpd);
+    if (!statusbar->dirty && statusbar_snapshot_equal(&snapshot, &statusbar->drawn))
+        return;
+
+    statusbar->drawn = snapshot;
+    statusbar->dirty = false;
+
     werase(statusbar->win);
     statusbar_draw_modes(statusbar, status);
-    statusbar_draw_volume(statusbar, status);
+    statusbar_draw_volume(statusbar, snapshot.volume);
 
     if (!mpdwrapper_is_stopped(mpd)) {
-        double song_length = mpdwrapper_get_current_song_duration(mpd);
-        double time_elapsed = mpdwrapper_get_current_song_elapsed(mpd);
-
-        statusbar_draw_progress_bar(statusbar, time_elapsed, song_length);
-        statusbar_draw_progress_label(statusbar, time_elapsed, song_length);
+        statusbar_draw_progress_bar(statusbar, snapshot.bar_column);
+        statusbar_draw_progress_label(statusbar, snapshot.elapsed, snapshot.duration);
     }
 
-    /* Either the song or a notification is displayed, not both. */
+    /* Either the prompt, the song, or a notification is displayed, not more than one. */
     bool playing = mpdwrapper_is_playing(mpd);
     bool paused = mpdwrapper_is_paused(mpd);
 
-    if (statusbar->notification && time(NULL) <= statusbar->notify_end)
+    if (statusbar->prompt)
+        statusbar_draw_prompt(statusbar);
+    else if (statusbar->notification && time(NULL) <= statusbar->notify_end)
         statusbar_draw_notification(statusbar);
     else if (playing || paused)
         statusbar_draw_song_label(statusbar, mpdwrapper_get_current_song(mpd));
@@ -110,6 +175,66 @@ void statusbar_draw(struct statusbar *statusbar, struct mpdwrapper *mpd)
     wnoutrefresh(statusbar->win);
 }
 
+/**
+ * @brief Finds how long until something shown on the status bar changes by itself.
+ *
+ * That's the countdown to the next connection attempt, the progress of a playing song,
+ * and a notification running out. Anything else only changes when the server or the
+ * user does something.
+ *
+ * @return The number of milliseconds, or -1 if nothing shown changes with time.
+ */
+int statusbar_next_change(struct statusbar *statusbar, struct mpdwrapper *mpd)
+{
+    enum mpdwrapper_connection connection = mpdwrapper_get_connection(mpd);
+    int next = -1;
+
+    if (connection == CONNECTION_DISCONNECTED) {
+        int delay = mpdwrapper_get_reconnect_delay_ms(mpd);
+        return (delay > 0) ? (delay - 1) % 1000 + 1 : -1;
+    }
+
+    if (connection == CONNECTION_CONNECTED && mpdwrapper_is_playing(mpd)) {
+        int elapsed_ms = mpdwrapper_get_current_song_elapsed_ms(mpd);
+        int duration = mpdwrapper_get_current_song_duration(mpd);
+        int width = getmaxx(statusbar->win);
+
+        if (elapsed_ms >= 0)
+            next = 1000 - elapsed_ms % 1000;
+        /* The bar's tip moves on at the first millisecond that maps to the next column. */
+        if (elapsed_ms >= 0 && duration > 0 && width > 0) {
+            long long column = statusbar_progress_column(statusbar, elapsed_ms, duration);
+            long long moves = ((column + 1) * duration * 1000LL + width - 1) / width - elapsed_ms;
+
+            if (column + 1 < width && moves > 0 && moves < next)
+                next = moves;
+        }
+    }
+
+    if (statusbar->notification && !statusbar->prompt) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+
+        if (now.tv_sec <= statusbar->notify_end) {
+            long long ends = (statusbar->notify_end + 1 - now.tv_sec) * 1000LL -
+                             now.tv_nsec / 1000000;
+
+            if (next < 0 || ends < next)
+                next = (ends > 0) ? ends : 1;
+        }
+    }
+
+    return next;
+}
+
+/**
+ * @brief Makes the next draw repaint the whole status bar.
+ */
+void statusbar_invalidate(struct statusbar *statusbar)
+{
+    statusbar->dirty = true;
+}
+
 /**
  * @brief Draws the playback modes label on the status bar.
  */
@@ -124,11 +249,13 @@ void statusbar_draw_modes(struct statusbar *statusbar, struct mpd_status *mpd_st
 }
 
 /**
- * @brief Draws the current MPD volume on the status bar.
+ * @brief Draws the volume on the status bar.
+ *
+ * @param volume The volume in percent. A change that hasn't reached the server yet is
+ *   shown straight away.
  */
-void statusbar_draw_volume(struct statusbar *statusbar, struct mpd_status *status)
+void statusbar_draw_volume(struct statusbar *statusbar, int volume)
 {
-    int volume = mpd_status_get_volume(status);
     int width = getmaxx(statusbar->win);
     int begin_x = width - strlen(statusbar->modes_label) - strlen(statusbar->progress_label) -
                   strlen("100%%") - 1;
@@ -137,24 +264,34 @@ void statusbar_draw_volume(struct statusbar *statusbar, struct mpd_status *statu
 }
 
 /**
- * @brief Draws the moving progress bar on the status bar area.
+ * @brief Finds the column the tip of the progress bar is drawn at.
+ *
+ * @param elapsed_ms How far into the song the player is, in milliseconds.
+ * @param song_length The length of the song in seconds.
+ * @return The column, or 0 if the song has no known length.
  */
-void statusbar_draw_progress_bar(struct statusbar *statusbar, unsigned int time_elapsed,
-                                 unsigned int song_length)
+int statusbar_progress_column(struct statusbar *statusbar, int elapsed_ms, int song_length)
 {
     int width = getmaxx(statusbar->win);
 
-    /* Number of seconds that must elapse for the bar to progress. */
-    double secs_per_tick = song_length / width;
-    /* Number of spaces to move for every tick. */
-    double tick_size = (width / song_length) + 1;
-    /* Number of times the bar has moved. */
-    double ticks_elapsed = time_elapsed / tick_size;
+    if (elapsed_ms <= 0 || song_length <= 0 || width <= 0)
+        return 0;
+
+    long long column = (long long)elapsed_ms * width / (song_length * 1000LL);
+    return (column >= width) ? width - 1 : column;
+}
 
+/**
+ * @brief Draws the moving progress bar on the status bar area.
+ *
+ * @param column The column the tip of the bar is at.
+ */
+void statusbar_draw_progress_bar(struct statusbar *statusbar, int column)
+{
     wmove(statusbar->win, 0, 0);
     wattr_on(statusbar->win, A_BOLD, NULL);
-    whline(statusbar->win, '=', (tick_size * ticks_elapsed) / secs_per_tick);
-    mvwaddch(statusbar->win, 0, (tick_size * ticks_elapsed) / secs_per_tick, '>');
+    whline(statusbar->win, '=', column);
+    mvwaddch(statusbar->win, 0, column, '>');
     wattr_off(statusbar->win, A_BOLD, NULL);
 }
 
@@ -197,6 +334,70 @@ void statusbar_draw_notification(struct statusbar *statusbar)
     wattr_off(statusbar->win, A_BOLD, NULL);
 }
 
+/**
+ * @brief Draws the prompt the user is typing in, with a cursor after it.
+ */
+void statusbar_draw_prompt(struct statusbar *statusbar)
+{
+    wmove(statusbar->win, 1, 0);
+    wclrtoeol(statusbar->win);
+    mvwaddstr(statusbar->win, 1, 0, statusbar->prompt);
+    waddch(statusbar->win, ' ' | A_STANDOUT);
+}
+
+/**
+ * @brief Draws the state of the connection in place of the player state.
+ *
+ * Nothing is drawn unless the text has changed, such as when the countdown to the next
+ * attempt ticks down.
+ */
+void statusbar_draw_connection(struct statusbar *statusbar, struct mpdwrapper *mpd)
+{
+    enum mpdwrapper_connection connection = mpdwrapper_get_connection(mpd);
+    const char *error = mpdwrapper_get_connection_error(mpd);
+    char label[CONNECTION_LABEL_LENGTH];
+
+    if (connection == CONNECTION_CONNECTING && error)
+        snprintf(label, sizeof(label), "Connection lost: %s. Reconnecting...", error);
+    else if (connection == CONNECTION_CONNECTING)
+        snprintf(label, sizeof(label), "Connecting...");
+    else
+        snprintf(label, sizeof(label), "Can't connect: %s. Retrying in %ds",
+                 error ? error : "Unknown error",
+                 (mpdwrapper_get_reconnect_delay_ms(mpd) + 999) / 1000);
+
+    if (!statusbar->dirty && statusbar->connection_label &&
+        strcmp(label, statusbar->connection_label) == 0)
+        return;
+
+    free(statusbar->connection_label);
+    statusbar->connection_label = strdup(label);
+    statusbar->dirty = false;
+
+    werase(statusbar->win);
+    if (statusbar->prompt)
+        statusbar_draw_prompt(statusbar);
+    else {
+        wattr_on(statusbar->win, A_BOLD, NULL);
+        mvwaddstr(statusbar->win, 1, 0, label);
+        wattr_off(statusbar->win, A_BOLD, NULL);
+    }
+
+    wnoutrefresh(statusbar->win);
+}
+
+/**
+ * @brief Shows a prompt in the status bar while the user types.
+ *
+ * @param prompt The text to show, or NULL to hide the prompt.
+ */
+void statusbar_set_prompt(struct statusbar *statusbar, const char *prompt)
+{
+    free(statusbar->prompt);
+    statusbar->prompt = prompt ? strdup(prompt) : NULL;
+    statusbar->dirty = true;
+}
+
 /**
  * @brief Sets the notification to display in the status bar.
  *
@@ -209,6 +410,7 @@ void statusbar_set_notification(struct statusbar *statusbar, char *msg, int dura
     statusbar->notification = realloc(statusbar->notification, (strlen(msg) + 1) * sizeof(char));
     sprintf(statusbar->notification, "%s", msg);
     statusbar->notify_end = time(NULL) + duration;
+    statusbar->dirty = true;
 }
 
 /**
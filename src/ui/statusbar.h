@@ -30,6 +30,20 @@
 #include "pantomime/mpdwrapper.h"
 #include "pantomime/statusbar.h"
 
+/**
+ * @brief What the status bar showed when it was last drawn.
+ */
+struct statusbar_snapshot {
+    enum mpd_state state;
+    int volume;
+    unsigned modes;     /* One bit for each playback mode that's on. */
+    int elapsed;        /* Seconds into the song. */
+    int bar_column;     /* Where the tip of the progress bar was. */
+    int duration;       /* Length of the song in seconds. */
+    long song_id;       /* The MPD ID of the song, or -1 if there was none. */
+    bool notification;  /* Whether the notification was showing. */
+};
+
 struct statusbar {
     WINDOW *win;
     char *modes_label;
@@ -37,19 +51,26 @@ struct statusbar {
     char *song_label;
     char *notification;
     time_t notify_end;
+    char *prompt; /* Text being typed by the user, shown in place of everything else. */
+    char *connection_label; /* Shown in place of the player state while disconnected. */
+
+    struct statusbar_snapshot drawn; /* What was shown the last time the bar was drawn. */
+    bool dirty;                      /* Whether the bar must be redrawn regardless. */
 };
 
 void statusbar_initialize(struct statusbar *statusbar);
 void statusbar_free(struct statusbar *statusbar);
 
 void statusbar_draw_modes(struct statusbar *statusbar, struct mpd_status *status);
-void statusbar_draw_volume(struct statusbar *statusbar, struct mpd_status *status);
-void statusbar_draw_progress_bar(struct statusbar *statusbar, unsigned int time_elapsed,
-                                 unsigned int song_length);
+void statusbar_draw_volume(struct statusbar *statusbar, int volume);
+int statusbar_progress_column(struct statusbar *statusbar, int elapsed_ms, int song_length);
+void statusbar_draw_progress_bar(struct statusbar *statusbar, int column);
 void statusbar_draw_progress_label(struct statusbar *statusbar, unsigned int time_elapsed,
                                    unsigned int song_length);
 void statusbar_draw_song_label(struct statusbar *statusbar, struct mpd_song *song);
 void statusbar_draw_notification(struct statusbar *statusbar);
+void statusbar_draw_prompt(struct statusbar *statusbar);
+void statusbar_draw_connection(struct statusbar *statusbar, struct mpdwrapper *mpd);
 
 char *statusbar_create_label_modes(char *buffer, struct mpd_status *status);
 char *statusbar_create_label_progress(char *buffer, unsigned int time_elapsed,
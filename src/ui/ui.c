@@ -21,6 +21,9 @@
 
 #include <locale.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include "panel_help.h"
 
@@ -38,6 +41,7 @@ void start_curses()
     curs_set(0);
     nodelay(stdscr, TRUE);
     keypad(stdscr, TRUE);
+    set_escdelay(25); /* Escape cancels a search, so it shouldn't wait for a sequence. */
     refresh();
 }
 
@@ -82,6 +86,63 @@ void destroy_panels(PANEL **panels, int num_panels)
     free(panels);
 }
 
+static void ui_handle_list(void *data, enum mpdwrapper_list type, const char *const *names,
+                           int count)
+{
+    struct ui *ui = data;
+    screen_library_handle_list(ui->library, type, names, count);
+}
+
+static void ui_handle_error(void *data, char *message)
+{
+    struct ui *ui = data;
+    statusbar_set_notification(ui->statusbar, message, DEFAULT_NOTIFICATION_LENGTH);
+}
+
+static int ui_queue_length(void *data)
+{
+    return songlist_get_size(mpdwrapper_get_queue(data));
+}
+
+static bool ui_queue_row_at(void *data, int index, struct playlist_row *row)
+{
+    struct queue_song *song = songlist_at(mpdwrapper_get_queue(data), index);
+    if (!song)
+        return false;
+
+    playlist_row_from_song(row, song);
+    return true;
+}
+
+static void ui_queue_columns(void *data, struct queue_columns *columns)
+{
+    songlist_get_columns(mpdwrapper_get_queue(data), columns);
+}
+
+static int ui_queue_find_id(void *data, unsigned id)
+{
+    return songlist_find_id(mpdwrapper_get_queue(data), id);
+}
+
+static bool ui_queue_take_changes(void *data, const unsigned **ids, int *count)
+{
+    return songlist_take_changes(mpdwrapper_get_queue(data), ids, count);
+}
+
+/* The queue view reads its rows straight from the cached queue. */
+static const struct playlist_source ui_queue_source = {
+    .length = ui_queue_length,
+    .row_at = ui_queue_row_at,
+    .columns = ui_queue_columns,
+    .find_id = ui_queue_find_id,
+    .take_changes = ui_queue_take_changes,
+};
+
+static const struct mpdwrapper_handlers ui_handlers = {
+    .on_list = ui_handle_list,
+    .on_error = ui_handle_error,
+};
+
 /**
  * @brief Creates and initializes the program UI.
  */
@@ -102,16 +163,24 @@ void ui_initialize(struct ui *ui, struct mpdwrapper *mpd)
 
     ui->panels = create_panels(NUM_PANELS, ui->maxy - 2, ui->maxx);
     ui->visible_panel = QUEUE;
+    ui->panel_switched = true;
+    ui->drawn_library_view = NULL;
     top_panel(ui->panels[ui->visible_panel]);
 
-    ui->queue = playlist_init(panel_window(ui->panels[QUEUE]));
+    ui->queue = playlist_init(panel_window(ui->panels[QUEUE]), &ui_queue_source, mpd);
     ui->statusbar = statusbar_new();
     ui->library = screen_library_new(ui->maxy - 2, ui->maxx);
 
-    screen_library_populate_artists(ui->library, mpd);
+    mpdwrapper_set_handlers(mpd, &ui_handlers, ui);
+    screen_library_request_artists(ui->library, mpd);
+    ui->db_version = mpdwrapper_get_db_version(mpd);
+    ui->queue_changes = mpdwrapper_get_queue_changes(mpd);
+    ui->follow_playing = false;
+    ui->followed_id = 0;
 
-    /* TODO: remove this once the playlist view gets refactored. */
-    playlist_populate(ui->queue, mpdwrapper_get_queue(mpd));
+    ui->searching = false;
+    ui->search_query[0] = '\0';
+    ui->search_length = 0;
 }
 
 void ui_free(struct ui *ui)
@@ -127,39 +196,213 @@ void ui_draw(struct ui *ui, struct mpdwrapper *mpd)
     statusbar_draw(ui->statusbar, mpd);
 
     WINDOW *win = panel_window(ui->panels[ui->visible_panel]);
-    int is_playing;
-    int is_paused;
-    int current_song_id;
+    bool has_song = mpdwrapper_is_playing(mpd) || mpdwrapper_is_paused(mpd);
+    unsigned current_song_id = has_song ? mpdwrapper_get_current_song_id(mpd) : 0;
 
-    if (mpdwrapper_queue_changed(mpd)) {
-        playlist_clear(ui->queue);
-        playlist_populate(ui->queue, mpdwrapper_get_queue(mpd));
+    /* A count rather than the queue version, since a restarted server can hand out a
+     * version the playlist has already seen. */
+    if (ui->queue_changes != mpdwrapper_get_queue_changes(mpd)) {
+        playlist_sync(ui->queue);
+        ui->queue_changes = mpdwrapper_get_queue_changes(mpd);
+    }
+    /* The song may not be in the cached queue yet, in which case this is tried again. */
+    if (ui->follow_playing && current_song_id && current_song_id != ui->followed_id &&
+        playlist_select_id(ui->queue, current_song_id))
+        ui->followed_id = current_song_id;
+    if (ui->db_version != mpdwrapper_get_db_version(mpd)) {
+        screen_library_request_artists(ui->library, mpd);
+        ui->db_version = mpdwrapper_get_db_version(mpd);
     }
 
+    /* The views draw straight to their windows, so the panel stack has to be settled first
+     * or it would paint over them. Only what changed since the last frame is redrawn. */
+    update_panels();
+
     switch (ui->visible_panel) {
         case HELP:
-            draw_help_screen(win);
+            if (ui->panel_switched)
+                draw_help_screen(win);
             break;
         case QUEUE:
-            is_playing = mpdwrapper_is_playing(mpd);
-            is_paused = mpdwrapper_is_paused(mpd);
-            current_song_id = (is_playing || is_paused) ? mpdwrapper_get_current_song_id(mpd) : 0;
+            if (ui->panel_switched)
+                playlist_invalidate(ui->queue);
             playlist_draw(ui->queue, current_song_id);
             break;
         case LIBRARY:
+            if (ui->panel_switched || ui->drawn_library_view != ui->library->visible_view)
+                list_view_invalidate(ui->library->visible_view);
+            ui->drawn_library_view = ui->library->visible_view;
             list_view_draw(ui->library->visible_view);
             break;
         default:
             break;
     }
-
-    update_panels();
+    ui->panel_switched = false;
 
     doupdate();
 }
 
+/**
+ * @brief Sends anything held back for merging that's due, and finds how long the UI can
+ * wait before it has to run again.
+ *
+ * @return The number of milliseconds until something on screen changes with time or a
+ *   held request is due, or -1 if only input or the server can change anything.
+ */
+int ui_next_tick(struct ui *ui, struct mpdwrapper *mpd)
+{
+    int flush = mpdwrapper_flush(mpd);
+    int change = statusbar_next_change(ui->statusbar, mpd);
+
+    if (flush < 0 || (change >= 0 && change < flush))
+        return change;
+    return flush;
+}
+
+/**
+ * @brief Picks up a new terminal size after the terminal has been resized.
+ *
+ * Signals are handled by the event loop rather than by curses, so curses is told the new
+ * size here. The screen is then repainted in full on the next draw.
+ */
+void ui_resize(struct ui *ui)
+{
+    struct winsize size;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0)
+        resizeterm(size.ws_row, size.ws_col);
+    getmaxyx(stdscr, ui->maxy, ui->maxx);
+
+    clearok(curscr, TRUE);
+    ui->panel_switched = true;
+    statusbar_invalidate(ui->statusbar);
+}
+
 void ui_set_visible_panel(struct ui *ui, enum ui_panel panel)
 {
+    if (ui->visible_panel != panel)
+        ui->panel_switched = true;
     ui->visible_panel = panel;
     top_panel(ui->panels[panel]);
 }
+
+/**
+ * @brief Filters the visible list by the search being typed.
+ */
+static void ui_search_apply(struct ui *ui)
+{
+    const char *query = ui->search_length > 0 ? ui->search_query : NULL;
+
+    switch (ui->visible_panel) {
+        case QUEUE:
+            playlist_filter(ui->queue, query);
+            break;
+        case LIBRARY:
+            ui->library->visible_view->lv_ops->lv_filter(ui->library->visible_view, query);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Updates the prompt in the status bar to show the search being typed.
+ */
+static void ui_search_show(struct ui *ui)
+{
+    char prompt[SEARCH_QUERY_LENGTH + 1];
+
+    snprintf(prompt, sizeof(prompt), "/%s", ui->search_query);
+    statusbar_set_prompt(ui->statusbar, prompt);
+}
+
+/**
+ * @brief Opens the search prompt for the visible list.
+ *
+ * The prompt starts with the list's current filter, if it has one. Until the search is
+ * finished, every key goes to ui_search_input().
+ */
+void ui_search_begin(struct ui *ui)
+{
+    const char *filter = NULL;
+
+    switch (ui->visible_panel) {
+        case QUEUE:
+            filter = playlist_get_filter(ui->queue);
+            break;
+        case LIBRARY:
+            filter = list_view_get_filter(ui->library->visible_view);
+            break;
+        default:
+            return;
+    }
+
+    snprintf(ui->search_query, sizeof(ui->search_query), "%s", filter ? filter : "");
+    ui->search_length = strlen(ui->search_query);
+    ui->searching = true;
+    ui_search_show(ui);
+}
+
+bool ui_search_is_active(struct ui *ui)
+{
+    return ui->searching;
+}
+
+/**
+ * @brief Closes the search prompt.
+ *
+ * @param keep Whether to keep the list filtered.
+ */
+static void ui_search_end(struct ui *ui, bool keep)
+{
+    if (!keep) {
+        ui->search_length = 0;
+        ui->search_query[0] = '\0';
+        ui_search_apply(ui);
+    }
+
+    ui->searching = false;
+    statusbar_set_prompt(ui->statusbar, NULL);
+}
+
+/**
+ * @brief Handles a key typed into the search prompt.
+ *
+ * The visible list is filtered again after every change. Enter closes the prompt and
+ * keeps the filter; Escape, or Backspace with nothing typed, closes it and shows the
+ * whole list again.
+ */
+void ui_search_input(struct ui *ui, int key)
+{
+    switch (key) {
+        case '\n':
+        case KEY_ENTER:
+            ui_search_end(ui, true);
+            return;
+        case 27: /* Escape */
+            ui_search_end(ui, false);
+            return;
+        case KEY_BACKSPACE:
+        case 127:
+        case '\b':
+            if (ui->search_length == 0) {
+                ui_search_end(ui, false);
+                return;
+            }
+            /* Remove a whole UTF-8 character, not just its last byte. */
+            do {
+                --ui->search_length;
+            } while (ui->search_length > 0 &&
+                     (ui->search_query[ui->search_length] & 0xC0) == 0x80);
+            break;
+        default:
+            if (key < ' ' || key > 0xFF || ui->search_length >= SEARCH_QUERY_LENGTH - 1)
+                return;
+            ui->search_query[ui->search_length++] = key;
+            break;
+    }
+
+    ui->search_query[ui->search_length] = '\0';
+    ui_search_apply(ui);
+    ui_search_show(ui);
+}
@@ -29,15 +29,28 @@
 #include "screens/screen_library.h"
 
 #define DEFAULT_NOTIFICATION_LENGTH 3
+#define SEARCH_QUERY_LENGTH 256 /* The longest search the prompt accepts, in bytes. */
 
 struct ui {
     PANEL **panels;
     enum ui_panel visible_panel; /* Only one panel should be visible at a time. */
+    bool panel_switched;         /* Whether the visible panel must be repainted in full. */
 
     struct playlist *queue;
     struct statusbar *statusbar;
     struct screen_library *library;
 
+    unsigned queue_changes; /* The queue change count the playlist was last synced at. */
+    bool follow_playing;    /* Whether the queue's cursor moves to each song that starts. */
+    unsigned followed_id;   /* The playing song the cursor was last moved to, or 0. */
+    unsigned db_version;    /* The database version the library was last populated from. */
+
+    struct list_view *drawn_library_view; /* The library view shown the last time it was drawn. */
+
+    bool searching;                         /* Whether keys are going to the search prompt. */
+    char search_query[SEARCH_QUERY_LENGTH]; /* The search being typed. */
+    int search_length;                      /* The length of the search in bytes. */
+
     int maxx;
     int maxy;
 };
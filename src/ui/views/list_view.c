@@ -23,35 +23,31 @@
 
 #include "list_view.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /* Creates an item for use in a list view.
- * The caller is responsible for freeing any dynamically
- * allocated pointer that is passed here.
+ * Interned text is shared rather than copied, since it outlives the item.
+ * Any other text is copied, so the caller keeps ownership of what it passes.
  */
-struct list_view_item *list_view_item_new(char *text)
+struct list_view_item *list_view_item_new(const char *text, bool interned)
 {
     struct list_view_item *item = malloc(sizeof(*item));
     if (!item)
         return NULL;
 
-    list_view_item_initialize(item, text);
+    list_view_item_initialize(item, text, interned);
 
     return item;
 }
 
-void list_view_item_initialize(struct list_view_item *this, char *text)
+void list_view_item_initialize(struct list_view_item *this, const char *text, bool interned)
 {
-    const size_t text_len = strlen(text) + 1;
-    this->text = malloc(text_len * sizeof(char));
-    snprintf(this->text, text_len, "%s", text);
+    this->owned_text = interned ? NULL : strdup(text);
+    this->text = interned ? text : this->owned_text;
 
     this->bold = 0;
     this->highlight = 0;
-    this->prev = NULL;
-    this->next = NULL;
 }
 
 void list_view_item_free(struct list_view_item *this)
@@ -59,7 +55,7 @@ void list_view_item_free(struct list_view_item *this)
     if (!this)
         return;
 
-    free(this->text);
+    free(this->owned_text);
     free(this);
 }
 
@@ -70,7 +66,7 @@ void list_view_item_draw(struct list_view_item *this, WINDOW *win, unsigned y)
     if (this->highlight)
         wattr_on(win, A_STANDOUT, 0);
 
-    mvwprintw(win, y, 0, this->text);
+    mvwprintw(win, y, 0, "%s", this->text);
 
     if (this->highlight)
         mvwchgat(win, y, 0, -1, A_STANDOUT, 0, NULL);
@@ -82,9 +78,12 @@ static const struct list_view_operations lv_ops = {
     .lv_append = list_view_append,
     .lv_remove_selected = list_view_remove_selected,
     .lv_clear = list_view_clear,
+    .lv_filter = list_view_filter,
+    .lv_get_selected = list_view_get_selected,
     .lv_select = list_view_select,
     .lv_select_prev = list_view_select_prev,
     .lv_select_next = list_view_select_next,
+    .lv_move = list_view_move,
     .lv_select_top_visible = list_view_select_top_visible,
     .lv_select_bottom_visible = list_view_select_bottom_visible,
     .lv_select_middle_visible = list_view_select_middle_visible,
@@ -109,16 +108,17 @@ void list_view_initialize(struct list_view *this, int height, int width)
 {
     this->win = newwin(height, width, 0, 0);
 
-    this->head = NULL;
-    this->tail = NULL;
-    this->selected = NULL;
+    this->items = NULL;
+    this->item_count = 0;
+    this->capacity = 0;
 
-    this->top_visible = NULL;
-    this->bottom_visible = NULL;
+    this->search = trigram_index_new();
+    this->filter = NULL;
+    this->matches = NULL;
+    this->match_count = 0;
 
-    this->item_count = 0;
-    this->idx_selected = -1;
-    this->max_visible = getmaxy(this->win) - 1;
+    viewport_initialize(&this->viewport, getmaxy(this->win) - 1);
+    viewport_damage_all(&this->damage);
 
     this->lv_ops = &lv_ops;
 }
@@ -126,108 +126,203 @@ void list_view_initialize(struct list_view *this, int height, int width)
 void list_view_free(struct list_view *this)
 {
     list_view_clear(this);
+    trigram_index_free(this->search);
+    free(this->filter);
+    free(this->matches);
+    free(this->items);
     free(this);
 }
 
-void list_view_append(struct list_view *this, char *text)
+/**
+ * @brief Gets the number of items shown, which is fewer than the number of items while
+ * a filter is set.
+ */
+static int list_view_shown_count(struct list_view *this)
+{
+    return this->filter ? this->match_count : this->item_count;
+}
+
+/**
+ * @brief Gets the item shown in a row of the list.
+ *
+ * @return The item, or NULL if there is no such row.
+ */
+static struct list_view_item *list_view_item_at(struct list_view *this, int row)
+{
+    if (row < 0 || row >= list_view_shown_count(this))
+        return NULL;
+
+    return this->items[this->filter ? this->matches[row] : row];
+}
+
+/**
+ * @brief Adds an item to the end of a list view.
+ *
+ * @param interned Whether the text is [interned](@ref intern.h) and can be shared.
+ */
+static void list_view_add_item(struct list_view *this, const char *text, bool interned)
 {
     if (!this || !text)
         return;
 
-    struct list_view_item *item = list_view_item_new(text);
-
-    if (!this->head) {
-        this->head = item;
-        this->selected = item;
-        this->top_visible = item;
-        this->bottom_visible = item;
-        this->idx_selected = 0;
-        item->highlight = 1;
+    if (this->item_count == this->capacity) {
+        int capacity = this->capacity ? this->capacity * 2 : LIST_VIEW_MIN_CAPACITY;
+        struct list_view_item **items = realloc(this->items, capacity * sizeof(*items));
+        if (!items)
+            return;
+        this->items = items;
+
+        /* Either array may have grown already, but capacity only counts once both have. */
+        int *matches = realloc(this->matches, capacity * sizeof(*matches));
+        if (!matches)
+            return;
+        this->matches = matches;
+        this->capacity = capacity;
     }
-    else {
-        struct list_view_item *tmp = this->tail;
-        tmp->next = item;
-        item->prev = tmp;
+
+    struct list_view_item *item = list_view_item_new(text, interned);
+    if (!item || !item->text) {
+        list_view_item_free(item);
+        return;
     }
 
-    this->tail = item;
-    this->item_count++;
+    int index = trigram_index_add(this->search, text);
+    this->items[this->item_count++] = item;
+
+    if (this->filter && trigram_index_match(this->search, index, this->filter))
+        this->matches[this->match_count++] = index;
+
+    viewport_set_length(&this->viewport, list_view_shown_count(this));
+    viewport_damage_all(&this->damage);
+}
+
+/**
+ * @brief Adds an item to the end of a list view, copying its text.
+ */
+void list_view_append(struct list_view *this, const char *text)
+{
+    list_view_add_item(this, text, false);
+}
+
+/**
+ * @brief Adds an item with [interned](@ref intern.h) text to the end of a list view.
+ *
+ * The text is shared with the intern table rather than copied.
+ */
+void list_view_append_interned(struct list_view *this, const char *text)
+{
+    list_view_add_item(this, text, true);
 }
 
 void list_view_remove_selected(struct list_view *this)
 {
-    if (!this || !this->head)
+    if (!this || this->item_count == 0)
         return;
 
-    if (this->selected == this->head) {
-        if (!this->head->next) /* Only one item in the list. */
-            this->lv_ops->lv_clear(this);
-        else {
-            struct list_view_item *current = this->head;
-            this->lv_ops->lv_select_next(this);
-            this->top_visible = this->selected;
-            this->lv_ops->lv_find_bottom(this);
-            this->head->prev = NULL;
-
-            list_view_item_free(current);
-            this->head = this->selected;
-        }
-        this->item_count--;
-        this->idx_selected = 0;
-    }
-    else {
-        struct list_view_item *current = this->selected;
-
-        if (current->next)
-            this->lv_ops->lv_select_next(this);
-        else
-            this->lv_ops->lv_select_prev(this);
-
-        if (current == this->top_visible)
-            this->top_visible = this->selected;
-        if (current == this->tail) {
-            this->tail = this->tail->prev;
-            this->idx_selected++;
-        }
+    int row = this->viewport.selected;
+    if (row < 0 || row >= list_view_shown_count(this))
+        return;
+
+    int index = this->filter ? this->matches[row] : row;
+
+    list_view_item_free(this->items[index]);
+    memmove(&this->items[index], &this->items[index + 1],
+            (this->item_count - index - 1) * sizeof(*this->items));
+    this->item_count--;
 
-        if (current->prev)
-            current->prev->next = current->next;
-        if (current->next)
-            current->next->prev = current->prev;
+    /* Every later item's index changed, so the search index is rebuilt. */
+    trigram_index_clear(this->search);
+    for (int i = 0; i < this->item_count; ++i)
+        trigram_index_add(this->search, this->items[i]->text);
 
-        list_view_item_free(current);
-        this->item_count--;
-        this->idx_selected--;
-        this->lv_ops->lv_find_bottom(this);
+    if (this->filter) {
+        this->match_count = trigram_index_search(this->search, this->filter, this->matches);
+        viewport_set_length(&this->viewport, this->match_count);
     }
+    else
+        viewport_set_length(&this->viewport, this->item_count);
+
+    viewport_damage_all(&this->damage);
 }
 
 /**
  * @brief Removes all items from a list view.
  *
+ * The list keeps its capacity and its filter, so refilling it doesn't reallocate and
+ * only the matching items are shown as they're added.
+ *
  * @param this The list view to clear.
  */
 void list_view_clear(struct list_view *this)
 {
-    if (!this || !this->head)
+    if (!this)
         return;
 
-    struct list_view_item *current = this->head;
-    struct list_view_item *next;
+    for (int i = 0; i < this->item_count; ++i)
+        list_view_item_free(this->items[i]);
+
+    this->item_count = 0;
+    this->match_count = 0;
+    trigram_index_clear(this->search);
+    viewport_initialize(&this->viewport, this->viewport.height);
+    viewport_damage_all(&this->damage);
+}
 
-    while (current) {
-        next = current->next;
-        list_view_item_free(current);
-        current = next;
+/**
+ * @brief Shows only the items containing some text.
+ *
+ * Matching ignores ASCII case. The items are found through the list's search index,
+ * so this is fast enough to run on every keystroke, even for very long lists.
+ *
+ * @param filter The text to search for, or NULL or an empty string to show every item.
+ */
+void list_view_filter(struct list_view *this, const char *filter)
+{
+    if (!this)
+        return;
+
+    free(this->filter);
+    this->filter = NULL;
+
+    if (filter && filter[0] != '\0') {
+        this->filter = strdup(filter);
+        this->match_count = trigram_index_search(this->search, filter, this->matches);
     }
 
-    this->head = NULL;
-    this->tail = NULL;
-    this->selected = NULL;
-    this->top_visible = NULL;
-    this->bottom_visible = NULL;
-    this->item_count = 0;
-    this->idx_selected = -1;
+    viewport_initialize(&this->viewport, this->viewport.height);
+    viewport_set_length(&this->viewport, list_view_shown_count(this));
+    viewport_damage_all(&this->damage);
+}
+
+/**
+ * @brief Gets the text the list is filtered by.
+ *
+ * @return The filter, or NULL if every item is shown.
+ */
+const char *list_view_get_filter(struct list_view *this)
+{
+    return this->filter;
+}
+
+/**
+ * @brief Makes the next draw repaint the whole list, such as after it's been covered up.
+ */
+void list_view_invalidate(struct list_view *this)
+{
+    viewport_damage_all(&this->damage);
+}
+
+/**
+ * @brief Gets the currently selected item.
+ *
+ * @return The selected item, or NULL if the list is empty.
+ */
+struct list_view_item *list_view_get_selected(struct list_view *this)
+{
+    if (!this)
+        return NULL;
+
+    return list_view_item_at(this, this->viewport.selected);
 }
 
 /**
@@ -235,22 +330,31 @@ void list_view_clear(struct list_view *this)
  */
 void list_view_select(struct list_view *this, int index)
 {
-    if (index < 0 || index >= this->item_count)
+    if (index < 0 || index >= list_view_shown_count(this))
         return;
 
-    struct list_view_item *current = this->head;
-    for (int i = 0; i < index; ++i)
-        current = current->next;
+    viewport_select(&this->viewport, index);
+}
+
+/**
+ * @brief Selects the shown item with the given text.
+ *
+ * @return true if the item was found, or false if no shown item has that text.
+ */
+bool list_view_select_text(struct list_view *this, const char *text)
+{
+    if (!this || !text)
+        return false;
 
-    this->selected = current;
-    this->idx_selected = index;
-    current->highlight = 1;
+    for (int row = 0; row < list_view_shown_count(this); ++row) {
+        const char *item_text = list_view_item_at(this, row)->text;
 
-    current = current->next;
-    while (current) {
-        current->highlight = 0;
-        current = current->next;
+        if (item_text == text || strcmp(item_text, text) == 0) {
+            viewport_select(&this->viewport, row);
+            return true;
+        }
     }
+    return false;
 }
 
 /**
@@ -258,20 +362,8 @@ void list_view_select(struct list_view *this, int index)
  */
 void list_view_select_prev(struct list_view *this)
 {
-    if (!this || this->selected == this->head)
-        return;
-
-    struct list_view_item *current = this->selected;
-    current->highlight = 0;
-    if (current == this->top_visible) {
-        this->top_visible = current->prev;
-        this->lv_ops->lv_find_bottom(this);
-    }
-    current = current->prev;
-    current->highlight = 1;
-
-    this->selected = this->selected->prev;
-    this->idx_selected--;
+    if (this)
+        viewport_select_prev(&this->viewport);
 }
 
 /**
@@ -279,21 +371,17 @@ void list_view_select_prev(struct list_view *this)
  */
 void list_view_select_next(struct list_view *this)
 {
-    if (!this || this->selected == this->tail)
-        return;
-
-    struct list_view_item *current = this->selected;
-    current->highlight = 0;
-    if (current == this->bottom_visible && current->next) {
-        this->top_visible = this->top_visible->next;
-        this->lv_ops->lv_find_bottom(this);
-    }
-
-    current = current->next;
-    current->highlight = 1;
+    if (this)
+        viewport_select_next(&this->viewport);
+}
 
-    this->selected = this->selected->next;
-    this->idx_selected++;
+/**
+ * @brief Moves the selection down a number of items, or up if the count is negative.
+ */
+void list_view_move(struct list_view *this, int count)
+{
+    if (this)
+        viewport_move(&this->viewport, count);
 }
 
 /**
@@ -301,19 +389,8 @@ void list_view_select_next(struct list_view *this)
  */
 void list_view_select_top_visible(struct list_view *this)
 {
-    if (!this || this->selected == this->top_visible)
-        return;
-
-    struct list_view_item *current = this->selected;
-    current->highlight = 0;
-
-    while (current != this->top_visible) {
-        current = current->prev;
-        this->idx_selected--;
-    }
-
-    current->highlight = 1;
-    this->selected = current;
+    if (this)
+        viewport_select_top_visible(&this->viewport);
 }
 
 /**
@@ -321,19 +398,8 @@ void list_view_select_top_visible(struct list_view *this)
  */
 void list_view_select_bottom_visible(struct list_view *this)
 {
-    if (!this || this->selected == this->bottom_visible)
-        return;
-
-    struct list_view_item *current = this->selected;
-    current->highlight = 0;
-
-    while (current != this->bottom_visible) {
-        current = current->next;
-        this->idx_selected++;
-    }
-
-    current->highlight = 1;
-    this->selected = current;
+    if (this)
+        viewport_select_bottom_visible(&this->viewport);
 }
 
 /**
@@ -341,14 +407,8 @@ void list_view_select_bottom_visible(struct list_view *this)
  */
 void list_view_select_middle_visible(struct list_view *this)
 {
-    if (!this || this->item_count == 0)
-        return;
-
-    int midpoint = this->item_count / 2;
-
-    this->lv_ops->lv_select_top_visible(this);
-    for (int i = 0; i < midpoint; ++i)
-        this->lv_ops->lv_select_next(this);
+    if (this)
+        viewport_select_middle_visible(&this->viewport);
 }
 
 /**
@@ -356,22 +416,8 @@ void list_view_select_middle_visible(struct list_view *this)
  */
 void list_view_scroll_page_up(struct list_view *this)
 {
-    if (!this || this->item_count == 0)
-        return;
-
-    /* For restoring cursor position, if necessary. */
-    int y_pos = this->lv_ops->lv_find_cursor_pos(this);
-
-    this->lv_ops->lv_select_top_visible(this);
-    if (!this->selected->prev)
-        return;
-
-    for (int i = 0; i < this->max_visible - 1; ++i)
-        this->lv_ops->lv_select_prev(this);
-
-    /* Restore cursor position */
-    for (int i = 0; i < y_pos; ++i)
-        this->lv_ops->lv_select_next(this);
+    if (this)
+        viewport_scroll_page_up(&this->viewport);
 }
 
 /**
@@ -379,35 +425,26 @@ void list_view_scroll_page_up(struct list_view *this)
  */
 void list_view_scroll_page_down(struct list_view *this)
 {
-    if (!this || this->item_count == 0)
-        return;
-
-    /* For restoring cursor position, if necessary. */
-    int y_pos = this->lv_ops->lv_find_cursor_pos(this);
-
-    this->lv_ops->lv_select_bottom_visible(this);
-    if (!this->selected->next)
-        return;
-
-    this->lv_ops->lv_select_next(this);
-    this->top_visible = this->selected;
-    this->lv_ops->lv_find_bottom(this);
-
-    /* Restore cursor position. */
-    this->lv_ops->lv_select_top_visible(this);
-    for (int i = 0; i < y_pos; ++i)
-        this->lv_ops->lv_select_next(this);
+    if (this)
+        viewport_scroll_page_down(&this->viewport);
 }
 
-/* Draws the list view on its window. */
+/*
+ * Draws the list view on its window.
+ *
+ * Only what changed since the last draw is repainted: nothing if the list is unchanged,
+ * the two rows involved if only the selection moved, and every visible row otherwise.
+ */
 void list_view_draw(struct list_view *this)
 {
-    werase(this->win);
+    struct viewport *viewport = &this->viewport;
+    bool full = viewport_damage_is_full(&this->damage, viewport);
 
-    if (this->item_count <= 0)
+    if (!full && this->damage.selected == viewport->selected)
         return;
-    if (!this->selected)
-        this->lv_ops->lv_select_top_visible(this);
+
+    if (full)
+        werase(this->win);
 
     /* Trying to draw the whole list at once and scrolling thorugh it
      * doesn't work because drawing past the bounds of an ncurses window
@@ -420,35 +457,32 @@ void list_view_draw(struct list_view *this)
      * we can figure out which item will be the last one visible and only draw
      * the ones in that range.
      */
-    struct list_view_item *current = this->top_visible;
-    this->lv_ops->lv_find_bottom(this);
+    int bottom = list_view_find_bottom(this);
 
-    int y = 1;
-    while (current != this->bottom_visible->next) {
-        list_view_item_draw(current, this->win, y++);
-        current = current->next;
+    for (int i = viewport->top, y = 1; i <= bottom; ++i, ++y) {
+        if (!viewport_damage_has_row(&this->damage, viewport, i))
+            continue;
+
+        struct list_view_item *item = list_view_item_at(this, i);
+
+        if (!full) {
+            wmove(this->win, y, 0);
+            wclrtoeol(this->win);
+        }
+        item->highlight = (i == viewport->selected);
+        list_view_item_draw(item, this->win, y);
     }
 
+    viewport_damage_clear(&this->damage, viewport);
     wnoutrefresh(this->win);
 }
 
 /*
- * Calculates which list item is the bottommost visible.
+ * Calculates the index of the bottommost visible item.
  */
-void list_view_find_bottom(struct list_view *this)
+int list_view_find_bottom(struct list_view *this)
 {
-    if (!this)
-        return;
-
-    int rows = getmaxy(this->win);
-    struct list_view_item *current = this->top_visible;
-
-    for (int i = 0; i < rows - 2; ++i) {
-        if (!current->next)
-            break;
-        current = current->next;
-    }
-    this->bottom_visible = current;
+    return viewport_bottom(&this->viewport);
 }
 
 /*
@@ -456,16 +490,5 @@ void list_view_find_bottom(struct list_view *this)
  */
 int list_view_find_cursor_pos(struct list_view *this)
 {
-    if (!this->top_visible)
-        return -1;
-
-    struct list_view_item *current = this->top_visible;
-    int y_pos = 0;
-
-    while (current != this->selected) {
-        ++y_pos;
-        current = current->next;
-    }
-
-    return y_pos;
+    return viewport_cursor_pos(&this->viewport);
 }
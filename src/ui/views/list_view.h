@@ -27,42 +27,49 @@
 
 #include <ncurses.h>
 
-struct list_view_item {
-    char *text;    /**< The text to display for this item. */
-    int bold;      /**< Whether to print the text in bold. */
-    int highlight; /**< Whether this item should be highlighted. */
+#include "pantomime/trigram_index.h"
+#include "viewport.h"
+
+#define LIST_VIEW_MIN_CAPACITY 64 /* The capacity of a list view's first allocation. */
 
-    struct list_view_item *prev; /**< The next item in the list. */
-    struct list_view_item *next; /**< The previous item in the list. */
+struct list_view_item {
+    const char *text; /**< The text to display for this item. */
+    char *owned_text; /**< The item's own copy of its text, or NULL if the text is interned. */
+    int bold;         /**< Whether to print the text in bold. */
+    int highlight;    /**< Whether this item should be highlighted. */
 };
 
 struct list_view {
     WINDOW *win; /**< The ncurses window to draw on. */
 
-    struct list_view_item *head;     /**< The first item in the list. */
-    struct list_view_item *tail;     /**< The last item in the list. */
-    struct list_view_item *selected; /**< The currently selected item. */
+    struct list_view_item **items; /**< The items in the list, in order. */
+    int item_count;                /**< The number of items in the list. */
+    int capacity;                  /**< The number of items there is room for. */
 
-    struct list_view_item *top_visible;    /**< Topmost visible item in the list. */
-    struct list_view_item *bottom_visible; /**< Bottommost visible item in the list. */
+    struct trigram_index *search; /**< The items' text, indexed for filtering. */
+    char *filter;                 /**< Only items containing this are shown, if it's set. */
+    int *matches;                 /**< The indices of the items shown while filtering. */
+    int match_count;              /**< The number of items shown while filtering. */
 
-    int item_count;   /**< The number of items in the list. */
-    int idx_selected; /**< The index of the currently selected item. */
-    int max_visible;  /**< Max number of items that can be displayed with the current window
-                         dimensions. */
+    struct viewport viewport;      /**< The selection and scroll position, over the items shown. */
+    struct viewport_damage damage; /**< What needs repainting on the next draw. */
 
     const struct list_view_operations *lv_ops; /* Callbacks for list view. */
 };
 
 struct list_view_operations {
-    void (*lv_append)(struct list_view *, char *);
+    void (*lv_append)(struct list_view *, const char *);
 
     void (*lv_remove_selected)(struct list_view *);
     void (*lv_clear)(struct list_view *);
 
+    void (*lv_filter)(struct list_view *, const char *);
+
+    struct list_view_item *(*lv_get_selected)(struct list_view *);
     void (*lv_select)(struct list_view *, int);
     void (*lv_select_prev)(struct list_view *);
     void (*lv_select_next)(struct list_view *);
+    void (*lv_move)(struct list_view *, int);
     void (*lv_select_top_visible)(struct list_view *);
     void (*lv_select_bottom_visible)(struct list_view *);
     void (*lv_select_middle_visible)(struct list_view *);
@@ -70,14 +77,14 @@ struct list_view_operations {
     void (*lv_scroll_page_up)(struct list_view *);
     void (*lv_scroll_page_down)(struct list_view *);
 
-    void (*lv_find_bottom)(struct list_view *);
+    int (*lv_find_bottom)(struct list_view *);
     int (*lv_find_cursor_pos)(struct list_view *);
 
     void (*lv_draw)(struct list_view *);
 };
 
-struct list_view_item *list_view_item_new(char *text);
-void list_view_item_initialize(struct list_view_item *this, char *text);
+struct list_view_item *list_view_item_new(const char *text, bool interned);
+void list_view_item_initialize(struct list_view_item *this, const char *text, bool interned);
 void list_view_item_free(struct list_view_item *this);
 void list_view_item_draw(struct list_view_item *this, WINDOW *win, unsigned y);
 
@@ -85,14 +92,22 @@ struct list_view *list_view_new(int height, int width);
 void list_view_initialize(struct list_view *this, int height, int width);
 void list_view_free(struct list_view *this);
 
-void list_view_append(struct list_view *this, char *text);
+void list_view_append(struct list_view *this, const char *text);
+void list_view_append_interned(struct list_view *this, const char *text);
 
 void list_view_remove_selected(struct list_view *this);
 void list_view_clear(struct list_view *this);
 
+void list_view_filter(struct list_view *this, const char *filter);
+const char *list_view_get_filter(struct list_view *this);
+void list_view_invalidate(struct list_view *this);
+
+struct list_view_item *list_view_get_selected(struct list_view *this);
 void list_view_select(struct list_view *this, int index);
+bool list_view_select_text(struct list_view *this, const char *text);
 void list_view_select_prev(struct list_view *this);
 void list_view_select_next(struct list_view *this);
+void list_view_move(struct list_view *this, int count);
 void list_view_select_top_visible(struct list_view *this);
 void list_view_select_bottom_visible(struct list_view *this);
 void list_view_select_middle_visible(struct list_view *this);
@@ -102,7 +117,7 @@ void list_view_scroll_page_down(struct list_view *this);
 
 void list_view_draw(struct list_view *this);
 
-void list_view_find_bottom(struct list_view *this);
+int list_view_find_bottom(struct list_view *this);
 int list_view_find_cursor_pos(struct list_view *this);
 
 #endif /* LIST_VIEW_H */
@@ -36,7 +36,7 @@ struct playlist_view_item *playlist_view_item_new(char *artist, char *title, cha
 void playlist_view_item_initialize(struct playlist_view_item *this, char *artist, char *title,
                                    char *album, int time, unsigned id)
 {
-    list_view_item_initialize((struct list_view_item *)this, NULL);
+    list_view_item_initialize((struct list_view_item *)this, "", true);
     this->artist = artist;
     this->title = title;
     this->album = album;
@@ -0,0 +1,241 @@
+/*******************************************************************************
+ * viewport.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file viewport.h
+ */
+
+#include "viewport.h"
+
+void viewport_initialize(struct viewport *viewport, int height)
+{
+    viewport->length = 0;
+    viewport->height = (height > 0) ? height : 1;
+    viewport->selected = -1;
+    viewport->top = 0;
+}
+
+/**
+ * @brief Scrolls as little as possible to bring the selected row on screen, and keeps
+ * the top row in bounds.
+ */
+static void viewport_clamp(struct viewport *viewport)
+{
+    if (viewport->length == 0) {
+        viewport->selected = -1;
+        viewport->top = 0;
+        return;
+    }
+
+    if (viewport->selected < 0)
+        viewport->selected = 0;
+    if (viewport->selected >= viewport->length)
+        viewport->selected = viewport->length - 1;
+
+    if (viewport->top > viewport->selected)
+        viewport->top = viewport->selected;
+    if (viewport->top < viewport->selected - (viewport->height - 1))
+        viewport->top = viewport->selected - (viewport->height - 1);
+    if (viewport->top < 0)
+        viewport->top = 0;
+}
+
+/**
+ * @brief Changes the number of rows, keeping the selection and scroll position
+ * where possible.
+ *
+ * If the list shrinks past the bottom of the screen, it scrolls back so the last
+ * page is full.
+ */
+void viewport_set_length(struct viewport *viewport, int length)
+{
+    viewport->length = (length > 0) ? length : 0;
+
+    if (viewport->top > viewport->length - viewport->height)
+        viewport->top = viewport->length - viewport->height;
+    viewport_clamp(viewport);
+}
+
+void viewport_set_height(struct viewport *viewport, int height)
+{
+    viewport->height = (height > 0) ? height : 1;
+    viewport_clamp(viewport);
+}
+
+/**
+ * @brief Selects the row at the given index, scrolling if it's off screen.
+ *
+ * Indices past either end of the list select the first or last row.
+ */
+void viewport_select(struct viewport *viewport, int index)
+{
+    viewport->selected = index;
+    viewport_clamp(viewport);
+}
+
+void viewport_select_prev(struct viewport *viewport)
+{
+    if (viewport->selected > 0)
+        viewport_select(viewport, viewport->selected - 1);
+}
+
+void viewport_select_next(struct viewport *viewport)
+{
+    if (viewport->selected < viewport->length - 1)
+        viewport_select(viewport, viewport->selected + 1);
+}
+
+/**
+ * @brief Moves the selection by a number of rows at once, stopping at either end.
+ *
+ * @param count The number of rows to move down, or up if negative.
+ */
+void viewport_move(struct viewport *viewport, int count)
+{
+    if (viewport->length > 0 && count != 0)
+        viewport_select(viewport, viewport->selected + count);
+}
+
+void viewport_select_top_visible(struct viewport *viewport)
+{
+    viewport_select(viewport, viewport->top);
+}
+
+void viewport_select_bottom_visible(struct viewport *viewport)
+{
+    viewport_select(viewport, viewport_bottom(viewport));
+}
+
+void viewport_select_middle_visible(struct viewport *viewport)
+{
+    int middle = viewport->top + viewport->height / 2;
+    int bottom = viewport_bottom(viewport);
+
+    viewport_select(viewport, (middle < bottom) ? middle : bottom);
+}
+
+/**
+ * @brief Scrolls up one page, keeping the cursor at the same place on screen.
+ *
+ * On the first page, the first row is selected instead.
+ */
+void viewport_scroll_page_up(struct viewport *viewport)
+{
+    if (viewport->length == 0)
+        return;
+
+    int cursor_pos = viewport_cursor_pos(viewport);
+
+    if (viewport->top == 0) {
+        viewport_select(viewport, 0);
+        return;
+    }
+
+    viewport->top -= viewport->height;
+    if (viewport->top < 0)
+        viewport->top = 0;
+    viewport_select(viewport, viewport->top + cursor_pos);
+}
+
+/**
+ * @brief Scrolls down one page, keeping the cursor at the same place on screen.
+ *
+ * On the last page, the last row is selected instead.
+ */
+void viewport_scroll_page_down(struct viewport *viewport)
+{
+    if (viewport->length == 0)
+        return;
+
+    int cursor_pos = viewport_cursor_pos(viewport);
+    int bottom = viewport_bottom(viewport);
+
+    if (bottom == viewport->length - 1) {
+        viewport_select(viewport, bottom);
+        return;
+    }
+
+    viewport->top = bottom + 1;
+    viewport_select(viewport, viewport->top + cursor_pos);
+}
+
+/**
+ * @brief Finds the index of the last visible row.
+ *
+ * @return The index of the bottommost visible row, or -1 if the list is empty.
+ */
+int viewport_bottom(struct viewport *viewport)
+{
+    int bottom = viewport->top + viewport->height - 1;
+
+    return (bottom < viewport->length) ? bottom : viewport->length - 1;
+}
+
+/**
+ * @brief Finds the y-position of the cursor, counting from the top visible row.
+ *
+ * @return The cursor's position, or -1 if the list is empty.
+ */
+int viewport_cursor_pos(struct viewport *viewport)
+{
+    if (viewport->selected < 0)
+        return -1;
+
+    return viewport->selected - viewport->top;
+}
+
+/**
+ * @brief Marks every row for repainting, such as after the rows themselves change.
+ */
+void viewport_damage_all(struct viewport_damage *damage)
+{
+    damage->full = true;
+}
+
+/**
+ * @brief Checks whether the whole view needs repainting.
+ *
+ * @return true if the rows changed or the view scrolled since it was last drawn.
+ */
+bool viewport_damage_is_full(struct viewport_damage *damage, struct viewport *viewport)
+{
+    return damage->full || damage->top != viewport->top || damage->height != viewport->height;
+}
+
+/**
+ * @brief Checks whether a visible row needs repainting.
+ *
+ * @return true if the whole view needs repainting, or the row gained or lost the selection.
+ */
+bool viewport_damage_has_row(struct viewport_damage *damage, struct viewport *viewport, int row)
+{
+    return viewport_damage_is_full(damage, viewport) || row == damage->selected ||
+           row == viewport->selected;
+}
+
+/**
+ * @brief Records that a view has been drawn.
+ */
+void viewport_damage_clear(struct viewport_damage *damage, struct viewport *viewport)
+{
+    damage->full = false;
+    damage->top = viewport->top;
+    damage->height = viewport->height;
+    damage->selected = viewport->selected;
+}
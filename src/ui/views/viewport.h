@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * viewport.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file viewport.h
+ * @brief Index-based scrolling for views that show a window onto a longer list.
+ *
+ * A viewport only tracks indices: how many rows there are, how many fit on screen,
+ * which row is selected, and which row is at the top. Every operation takes constant
+ * time, so views can navigate lists of any length without walking them.
+ *
+ * Views also use a viewport_damage to remember what they last drew. Moving the
+ * selection only repaints the two rows involved; scrolling, resizing, or changing the
+ * rows themselves repaints everything on screen.
+ */
+
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+#include <stdbool.h>
+
+struct viewport {
+    int length;   /**< The number of rows in the list. */
+    int height;   /**< The number of rows that fit on screen. */
+    int selected; /**< The index of the selected row, or -1 if the list is empty. */
+    int top;      /**< The index of the first visible row. */
+};
+
+/**
+ * @brief What a view showed when it was last drawn.
+ */
+struct viewport_damage {
+    bool full;    /**< Whether every visible row needs repainting. */
+    int top;      /**< The first visible row when last drawn. */
+    int height;   /**< The number of visible rows when last drawn. */
+    int selected; /**< The selected row when last drawn. */
+};
+
+void viewport_initialize(struct viewport *viewport, int height);
+
+void viewport_set_length(struct viewport *viewport, int length);
+void viewport_set_height(struct viewport *viewport, int height);
+
+void viewport_select(struct viewport *viewport, int index);
+void viewport_select_prev(struct viewport *viewport);
+void viewport_select_next(struct viewport *viewport);
+void viewport_move(struct viewport *viewport, int count);
+void viewport_select_top_visible(struct viewport *viewport);
+void viewport_select_bottom_visible(struct viewport *viewport);
+void viewport_select_middle_visible(struct viewport *viewport);
+
+void viewport_scroll_page_up(struct viewport *viewport);
+void viewport_scroll_page_down(struct viewport *viewport);
+
+int viewport_bottom(struct viewport *viewport);
+int viewport_cursor_pos(struct viewport *viewport);
+
+void viewport_damage_all(struct viewport_damage *damage);
+bool viewport_damage_is_full(struct viewport_damage *damage, struct viewport *viewport);
+bool viewport_damage_has_row(struct viewport_damage *damage, struct viewport *viewport, int row);
+void viewport_damage_clear(struct viewport_damage *damage, struct viewport *viewport);
+
+#endif /* VIEWPORT_H */
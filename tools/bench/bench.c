@@ -0,0 +1,857 @@
+/*******************************************************************************
+ * bench.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file bench.c
+ * @brief Microbenchmarks for the core data structures and views.
+ *
+ * Each benchmark runs at several sizes and reports the time and the number of heap
+ * allocations per operation. Allocations are counted by wrapping the C library's
+ * allocator, so they include everything allocated on the benchmark's behalf, down to
+ * libmpdclient and ncurses. Inputs are generated from a fixed seed, so every run measures
+ * the same work.
+ */
+
+#include <argp.h>
+#include <mpd/client.h>
+#include <ncurses.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "command/command.h"
+#include "mpdwrapper/mpdwrapper.h"
+#include "pantomime/arena.h"
+#include "pantomime/intern.h"
+#include "pantomime/stringlist.h"
+#include "ui/playlist.h"
+#include "ui/statusbar.h"
+#include "ui/views/list_view.h"
+
+#define BENCH_MIN_RUNS 3          /* Every benchmark runs at least this many times per size. */
+#define BENCH_MAX_RUNS 1000       /* Cheap benchmarks stop repeating after this many runs... */
+#define BENCH_MIN_TIME 200000000  /* ...or once they've run for this many nanoseconds. */
+#define BENCH_SEED 0x2545f491     /* Seeds the generator before each run. */
+#define BENCH_DRAW_OPS 10000      /* The most operations a benchmark that draws runs. */
+#define BENCH_QUADRATIC_OPS 100   /* The most operations a benchmark with O(n) operations runs. */
+#define BENCH_FILTER "track 1"    /* The text the views are filtered by. */
+#define BENCH_SYNC_OPS 1000       /* The most queue changes a filtered sync benchmark applies. */
+
+static const int bench_sizes[] = {1000, 10000, 100000, 1000000};
+
+/* Allocation Counting */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long long bench_allocations; /* Calls to the allocator so far. */
+
+void *malloc(size_t size)
+{
+    ++bench_allocations;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    ++bench_allocations;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    ++bench_allocations;
+    return __libc_realloc(ptr, size);
+}
+
+/* Inputs */
+
+static uint32_t bench_seed = BENCH_SEED;
+
+/**
+ * @brief Gets the next number from a xorshift generator.
+ */
+static uint32_t bench_random()
+{
+    bench_seed ^= bench_seed << 13;
+    bench_seed ^= bench_seed >> 17;
+    bench_seed ^= bench_seed << 5;
+
+    return bench_seed;
+}
+
+/**
+ * @brief Gets the monotonic time in nanoseconds.
+ */
+static uint64_t bench_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void bench_fail(const char *what)
+{
+    fprintf(stderr, "pantomime-bench: couldn't %s\n", what);
+    exit(1);
+}
+
+static struct arena bench_arena;         /* Holds the shared songs. */
+static struct queue_song **bench_songs; /* Songs shared by every benchmark that needs them. */
+static char **bench_texts;              /* Lines of text for the list views. */
+static int bench_input_count;           /* The number of songs and lines generated so far. */
+
+/**
+ * @brief Builds a song like the ones the worker reads from the server.
+ */
+static struct queue_song *bench_song_new(int i)
+{
+    char uri[64], artist[32], album[32], title[32];
+
+    snprintf(uri, sizeof(uri), "artist %d/album %d/track %d.flac", i / 120, i / 12, i);
+    snprintf(artist, sizeof(artist), "Artist %d", i / 120);
+    snprintf(album, sizeof(album), "Album %d", i / 12);
+    snprintf(title, sizeof(title), "Track %d", i);
+
+    struct queue_song song = {
+        .id = i + 1,
+        .duration = 120 + bench_random() % 360,
+        .artist_id = intern(artist),
+        .album_id = intern(album),
+        .uri = uri,
+        .title = title,
+    };
+
+    struct queue_song *copy = queue_song_copy(&bench_arena, &song);
+    if (!copy)
+        bench_fail("allocate a song");
+
+    return copy;
+}
+
+/**
+ * @brief Makes sure there are at least the given number of songs and lines of text.
+ *
+ * The inputs are only ever added to, so smaller sizes reuse the start of what larger
+ * ones generated.
+ */
+static void bench_generate_inputs(int count)
+{
+    if (count <= bench_input_count)
+        return;
+
+    bench_songs = realloc(bench_songs, count * sizeof(*bench_songs));
+    bench_texts = realloc(bench_texts, count * sizeof(*bench_texts));
+    if (!bench_songs || !bench_texts)
+        bench_fail("allocate the inputs");
+
+    char text[64];
+    uint32_t seed = bench_seed;
+    for (int i = bench_input_count; i < count; ++i) {
+        bench_songs[i] = bench_song_new(i);
+        snprintf(text, sizeof(text), "Artist %d - Album %d - Track %d", i / 120, i / 12, i);
+        bench_texts[i] = strdup(text);
+    }
+    bench_seed = seed;
+
+    bench_input_count = count;
+}
+
+static void bench_free_inputs()
+{
+    for (int i = 0; i < bench_input_count; ++i)
+        free(bench_texts[i]);
+    arena_release(&bench_arena);
+    free(bench_songs);
+    free(bench_texts);
+}
+
+/* Songlist */
+
+static void bench_songlist_free(void *state)
+{
+    songlist_free(state);
+}
+
+static void *bench_songlist_setup_empty(int n)
+{
+    return songlist_new();
+}
+
+static void *bench_songlist_setup_full(int n)
+{
+    struct songlist *songlist = songlist_new();
+    for (int i = 0; i < n; ++i)
+        songlist_append(songlist, bench_songs[i]);
+
+    return songlist;
+}
+
+static long bench_songlist_append(void *state, int n)
+{
+    for (int i = 0; i < n; ++i)
+        songlist_append(state, bench_songs[i]);
+
+    return n;
+}
+
+static long bench_songlist_at(void *state, int n)
+{
+    struct queue_song *volatile song;
+    for (int i = 0; i < n; ++i)
+        song = songlist_at(state, bench_random() % n);
+    (void)song;
+
+    return n;
+}
+
+static long bench_songlist_find_id(void *state, int n)
+{
+    volatile int pos;
+    for (int i = 0; i < n; ++i)
+        pos = songlist_find_id(state, 1 + bench_random() % n);
+    (void)pos;
+
+    return n;
+}
+
+static long bench_songlist_clear(void *state, int n)
+{
+    songlist_clear(state);
+
+    return n;
+}
+
+/* Playlist */
+
+/**
+ * @brief A playlist over the shared songs, read the way the queue view reads its songs.
+ */
+struct bench_playlist {
+    WINDOW *win;
+    struct playlist *playlist;
+    struct songlist *queue; /* Every song the playlist can be asked to show. */
+    int length;             /* The number of songs the playlist's source holds. */
+};
+
+static int bench_playlist_length(void *data)
+{
+    return ((struct bench_playlist *)data)->length;
+}
+
+static bool bench_playlist_row_at(void *data, int index, struct playlist_row *row)
+{
+    struct bench_playlist *bench = data;
+    if (index >= bench->length)
+        return false;
+
+    playlist_row_from_song(row, songlist_at(bench->queue, index));
+    return true;
+}
+
+static void bench_playlist_columns(void *data, struct queue_columns *columns)
+{
+    struct bench_playlist *bench = data;
+
+    songlist_get_columns(bench->queue, columns);
+    columns->count = bench->length;
+}
+
+static int bench_playlist_find_id(void *data, unsigned id)
+{
+    struct bench_playlist *bench = data;
+    int index = songlist_find_id(bench->queue, id);
+
+    return index < bench->length ? index : -1;
+}
+
+static const struct playlist_source bench_playlist_source = {
+    .length = bench_playlist_length,
+    .row_at = bench_playlist_row_at,
+    .columns = bench_playlist_columns,
+    .find_id = bench_playlist_find_id,
+};
+
+static bool bench_playlist_take_changes(void *data, const unsigned **ids, int *count)
+{
+    return songlist_take_changes(((struct bench_playlist *)data)->queue, ids, count);
+}
+
+/* Reports which songs changed, the way the queue view's source does. */
+static const struct playlist_source bench_tracked_source = {
+    .length = bench_playlist_length,
+    .row_at = bench_playlist_row_at,
+    .columns = bench_playlist_columns,
+    .find_id = bench_playlist_find_id,
+    .take_changes = bench_playlist_take_changes,
+};
+
+static void *bench_playlist_setup(int length, int n)
+{
+    struct bench_playlist *bench = malloc(sizeof(*bench));
+    if (!bench)
+        bench_fail("allocate a playlist");
+
+    bench->queue = songlist_new();
+    for (int i = 0; i < n; ++i)
+        songlist_append(bench->queue, bench_songs[i]);
+
+    bench->win = newwin(LINES - 2, COLS, 0, 0);
+    bench->length = length;
+    bench->playlist = playlist_init(bench->win, &bench_playlist_source, bench);
+
+    return bench;
+}
+
+static void *bench_playlist_setup_empty(int n)
+{
+    return bench_playlist_setup(0, n);
+}
+
+static void *bench_playlist_setup_full(int n)
+{
+    return bench_playlist_setup(n, n);
+}
+
+static void *bench_playlist_setup_filtered(int n)
+{
+    struct bench_playlist *bench = bench_playlist_setup(n, n);
+
+    playlist_free(bench->playlist);
+    bench->playlist = playlist_init(bench->win, &bench_tracked_source, bench);
+    playlist_filter(bench->playlist, BENCH_FILTER);
+
+    return bench;
+}
+
+static void bench_playlist_free(void *state)
+{
+    struct bench_playlist *bench = state;
+
+    playlist_free(bench->playlist);
+    songlist_free(bench->queue);
+    delwin(bench->win);
+    free(bench);
+}
+
+static long bench_playlist_populate(void *state, int n)
+{
+    struct bench_playlist *bench = state;
+
+    bench->length = n;
+    playlist_sync(bench->playlist);
+
+    return 1;
+}
+
+static long bench_playlist_clear(void *state, int n)
+{
+    struct bench_playlist *bench = state;
+
+    bench->length = 0;
+    playlist_sync(bench->playlist);
+
+    return 1;
+}
+
+static long bench_playlist_filter(void *state, int n)
+{
+    struct bench_playlist *bench = state;
+    playlist_filter(bench->playlist, BENCH_FILTER);
+
+    return n;
+}
+
+static long bench_playlist_filter_typed(void *state, int n)
+{
+    /* Each operation is one keystroke of a search typed into an already indexed playlist. */
+    static const char *const typed[] = {"a", "al", "alb", "albu", "album", "album ",
+                                        "album 4", "album 43", "album 432", "album 4321"};
+    struct bench_playlist *bench = state;
+
+    n = n < BENCH_SYNC_OPS ? n : BENCH_SYNC_OPS;
+    for (int i = 0; i < n; ++i)
+        playlist_filter(bench->playlist, typed[i % (sizeof(typed) / sizeof(typed[0]))]);
+
+    return n;
+}
+
+static long bench_playlist_sync_filtered(void *state, int n)
+{
+    struct bench_playlist *bench = state;
+
+    /* Each sync sees one song replaced, as when the server retags a song in the queue. */
+    n = n < BENCH_SYNC_OPS ? n : BENCH_SYNC_OPS;
+    for (int i = 0; i < n; ++i) {
+        songlist_touch(bench->queue, 1 + bench_random() % bench->length);
+        playlist_sync(bench->playlist);
+    }
+
+    return n;
+}
+
+static long bench_playlist_navigate(void *state, int n)
+{
+    struct bench_playlist *bench = state;
+
+    for (int i = 0; i < n; ++i) {
+        if (i % 16 == 15)
+            playlist_scroll_page_down(bench->playlist);
+        else
+            playlist_select_next(bench->playlist);
+    }
+
+    return n;
+}
+
+static long bench_playlist_navigate_draw(void *state, int n)
+{
+    struct bench_playlist *bench = state;
+
+    n = n < BENCH_DRAW_OPS ? n : BENCH_DRAW_OPS;
+    for (int i = 0; i < n; ++i) {
+        playlist_select_next(bench->playlist);
+        playlist_draw(bench->playlist, 0);
+    }
+
+    return n;
+}
+
+/* List View */
+
+static void *bench_list_view_setup_empty(int n)
+{
+    struct list_view *view = list_view_new(LINES - 2, COLS);
+    if (!view)
+        bench_fail("allocate a list view");
+
+    return view;
+}
+
+static void *bench_list_view_setup_full(int n)
+{
+    struct list_view *view = bench_list_view_setup_empty(n);
+    for (int i = 0; i < n; ++i)
+        list_view_append(view, bench_texts[i]);
+
+    return view;
+}
+
+static void bench_list_view_free(void *state)
+{
+    struct list_view *view = state;
+
+    delwin(view->win);
+    list_view_free(view);
+}
+
+static long bench_list_view_append(void *state, int n)
+{
+    for (int i = 0; i < n; ++i)
+        list_view_append(state, bench_texts[i]);
+
+    return n;
+}
+
+static long bench_list_view_navigate(void *state, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        if (i % 16 == 15)
+            list_view_scroll_page_down(state);
+        else
+            list_view_select_next(state);
+    }
+
+    return n;
+}
+
+static long bench_list_view_filter(void *state, int n)
+{
+    list_view_filter(state, BENCH_FILTER);
+
+    return n;
+}
+
+static long bench_list_view_remove_selected(void *state, int n)
+{
+    n = n < BENCH_QUADRATIC_OPS ? n : BENCH_QUADRATIC_OPS;
+    list_view_select(state, ((struct list_view *)state)->item_count / 2);
+    for (int i = 0; i < n; ++i)
+        list_view_remove_selected(state);
+
+    return n;
+}
+
+static long bench_list_view_clear(void *state, int n)
+{
+    list_view_clear(state);
+
+    return n;
+}
+
+/* Stringlist */
+
+static char bench_string[] = "Artist - Album - Track";
+
+static void *bench_stringlist_setup_empty(int n)
+{
+    return stringlist_new();
+}
+
+static void *bench_stringlist_setup_full(int n)
+{
+    struct stringlist *list = stringlist_new();
+    for (int i = 0; i < n; ++i)
+        stringlist_append(list, bench_string);
+
+    return list;
+}
+
+static void bench_stringlist_free(void *state)
+{
+    stringlist_free(state);
+}
+
+static long bench_stringlist_append(void *state, int n)
+{
+    for (int i = 0; i < n; ++i)
+        stringlist_append(state, bench_string);
+
+    return n;
+}
+
+static long bench_stringlist_remove_head(void *state, int n)
+{
+    for (int i = 0; i < n; ++i)
+        stringlist_remove(state, 0);
+
+    return n;
+}
+
+static long bench_stringlist_remove_middle(void *state, int n)
+{
+    struct stringlist *list = state;
+
+    n = n < BENCH_QUADRATIC_OPS ? n : BENCH_QUADRATIC_OPS;
+    for (int i = 0; i < n; ++i)
+        stringlist_remove(list, list->item_count / 2);
+
+    return n;
+}
+
+static long bench_stringlist_clear(void *state, int n)
+{
+    stringlist_clear(state);
+
+    return n;
+}
+
+/* Commands and Labels */
+
+static void *bench_setup_none(int n)
+{
+    return NULL;
+}
+
+static void bench_free_none(void *state)
+{
+}
+
+static void *bench_setup_keymap(int n)
+{
+    build_keymap();
+    return NULL;
+}
+
+static long bench_find_key_command(void *state, int n)
+{
+    /* Mostly bound keys, with a few that aren't bound to anything. */
+    static const int keys[] = {'j', 'k', 'g', 'G', 'p', 'q', '1', '2', '3', 'r',
+                               'z', 's', 'c', 'x', '<', '>', '/', 'Q', '%', KEY_UP,
+                               KEY_DOWN, KEY_NPAGE, KEY_PPAGE, KEY_F(12)};
+    volatile enum command_type cmd;
+
+    for (int i = 0; i < n; ++i)
+        cmd = find_key_command(keys[bench_random() % (sizeof(keys) / sizeof(keys[0]))]);
+    (void)cmd;
+
+    return n;
+}
+
+static long bench_get_command_keys(void *state, int n)
+{
+    volatile size_t length = 0;
+
+    for (int i = 0; i < n; ++i)
+        length += strlen(get_command_keys(1 + bench_random() % (NUM_CMDS - 1)));
+    (void)length;
+
+    return n;
+}
+
+/**
+ * @brief Binds a spare key to a command and unbinds it again, checking the keymap each time.
+ *
+ * The key and command are looked up by name, the same way --bind reads them.
+ */
+static long bench_bind_key(void *state, int n)
+{
+    int key = str_to_key("f12");
+    enum command_type cmd = find_command("stop");
+
+    if (key != KEY_F(12) || cmd != CMD_STOP)
+        bench_fail("look up a key or command by name");
+
+    for (int i = 0; i < n; ++i) {
+        if (!bind_key(key, cmd) || find_key_command(key) != cmd ||
+            !strstr(get_command_keys(cmd), "F12"))
+            bench_fail("bind a key");
+
+        unbind_key(key);
+        if (find_key_command(key) != CMD_NULL || strstr(get_command_keys(cmd), "F12"))
+            bench_fail("unbind a key");
+    }
+
+    return 2 * n;
+}
+
+static long bench_statusbar_label_progress(void *state, int n)
+{
+    char *label = NULL;
+    for (int i = 0; i < n; ++i)
+        label = statusbar_create_label_progress(label, i % 3600, 3600);
+    free(label);
+
+    return n;
+}
+
+static long bench_statusbar_label_song(void *state, int n)
+{
+    char *label = NULL;
+    for (int i = 0; i < n; ++i)
+        label = statusbar_create_label_song(label, bench_songs[i]->title,
+                                            intern_string(bench_songs[i]->artist_id));
+    free(label);
+
+    return n;
+}
+
+static void *bench_status_setup(int n)
+{
+    static const struct mpd_pair pairs[] = {
+        {"repeat", "1"}, {"random", "0"}, {"single", "1"}, {"consume", "0"}, {"xfade", "5"},
+    };
+
+    struct mpd_status *status = mpd_status_begin();
+    if (!status)
+        bench_fail("allocate a status");
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); ++i)
+        mpd_status_feed(status, &pairs[i]);
+
+    return status;
+}
+
+static void bench_status_free(void *state)
+{
+    mpd_status_free(state);
+}
+
+static long bench_statusbar_label_modes(void *state, int n)
+{
+    char *label = NULL;
+    for (int i = 0; i < n; ++i)
+        label = statusbar_create_label_modes(label, state);
+    free(label);
+
+    return n;
+}
+
+/* Running */
+
+/**
+ * @brief A benchmark, run once per size.
+ *
+ * Only the run callback is timed. It gets a fresh state from the setup callback each time.
+ */
+struct bench_case {
+    const char *name;
+    void *(*setup)(int n);
+    long (*run)(void *state, int n); /* Returns the number of operations it performed. */
+    void (*teardown)(void *state);
+};
+
+static const struct bench_case bench_cases[] = {
+    {"songlist_append", bench_songlist_setup_empty, bench_songlist_append, bench_songlist_free},
+    {"songlist_at", bench_songlist_setup_full, bench_songlist_at, bench_songlist_free},
+    {"songlist_find_id", bench_songlist_setup_full, bench_songlist_find_id, bench_songlist_free},
+    {"songlist_clear", bench_songlist_setup_full, bench_songlist_clear, bench_songlist_free},
+    {"playlist_populate", bench_playlist_setup_empty, bench_playlist_populate,
+     bench_playlist_free},
+    {"playlist_clear", bench_playlist_setup_full, bench_playlist_clear, bench_playlist_free},
+    {"playlist_filter", bench_playlist_setup_full, bench_playlist_filter, bench_playlist_free},
+    {"playlist_filter_typed", bench_playlist_setup_filtered, bench_playlist_filter_typed,
+     bench_playlist_free},
+    {"playlist_sync_filtered", bench_playlist_setup_filtered, bench_playlist_sync_filtered,
+     bench_playlist_free},
+    {"playlist_navigate", bench_playlist_setup_full, bench_playlist_navigate,
+     bench_playlist_free},
+    {"playlist_navigate_draw", bench_playlist_setup_full, bench_playlist_navigate_draw,
+     bench_playlist_free},
+    {"list_view_append", bench_list_view_setup_empty, bench_list_view_append,
+     bench_list_view_free},
+    {"list_view_navigate", bench_list_view_setup_full, bench_list_view_navigate,
+     bench_list_view_free},
+    {"list_view_filter", bench_list_view_setup_full, bench_list_view_filter,
+     bench_list_view_free},
+    {"list_view_remove_selected", bench_list_view_setup_full, bench_list_view_remove_selected,
+     bench_list_view_free},
+    {"list_view_clear", bench_list_view_setup_full, bench_list_view_clear, bench_list_view_free},
+    {"stringlist_append", bench_stringlist_setup_empty, bench_stringlist_append,
+     bench_stringlist_free},
+    {"stringlist_remove_head", bench_stringlist_setup_full, bench_stringlist_remove_head,
+     bench_stringlist_free},
+    {"stringlist_remove_middle", bench_stringlist_setup_full, bench_stringlist_remove_middle,
+     bench_stringlist_free},
+    {"stringlist_clear", bench_stringlist_setup_full, bench_stringlist_clear,
+     bench_stringlist_free},
+    {"find_key_command", bench_setup_keymap, bench_find_key_command, bench_free_none},
+    {"get_command_keys", bench_setup_keymap, bench_get_command_keys, bench_free_none},
+    {"bind_key", bench_setup_keymap, bench_bind_key, bench_free_none},
+    {"statusbar_create_label_progress", bench_setup_none, bench_statusbar_label_progress,
+     bench_free_none},
+    {"statusbar_create_label_song", bench_setup_none, bench_statusbar_label_song,
+     bench_free_none},
+    {"statusbar_create_label_modes", bench_status_setup, bench_statusbar_label_modes,
+     bench_status_free},
+};
+
+/**
+ * @brief Runs a benchmark at one size and prints its fastest run.
+ *
+ * Cheap benchmarks are repeated until they've run long enough to give a stable time.
+ */
+static void bench_measure(const struct bench_case *bench, int n)
+{
+    double best_ns = 0;
+    double allocs = 0;
+    long ops = 0;
+    uint64_t spent = 0;
+
+    for (int run = 0; run < BENCH_MIN_RUNS || (spent < BENCH_MIN_TIME && run < BENCH_MAX_RUNS);
+         ++run) {
+        bench_seed = BENCH_SEED;
+        void *state = bench->setup(n);
+
+        unsigned long long allocations = bench_allocations;
+        uint64_t start = bench_now();
+        ops = bench->run(state, n);
+        uint64_t elapsed = bench_now() - start;
+        allocations = bench_allocations - allocations;
+
+        bench->teardown(state);
+
+        double ns = (double)elapsed / ops;
+        if (run == 0 || ns < best_ns)
+            best_ns = ns;
+        allocs = (double)allocations / ops;
+        spent += elapsed;
+    }
+
+    printf("%-32s %8d %8ld %12.1f %10.2f\n", bench->name, n, ops, best_ns, allocs);
+    fflush(stdout);
+}
+
+/* Argument Parsing */
+
+struct bench_options {
+    const char *filter; /* Only benchmarks whose name contains this are run. */
+    int max_size;       /* Sizes larger than this are skipped. */
+};
+
+const char *argp_program_version = "pantomime-bench 0.1";
+static char doc[] = "pantomime-bench -- Microbenchmarks for pantomime's data structures and views";
+
+static struct argp_option options[] = {
+    {"filter", 'f', "TEXT", 0, "Only run benchmarks whose name contains TEXT"},
+    {"max", 'm', "SIZE", 0, "Skip sizes larger than SIZE"},
+    {0}};
+
+/* Parse a single option. */
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+    struct bench_options *arguments = state->input;
+
+    switch (key) {
+        case 'f':
+            arguments->filter = arg;
+            break;
+        case 'm':
+            arguments->max_size = atoi(arg);
+            break;
+        case ARGP_KEY_ARG:
+            argp_usage(state);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = {options, parse_opt, 0, doc};
+
+int main(int argc, char **argv)
+{
+    struct bench_options arguments = {
+        .filter = "",
+        .max_size = bench_sizes[sizeof(bench_sizes) / sizeof(bench_sizes[0]) - 1],
+    };
+    argp_parse(&argp, argc, argv, 0, 0, &arguments);
+
+    /* The views need a screen to create their windows on, but nothing is ever shown. */
+    FILE *screen_output = fopen("/dev/null", "w");
+    const char *term = getenv("TERM");
+    SCREEN *screen = newterm(term && term[0] != '\0' ? term : "vt100", screen_output, stdin);
+    if (!screen)
+        bench_fail("set up a screen");
+
+    printf("%-32s %8s %8s %12s %10s\n", "benchmark", "n", "ops", "ns/op", "allocs/op");
+
+    for (size_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); ++i) {
+        int n = bench_sizes[i];
+        if (n > arguments.max_size)
+            break;
+
+        bench_generate_inputs(n);
+        for (size_t j = 0; j < sizeof(bench_cases) / sizeof(bench_cases[0]); ++j) {
+            if (strstr(bench_cases[j].name, arguments.filter))
+                bench_measure(&bench_cases[j], n);
+        }
+    }
+
+    endwin();
+    delscreen(screen);
+    fclose(screen_output);
+    bench_free_inputs();
+
+    return 0;
+}
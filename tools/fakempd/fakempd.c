@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * fakempd.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file fakempd.h
+ */
+
+#include <argp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fakempd.h"
+
+/* Argument Parsing */
+const char *argp_program_version = "fakempd 0.1";
+static char doc[] = "fakempd -- A stand-in MPD server for testing and benchmarking pantomime";
+
+static struct argp_option options[] = {
+    {"host", 'h', "HOST", 0, "The IP address to listen on"},
+    {"port", 'p', "PORT", 0, "The port to listen on"},
+    {"artists", 'a', "COUNT", 0, "The number of artists in the library"},
+    {"albums", 'b', "COUNT", 0, "The number of albums by each artist"},
+    {"tracks", 't', "COUNT", 0, "The number of tracks on each album"},
+    {"queue", 'q', "LENGTH", 0, "The number of songs in the queue at startup"},
+    {"latency", 'l', "MS", 0, "How long to hold back each response, in milliseconds"},
+    {"throughput", 'r', "BYTES", 0, "The most bytes sent to each client per second"},
+    {"play", 'P', 0, 0, "Start playing the queue at startup"},
+    {0}};
+
+/* Parse a single option. */
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+    struct fake_options *arguments = state->input;
+
+    switch (key) {
+        case 'h':
+            arguments->host = arg;
+            break;
+        case 'p':
+            arguments->port = atoi(arg);
+            break;
+        case 'a':
+            arguments->artists = strtoul(arg, NULL, 10);
+            break;
+        case 'b':
+            arguments->albums = strtoul(arg, NULL, 10);
+            break;
+        case 't':
+            arguments->tracks = strtoul(arg, NULL, 10);
+            break;
+        case 'q':
+            arguments->queue = strtoul(arg, NULL, 10);
+            break;
+        case 'l':
+            arguments->latency = strtoul(arg, NULL, 10);
+            break;
+        case 'r':
+            arguments->throughput = strtoul(arg, NULL, 10);
+            break;
+        case 'P':
+            arguments->play = true;
+            break;
+        case ARGP_KEY_ARG:
+            argp_usage(state);
+            break;
+        case ARGP_KEY_END:
+            if (!arguments->artists || !arguments->albums || !arguments->tracks)
+                argp_error(state, "the library needs at least one song");
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = {options, parse_opt, 0, doc};
+
+int main(int argc, char **argv)
+{
+    /* Default arguments. */
+    struct fake_options arguments = {
+        .host = "127.0.0.1",
+        .port = 6601,
+        .artists = 100,
+        .albums = 10,
+        .tracks = 12,
+        .queue = 500,
+        .latency = 0,
+        .throughput = 0,
+        .play = false,
+    };
+    argp_parse(&argp, argc, argv, 0, 0, &arguments);
+
+    struct fake_server server;
+    if (!fake_server_initialize(&server, &arguments))
+        return 1;
+
+    fprintf(stderr, "fakempd: listening on %s:%d with %u songs\n", arguments.host, arguments.port,
+            server.library.song_count);
+
+    int status = fake_server_run(&server);
+    fake_server_free(&server);
+
+    return status;
+}
@@ -0,0 +1,215 @@
+/*******************************************************************************
+ * fakempd.h
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file fakempd.h
+ * @brief A stand-in MPD server, for running the client where no real MPD is installed.
+ *
+ * The server speaks enough of the MPD protocol for everything the client does: status and
+ * statistics, the queue and its change listings, database searches and listings, playback
+ * commands, and idle notifications. Its library is generated from three numbers (artists,
+ * albums per artist, and tracks per album), so every run sees the same songs, and its
+ * responses can be delayed and throttled to imitate a distant or overloaded server.
+ *
+ * Everything runs on a single thread around poll(). Nothing is meant to be fast or
+ * complete, only predictable.
+ */
+
+#ifndef FAKEMPD_H
+#define FAKEMPD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define FAKEMPD_VERSION "0.23.5" /* The protocol version sent in the greeting. */
+#define FAKEMPD_MAX_ARGS 32      /* The most arguments a command can have. */
+
+/**
+ * @brief The subsystems a client can wait on with the idle command.
+ */
+enum fake_event {
+    FAKE_EVENT_DATABASE = 1 << 0,
+    FAKE_EVENT_UPDATE = 1 << 1,
+    FAKE_EVENT_STORED_PLAYLIST = 1 << 2,
+    FAKE_EVENT_PLAYLIST = 1 << 3,
+    FAKE_EVENT_PLAYER = 1 << 4,
+    FAKE_EVENT_MIXER = 1 << 5,
+    FAKE_EVENT_OUTPUT = 1 << 6,
+    FAKE_EVENT_OPTIONS = 1 << 7,
+    FAKE_EVENT_ALL = (1 << 8) - 1
+};
+
+/**
+ * @brief The song tags a search can match on.
+ */
+enum fake_tag { FAKE_TAG_ARTIST, FAKE_TAG_ALBUM, FAKE_TAG_TITLE, FAKE_TAG_TRACK, FAKE_TAG_FILE };
+
+enum fake_state { FAKE_STATE_STOP, FAKE_STATE_PLAY, FAKE_STATE_PAUSE };
+
+/**
+ * @brief A growable byte buffer for building responses.
+ */
+struct fake_buffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+struct fake_options {
+    const char *host;    /**< The address to listen on. */
+    int port;            /**< The TCP port to listen on. */
+    unsigned artists;    /**< The number of artists in the library. */
+    unsigned albums;     /**< The number of albums by each artist. */
+    unsigned tracks;     /**< The number of tracks on each album. */
+    unsigned queue;      /**< The number of songs in the queue at startup. */
+    unsigned latency;    /**< How long each response is held back, in milliseconds. */
+    unsigned throughput; /**< The most bytes sent to each client per second, or 0 for no limit. */
+    bool play;           /**< Whether to start playing the queue at startup. */
+};
+
+/**
+ * @brief The synthetic music library.
+ *
+ * Songs aren't stored. Song n is track n % tracks of album (n / tracks) % albums by
+ * artist n / (tracks * albums), and everything about it is worked out from that.
+ */
+struct fake_library {
+    unsigned artists;
+    unsigned albums;
+    unsigned tracks;
+    unsigned song_count;
+    time_t db_update; /**< When the library was last "updated". */
+};
+
+struct fake_queue_entry {
+    unsigned song;    /**< The song's number in the library. */
+    unsigned id;      /**< The song's ID, unique for the life of the server. */
+    unsigned version; /**< The queue version in which this position last changed. */
+};
+
+struct fake_queue {
+    struct fake_queue_entry *entries;
+    unsigned length;
+    unsigned capacity;
+    unsigned version;
+    unsigned next_id;
+};
+
+struct fake_player {
+    enum fake_state state;
+    int pos;             /**< The current song's position in the queue, or -1 if there isn't one. */
+    uint64_t elapsed_ms; /**< How far into the song playback was at the time below. */
+    uint64_t since;      /**< When elapsed_ms was last set, from fake_now(). */
+    int volume;
+    bool repeat;
+    bool random;
+    bool single;
+    bool consume;
+    int crossfade;
+};
+
+struct fake_client {
+    int fd;
+    struct fake_buffer in;  /**< Received bytes that don't form a whole line yet. */
+    struct fake_buffer out; /**< Bytes waiting to be sent. */
+    size_t out_sent;        /**< How much of the output buffer has been sent. */
+    uint64_t ready_at;      /**< When the waiting output may be sent, for the latency. */
+    double tokens;          /**< Bytes that may be sent right now, for the throughput. */
+    uint64_t refilled_at;   /**< When tokens were last added. */
+
+    bool in_list;            /**< Whether a command list is being received. */
+    bool list_ok;            /**< Whether the list wants list_OK after each command. */
+    struct fake_buffer list; /**< The list's commands, each ending with a NUL byte. */
+    int list_count;
+
+    bool idle;          /**< Whether the client is waiting in idle mode. */
+    unsigned idle_mask; /**< The events the idle client is waiting for. */
+    unsigned events;    /**< Events that happened since the client last heard about them. */
+    bool closing;       /**< Whether the connection closes once the output is sent. */
+};
+
+struct fake_server {
+    struct fake_options options;
+    struct fake_library library;
+    struct fake_queue queue;
+    struct fake_player player;
+
+    int listen_fd;
+    struct fake_client **clients;
+    int client_count;
+    int client_capacity;
+
+    time_t started;     /**< When the server started, for its uptime. */
+    unsigned update_id; /**< The running database update's job ID, or 0 if there isn't one. */
+    uint64_t update_at; /**< When the running database update finishes. */
+    unsigned seed;      /**< Random state for shuffling. */
+};
+
+uint64_t fake_now(void);
+
+void fake_buffer_append(struct fake_buffer *buffer, const char *data, size_t length);
+void fake_buffer_printf(struct fake_buffer *buffer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+void fake_buffer_free(struct fake_buffer *buffer);
+
+void fake_library_initialize(struct fake_library *library, unsigned artists, unsigned albums,
+                             unsigned tracks);
+int fake_tag_parse(const char *name);
+const char *fake_tag_label(enum fake_tag tag);
+void fake_library_get_tag(const struct fake_library *library, unsigned song, enum fake_tag tag,
+                          char *buffer, size_t size);
+unsigned fake_library_get_key(const struct fake_library *library, unsigned song,
+                              enum fake_tag tag);
+unsigned fake_library_get_key_count(const struct fake_library *library, enum fake_tag tag);
+unsigned fake_library_get_duration(const struct fake_library *library, unsigned song);
+bool fake_library_find_uri(const struct fake_library *library, const char *uri,
+                           unsigned *first, unsigned *count);
+void fake_library_print_song(const struct fake_library *library, unsigned song,
+                             struct fake_buffer *out);
+
+void fake_queue_initialize(struct fake_queue *queue);
+void fake_queue_free(struct fake_queue *queue);
+unsigned fake_queue_add(struct fake_queue *queue, unsigned song);
+void fake_queue_delete(struct fake_queue *queue, unsigned start, unsigned end);
+void fake_queue_clear(struct fake_queue *queue);
+int fake_queue_find_id(const struct fake_queue *queue, unsigned id);
+
+void fake_player_initialize(struct fake_player *player);
+uint64_t fake_player_get_elapsed(const struct fake_player *player, uint64_t now);
+void fake_player_play(struct fake_server *server, int pos, uint64_t elapsed_ms);
+void fake_player_pause(struct fake_server *server, bool pause);
+void fake_player_stop(struct fake_server *server);
+void fake_player_next(struct fake_server *server);
+void fake_player_previous(struct fake_server *server);
+void fake_player_delete(struct fake_server *server, unsigned start, unsigned end);
+void fake_player_clear(struct fake_server *server);
+void fake_player_tick(struct fake_server *server, uint64_t now);
+int64_t fake_player_get_deadline(const struct fake_server *server, uint64_t now);
+
+void fake_protocol_execute(struct fake_server *server, struct fake_client *client, char *line);
+void fake_protocol_notify(struct fake_server *server, unsigned events);
+
+bool fake_server_initialize(struct fake_server *server, const struct fake_options *options);
+void fake_server_free(struct fake_server *server);
+int fake_server_run(struct fake_server *server);
+void fake_client_send(struct fake_server *server, struct fake_client *client, const char *data,
+                      size_t length);
+
+#endif /* FAKEMPD_H */
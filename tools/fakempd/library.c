@@ -0,0 +1,213 @@
+/*******************************************************************************
+ * library.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file fakempd.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "fakempd.h"
+
+/**
+ * @brief Sets up a library of artists * albums * tracks songs.
+ */
+void fake_library_initialize(struct fake_library *library, unsigned artists, unsigned albums,
+                             unsigned tracks)
+{
+    library->artists = artists;
+    library->albums = albums;
+    library->tracks = tracks;
+    library->song_count = artists * albums * tracks;
+    library->db_update = time(NULL);
+}
+
+/**
+ * @brief Looks up a tag by the name used in commands, ignoring case.
+ *
+ * @return The tag, or -1 if it isn't one the server knows.
+ */
+int fake_tag_parse(const char *name)
+{
+    if (strcasecmp(name, "artist") == 0 || strcasecmp(name, "albumartist") == 0)
+        return FAKE_TAG_ARTIST;
+    if (strcasecmp(name, "album") == 0)
+        return FAKE_TAG_ALBUM;
+    if (strcasecmp(name, "title") == 0)
+        return FAKE_TAG_TITLE;
+    if (strcasecmp(name, "track") == 0)
+        return FAKE_TAG_TRACK;
+    if (strcasecmp(name, "file") == 0)
+        return FAKE_TAG_FILE;
+    return -1;
+}
+
+/**
+ * @brief Gets the name a tag is given in responses.
+ */
+const char *fake_tag_label(enum fake_tag tag)
+{
+    static const char *labels[] = {"Artist", "Album", "Title", "Track", "file"};
+
+    return labels[tag];
+}
+
+/**
+ * @brief Writes one of a song's tags into a buffer.
+ */
+void fake_library_get_tag(const struct fake_library *library, unsigned song, enum fake_tag tag,
+                          char *buffer, size_t size)
+{
+    unsigned track = song % library->tracks;
+    unsigned album = song / library->tracks % library->albums;
+    unsigned artist = song / library->tracks / library->albums;
+
+    switch (tag) {
+        case FAKE_TAG_ARTIST:
+            snprintf(buffer, size, "Artist %04u", artist);
+            break;
+        case FAKE_TAG_ALBUM:
+            snprintf(buffer, size, "Album %04u", album);
+            break;
+        case FAKE_TAG_TITLE:
+            snprintf(buffer, size, "Track %04u", track);
+            break;
+        case FAKE_TAG_TRACK:
+            snprintf(buffer, size, "%u", track + 1);
+            break;
+        case FAKE_TAG_FILE:
+            snprintf(buffer, size, "artist%04u/album%04u/track%04u.flac", artist, album, track);
+            break;
+    }
+}
+
+/**
+ * @brief Gets a number that's the same for two songs exactly when the tag's value is.
+ *
+ * Used to list each tag value once without comparing strings.
+ */
+unsigned fake_library_get_key(const struct fake_library *library, unsigned song,
+                              enum fake_tag tag)
+{
+    switch (tag) {
+        case FAKE_TAG_ARTIST:
+            return song / library->tracks / library->albums;
+        case FAKE_TAG_ALBUM:
+            return song / library->tracks % library->albums;
+        case FAKE_TAG_TITLE:
+        case FAKE_TAG_TRACK:
+            return song % library->tracks;
+        default:
+            return song;
+    }
+}
+
+/**
+ * @brief Gets the number of distinct keys a tag can have.
+ */
+unsigned fake_library_get_key_count(const struct fake_library *library, enum fake_tag tag)
+{
+    switch (tag) {
+        case FAKE_TAG_ARTIST:
+            return library->artists;
+        case FAKE_TAG_ALBUM:
+            return library->albums;
+        case FAKE_TAG_TITLE:
+        case FAKE_TAG_TRACK:
+            return library->tracks;
+        default:
+            return library->song_count;
+    }
+}
+
+/**
+ * @brief Gets a song's length in seconds, somewhere between two and six minutes.
+ */
+unsigned fake_library_get_duration(const struct fake_library *library, unsigned song)
+{
+    (void)library;
+    return 120 + song * 37 % 240;
+}
+
+/**
+ * @brief Finds the songs under a URI.
+ *
+ * The URI can name a song, an artist's directory, or one of their albums. The songs under
+ * each directory are numbered consecutively.
+ *
+ * @param first Set to the number of the first song found.
+ * @param count Set to the number of songs found.
+ * @return true if the URI names anything in the library, false otherwise.
+ */
+bool fake_library_find_uri(const struct fake_library *library, const char *uri,
+                           unsigned *first, unsigned *count)
+{
+    unsigned artist;
+    unsigned album;
+    unsigned track;
+    int end = -1;
+
+    if (sscanf(uri, "artist%u/album%u/track%u.flac%n", &artist, &album, &track, &end) == 3 &&
+        uri[end] == '\0') {
+        *count = 1;
+    }
+    else if (sscanf(uri, "artist%u/album%u%n", &artist, &album, &end) == 2 && uri[end] == '\0') {
+        track = 0;
+        *count = library->tracks;
+    }
+    else if (sscanf(uri, "artist%u%n", &artist, &end) == 1 && uri[end] == '\0') {
+        album = 0;
+        track = 0;
+        *count = library->albums * library->tracks;
+    }
+    else
+        return false;
+
+    if (artist >= library->artists || album >= library->albums || track >= library->tracks)
+        return false;
+
+    *first = (artist * library->albums + album) * library->tracks + track;
+    return true;
+}
+
+/**
+ * @brief Writes a song's metadata the way MPD lists it.
+ */
+void fake_library_print_song(const struct fake_library *library, unsigned song,
+                             struct fake_buffer *out)
+{
+    char uri[64];
+    char artist[32];
+    char album[32];
+    char title[32];
+    unsigned duration = fake_library_get_duration(library, song);
+
+    fake_library_get_tag(library, song, FAKE_TAG_FILE, uri, sizeof(uri));
+    fake_library_get_tag(library, song, FAKE_TAG_ARTIST, artist, sizeof(artist));
+    fake_library_get_tag(library, song, FAKE_TAG_ALBUM, album, sizeof(album));
+    fake_library_get_tag(library, song, FAKE_TAG_TITLE, title, sizeof(title));
+
+    fake_buffer_printf(out,
+                       "file: %s\nLast-Modified: 2022-01-01T00:00:00Z\nArtist: %s\n"
+                       "AlbumArtist: %s\nAlbum: %s\nTitle: %s\nTrack: %u\nTime: %u\n"
+                       "duration: %u.000\n",
+                       uri, artist, artist, album, title, song % library->tracks + 1, duration,
+                       duration);
+}
@@ -0,0 +1,322 @@
+/*******************************************************************************
+ * player.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file fakempd.h
+ */
+
+#include <stdlib.h>
+
+#include "fakempd.h"
+
+void fake_queue_initialize(struct fake_queue *queue)
+{
+    queue->entries = NULL;
+    queue->length = 0;
+    queue->capacity = 0;
+    queue->version = 1;
+    queue->next_id = 1;
+}
+
+void fake_queue_free(struct fake_queue *queue)
+{
+    free(queue->entries);
+}
+
+/**
+ * @brief Adds a song to the end of the queue. The caller bumps the version first.
+ *
+ * @return The new entry's song ID.
+ */
+unsigned fake_queue_add(struct fake_queue *queue, unsigned song)
+{
+    if (queue->length == queue->capacity) {
+        queue->capacity = queue->capacity ? queue->capacity * 2 : 64;
+        queue->entries = realloc(queue->entries, queue->capacity * sizeof(*queue->entries));
+    }
+
+    struct fake_queue_entry *entry = &queue->entries[queue->length++];
+
+    entry->song = song;
+    entry->id = queue->next_id++;
+    entry->version = queue->version;
+
+    return entry->id;
+}
+
+/**
+ * @brief Removes the songs in positions [start, end). The caller bumps the version first.
+ *
+ * Every song after the removed ones moves, so each of their positions counts as changed.
+ */
+void fake_queue_delete(struct fake_queue *queue, unsigned start, unsigned end)
+{
+    unsigned removed = end - start;
+
+    for (unsigned i = start; i + removed < queue->length; ++i) {
+        queue->entries[i] = queue->entries[i + removed];
+        queue->entries[i].version = queue->version;
+    }
+    queue->length -= removed;
+}
+
+void fake_queue_clear(struct fake_queue *queue)
+{
+    queue->length = 0;
+}
+
+/**
+ * @brief Finds a song in the queue by ID.
+ *
+ * @return The song's position, or -1 if it isn't in the queue.
+ */
+int fake_queue_find_id(const struct fake_queue *queue, unsigned id)
+{
+    for (unsigned i = 0; i < queue->length; ++i) {
+        if (queue->entries[i].id == id)
+            return i;
+    }
+    return -1;
+}
+
+void fake_player_initialize(struct fake_player *player)
+{
+    player->state = FAKE_STATE_STOP;
+    player->pos = -1;
+    player->elapsed_ms = 0;
+    player->since = fake_now();
+    player->volume = 50;
+    player->repeat = false;
+    player->random = false;
+    player->single = false;
+    player->consume = false;
+    player->crossfade = 0;
+}
+
+/**
+ * @brief Gets how far into the current song playback is.
+ */
+uint64_t fake_player_get_elapsed(const struct fake_player *player, uint64_t now)
+{
+    if (player->state == FAKE_STATE_PLAY)
+        return player->elapsed_ms + (now - player->since);
+    return player->elapsed_ms;
+}
+
+/**
+ * @brief Starts playing the song at a position, from some way into it.
+ */
+void fake_player_play(struct fake_server *server, int pos, uint64_t elapsed_ms)
+{
+    struct fake_player *player = &server->player;
+
+    player->state = FAKE_STATE_PLAY;
+    player->pos = pos;
+    player->elapsed_ms = elapsed_ms;
+    player->since = fake_now();
+
+    fake_protocol_notify(server, FAKE_EVENT_PLAYER);
+}
+
+/**
+ * @brief Pauses or resumes playback. Does nothing while stopped.
+ */
+void fake_player_pause(struct fake_server *server, bool pause)
+{
+    struct fake_player *player = &server->player;
+    uint64_t now = fake_now();
+
+    if (player->state == FAKE_STATE_STOP)
+        return;
+
+    player->elapsed_ms = fake_player_get_elapsed(player, now);
+    player->since = now;
+    player->state = pause ? FAKE_STATE_PAUSE : FAKE_STATE_PLAY;
+
+    fake_protocol_notify(server, FAKE_EVENT_PLAYER);
+}
+
+/**
+ * @brief Stops playback. The current song stays current.
+ */
+void fake_player_stop(struct fake_server *server)
+{
+    struct fake_player *player = &server->player;
+
+    player->state = FAKE_STATE_STOP;
+    player->elapsed_ms = 0;
+    player->since = fake_now();
+
+    fake_protocol_notify(server, FAKE_EVENT_PLAYER);
+}
+
+/**
+ * @brief Works out which position plays after the current one.
+ *
+ * @param finished Whether the current song played to its end, rather than being skipped.
+ * @return The next position, or -1 if playback should stop.
+ */
+static int fake_player_get_next(struct fake_server *server, bool finished)
+{
+    struct fake_player *player = &server->player;
+    unsigned length = server->queue.length;
+
+    if (length == 0)
+        return -1;
+    if (finished && player->single)
+        return player->repeat ? player->pos : -1;
+    if (player->random)
+        return rand_r(&server->seed) % length;
+    if ((unsigned)player->pos + 1 < length)
+        return player->pos + 1;
+    return player->repeat ? 0 : -1;
+}
+
+/**
+ * @brief Moves on from the current song, removing it first in consume mode.
+ */
+static void fake_player_advance(struct fake_server *server, bool finished)
+{
+    struct fake_player *player = &server->player;
+    int next;
+
+    if (player->consume && player->pos >= 0) {
+        unsigned pos = player->pos;
+
+        server->queue.version++;
+        fake_queue_delete(&server->queue, pos, pos + 1);
+        fake_protocol_notify(server, FAKE_EVENT_PLAYLIST);
+
+        /* The next song has moved into the removed song's position. */
+        player->pos = pos - 1;
+        if (player->random || (finished && player->single))
+            player->pos = (pos < server->queue.length) ? (int)pos : -1;
+    }
+
+    next = fake_player_get_next(server, finished);
+    if (next < 0) {
+        player->pos = server->queue.length ? 0 : -1;
+        fake_player_stop(server);
+    }
+    else
+        fake_player_play(server, next, 0);
+}
+
+/**
+ * @brief Skips to the next song.
+ */
+void fake_player_next(struct fake_server *server)
+{
+    if (server->player.state != FAKE_STATE_STOP)
+        fake_player_advance(server, false);
+}
+
+/**
+ * @brief Goes back to the previous song, or to the last song if repeating.
+ */
+void fake_player_previous(struct fake_server *server)
+{
+    struct fake_player *player = &server->player;
+
+    if (player->state == FAKE_STATE_STOP || server->queue.length == 0)
+        return;
+
+    if (player->pos > 0)
+        fake_player_play(server, player->pos - 1, 0);
+    else if (player->repeat)
+        fake_player_play(server, server->queue.length - 1, 0);
+    else
+        fake_player_play(server, 0, 0);
+}
+
+/**
+ * @brief Removes the songs in positions [start, end), keeping track of the current song.
+ *
+ * If the current song is removed, the song that takes its place plays instead.
+ */
+void fake_player_delete(struct fake_server *server, unsigned start, unsigned end)
+{
+    struct fake_player *player = &server->player;
+
+    server->queue.version++;
+    fake_queue_delete(&server->queue, start, end);
+    fake_protocol_notify(server, FAKE_EVENT_PLAYLIST);
+
+    if (player->pos < (int)start)
+        return;
+    if (player->pos >= (int)end) {
+        player->pos -= end - start;
+        return;
+    }
+
+    if (start < server->queue.length && player->state != FAKE_STATE_STOP)
+        fake_player_play(server, start, 0);
+    else {
+        player->pos = (start < server->queue.length) ? (int)start : -1;
+        fake_player_stop(server);
+    }
+}
+
+/**
+ * @brief Empties the queue and stops playback.
+ */
+void fake_player_clear(struct fake_server *server)
+{
+    server->queue.version++;
+    fake_queue_clear(&server->queue);
+    fake_protocol_notify(server, FAKE_EVENT_PLAYLIST);
+
+    server->player.pos = -1;
+    fake_player_stop(server);
+}
+
+/**
+ * @brief Moves on to the next song if the current one has finished.
+ */
+void fake_player_tick(struct fake_server *server, uint64_t now)
+{
+    struct fake_player *player = &server->player;
+
+    if (player->state != FAKE_STATE_PLAY || player->pos < 0)
+        return;
+
+    unsigned song = server->queue.entries[player->pos].song;
+    uint64_t duration = fake_library_get_duration(&server->library, song) * 1000ULL;
+
+    if (fake_player_get_elapsed(player, now) >= duration)
+        fake_player_advance(server, true);
+}
+
+/**
+ * @brief Gets how long until the current song finishes.
+ *
+ * @return The time in milliseconds, or -1 if nothing is playing.
+ */
+int64_t fake_player_get_deadline(const struct fake_server *server, uint64_t now)
+{
+    const struct fake_player *player = &server->player;
+
+    if (player->state != FAKE_STATE_PLAY || player->pos < 0)
+        return -1;
+
+    unsigned song = server->queue.entries[player->pos].song;
+    uint64_t duration = fake_library_get_duration(&server->library, song) * 1000ULL;
+    uint64_t elapsed = fake_player_get_elapsed(player, now);
+
+    return (elapsed >= duration) ? 0 : (int64_t)(duration - elapsed);
+}
@@ -0,0 +1,896 @@
+/*******************************************************************************
+ * protocol.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file fakempd.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "fakempd.h"
+
+/* Error codes sent in ACK responses, as MPD numbers them. */
+#define ACK_ERROR_ARG 2
+#define ACK_ERROR_UNKNOWN 5
+#define ACK_ERROR_NO_EXIST 50
+
+/**
+ * @brief Everything a command handler needs to run a command and respond to it.
+ */
+struct fake_context {
+    struct fake_server *server;
+    struct fake_client *client;
+    struct fake_buffer *out; /**< The response being built. */
+    char message[128];       /**< Set by a handler that fails, for the ACK line. */
+};
+
+/**
+ * @brief A search's tag constraints, as tag/value pairs, and the range of results wanted.
+ */
+struct fake_filter {
+    int tags[FAKEMPD_MAX_ARGS / 2];
+    const char *values[FAKEMPD_MAX_ARGS / 2];
+    int count;
+    unsigned window_start;
+    unsigned window_end;
+};
+
+struct fake_command {
+    const char *name;
+    int min_args;
+    int max_args;
+    int (*run)(struct fake_context *context, int argc, char **argv);
+};
+
+static const char *event_names[] = {"database", "update", "stored_playlist", "playlist",
+                                    "player",   "mixer",  "output",          "options"};
+
+/**
+ * @brief Fails a command with an ACK error.
+ *
+ * @return The error code, to be returned by the handler.
+ */
+static int fake_fail(struct fake_context *context, int code, const char *message)
+{
+    snprintf(context->message, sizeof(context->message), "%s", message);
+    return code;
+}
+
+/**
+ * @brief Parses an unsigned number that has to take up the whole argument.
+ */
+static bool fake_parse_unsigned(const char *str, unsigned *value)
+{
+    char *end;
+    unsigned long result = strtoul(str, &end, 10);
+
+    if (end == str || *end != '\0')
+        return false;
+    *value = result;
+    return true;
+}
+
+/**
+ * @brief Parses a position or a START:END range of positions. A lone position is the
+ * range [pos, pos + 1), and a range with no end runs to the end of the queue.
+ */
+static bool fake_parse_range(const char *str, unsigned length, unsigned *start, unsigned *end)
+{
+    char *rest;
+
+    *start = strtoul(str, &rest, 10);
+    if (rest == str)
+        return false;
+    if (*rest == '\0')
+        *end = *start + 1;
+    else if (*rest == ':' && rest[1] == '\0')
+        *end = length;
+    else if (*rest == ':' && !fake_parse_unsigned(rest + 1, end))
+        return false;
+    else if (*rest != ':')
+        return false;
+
+    return *start < *end && *end <= length;
+}
+
+/**
+ * @brief Parses a boolean argument, which MPD sends as 0 or 1.
+ */
+static bool fake_parse_bool(const char *str, bool *value)
+{
+    if (strcmp(str, "0") != 0 && strcmp(str, "1") != 0)
+        return false;
+    *value = str[0] == '1';
+    return true;
+}
+
+/**
+ * @brief Splits a command line into arguments, in place.
+ *
+ * Arguments are separated by spaces, and can be quoted with double quotes. Inside quotes,
+ * a backslash escapes the next character.
+ *
+ * @return The number of arguments, or -1 if the line is malformed.
+ */
+static int fake_split(char *line, char **argv)
+{
+    int argc = 0;
+    char *p = line;
+
+    while (*p) {
+        while (*p == ' ' || *p == '\t')
+            ++p;
+        if (!*p)
+            break;
+        if (argc == FAKEMPD_MAX_ARGS)
+            return -1;
+
+        if (*p == '"') {
+            char *out = ++p;
+
+            argv[argc++] = out;
+            while (*p && *p != '"') {
+                if (*p == '\\' && p[1])
+                    ++p;
+                *out++ = *p++;
+            }
+            if (*p != '"')
+                return -1;
+            ++p;
+            *out = '\0';
+        }
+        else {
+            argv[argc++] = p;
+            while (*p && *p != ' ' && *p != '\t')
+                ++p;
+            if (*p)
+                *p++ = '\0';
+        }
+    }
+
+    return argc;
+}
+
+/**
+ * @brief Parses a search's arguments: tag/value pairs, then optional sort and window
+ * arguments. Sorting is accepted and ignored, since results are already in library order.
+ *
+ * @return true on success, false if the arguments are malformed.
+ */
+static bool fake_parse_filter(struct fake_filter *filter, int argc, char **argv,
+                              unsigned song_count)
+{
+    filter->count = 0;
+    filter->window_start = 0;
+    filter->window_end = song_count;
+
+    for (int i = 0; i < argc; i += 2) {
+        if (i + 1 == argc)
+            return false;
+        if (strcasecmp(argv[i], "sort") == 0)
+            continue;
+        if (strcasecmp(argv[i], "window") == 0) {
+            if (!fake_parse_range(argv[i + 1], song_count, &filter->window_start,
+                                  &filter->window_end))
+                return false;
+            continue;
+        }
+
+        int tag = fake_tag_parse(argv[i]);
+        if (tag < 0)
+            return false;
+
+        filter->tags[filter->count] = tag;
+        filter->values[filter->count++] = argv[i + 1];
+    }
+
+    return true;
+}
+
+/**
+ * @brief Checks a song against every constraint in a filter.
+ */
+static bool fake_filter_match(const struct fake_filter *filter, const struct fake_library *library,
+                              unsigned song)
+{
+    char value[64];
+
+    for (int i = 0; i < filter->count; ++i) {
+        fake_library_get_tag(library, song, filter->tags[i], value, sizeof(value));
+        if (strcmp(value, filter->values[i]) != 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the queue entry at a position, with its metadata.
+ */
+static void fake_print_entry(struct fake_server *server, unsigned pos, struct fake_buffer *out)
+{
+    struct fake_queue_entry *entry = &server->queue.entries[pos];
+
+    fake_library_print_song(&server->library, entry->song, out);
+    fake_buffer_printf(out, "Pos: %u\nId: %u\n", pos, entry->id);
+}
+
+static int cmd_ok(struct fake_context *context, int argc, char **argv)
+{
+    return 0;
+}
+
+static int cmd_status(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_server *server = context->server;
+    struct fake_player *player = &server->player;
+    static const char *states[] = {"stop", "play", "pause"};
+
+    fake_buffer_printf(context->out,
+                       "volume: %d\nrepeat: %d\nrandom: %d\nsingle: %d\nconsume: %d\n"
+                       "playlist: %u\nplaylistlength: %u\nmixrampdb: 0.000000\nstate: %s\n",
+                       player->volume, player->repeat, player->random, player->single,
+                       player->consume, server->queue.version, server->queue.length,
+                       states[player->state]);
+
+    if (player->crossfade)
+        fake_buffer_printf(context->out, "xfade: %d\n", player->crossfade);
+
+    if (player->pos >= 0) {
+        struct fake_queue_entry *entry = &server->queue.entries[player->pos];
+
+        fake_buffer_printf(context->out, "song: %d\nsongid: %u\n", player->pos, entry->id);
+        if ((unsigned)player->pos + 1 < server->queue.length)
+            fake_buffer_printf(context->out, "nextsong: %d\nnextsongid: %u\n", player->pos + 1,
+                               server->queue.entries[player->pos + 1].id);
+    }
+
+    if (player->state != FAKE_STATE_STOP && player->pos >= 0) {
+        unsigned song = server->queue.entries[player->pos].song;
+        unsigned duration = fake_library_get_duration(&server->library, song);
+        uint64_t elapsed = fake_player_get_elapsed(player, fake_now());
+
+        fake_buffer_printf(context->out,
+                           "time: %u:%u\nelapsed: %u.%03u\nbitrate: 1411\nduration: %u.000\n"
+                           "audio: 44100:16:2\n",
+                           (unsigned)(elapsed / 1000), duration, (unsigned)(elapsed / 1000),
+                           (unsigned)(elapsed % 1000), duration);
+    }
+
+    if (server->update_id)
+        fake_buffer_printf(context->out, "updating_db: %u\n", server->update_id);
+
+    return 0;
+}
+
+static int cmd_stats(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_server *server = context->server;
+    struct fake_library *library = &server->library;
+    unsigned long long playtime = 0;
+
+    for (unsigned i = 0; i < library->song_count; ++i)
+        playtime += fake_library_get_duration(library, i);
+
+    fake_buffer_printf(context->out,
+                       "artists: %u\nalbums: %u\nsongs: %u\nuptime: %ld\nplaytime: 0\n"
+                       "db_playtime: %llu\ndb_update: %ld\n",
+                       library->artists, library->artists * library->albums, library->song_count,
+                       (long)(time(NULL) - server->started), playtime, (long)library->db_update);
+    return 0;
+}
+
+static int cmd_currentsong(struct fake_context *context, int argc, char **argv)
+{
+    if (context->server->player.pos >= 0)
+        fake_print_entry(context->server, context->server->player.pos, context->out);
+    return 0;
+}
+
+static int cmd_playlistinfo(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_queue *queue = &context->server->queue;
+    unsigned start = 0;
+    unsigned end = queue->length;
+
+    if (argc > 1 && !fake_parse_range(argv[1], queue->length, &start, &end))
+        return fake_fail(context, ACK_ERROR_ARG, "Bad song index");
+
+    for (unsigned i = start; i < end; ++i)
+        fake_print_entry(context->server, i, context->out);
+    return 0;
+}
+
+static int cmd_playlistid(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_queue *queue = &context->server->queue;
+    unsigned id;
+
+    if (argc == 1)
+        return cmd_playlistinfo(context, 1, argv);
+    if (!fake_parse_unsigned(argv[1], &id))
+        return fake_fail(context, ACK_ERROR_ARG, "Invalid song ID");
+
+    int pos = fake_queue_find_id(queue, id);
+    if (pos < 0)
+        return fake_fail(context, ACK_ERROR_NO_EXIST, "No such song");
+
+    fake_print_entry(context->server, pos, context->out);
+    return 0;
+}
+
+static int cmd_plchanges(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_queue *queue = &context->server->queue;
+    bool brief = strcmp(argv[0], "plchangesposid") == 0;
+    unsigned version;
+
+    if (!fake_parse_unsigned(argv[1], &version))
+        return fake_fail(context, ACK_ERROR_ARG, "Invalid version");
+
+    for (unsigned i = 0; i < queue->length; ++i) {
+        if (queue->entries[i].version <= version)
+            continue;
+        if (brief)
+            fake_buffer_printf(context->out, "cpos: %u\nId: %u\n", i, queue->entries[i].id);
+        else
+            fake_print_entry(context->server, i, context->out);
+    }
+    return 0;
+}
+
+static int cmd_listallinfo(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_library *library = &context->server->library;
+    unsigned first = 0;
+    unsigned count = library->song_count;
+
+    if (argc > 1 && argv[1][0] && !fake_library_find_uri(library, argv[1], &first, &count))
+        return fake_fail(context, ACK_ERROR_NO_EXIST, "No such directory");
+
+    for (unsigned song = first; song < first + count; ++song) {
+        if (song % library->tracks == 0) {
+            char uri[64];
+            char *slash;
+
+            fake_library_get_tag(library, song, FAKE_TAG_FILE, uri, sizeof(uri));
+            slash = strrchr(uri, '/');
+            *slash = '\0';
+            if (song % (library->tracks * library->albums) == 0)
+                fake_buffer_printf(context->out, "directory: %.*s\n",
+                                   (int)(strchr(uri, '/') - uri), uri);
+            fake_buffer_printf(context->out, "directory: %s\n", uri);
+        }
+        fake_library_print_song(library, song, context->out);
+    }
+    return 0;
+}
+
+static int cmd_find(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_server *server = context->server;
+    struct fake_library *library = &server->library;
+    struct fake_filter filter;
+    bool add = strcmp(argv[0], "findadd") == 0;
+    unsigned found = 0;
+
+    if (!fake_parse_filter(&filter, argc - 1, argv + 1, library->song_count))
+        return fake_fail(context, ACK_ERROR_ARG, "Bad search arguments");
+
+    if (add)
+        server->queue.version++;
+
+    for (unsigned song = 0; song < library->song_count; ++song) {
+        if (!fake_filter_match(&filter, library, song))
+            continue;
+        if (found++ < filter.window_start || found > filter.window_end)
+            continue;
+
+        if (add)
+            fake_queue_add(&server->queue, song);
+        else
+            fake_library_print_song(library, song, context->out);
+    }
+
+    if (add)
+        fake_protocol_notify(server, FAKE_EVENT_PLAYLIST);
+    return 0;
+}
+
+static int cmd_list(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_library *library = &context->server->library;
+    struct fake_filter filter;
+    int tag = fake_tag_parse(argv[1]);
+    char *artist_filter[2] = {"artist", argv[argc - 1]};
+    char **filter_argv = argv + 2;
+    int filter_argc = argc - 2;
+
+    if (tag < 0)
+        return fake_fail(context, ACK_ERROR_ARG, "Unknown tag type");
+
+    /* The old form of "list album ARTIST" names the artist without a tag. */
+    if (tag == FAKE_TAG_ALBUM && argc == 3) {
+        filter_argv = artist_filter;
+        filter_argc = 2;
+    }
+    if (!fake_parse_filter(&filter, filter_argc, filter_argv, library->song_count))
+        return fake_fail(context, ACK_ERROR_ARG, "Bad search arguments");
+
+    unsigned key_count = fake_library_get_key_count(library, tag);
+    bool *seen = calloc(key_count, sizeof(*seen));
+    char value[64];
+
+    for (unsigned song = 0; song < library->song_count; ++song) {
+        unsigned key = fake_library_get_key(library, song, tag);
+
+        if (seen[key] || !fake_filter_match(&filter, library, song))
+            continue;
+        seen[key] = true;
+
+        fake_library_get_tag(library, song, tag, value, sizeof(value));
+        fake_buffer_printf(context->out, "%s: %s\n", fake_tag_label(tag), value);
+    }
+
+    free(seen);
+    return 0;
+}
+
+static int cmd_add(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_server *server = context->server;
+    unsigned first;
+    unsigned count;
+
+    if (!fake_library_find_uri(&server->library, argv[1], &first, &count))
+        return fake_fail(context, ACK_ERROR_NO_EXIST, "No such song");
+
+    server->queue.version++;
+    for (unsigned song = first; song < first + count; ++song)
+        fake_queue_add(&server->queue, song);
+    fake_protocol_notify(server, FAKE_EVENT_PLAYLIST);
+
+    return 0;
+}
+
+static int cmd_delete(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_server *server = context->server;
+    unsigned start;
+    unsigned end;
+
+    if (!fake_parse_range(argv[1], server->queue.length, &start, &end))
+        return fake_fail(context, ACK_ERROR_ARG, "Bad song index");
+
+    fake_player_delete(server, start, end);
+    return 0;
+}
+
+static int cmd_clear(struct fake_context *context, int argc, char **argv)
+{
+    fake_player_clear(context->server);
+    return 0;
+}
+
+static int cmd_play(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_server *server = context->server;
+    struct fake_player *player = &server->player;
+    unsigned pos;
+
+    if (argc == 1) {
+        if (player->state == FAKE_STATE_PAUSE)
+            fake_player_pause(server, false);
+        else if (player->state == FAKE_STATE_STOP && server->queue.length)
+            fake_player_play(server, player->pos < 0 ? 0 : player->pos, 0);
+        return 0;
+    }
+
+    if (strcmp(argv[0], "playid") == 0) {
+        int found = -1;
+
+        if (fake_parse_unsigned(argv[1], &pos))
+            found = fake_queue_find_id(&server->queue, pos);
+        if (found < 0)
+            return fake_fail(context, ACK_ERROR_NO_EXIST, "No such song");
+        pos = found;
+    }
+    else if (!fake_parse_unsigned(argv[1], &pos) || pos >= server->queue.length)
+        return fake_fail(context, ACK_ERROR_ARG, "Bad song index");
+
+    fake_player_play(server, pos, 0);
+    return 0;
+}
+
+static int cmd_pause(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_player *player = &context->server->player;
+    bool pause = player->state == FAKE_STATE_PLAY;
+
+    if (argc > 1 && !fake_parse_bool(argv[1], &pause))
+        return fake_fail(context, ACK_ERROR_ARG, "Boolean (0/1) expected");
+
+    fake_player_pause(context->server, pause);
+    return 0;
+}
+
+static int cmd_stop(struct fake_context *context, int argc, char **argv)
+{
+    fake_player_stop(context->server);
+    return 0;
+}
+
+static int cmd_next(struct fake_context *context, int argc, char **argv)
+{
+    fake_player_next(context->server);
+    return 0;
+}
+
+static int cmd_previous(struct fake_context *context, int argc, char **argv)
+{
+    fake_player_previous(context->server);
+    return 0;
+}
+
+static int cmd_seek(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_server *server = context->server;
+    struct fake_player *player = &server->player;
+    const char *time_arg = argv[argc - 1];
+    unsigned pos;
+    int found;
+
+    if (strcmp(argv[0], "seekcur") == 0) {
+        if (player->state == FAKE_STATE_STOP)
+            return fake_fail(context, ACK_ERROR_ARG, "Not playing");
+        pos = player->pos;
+    }
+    else if (strcmp(argv[0], "seekid") == 0) {
+        if (!fake_parse_unsigned(argv[1], &pos) ||
+            (found = fake_queue_find_id(&server->queue, pos)) < 0)
+            return fake_fail(context, ACK_ERROR_NO_EXIST, "No such song");
+        pos = found;
+    }
+    else if (!fake_parse_unsigned(argv[1], &pos) || pos >= server->queue.length)
+        return fake_fail(context, ACK_ERROR_ARG, "Bad song index");
+
+    /* seekcur takes an offset from the current time when the time has a sign. */
+    char *end;
+    double seconds = strtod(time_arg, &end);
+    if (end == time_arg || *end != '\0')
+        return fake_fail(context, ACK_ERROR_ARG, "Bad time");
+
+    int64_t elapsed = seconds * 1000;
+    if (strcmp(argv[0], "seekcur") == 0 && (time_arg[0] == '+' || time_arg[0] == '-'))
+        elapsed += fake_player_get_elapsed(player, fake_now());
+
+    unsigned duration = fake_library_get_duration(&server->library,
+                                                  server->queue.entries[pos].song);
+    if (elapsed < 0)
+        elapsed = 0;
+    if (elapsed > duration * 1000)
+        elapsed = duration * 1000;
+
+    bool paused = player->state == FAKE_STATE_PAUSE;
+    fake_player_play(server, pos, elapsed);
+    if (paused)
+        fake_player_pause(server, true);
+    return 0;
+}
+
+static int cmd_setvol(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_player *player = &context->server->player;
+    char *end;
+    long volume = strtol(argv[1], &end, 10);
+
+    if (end == argv[1] || *end != '\0')
+        return fake_fail(context, ACK_ERROR_ARG, "Bad volume");
+
+    /* The deprecated volume command changes the volume by an amount. */
+    if (strcmp(argv[0], "volume") == 0)
+        volume += player->volume;
+    if (volume < 0 || volume > 100)
+        return fake_fail(context, ACK_ERROR_ARG, "Invalid volume value");
+
+    player->volume = volume;
+    fake_protocol_notify(context->server, FAKE_EVENT_MIXER);
+    return 0;
+}
+
+static int cmd_option(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_player *player = &context->server->player;
+    bool *option = NULL;
+    bool value;
+
+    if (strcmp(argv[0], "repeat") == 0)
+        option = &player->repeat;
+    else if (strcmp(argv[0], "random") == 0)
+        option = &player->random;
+    else if (strcmp(argv[0], "single") == 0)
+        option = &player->single;
+    else
+        option = &player->consume;
+
+    if (!fake_parse_bool(argv[1], &value))
+        return fake_fail(context, ACK_ERROR_ARG, "Boolean (0/1) expected");
+
+    *option = value;
+    fake_protocol_notify(context->server, FAKE_EVENT_OPTIONS);
+    return 0;
+}
+
+static int cmd_crossfade(struct fake_context *context, int argc, char **argv)
+{
+    unsigned seconds;
+
+    if (!fake_parse_unsigned(argv[1], &seconds))
+        return fake_fail(context, ACK_ERROR_ARG, "Bad crossfade time");
+
+    context->server->player.crossfade = seconds;
+    fake_protocol_notify(context->server, FAKE_EVENT_OPTIONS);
+    return 0;
+}
+
+static int cmd_update(struct fake_context *context, int argc, char **argv)
+{
+    struct fake_server *server = context->server;
+    static unsigned next_id = 1;
+
+    if (!server->update_id) {
+        server->update_id = next_id++;
+        server->update_at = fake_now() + 100;
+        fake_protocol_notify(server, FAKE_EVENT_UPDATE);
+    }
+
+    fake_buffer_printf(context->out, "updating_db: %u\n", server->update_id);
+    return 0;
+}
+
+/* Sorted by name, for bsearch(). */
+static const struct fake_command commands[] = {
+    {"add", 1, 1, cmd_add},
+    {"binarylimit", 1, 1, cmd_ok},
+    {"clear", 0, 0, cmd_clear},
+    {"consume", 1, 1, cmd_option},
+    {"crossfade", 1, 1, cmd_crossfade},
+    {"currentsong", 0, 0, cmd_currentsong},
+    {"delete", 1, 1, cmd_delete},
+    {"find", 2, FAKEMPD_MAX_ARGS - 1, cmd_find},
+    {"findadd", 2, FAKEMPD_MAX_ARGS - 1, cmd_find},
+    {"list", 1, FAKEMPD_MAX_ARGS - 1, cmd_list},
+    {"listallinfo", 0, 1, cmd_listallinfo},
+    {"next", 0, 0, cmd_next},
+    {"password", 1, 1, cmd_ok},
+    {"pause", 0, 1, cmd_pause},
+    {"ping", 0, 0, cmd_ok},
+    {"play", 0, 1, cmd_play},
+    {"playid", 0, 1, cmd_play},
+    {"playlistid", 0, 1, cmd_playlistid},
+    {"playlistinfo", 0, 1, cmd_playlistinfo},
+    {"plchanges", 1, 2, cmd_plchanges},
+    {"plchangesposid", 1, 2, cmd_plchanges},
+    {"previous", 0, 0, cmd_previous},
+    {"random", 1, 1, cmd_option},
+    {"repeat", 1, 1, cmd_option},
+    {"seek", 2, 2, cmd_seek},
+    {"seekcur", 1, 1, cmd_seek},
+    {"seekid", 2, 2, cmd_seek},
+    {"setvol", 1, 1, cmd_setvol},
+    {"single", 1, 1, cmd_option},
+    {"stats", 0, 0, cmd_stats},
+    {"status", 0, 0, cmd_status},
+    {"stop", 0, 0, cmd_stop},
+    {"update", 0, 1, cmd_update},
+    {"volume", 1, 1, cmd_setvol},
+};
+
+static int fake_command_compare(const void *key, const void *command)
+{
+    return strcmp(key, ((const struct fake_command *)command)->name);
+}
+
+/**
+ * @brief Runs a single command, appending its response (but not the final OK) to the
+ * output.
+ *
+ * @param index The command's position in its command list, for the ACK line.
+ * @return true on success, or false if an ACK was sent.
+ */
+static bool fake_protocol_run(struct fake_context *context, char *line, int index)
+{
+    char *argv[FAKEMPD_MAX_ARGS];
+    int argc = fake_split(line, argv);
+
+    if (argc <= 0) {
+        fake_buffer_printf(context->out, "ACK [%d@%d] {} %s\n", ACK_ERROR_UNKNOWN, index,
+                           argc < 0 ? "Malformed command" : "No command given");
+        return false;
+    }
+
+    const struct fake_command *command =
+        bsearch(argv[0], commands, sizeof(commands) / sizeof(*commands), sizeof(*commands),
+                fake_command_compare);
+
+    if (!command) {
+        fake_buffer_printf(context->out, "ACK [%d@%d] {%s} unknown command \"%s\"\n",
+                           ACK_ERROR_UNKNOWN, index, argv[0], argv[0]);
+        return false;
+    }
+    if (argc - 1 < command->min_args || argc - 1 > command->max_args) {
+        fake_buffer_printf(context->out, "ACK [%d@%d] {%s} wrong number of arguments for \"%s\"\n",
+                           ACK_ERROR_ARG, index, argv[0], argv[0]);
+        return false;
+    }
+
+    int code = command->run(context, argc, argv);
+    if (code) {
+        fake_buffer_printf(context->out, "ACK [%d@%d] {%s} %s\n", code, index, argv[0],
+                           context->message);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Parses the subsystems an idle command waits for.
+ *
+ * @return The events, or every event if none are named.
+ */
+static unsigned fake_parse_events(int argc, char **argv)
+{
+    unsigned mask = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        for (int event = 0; event < (int)(sizeof(event_names) / sizeof(*event_names)); ++event) {
+            if (strcmp(argv[i], event_names[event]) == 0)
+                mask |= 1u << event;
+        }
+    }
+
+    return mask ? mask : FAKE_EVENT_ALL;
+}
+
+/**
+ * @brief Sends an idle client the events it's waiting for and takes it out of idle mode.
+ */
+static void fake_protocol_wake(struct fake_server *server, struct fake_client *client)
+{
+    struct fake_buffer out = {0};
+    unsigned events = client->events & client->idle_mask;
+
+    for (int event = 0; event < (int)(sizeof(event_names) / sizeof(*event_names)); ++event) {
+        if (events & (1u << event))
+            fake_buffer_printf(&out, "changed: %s\n", event_names[event]);
+    }
+    fake_buffer_printf(&out, "OK\n");
+
+    client->events &= ~events;
+    client->idle = false;
+
+    fake_client_send(server, client, out.data, out.length);
+    fake_buffer_free(&out);
+}
+
+/**
+ * @brief Tells every client that some subsystems have changed. Idle clients waiting on
+ * them are woken, and the rest hear about it the next time they go idle.
+ */
+void fake_protocol_notify(struct fake_server *server, unsigned events)
+{
+    for (int i = 0; i < server->client_count; ++i) {
+        struct fake_client *client = server->clients[i];
+
+        client->events |= events;
+        if (client->idle && (client->events & client->idle_mask))
+            fake_protocol_wake(server, client);
+    }
+}
+
+/**
+ * @brief Runs the commands in a finished command list and sends a single response.
+ */
+static void fake_protocol_run_list(struct fake_server *server, struct fake_client *client)
+{
+    struct fake_buffer out = {0};
+    struct fake_context context = {.server = server, .client = client, .out = &out};
+    char *line = client->list.data;
+    bool success = true;
+
+    for (int i = 0; i < client->list_count && success; ++i) {
+        char *next = line + strlen(line) + 1;
+
+        success = fake_protocol_run(&context, line, i);
+        if (success && client->list_ok)
+            fake_buffer_printf(&out, "list_OK\n");
+        line = next;
+    }
+    if (success)
+        fake_buffer_printf(&out, "OK\n");
+
+    client->in_list = false;
+    client->list.length = 0;
+    client->list_count = 0;
+
+    fake_client_send(server, client, out.data, out.length);
+    fake_buffer_free(&out);
+}
+
+/**
+ * @brief Handles one line received from a client.
+ *
+ * Lines inside a command list are saved until the list ends. An idle client may only
+ * send noidle; anything else closes the connection, as it does with MPD.
+ */
+void fake_protocol_execute(struct fake_server *server, struct fake_client *client, char *line)
+{
+    if (client->idle) {
+        if (strcmp(line, "noidle") == 0)
+            fake_protocol_wake(server, client);
+        else
+            client->closing = true;
+        return;
+    }
+
+    if (client->in_list) {
+        if (strcmp(line, "command_list_end") == 0)
+            fake_protocol_run_list(server, client);
+        else {
+            fake_buffer_append(&client->list, line, strlen(line) + 1);
+            client->list_count++;
+        }
+        return;
+    }
+
+    if (strcmp(line, "command_list_begin") == 0 || strcmp(line, "command_list_ok_begin") == 0) {
+        client->in_list = true;
+        client->list_ok = strcmp(line, "command_list_ok_begin") == 0;
+        return;
+    }
+    /* A noidle that crosses paths with the idle response is ignored. */
+    if (strcmp(line, "noidle") == 0)
+        return;
+    if (strcmp(line, "close") == 0) {
+        client->closing = true;
+        return;
+    }
+
+    if (strncmp(line, "idle", 4) == 0 && (line[4] == '\0' || line[4] == ' ')) {
+        char *argv[FAKEMPD_MAX_ARGS];
+        int argc = fake_split(line, argv);
+
+        client->idle = true;
+        client->idle_mask = fake_parse_events(argc, argv);
+        if (client->events & client->idle_mask)
+            fake_protocol_wake(server, client);
+        return;
+    }
+
+    struct fake_buffer out = {0};
+    struct fake_context context = {.server = server, .client = client, .out = &out};
+
+    if (fake_protocol_run(&context, line, 0))
+        fake_buffer_printf(&out, "OK\n");
+
+    fake_client_send(server, client, out.data, out.length);
+    fake_buffer_free(&out);
+}
@@ -0,0 +1,419 @@
+/*******************************************************************************
+ * server.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+/**
+ * @file fakempd.h
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fakempd.h"
+
+#define FAKE_READ_SIZE 4096      /* Bytes read from a client at a time. */
+#define FAKE_MIN_BURST 1500      /* The fewest bytes a throttled client can be sent at once. */
+#define FAKE_MAX_LINE (1 << 20) /* The longest command line accepted from a client. */
+
+static volatile sig_atomic_t stopping = 0;
+
+static void fake_handle_signal(int signal)
+{
+    (void)signal;
+    stopping = 1;
+}
+
+/**
+ * @brief Gets the current time on the monotonic clock, in milliseconds.
+ */
+uint64_t fake_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void fake_buffer_reserve(struct fake_buffer *buffer, size_t length)
+{
+    if (buffer->length + length + 1 <= buffer->capacity)
+        return;
+
+    while (buffer->length + length + 1 > buffer->capacity)
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+    buffer->data = realloc(buffer->data, buffer->capacity);
+}
+
+void fake_buffer_append(struct fake_buffer *buffer, const char *data, size_t length)
+{
+    fake_buffer_reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+void fake_buffer_printf(struct fake_buffer *buffer, const char *format, ...)
+{
+    va_list args;
+    va_list copy;
+
+    va_start(args, format);
+    va_copy(copy, args);
+    int length = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+
+    fake_buffer_reserve(buffer, length);
+    vsnprintf(buffer->data + buffer->length, length + 1, format, args);
+    buffer->length += length;
+    va_end(args);
+}
+
+void fake_buffer_free(struct fake_buffer *buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+/**
+ * @brief Queues part of a response for a client.
+ *
+ * A response that arrives while nothing is waiting to be sent is held back for the
+ * configured latency. One that arrives behind other output goes out after it.
+ */
+void fake_client_send(struct fake_server *server, struct fake_client *client, const char *data,
+                      size_t length)
+{
+    if (client->out_sent == client->out.length) {
+        client->out.length = 0;
+        client->out_sent = 0;
+        client->ready_at = fake_now() + server->options.latency;
+    }
+
+    fake_buffer_append(&client->out, data, length);
+}
+
+/**
+ * @brief Adds the bytes a throttled client has earned since it was last topped up.
+ */
+static void fake_client_refill(struct fake_server *server, struct fake_client *client,
+                               uint64_t now)
+{
+    double rate = server->options.throughput;
+    double burst = (rate / 20 > FAKE_MIN_BURST) ? rate / 20 : FAKE_MIN_BURST;
+
+    client->tokens += (now - client->refilled_at) * rate / 1000;
+    if (client->tokens > burst)
+        client->tokens = burst;
+    client->refilled_at = now;
+}
+
+/**
+ * @brief Gets how long until a client's waiting output can be sent.
+ *
+ * @return The time in milliseconds, 0 if it can be sent now, or -1 if nothing is waiting.
+ */
+static int64_t fake_client_get_deadline(struct fake_server *server, struct fake_client *client,
+                                        uint64_t now)
+{
+    if (client->out_sent == client->out.length)
+        return -1;
+    if (now < client->ready_at)
+        return client->ready_at - now;
+    if (!server->options.throughput)
+        return 0;
+
+    /* Waiting for a packet's worth of bytes keeps a slow client from being sent one byte at
+     * a time. */
+    size_t waiting = client->out.length - client->out_sent;
+    double wanted = (waiting < FAKE_MIN_BURST) ? waiting : FAKE_MIN_BURST;
+
+    fake_client_refill(server, client, now);
+    if (client->tokens < wanted)
+        return 1 + (wanted - client->tokens) * 1000 / server->options.throughput;
+    return 0;
+}
+
+/**
+ * @brief Sends as much waiting output as the socket and the throughput limit allow.
+ *
+ * @return false if the connection failed, true otherwise.
+ */
+static bool fake_client_flush(struct fake_server *server, struct fake_client *client,
+                              uint64_t now)
+{
+    size_t length = client->out.length - client->out_sent;
+
+    if (server->options.throughput && length > client->tokens)
+        length = client->tokens;
+    if (length == 0)
+        return true;
+
+    ssize_t sent = send(client->fd, client->out.data + client->out_sent, length, MSG_NOSIGNAL);
+    if (sent < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    client->out_sent += sent;
+    if (server->options.throughput)
+        client->tokens -= sent;
+    return true;
+}
+
+/**
+ * @brief Reads whatever a client has sent and runs each complete line.
+ *
+ * @return false if the client disconnected or sent something unreasonable, true otherwise.
+ */
+static bool fake_client_read(struct fake_server *server, struct fake_client *client)
+{
+    char buffer[FAKE_READ_SIZE];
+    ssize_t received = recv(client->fd, buffer, sizeof(buffer), 0);
+
+    if (received == 0)
+        return false;
+    if (received < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    fake_buffer_append(&client->in, buffer, received);
+
+    char *line = client->in.data;
+    char *end = client->in.data + client->in.length;
+    char *newline;
+
+    while (!client->closing && (newline = memchr(line, '\n', end - line))) {
+        *newline = '\0';
+        fake_protocol_execute(server, client, line);
+        line = newline + 1;
+    }
+
+    size_t rest = end - line;
+    memmove(client->in.data, line, rest);
+    client->in.length = rest;
+
+    return client->in.length < FAKE_MAX_LINE;
+}
+
+static void fake_client_free(struct fake_client *client)
+{
+    close(client->fd);
+    fake_buffer_free(&client->in);
+    fake_buffer_free(&client->out);
+    fake_buffer_free(&client->list);
+    free(client);
+}
+
+/**
+ * @brief Accepts a new client and greets it.
+ */
+static void fake_server_accept(struct fake_server *server)
+{
+    int fd = accept(server->listen_fd, NULL, NULL);
+    int on = 1;
+
+    if (fd < 0)
+        return;
+
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (server->client_count == server->client_capacity) {
+        server->client_capacity = server->client_capacity ? server->client_capacity * 2 : 8;
+        server->clients =
+            realloc(server->clients, server->client_capacity * sizeof(*server->clients));
+    }
+
+    struct fake_client *client = calloc(1, sizeof(*client));
+    char greeting[32];
+
+    client->fd = fd;
+    client->refilled_at = fake_now();
+    server->clients[server->client_count++] = client;
+
+    snprintf(greeting, sizeof(greeting), "OK MPD %s\n", FAKEMPD_VERSION);
+    fake_client_send(server, client, greeting, strlen(greeting));
+}
+
+/**
+ * @brief Starts listening, and sets up the library, the queue, and the player.
+ *
+ * @return true on success, or false if the server couldn't listen on the address.
+ */
+bool fake_server_initialize(struct fake_server *server, const struct fake_options *options)
+{
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(options->port)};
+    int on = 1;
+
+    memset(server, 0, sizeof(*server));
+    server->options = *options;
+    server->started = time(NULL);
+    server->seed = 1;
+
+    fake_library_initialize(&server->library, options->artists, options->albums,
+                            options->tracks);
+    fake_queue_initialize(&server->queue);
+    fake_player_initialize(&server->player);
+
+    for (unsigned i = 0; i < options->queue && i < server->library.song_count; ++i)
+        fake_queue_add(&server->queue, i);
+    if (options->play && server->queue.length)
+        fake_player_play(server, 0, 0);
+
+    if (inet_pton(AF_INET, options->host, &address.sin_addr) != 1) {
+        fprintf(stderr, "fakempd: invalid address %s\n", options->host);
+        return false;
+    }
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server->listen_fd, 16) != 0) {
+        fprintf(stderr, "fakempd: %s:%d: %s\n", options->host, options->port, strerror(errno));
+        close(server->listen_fd);
+        return false;
+    }
+
+    fcntl(server->listen_fd, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+void fake_server_free(struct fake_server *server)
+{
+    for (int i = 0; i < server->client_count; ++i)
+        fake_client_free(server->clients[i]);
+    free(server->clients);
+    fake_queue_free(&server->queue);
+    close(server->listen_fd);
+}
+
+/**
+ * @brief Finishes a running database update once its time is up.
+ */
+static void fake_server_update(struct fake_server *server, uint64_t now)
+{
+    if (!server->update_id || now < server->update_at)
+        return;
+
+    time_t db_update = time(NULL);
+
+    server->library.db_update =
+        (db_update > server->library.db_update) ? db_update : server->library.db_update + 1;
+    server->update_id = 0;
+    fake_protocol_notify(server, FAKE_EVENT_UPDATE | FAKE_EVENT_DATABASE);
+}
+
+/**
+ * @brief Picks the earlier of two deadlines, where -1 means no deadline.
+ */
+static int64_t fake_earliest(int64_t a, int64_t b)
+{
+    if (a < 0)
+        return b;
+    if (b < 0)
+        return a;
+    return (a < b) ? a : b;
+}
+
+/**
+ * @brief Serves clients until interrupted.
+ *
+ * @return The exit status for the program.
+ */
+int fake_server_run(struct fake_server *server)
+{
+    struct pollfd *fds = NULL;
+    int fds_capacity = 0;
+
+    signal(SIGINT, fake_handle_signal);
+    signal(SIGTERM, fake_handle_signal);
+
+    while (!stopping) {
+        uint64_t now = fake_now();
+        int64_t timeout = fake_player_get_deadline(server, now);
+
+        if (server->update_id)
+            timeout = fake_earliest(timeout, server->update_at > now ? server->update_at - now : 0);
+
+        if (fds_capacity < server->client_count + 1) {
+            fds_capacity = server->client_count + 1;
+            fds = realloc(fds, fds_capacity * sizeof(*fds));
+        }
+
+        fds[0] = (struct pollfd){.fd = server->listen_fd, .events = POLLIN};
+        for (int i = 0; i < server->client_count; ++i) {
+            struct fake_client *client = server->clients[i];
+            int64_t deadline = fake_client_get_deadline(server, client, now);
+
+            fds[i + 1] = (struct pollfd){.fd = client->fd, .events = POLLIN};
+            if (deadline == 0)
+                fds[i + 1].events |= POLLOUT;
+            else
+                timeout = fake_earliest(timeout, deadline);
+        }
+
+        if (poll(fds, server->client_count + 1, timeout) < 0 && errno != EINTR)
+            break;
+
+        now = fake_now();
+        fake_player_tick(server, now);
+        fake_server_update(server, now);
+
+        /* A command can notify every client, so none are removed until all have been served.
+         * Clients that are done are marked by clearing their descriptor. */
+        int count = server->client_count;
+        int kept = 0;
+
+        for (int i = 0; i < count; ++i) {
+            struct fake_client *client = server->clients[i];
+            bool alive = true;
+
+            if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+                alive = fake_client_read(server, client);
+            if (alive && fake_client_get_deadline(server, client, now) == 0)
+                alive = fake_client_flush(server, client, now);
+            if (alive && client->closing && client->out_sent == client->out.length)
+                alive = false;
+            if (!alive)
+                fds[i + 1].fd = -1;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (fds[i + 1].fd < 0)
+                fake_client_free(server->clients[i]);
+            else
+                server->clients[kept++] = server->clients[i];
+        }
+        server->client_count = kept;
+
+        if (fds[0].revents & POLLIN)
+            fake_server_accept(server);
+    }
+
+    free(fds);
+    return 0;
+}
@@ -0,0 +1,476 @@
+/*******************************************************************************
+ * latency.c
+ *******************************************************************************
+ * Copyright (C) 2022  Julianne Adams
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file latency.c
+ * @brief Measures how long the client takes to answer a keypress, end to end.
+ *
+ * The harness starts the stand-in MPD server, runs pantomime on a pseudo-terminal
+ * against it, and plays a scripted session of keystrokes. After each keystroke it reads
+ * the terminal output until the screen has been quiet for a while. That output is the
+ * frame the keystroke caused. The time to its first byte is how long the user waits to
+ * see a reaction. The time to its last byte is how long until the screen has caught up,
+ * including any replies from the server that the keystroke waited on.
+ */
+
+#include <argp.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LATENCY_ROWS 40               /* The height of the pseudo-terminal. */
+#define LATENCY_COLUMNS 120           /* The width of the pseudo-terminal. */
+#define LATENCY_STARTUP_QUIET 1000    /* Milliseconds without output before the first key. */
+#define LATENCY_STARTUP_TIMEOUT 10000 /* The longest wait for the client to start up. */
+#define LATENCY_SERVER_TIMEOUT 5000   /* The longest wait for the server to start listening. */
+
+#define KEY_PAGE_DOWN "\033[6~"
+#define KEY_PAGE_UP "\033[5~"
+#define KEY_F1 "\033OP"
+#define KEY_F2 "\033OQ"
+#define KEY_F3 "\033OR"
+
+/**
+ * @brief Keystrokes sent one at a time, with the output of each measured separately.
+ */
+struct latency_step {
+    const char *group; /* The kind of action, which results are reported by. */
+    const char *key;   /* The bytes the terminal sends for the key. */
+    int repeat;        /* How many times in a row the key is pressed. */
+};
+
+/* One round of the session. Each round ends where it started, so rounds can repeat.
+ * Panels are switched with the function keys, since a digit waits to see whether it
+ * starts a count. */
+static const struct latency_step latency_script[] = {
+    {"panel", KEY_F2, 1},
+    {"scroll", "j", 40},
+    {"page", KEY_PAGE_DOWN, 10},
+    {"page", KEY_PAGE_UP, 10},
+    {"scroll", "k", 40},
+    {"delete", "dd", 5},
+    {"panel", KEY_F3, 1},
+    {"scroll", "j", 20},
+    {"column", "l", 2},
+    {"add", " ", 5},
+    {"column", "h", 2},
+    {"scroll", "k", 20},
+    {"panel", KEY_F1, 1},
+};
+
+/**
+ * @brief What one keystroke caused.
+ */
+struct latency_sample {
+    const char *group;
+    uint64_t first; /* Nanoseconds from the keystroke to the first byte of output. */
+    uint64_t last;  /* Nanoseconds from the keystroke to the last byte of output. */
+    size_t bytes;   /* The number of bytes of output. */
+};
+
+struct latency_options {
+    const char *pantomime; /* The client to measure. */
+    const char *fakempd;   /* The stand-in server to start, or NULL to use a running server. */
+    int port;              /* The port the server listens on. */
+    unsigned queue;        /* The length of the stand-in server's queue. */
+    int rounds;            /* How many times the script is played. */
+    int quiet;             /* Milliseconds without output that end a frame. */
+};
+
+/**
+ * @brief Gets the monotonic time in nanoseconds.
+ */
+static uint64_t latency_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* Processes */
+
+/**
+ * @brief Starts the stand-in server and waits for it to accept connections.
+ *
+ * @return The server's process ID, or -1 if it didn't start.
+ */
+static pid_t latency_start_server(const struct latency_options *options)
+{
+    char port[16], queue[16];
+    snprintf(port, sizeof(port), "%d", options->port);
+    snprintf(queue, sizeof(queue), "%u", options->queue);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execlp(options->fakempd, options->fakempd, "--port", port, "--queue", queue, NULL);
+        perror(options->fakempd);
+        _exit(127);
+    }
+    if (pid < 0)
+        return -1;
+
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(options->port)};
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    uint64_t deadline = latency_now() + (uint64_t)LATENCY_SERVER_TIMEOUT * 1000000;
+    while (latency_now() < deadline) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        bool listening = connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0;
+        close(fd);
+        if (listening)
+            return pid;
+
+        if (waitpid(pid, NULL, WNOHANG) == pid)
+            return -1;
+        usleep(10000);
+    }
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+/**
+ * @brief Starts the client on a new pseudo-terminal.
+ *
+ * @param master Set to the terminal end the client's output is read from.
+ * @return The client's process ID, or -1 if it didn't start.
+ */
+static pid_t latency_start_client(const struct latency_options *options, int *master)
+{
+    struct winsize size = {.ws_row = LATENCY_ROWS, .ws_col = LATENCY_COLUMNS};
+    char port[16];
+    snprintf(port, sizeof(port), "%d", options->port);
+
+    pid_t pid = forkpty(master, NULL, NULL, &size);
+    if (pid == 0) {
+        setenv("TERM", "xterm", 1);
+        execlp(options->pantomime, options->pantomime, "--host", "127.0.0.1", "--port", port,
+               NULL);
+        perror(options->pantomime);
+        _exit(127);
+    }
+
+    return pid;
+}
+
+/* Measuring */
+
+/**
+ * @brief Reads output until there's been none for the given time.
+ *
+ * @param since When the wait started. Output times are measured from this.
+ * @param sample Filled in with when the output arrived and how much of it there was.
+ * @param timeout The longest to wait in total, in milliseconds, or -1 to wait forever.
+ * @return false if the client closed the terminal, true otherwise.
+ */
+static bool latency_read_frame(int master, int quiet, uint64_t since,
+                               struct latency_sample *sample, int timeout)
+{
+    char buffer[65536];
+    uint64_t deadline = since + (uint64_t)timeout * 1000000;
+
+    sample->first = 0;
+    sample->last = 0;
+    sample->bytes = 0;
+
+    for (;;) {
+        int wait = quiet;
+        if (timeout >= 0) {
+            uint64_t now = latency_now();
+            if (now >= deadline)
+                return true;
+            if ((deadline - now) / 1000000 < (uint64_t)wait)
+                wait = (deadline - now) / 1000000;
+        }
+
+        struct pollfd pfd = {.fd = master, .events = POLLIN};
+        int ready = poll(&pfd, 1, wait);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready <= 0)
+            return true;
+
+        ssize_t count = read(master, buffer, sizeof(buffer));
+        if (count <= 0)
+            return false;
+
+        uint64_t arrived = latency_now() - since;
+        if (!sample->bytes)
+            sample->first = arrived;
+        sample->last = arrived;
+        sample->bytes += count;
+    }
+}
+
+/**
+ * @brief Plays the script, recording what each keystroke caused.
+ *
+ * @param samples Room for every keystroke in every round.
+ * @return The number of samples recorded, which is short if the client exited early.
+ */
+static int latency_play(int master, const struct latency_options *options,
+                        struct latency_sample *samples)
+{
+    int count = 0;
+
+    for (int round = 0; round < options->rounds; ++round) {
+        for (size_t i = 0; i < sizeof(latency_script) / sizeof(latency_script[0]); ++i) {
+            const struct latency_step *step = &latency_script[i];
+
+            for (int j = 0; j < step->repeat; ++j) {
+                struct latency_sample *sample = &samples[count];
+                uint64_t sent = latency_now();
+
+                if (write(master, step->key, strlen(step->key)) < 0 ||
+                    !latency_read_frame(master, options->quiet, sent, sample, -1))
+                    return count;
+
+                sample->group = step->group;
+                ++count;
+            }
+        }
+    }
+
+    return count;
+}
+
+/* Reporting */
+
+static int latency_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Gets a percentile of a sorted array by the nearest-rank method.
+ */
+static uint64_t latency_percentile(const uint64_t *sorted, int count, int percent)
+{
+    int rank = (count * percent + 99) / 100;
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * @brief Prints the results for the samples in a group, or for every sample if it's NULL.
+ *
+ * Keystrokes that drew nothing, like moving up at the top of a list, are counted but
+ * left out of the times and sizes.
+ */
+static void latency_report(const char *group, const struct latency_sample *samples, int count)
+{
+    uint64_t *first = malloc(count * sizeof(*first));
+    uint64_t *last = malloc(count * sizeof(*last));
+    uint64_t *bytes = malloc(count * sizeof(*bytes));
+    int frames = 0;
+    int keys = 0;
+
+    for (int i = 0; i < count; ++i) {
+        if (group && strcmp(samples[i].group, group) != 0)
+            continue;
+
+        ++keys;
+        if (!samples[i].bytes)
+            continue;
+
+        first[frames] = samples[i].first;
+        last[frames] = samples[i].last;
+        bytes[frames] = samples[i].bytes;
+        ++frames;
+    }
+
+    if (frames) {
+        qsort(first, frames, sizeof(*first), latency_compare);
+        qsort(last, frames, sizeof(*last), latency_compare);
+        qsort(bytes, frames, sizeof(*bytes), latency_compare);
+
+        uint64_t total = 0;
+        for (int i = 0; i < frames; ++i)
+            total += bytes[i];
+
+        printf("%-8s %6d %6d %9.2f %9.2f %9.2f %9.2f %9llu %9llu\n", group ? group : "all", keys,
+               frames, latency_percentile(first, frames, 50) / 1e6,
+               latency_percentile(first, frames, 99) / 1e6,
+               latency_percentile(last, frames, 50) / 1e6,
+               latency_percentile(last, frames, 99) / 1e6,
+               (unsigned long long)(total / frames),
+               (unsigned long long)latency_percentile(bytes, frames, 99));
+    }
+    else if (keys)
+        printf("%-8s %6d %6d\n", group ? group : "all", keys, 0);
+
+    free(first);
+    free(last);
+    free(bytes);
+}
+
+/* Argument Parsing */
+
+const char *argp_program_version = "pantomime-latency 0.1";
+static char doc[] = "pantomime-latency -- Measures pantomime's keypress-to-frame latency "
+                    "on a pseudo-terminal";
+
+static struct argp_option options[] = {
+    {"pantomime", 'c', "PATH", 0, "The client to measure"},
+    {"fakempd", 's', "PATH", 0, "The stand-in server to start"},
+    {"external", 'e', 0, 0, "Use a server that's already running instead of starting one"},
+    {"port", 'p', "PORT", 0, "The port the server listens on"},
+    {"queue", 'q', "LENGTH", 0, "The number of songs in the stand-in server's queue"},
+    {"rounds", 'r', "COUNT", 0, "How many times to play the script"},
+    {"quiet", 'w', "MS", 0, "Milliseconds without output that end a frame"},
+    {0}};
+
+/* Parse a single option. */
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+    struct latency_options *arguments = state->input;
+
+    switch (key) {
+        case 'c':
+            arguments->pantomime = arg;
+            break;
+        case 's':
+            arguments->fakempd = arg;
+            break;
+        case 'e':
+            arguments->fakempd = NULL;
+            break;
+        case 'p':
+            arguments->port = atoi(arg);
+            break;
+        case 'q':
+            arguments->queue = strtoul(arg, NULL, 10);
+            break;
+        case 'r':
+            arguments->rounds = atoi(arg);
+            break;
+        case 'w':
+            arguments->quiet = atoi(arg);
+            break;
+        case ARGP_KEY_ARG:
+            argp_usage(state);
+            break;
+        case ARGP_KEY_END:
+            if (arguments->rounds < 1 || arguments->quiet < 1)
+                argp_error(state, "the rounds and the quiet time must be positive");
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = {options, parse_opt, 0, doc};
+
+int main(int argc, char **argv)
+{
+    /* Default arguments. The quiet time leaves room for the server's replies, which are
+     * drawn after the keystroke's own redraw, to still count towards its frame. */
+    struct latency_options arguments = {
+        .pantomime = "pantomime",
+        .fakempd = "fakempd",
+        .port = 6611,
+        .queue = 5000,
+        .rounds = 5,
+        .quiet = 150,
+    };
+    argp_parse(&argp, argc, argv, 0, 0, &arguments);
+
+    pid_t server = -1;
+    if (arguments.fakempd) {
+        server = latency_start_server(&arguments);
+        if (server < 0) {
+            fprintf(stderr, "pantomime-latency: couldn't start %s\n", arguments.fakempd);
+            return 1;
+        }
+    }
+
+    int master;
+    pid_t client = latency_start_client(&arguments, &master);
+    if (client < 0) {
+        fprintf(stderr, "pantomime-latency: couldn't start %s\n", arguments.pantomime);
+        if (server > 0)
+            kill(server, SIGTERM);
+        return 1;
+    }
+
+    /* Let the client connect and draw its first screen before timing anything. */
+    struct latency_sample startup;
+    latency_read_frame(master, LATENCY_STARTUP_QUIET, latency_now(), &startup,
+                       LATENCY_STARTUP_TIMEOUT);
+
+    int steps = 0;
+    for (size_t i = 0; i < sizeof(latency_script) / sizeof(latency_script[0]); ++i)
+        steps += latency_script[i].repeat;
+
+    struct latency_sample *samples = malloc(steps * arguments.rounds * sizeof(*samples));
+    int count = samples ? latency_play(master, &arguments, samples) : 0;
+    bool finished = samples && count == steps * arguments.rounds;
+
+    if (write(master, "q", 1) == 1) {
+        struct latency_sample ignored;
+        latency_read_frame(master, arguments.quiet, latency_now(), &ignored, 1000);
+    }
+    kill(client, SIGTERM);
+    waitpid(client, NULL, 0);
+    close(master);
+    if (server > 0) {
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    }
+
+    printf("startup: %zu bytes in %.2f ms\n", startup.bytes, startup.last / 1e6);
+    printf("%-8s %6s %6s %9s %9s %9s %9s %9s %9s\n", "action", "keys", "frames", "first p50",
+           "first p99", "last p50", "last p99", "bytes avg", "bytes p99");
+
+    for (size_t i = 0; i < sizeof(latency_script) / sizeof(latency_script[0]); ++i) {
+        bool reported = false;
+        for (size_t j = 0; j < i; ++j)
+            reported |= strcmp(latency_script[i].group, latency_script[j].group) == 0;
+        if (!reported)
+            latency_report(latency_script[i].group, samples, count);
+    }
+    latency_report(NULL, samples, count);
+    printf("times are in milliseconds\n");
+
+    free(samples);
+
+    if (!finished) {
+        fprintf(stderr, "pantomime-latency: the client exited after %d keystrokes\n", count);
+        return 1;
+    }
+
+    return 0;
+}